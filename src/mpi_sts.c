@@ -313,11 +313,16 @@
 #include "utils/utilities.h"
 #include "utils/externs.h"
 #include "utils/debug.h"
+#include "utils/transform.h"
+#include "utils/numa.h"
 
 // STS executable location
 #define STS_EXE "./sts"
 #define MPI_STS_EXE "./mpi_sts"
 
+// name of the per-node shared memory object holding the input of every rank on that node
+#define NODE_WINDOW "sts.data"
+
 // STS version
 const char *const version = "3.2.6";
 
@@ -329,80 +334,79 @@ long int debuglevel = DBG_NONE;
 
 extern int job_rank;
 
+/*
+ * sts_run - run sts on an already parsed run state
+ *
+ * given:
+ *      run_state       // options set and dynamic arrays for this run
+ */
 int
-sts_main(int argc, char *argv[])
+sts_run(struct state *run_state)
 {
-	struct state run_state;		// Options set and dynamic arrays for this run
-
-	/*
-	 * Set default test parameters and parse command line
-	 */
-	parse_args(&run_state, argc, argv);
-
 	/*
 	 * Initialize all active tests
 	 */
-	init(&run_state);
+	init(run_state);
 	/*
 	 * Report state if debugging
 	 */
 	if (debuglevel > DBG_HIGH) {
-		print_option_summary(&run_state, "ready to test state");
+		print_option_summary(run_state, "ready to test state");
 	}
 
 	/*
 	 * Run test suite iterations if needed
 	 */
-	if (run_state.runMode != MODE_ASSESS_ONLY) {
-		invokeTestSuite(&run_state);
+	if (run_state->runMode != MODE_ASSESS_ONLY) {
+		invokeTestSuite(run_state);
 
 		/*
 		 * Print p-values and stats of each test in separate files (if needed)
 		 */
-		if (run_state.resultstxtFlag == true) {
-			print(&run_state);
+		if (run_state->resultstxtFlag == true) {
+			print(run_state);
 		}
 	}
 
 	/*
 	 * If only iterations were to be done, save the p-values to file
 	 */
-	if (run_state.runMode == MODE_ITERATE_ONLY) {
-		write_p_val_to_file(&run_state);
+	if (run_state->runMode == MODE_ITERATE_ONLY) {
+		write_p_val_to_file(run_state);
 	}
 
 	/*
 	 * If there were no iterations to do, but only assess, read the data from given files
 	 */
-	else if (run_state.runMode == MODE_ASSESS_ONLY) {
-		read_from_p_val_file(&run_state);
+	else if (run_state->runMode == MODE_ASSESS_ONLY) {
+		read_from_p_val_file(run_state);
 	}
 
 	/*
 	 * Perform metrics processing for each test and write final result to file
 	 */
-	if (run_state.runMode != MODE_ITERATE_ONLY) {
-		metrics(&run_state);
+	if (run_state->runMode != MODE_ITERATE_ONLY) {
+		metrics(run_state);
 	}
 
 	/*
 	 * Free memory no longer needed
 	 */
-	destroy(&run_state);
+	destroy(run_state);
 
 	/*
 	 * Tell user that the execution is completed
 	 */
 	//msg("Execution completed!");
-	if (run_state.runMode == MODE_ITERATE_AND_ASSESS || run_state.runMode == MODE_ASSESS_ONLY) {
-		if (run_state.legacy_output == true) {
+	if (run_state->runMode == MODE_ITERATE_AND_ASSESS || run_state->runMode == MODE_ASSESS_ONLY) {
+		if (run_state->legacy_output == true) {
 			msg("Check the finalAnalysisReport.txt file for the results");
 		} else {
 			//msg("Check the result.txt file for the results");
 		}
 	}
 
-	else if (run_state.runMode == MODE_ITERATE_ONLY) {
+	else if (run_state->runMode == MODE_ITERATE_ONLY) {
 		/*msg("A binary file (with extension .pvalues) containing the p-values of the tests has been generated.\n"
 				    "You can later assess the results of this and other runs by executing "
 				    "sts in '-m a' mode and passing that file's directory as an argument with the '-d' flag.");*/
@@ -412,6 +416,19 @@ sts_main(int argc, char *argv[])
 	return 0;
 }
 
+int
+sts_main(int argc, char *argv[])
+{
+	struct state run_state;		// Options set and dynamic arrays for this run
+
+	/*
+	 * Set default test parameters and parse command line
+	 */
+	parse_args(&run_state, argc, argv);
+
+	return sts_run(&run_state);
+}
+
 uint64_t get_file_size(char* fname) {
 
 	struct stat statbuf;
@@ -439,65 +456,261 @@ uint64_t get_file_size(char* fname) {
 
 }
 
-uint64_t call_sts(uint64_t buffer_length,char* data_buffer, char** ret_buffer) {
+// ranks that share a node, and the part of that node each of them owns
+struct node_layout {
 
-	// NOTE: buffer length is number of million bit runs, so multiply it by (1 << 17) to get the number of bytes
-	int size,rank;
-	int name_len;
-	char processor_name[MPI_MAX_PROCESSOR_NAME];
-	MPI_Comm_rank(MPI_COMM_WORLD,&rank);
-	MPI_Comm_size(MPI_COMM_WORLD,&size);
-	MPI_Get_processor_name(processor_name, &name_len);
+	MPI_Comm node_comm;
 
-	job_rank = rank;
+	int node_rank;
+	int node_size;
 
-	char hostname[500];
-	snprintf(hostname,500,"%s %02d",processor_name,rank);
-	int data_fs = shm_open("sts.data", O_CREAT | O_RDWR,S_IRUSR | S_IWUSR);
-	ftruncate(data_fs,buffer_length * (1 << 17));
-	char* buffer = (char*) mmap(NULL,buffer_length * (1 << 17),PROT_READ | PROT_WRITE,MAP_SHARED,data_fs,0);
-	if (buffer == (void*) -1) {
-		printf("[%s] mmap error: %d %s\n",hostname,errno,strerror(errno));
+	long threads;
+	long first_cpu;		// index into the CPUs we may run on, see numa_cpu()
+
+	char* window;
+	uint64_t window_size;
+
+};
+
+// find the ranks on our node and split the cores we may run on evenly between them
+// counting the affinity mask rather than the online CPUs keeps ranks inside a cgroup, taskset or Slurm allocation
+struct node_layout* make_node_layout() {
+
+	struct node_layout* nl = (struct node_layout*) malloc(sizeof(struct node_layout));
+
+	int rank;
+	MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+
+	MPI_Comm_split_type(MPI_COMM_WORLD, MPI_COMM_TYPE_SHARED, rank, MPI_INFO_NULL, &nl->node_comm);
+	MPI_Comm_rank(nl->node_comm, &nl->node_rank);
+	MPI_Comm_size(nl->node_comm, &nl->node_size);
+
+	long cores = numa_cpus();
+	long per_rank = cores / nl->node_size;
+	long extra = cores % nl->node_size;
+
+	// more ranks than cores on this node, all we can do is double up
+	if (per_rank == 0) {
+		nl->threads = 1;
+		nl->first_cpu = nl->node_rank % cores;
+	}
+	// the first extra ranks get one more core each
+	else {
+		nl->threads = per_rank + ((nl->node_rank < extra) ? 1 : 0);
+		nl->first_cpu = nl->node_rank * per_rank + MIN(nl->node_rank, extra);
+	}
+
+	nl->window = nullptr;
+	nl->window_size = 0;
+
+	return nl;
+
+}
+
+// map the node's shared input window, every rank on the node receives into its own slice of it
+char* map_node_window(struct node_layout* nl, uint64_t slice_size) {
+
+	int data_fs = -1;
+
+	nl->window_size = slice_size * nl->node_size;
+
+	// the node leader creates it, the others wait for it to exist before opening it
+	if (nl->node_rank == 0) {
+		shm_unlink(NODE_WINDOW);
+		data_fs = shm_open(NODE_WINDOW, O_CREAT | O_RDWR, S_IRUSR | S_IWUSR);
+		if (data_fs != -1 && ftruncate(data_fs, nl->window_size) == -1) {
+			printf("Error sizing %s: %s\n", NODE_WINDOW, strerror(errno));
+			exit(1);
+		}
+	}
+	MPI_Barrier(nl->node_comm);
+	if (nl->node_rank != 0) {
+		data_fs = shm_open(NODE_WINDOW, O_RDWR, S_IRUSR | S_IWUSR);
+	}
+	if (data_fs == -1) {
+		printf("Error opening %s: %s\n", NODE_WINDOW, strerror(errno));
 		exit(1);
 	}
 
-	memcpy(buffer,data_buffer,buffer_length * (1 << 17));
+	nl->window = (char*) mmap(NULL, nl->window_size, PROT_READ | PROT_WRITE, MAP_SHARED, data_fs, 0);
+	if (nl->window == (void*) -1) {
+		printf("Error mapping %s: %s\n", NODE_WINDOW, strerror(errno));
+		exit(1);
+	}
 	close(data_fs);
 
-	static char opt1[] = "-m";
-	static char opt2[] = "i";
-	static char opt3[] = "-i";
-	char opt4[30];
-	snprintf(opt4,30,"%ld",buffer_length);
-	//printf("[%03d] buff_len: %ld\n",rank,buffer_length);
-	static char file[] = "/dev/shm/sts.data";
-
-	int arg_c = 6;
-	char** args = malloc(6 * sizeof(void*));
-	args[0] = STS_EXE;
-	args[1] = opt1;
-	args[2] = opt2;
-	args[3] = opt3;
-	args[4] = opt4;
-	args[5] = file;
-
-	sts_main(arg_c, args);
-	// clean up our calling stuff
-	free(args);
-	munmap(buffer,buffer_length * (1<<17));
-	shm_unlink("sts.data");
-	remove("/dev/shm/sts.data");
+	return nl->window + nl->node_rank * slice_size;
+
+}
+
+// drop the node's input window once every rank on the node is done reading it
+void unmap_node_window(struct node_layout* nl) {
+
+	MPI_Barrier(nl->node_comm);
+
+	munmap(nl->window, nl->window_size);
+	if (nl->node_rank == 0) {
+		shm_unlink(NODE_WINDOW);
+	}
+
+}
+
+// what mpi_sts was asked to do, the sts options are parsed once on rank 0 and broadcast to every rank
+struct mpi_opts {
+
+	char* infile;
+	char* outfile;
+
+	// NOTE: only the plain option values of cfg are used, its pointers are only valid on rank 0
+	struct state cfg;
+
+};
+
+void mpi_usage() {
+	printf("Usage: ./mpi_sts [sts options] <filename> <outfile>\n");
+	printf("       sts options are those of sts, except for -m, -w, -d, -j, -L, -W and -A which mpi_sts sets itself\n");
+	printf("       and -N: mpi_sts places the ranks and their threads on the cores of each node itself\n");
+	printf("       and -C: mpi_sts pins the threads of each rank to its own share of the cores\n");
+	printf("       -Y tracefile is not supported: the ranks do not trace their runs\n");
+	printf("       -D qdepth is not supported: the ranks read their bitstreams from a shared memory window\n");
+	printf("       -s is not supported: the ranks only write p-values, which mpi_sts assesses\n");
+}
+
+// parse [sts options] <filename> <outfile> on rank 0 and share the parsed options with every rank
+struct mpi_opts* parse_mpi_args(int argc, char** argv) {
+
+	int rank;
+	MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+
+	struct mpi_opts* mo = (struct mpi_opts*) calloc(1, sizeof(struct mpi_opts));
+	int outfile_len = 0;
+
+	if (rank == 0) {
+		if (argc < 3) {
+			mpi_usage();
+			MPI_Abort(MPI_COMM_WORLD, 1);
+		}
+		mo->infile = argv[argc - 2];
+		mo->outfile = strdup(argv[argc - 1]);
+		outfile_len = strlen(mo->outfile) + 1;
+
+		// sts sees everything but the outfile, the filename is its randdata
+		parse_args(&mo->cfg, argc - 1, argv);
+
+		if (mo->cfg.runModeFlag || mo->cfg.workDirFlag || mo->cfg.pvalues_dir != nullptr ||
+		    mo->cfg.jobnumFlag || mo->cfg.stdinData || !mo->cfg.batchmode || mo->cfg.sweepCount > 0 || mo->cfg.numaFlag ||
+		    mo->cfg.traceFlag || mo->cfg.manifestFlag || mo->cfg.pinThreadsFlag || mo->cfg.directIOFlag ||
+		    mo->cfg.resultstxtFlag) {
+			mpi_usage();
+			MPI_Abort(MPI_COMM_WORLD, 1);
+		}
+	}
+
+	MPI_Bcast(&mo->cfg, sizeof(mo->cfg), MPI_BYTE, 0, MPI_COMM_WORLD);
+	MPI_Bcast(&debuglevel, 1, MPI_LONG, 0, MPI_COMM_WORLD);
+	MPI_Bcast(&outfile_len, 1, MPI_INT, 0, MPI_COMM_WORLD);
+	if (rank != 0) {
+		mo->outfile = (char*) malloc(outfile_len);
+	}
+	MPI_Bcast(mo->outfile, outfile_len, MPI_CHAR, 0, MPI_COMM_WORLD);
+
+	return mo;
+
+}
+
+// bytes of input holding one bitstream
+uint64_t stream_bytes(struct mpi_opts* mo) {
+	return (mo->cfg.dataFormat == FORMAT_ASCII_01) ? mo->cfg.tp.n : transform_bytes(&mo->cfg);
+}
+
+// this rank's run state: rank 0's options on top of our own defaults, plus our share of the data and cores
+void make_rank_state(struct state* state, struct mpi_opts* mo, struct node_layout* nl, uint64_t streams) {
+
+	struct state* cfg = &mo->cfg;
+
+	default_state(state);
+
+	// plain option values only, rank 0's pointers mean nothing here
+	state->testVectorFlag = cfg->testVectorFlag;
+	memcpy(state->testVector, cfg->testVector, sizeof(state->testVector));
+	state->reportCycleFlag = cfg->reportCycleFlag;
+	state->reportCycle = cfg->reportCycle;
+	state->dataFormatFlag = cfg->dataFormatFlag;
+	state->dataFormat = cfg->dataFormat;
+	state->xformFlag = cfg->xformFlag;
+	state->xformLsbFirst = cfg->xformLsbFirst;
+	state->xformLittleEndian = cfg->xformLittleEndian;
+	state->xformWordBytes = cfg->xformWordBytes;
+	state->xformLowBits = cfg->xformLowBits;
+	state->xformDecimation = cfg->xformDecimation;
+	state->checkpointFlag = cfg->checkpointFlag;
+	state->checkpointCycle = cfg->checkpointCycle;
+	state->resumeFlag = cfg->resumeFlag;
+	state->memLimitFlag = cfg->memLimitFlag;
+	state->memLimit = cfg->memLimit;
+	state->tp = cfg->tp;
+	state->uniformityBinsFlag = cfg->uniformityBinsFlag;
+
+	// what this rank tests, our slice starts node_rank slices into the window file
+	state->runModeFlag = true;
+	state->runMode = MODE_ITERATE_ONLY;
+	state->iterationFlag = true;
+	state->tp.numOfBitStreams = streams;
+	state->randomDataArg = true;
+	state->randomDataPath = "/dev/shm/" NODE_WINDOW;
+	state->jobnumFlag = true;
+	state->jobnum = nl->node_rank;
+
+	// checkpoints and spilled results go to the output directory, /dev/shm is memory
+	if (state->checkpointFlag || state->resumeFlag || state->memLimitFlag) {
+		state->workDirFlag = true;
+		state->workDir = strdup(mo->outfile);
+	}
+
+	// our share of the node's cores, unless -T asked for a number of threads per rank
+	state->numberOfThreadsFlag = true;
+	state->numberOfThreads = (cfg->numberOfThreadsFlag && cfg->numberOfThreads > 0) ? cfg->numberOfThreads : nl->threads;
+	state->teamFlag = cfg->teamFlag;
+	state->teamSize = cfg->teamSize;
+	state->splitFlag = cfg->splitFlag;
+	state->splitParts = cfg->splitParts;
+	state->sliceFlag = cfg->sliceFlag;
+	if (!state->teamFlag) {
+		state->numberOfThreads = MIN(state->numberOfThreads, (long) streams);	// else init() trims them per -G team
+	}
+	state->pinThreadsFlag = true;
+	state->firstCpu = nl->first_cpu;
+	state->hugePagesFlag = cfg->hugePagesFlag;
+	state->timingFlag = cfg->timingFlag;
+	state->validateFlag = cfg->validateFlag;
+	state->readerThreadsFlag = cfg->readerThreadsFlag;
+	state->readerThreads = cfg->readerThreads;
+
+}
+
+uint64_t call_sts(struct state* run_state, struct node_layout* nl, char** ret_buffer) {
+
+	// NOTE: the data itself is already in our slice of the node window
+	int size,rank;
+	MPI_Comm_rank(MPI_COMM_WORLD,&rank);
+	MPI_Comm_size(MPI_COMM_WORLD,&size);
+
+	job_rank = rank;
+
+	sts_run(run_state);
+	unmap_node_window(nl);
 
 	// now deal with the results
 	char filename[500];
 	char full_filepath[600];
-	snprintf(filename,500,"sts.%04d.%s.1048576.pvalues", job_rank, opt4);
+	snprintf(filename,500,"sts.%04d.%ld.%ld.pvalues", job_rank, run_state->tp.numOfBitStreams, run_state->tp.n);
 	snprintf(full_filepath,600,"/dev/shm/%s",filename);	
 
-	data_fs = shm_open(filename,O_RDWR,S_IRUSR | S_IWUSR);
+	int data_fs = shm_open(filename,O_RDWR,S_IRUSR | S_IWUSR);
 	uint64_t fsize = get_file_size(full_filepath);
 
 	*ret_buffer = (char*) mmap(NULL,fsize,PROT_READ | PROT_WRITE,MAP_SHARED,data_fs,0);
+	close(data_fs);
 	return fsize;
 }
 
@@ -515,14 +728,16 @@ struct split_group {
 	uint64_t file_size;
 	uint64_t per_group;
 
+	uint64_t stream_bytes;
+	long bitcount;
+
 	bool am_plus1;
 
 };
 
-void clean_up(char* buffer, uint64_t size, struct split_group* sg) {
-	
-	munmap(buffer,size);
-		
+// unlink our result file, our mapping of it stays valid until we munmap it after gathering
+void clean_up(struct split_group* sg) {
+
 	int job_rank;
 
 	MPI_Comm_rank(MPI_COMM_WORLD, &job_rank);
@@ -533,8 +748,8 @@ void clean_up(char* buffer, uint64_t size, struct split_group* sg) {
 	char opt4[30];
 	snprintf(opt4,30,"%ld",sg->per_group + ((sg->am_plus1) ? 1 : 0));
 
-	snprintf(filename,500,"sts.%04d.%s.1048576.pvalues", job_rank, opt4);
-	snprintf(full_filepath,600,"/dev/shm%s",filename);
+	snprintf(filename,500,"sts.%04d.%s.%ld.pvalues", job_rank, opt4, sg->bitcount);
+	snprintf(full_filepath,600,"/dev/shm/%s",filename);
 	
 	shm_unlink(filename);
 	remove(full_filepath);
@@ -543,7 +758,7 @@ void clean_up(char* buffer, uint64_t size, struct split_group* sg) {
 }
 
 // split comm world into 2 groups for un-even data
-struct split_group* make_groups(uint64_t data_size) {
+struct split_group* make_groups(uint64_t data_size, struct mpi_opts* mo) {
 	
 	struct split_group* sg = (struct split_group*) malloc(sizeof(struct split_group));
 	
@@ -553,13 +768,19 @@ struct split_group* make_groups(uint64_t data_size) {
 	MPI_Comm_size(MPI_COMM_WORLD, &size);
 
 	sg->file_size = data_size;
+	sg->stream_bytes = stream_bytes(mo);
+	sg->bitcount = mo->cfg.tp.n;
 	
-	uint64_t num_runs = data_size / (1 << 17);
+	uint64_t num_runs = data_size / sg->stream_bytes;
+	// -i asks for at most that many bitstreams over all ranks
+	if (mo->cfg.iterationFlag && num_runs > (uint64_t) mo->cfg.tp.numOfBitStreams) {
+		num_runs = mo->cfg.tp.numOfBitStreams;
+	}
 
 	sg->per_group = num_runs / size;
 	sg->num_plus = num_runs % size;
 	if (rank == 0 && sg->num_plus) {
-		printf("Cutting off last %d bytes\n",sg->num_plus * (1 << 17));
+		printf("Cutting off last %ld bytes\n",sg->num_plus * sg->stream_bytes);
 	}
 	sg->num_plus = 0;
 	sg->num_norm = size - sg->num_plus;
@@ -602,7 +823,8 @@ struct split_group* make_groups(uint64_t data_size) {
 
 }
 
-char* get_data(struct split_group* sg, uint64_t* data_length, char* prov_data) {
+// NOTE: make_groups() never leaves plus ranks, so every slice of the node window holds per_group runs
+char* get_data(struct split_group* sg, uint64_t* data_length, char* prov_data, struct node_layout* nl) {
 	
 	int size, rank, rank2, size2;
 
@@ -620,15 +842,15 @@ char* get_data(struct split_group* sg, uint64_t* data_length, char* prov_data) {
 	// yay!! easy
 	if (sg->num_plus == 0) {
 		
-		ret_buffer = (char*) malloc(sg->per_group * (1 << 17));
+		ret_buffer = map_node_window(nl, sg->per_group * sg->stream_bytes);
 		*data_length = sg->per_group; 
-		MPI_Scatter(data_buffer,sg->per_group * (1 << 17),MPI_BYTE,ret_buffer,sg->per_group * (1 << 17),MPI_BYTE,0,MPI_COMM_WORLD);
+		MPI_Scatter(data_buffer,sg->per_group * sg->stream_bytes,MPI_BYTE,ret_buffer,sg->per_group * sg->stream_bytes,MPI_BYTE,0,MPI_COMM_WORLD);
 			
 	}
 	// no yay, not easy
 	else {
 		// how much data is in the normal part of it?
-		ret_buffer = (char*) calloc((sg->per_group + ((sg->am_plus1) ? 1 : 0)) * (1 << 17),1);
+		ret_buffer = map_node_window(nl, (sg->per_group + 1) * sg->stream_bytes);
 
 		if (ret_buffer == nullptr) {
 			fprintf(stderr,"very bad\n");
@@ -640,20 +862,20 @@ char* get_data(struct split_group* sg, uint64_t* data_length, char* prov_data) {
 			MPI_Comm_rank(sg->norm_comm, &rank2);
 			fprintf(stderr,"not plus %d, %d, %d\n",rank,rank2,size2);
 			if (rank == 0) {
-				fprintf(stderr,"%ld\n",(sg->num_plus * sg->per_group * (1 << 17)) + 
-                                        sg->num_plus * ((sg->per_group + 1) - sg->per_group) * (1 << 17));
+				fprintf(stderr,"%ld\n",(sg->num_plus * sg->per_group * sg->stream_bytes) + 
+                                        sg->num_plus * ((sg->per_group + 1) - sg->per_group) * sg->stream_bytes);
 			}
 			MPI_Scatter(data_buffer + 
-					(sg->num_plus * sg->per_group * (1 << 17)) + 
-					sg->num_plus * ((sg->per_group + 1) - sg->per_group) * (1 << 17),
-					sg->per_group * (1 << 17),
+					(sg->num_plus * sg->per_group * sg->stream_bytes) + 
+					sg->num_plus * ((sg->per_group + 1) - sg->per_group) * sg->stream_bytes,
+					sg->per_group * sg->stream_bytes,
 					MPI_BYTE,
 					ret_buffer,
-					sg->per_group * (1 << 17),
+					sg->per_group * sg->stream_bytes,
 					MPI_BYTE,
 					0,
 					sg->norm_comm);
-			*data_length = sg->per_group * (1 << 17);
+			*data_length = sg->per_group;
 			fprintf(stderr,"%d Are we good?\n",rank);
 		}
 	
@@ -666,8 +888,8 @@ char* get_data(struct split_group* sg, uint64_t* data_length, char* prov_data) {
 		// root will go through both because it has to
 		if (rank == 0 || sg->am_plus1) {
 			fprintf(stderr,"trying plus?\n");
-			MPI_Scatter(data_buffer,(sg->per_group + 1) * (1 << 17),MPI_BYTE,ret_buffer,(sg->per_group + 1) * (1 << 17),MPI_BYTE,0,sg->plus_comm);
-			*data_length = (sg->per_group + 1) * (1 << 17);
+			MPI_Scatter(data_buffer,(sg->per_group + 1) * sg->stream_bytes,MPI_BYTE,ret_buffer,(sg->per_group + 1) * sg->stream_bytes,MPI_BYTE,0,sg->plus_comm);
+			*data_length = sg->per_group + 1;
 			fprintf(stderr,"d-done?\n");
 
 
@@ -687,7 +909,7 @@ void write_res_to_file(char* buffer, uint64_t size, int rank, bool plus_one, str
 	char opt4[30];
 	snprintf(opt4,30,"%ld",sg->per_group + ((sg->am_plus1) ? 1 : 0));
 
-	snprintf(filename, 500, "sts.%04d.%s.1048576.pvalues", rank, opt4);
+	snprintf(filename, 500, "sts.%04d.%s.%ld.pvalues", rank, opt4, sg->bitcount);
 	snprintf(full_filepath,600,"/dev/shm/%s", filename);
 	int data_fs = shm_open(filename,O_CREAT | O_RDWR,S_IRUSR | S_IWUSR);
 	if (data_fs == -1) {
@@ -737,13 +959,19 @@ void gather_results(char* buffer, uint64_t size, struct split_group* sg) {
         }
 
 		write_res_to_file(buffer,size,0,sg->am_plus1,sg);
-		char* rbuffer = (char*) malloc((sg->per_group + 1) * (1 << 17));
+		// results are not proportional to the data, size the buffer by what each rank sends
+		char* rbuffer = NULL;
+		uint64_t rbuffer_size = 0;
 		uint64_t rsize;
 		uint8_t plus_one;
 		MPI_Status status;
 		for (int i = 1; i < mpi_size; i++) {
 			MPI_Recv(&rsize,1,MPI_UINT64_T,i,0,MPI_COMM_WORLD,&status);
 			MPI_Recv(&plus_one,1,MPI_UINT8_T,i,0,MPI_COMM_WORLD,&status);
+			if (rsize > rbuffer_size) {
+				rbuffer = (char*) realloc(rbuffer, rsize);
+				rbuffer_size = rsize;
+			}
 			MPI_Recv(rbuffer,rsize,MPI_CHAR,i,0,MPI_COMM_WORLD,&status);
 			write_res_to_file(rbuffer,rsize,i,plus_one,sg);	
 		}
@@ -757,9 +985,36 @@ void gather_results(char* buffer, uint64_t size, struct split_group* sg) {
 
 }
 
-void final_compute(char* outfile) {
-	char cmd[2048];
-	snprintf(cmd,2048,"%s -m a -d /dev/shm/ -w %s", MPI_STS_EXE, outfile);
+// assess everyone's p-values with the tests and parameters the ranks used, the files alone do not say
+void final_compute(struct mpi_opts* mo) {
+
+	struct state* cfg = &mo->cfg;
+	char cmd[4096];
+	int len;
+
+	len = snprintf(cmd,sizeof(cmd),"%s -m a -d /dev/shm/ -w %s -v %ld -S %ld -t ", MPI_STS_EXE, mo->outfile,
+		       debuglevel, cfg->tp.n);
+	for (int i = 1; i <= NUMOFTESTS; i++) {
+		if (cfg->testVector[i]) {
+			len += snprintf(cmd + len,sizeof(cmd) - len,"%d,",i);
+		}
+	}
+	cmd[len - 1] = ' ';
+	len += snprintf(cmd + len,sizeof(cmd) - len,"-P 1=%ld,2=%ld,3=%ld,4=%ld,5=%ld,6=%ld,10=%.17g,11=%.17g",
+			cfg->tp.blockFrequencyBlockLength, cfg->tp.nonOverlappingTemplateLength,
+			cfg->tp.overlappingTemplateLength, cfg->tp.approximateEntropyBlockLength,
+			cfg->tp.serialBlockLength, cfg->tp.linearComplexitySequenceLength,
+			cfg->tp.uniformity_level, cfg->tp.alpha);
+	if (cfg->uniformityBinsFlag) {
+		len += snprintf(cmd + len,sizeof(cmd) - len,",8=%ld",cfg->tp.uniformity_bins);
+	}
+	if (cfg->legacy_output) {
+		len += snprintf(cmd + len,sizeof(cmd) - len," -O");
+	}
+	if (cfg->subDirsFlag && !cfg->subDirs) {
+		len += snprintf(cmd + len,sizeof(cmd) - len," -c");
+	}
+
 	system(cmd);
 }
 
@@ -805,8 +1060,8 @@ int main(int argc, char** argv) {
 		exit(0);	
 	}
 
-    if (argc == 1) {
-        printf("Usage: ./mpi_sts <filename> <outfile>\n");
+    if (argc < 3) {
+        mpi_usage();
         exit(1);
     }
     
@@ -820,10 +1075,12 @@ int main(int argc, char** argv) {
 	MPI_Comm_rank(MPI_COMM_WORLD, &rank);
 	MPI_Comm_size(MPI_COMM_WORLD, &size);
 
+	struct mpi_opts* mo = parse_mpi_args(argc, argv);
+
 	uint64_t data_length;
 	char* data = NULL;
 	if (rank == 0) {
-		data = get_data_from_network(&data_length, argv[1]);
+		data = get_data_from_network(&data_length, mo->infile);
 	}
 
 	MPI_Bcast(&data_length,1,MPI_UINT64_T,0,MPI_COMM_WORLD);	
@@ -831,18 +1088,33 @@ int main(int argc, char** argv) {
 		printf("[%03d] Size: %ld\n",rank,data_length);
 	}
 	
-	struct split_group* sg = make_groups(data_length);
-	uint64_t calc_data_length;
-	char* calc_data = get_data(sg,&calc_data_length,data);
+	struct node_layout* nl = make_node_layout();
+	if (nl->node_rank == 0) {
+		printf("[%03d] %d ranks on this node, %ld threads each from cpu %ld\n",rank,nl->node_size,nl->threads,nl->first_cpu);
+	}
+
+	struct split_group* sg = make_groups(data_length, mo);
+	uint64_t calc_streams;
+	get_data(sg,&calc_streams,data,nl);
 	char* ret_buffer;
-	uint64_t ret = call_sts(calc_data_length,calc_data,&ret_buffer);
+	struct state run_state;
+	make_rank_state(&run_state,mo,nl,calc_streams);
+	uint64_t ret = call_sts(&run_state,nl,&ret_buffer);
+
+	// unlink our results before rank 0 rewrites everyone's, ranks sharing its node would remove them otherwise
+	clean_up(sg);
+	MPI_Barrier(MPI_COMM_WORLD);
 
 	// gather stuff
 	gather_results(ret_buffer,ret,sg);
-	clean_up(ret_buffer,ret,sg);
+	munmap(ret_buffer,ret);
+	MPI_Comm_free(&nl->node_comm);
+	free(nl);
 	if (rank == 0) {
-		final_compute(argv[2]);
+		final_compute(mo);
 	}
+	free(mo->outfile);
+	free(mo);
 
 	MPI_Finalize();
 	return 0;
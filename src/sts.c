@@ -334,39 +334,44 @@ main(int argc, char *argv[])
 	}
 
 	/*
-	 * Run test suite iterations if needed
+	 * Test randdata, or under -L manifest each source it lists in turn
 	 */
-	if (run_state.runMode != MODE_ASSESS_ONLY) {
-		invokeTestSuite(&run_state);
-
+	do {
 		/*
-		 * Print p-values and stats of each test in separate files (if needed)
+		 * Run test suite iterations if needed
 		 */
-		if (run_state.resultstxtFlag == true) {
-			print(&run_state);
+		if (run_state.runMode != MODE_ASSESS_ONLY) {
+			invokeTestSuite(&run_state);
+
+			/*
+			 * Print p-values and stats of each test in separate files (if needed)
+			 */
+			if (run_state.resultstxtFlag == true) {
+				print(&run_state);
+			}
 		}
-	}
 
-	/*
-	 * If only iterations were to be done, save the p-values to file
-	 */
-	if (run_state.runMode == MODE_ITERATE_ONLY) {
-		write_p_val_to_file(&run_state);
-	}
+		/*
+		 * If only iterations were to be done, save the p-values to file
+		 */
+		if (run_state.runMode == MODE_ITERATE_ONLY) {
+			write_p_val_to_file(&run_state);
+		}
 
-	/*
-	 * If there were no iterations to do, but only assess, read the data from given files
-	 */
-	else if (run_state.runMode == MODE_ASSESS_ONLY) {
-		read_from_p_val_file(&run_state);
-	}
+		/*
+		 * If there were no iterations to do, but only assess, read the data from given files
+		 */
+		else if (run_state.runMode == MODE_ASSESS_ONLY) {
+			read_from_p_val_file(&run_state);
+		}
 
-	/*
-	 * Perform metrics processing for each test and write final result to file
-	 */
-	if (run_state.runMode != MODE_ITERATE_ONLY) {
-		metrics(&run_state);
-	}
+		/*
+		 * Perform metrics processing for each test and write final result to file
+		 */
+		if (run_state.runMode != MODE_ITERATE_ONLY) {
+			metrics(&run_state);
+		}
+	} while (next_source(&run_state));
 
 	/*
 	 * Free memory no longer needed
@@ -35,6 +35,8 @@
 #include <errno.h>
 #include "../utils/externs.h"
 #include "../utils/utilities.h"
+#include "../utils/writer.h"
+#include "../utils/timing.h"
 #include "../utils/cephes.h"
 #include "../utils/debug.h"
 
@@ -80,7 +82,6 @@ void
 ApproximateEntropy_init(struct state *state)
 {
 	long int m;		// Approximate Entropy Test - block lengt
-	long int i;
 
 	/*
 	 * Check preconditions (firewall)
@@ -122,38 +123,17 @@ ApproximateEntropy_init(struct state *state)
 	}
 
 	/*
-	 * Allocate frequency count C array
+	 * Count the overlapping patterns of up to m+1 bits in each bitstream
 	 */
-	if (m > (BITS_N_LONGINT - 1)) {	// firewall
-		err(10, __func__, "m is too large, 1 << (m:%ld) can't be longer than %ld bits", m, BITS_N_LONGINT - 1);
-	}
-	state->apen_C_len = (long int) 1 << (m + 1);
-
-	/*
-	 * Allocate the array for the frequency count for each thread
-	 */
-	state->apen_C = malloc((size_t) state->numberOfThreads * sizeof(*state->apen_C));
-	if (state->apen_C == NULL) {
-		errp(10, __func__, "cannot malloc for apen_C: %ld elements of %ld bytes each", state->numberOfThreads,
-		     sizeof(*state->apen_C));
-	}
-	for (i = 0; i < state->numberOfThreads; i++) {
-		state->apen_C[i] = malloc(state->apen_C_len * sizeof(state->apen_C[i][0]));
-		if (state->apen_C[i] == NULL) {
-			errp(10, __func__, "cannot malloc of %ld elements of %ld bytes each for state->apen_C[%ld]",
-			     state->apen_C_len, sizeof(state->apen_C[i][0]), i);
-		}
-	}
+	reservePatterns(state, m + 1);
 
 	/*
 	 * Allocate dynamic arrays
 	 */
 	if (state->resultstxtFlag == true) {
-		state->stats[test_num] = create_dyn_array(sizeof(struct ApproximateEntropy_private_stats),
-							  DEFAULT_CHUNK, state->tp.numOfBitStreams, false);	// stats.txt
+		state->stats[test_num] = createResults(state, sizeof(struct ApproximateEntropy_private_stats), 1);	// stats.txt
 	}
-	state->p_val[test_num] = create_dyn_array(sizeof(double),
-						  DEFAULT_CHUNK, state->tp.numOfBitStreams, false);	// results.txt
+	state->p_val[test_num] = createResults(state, sizeof(double), state->partitionCount[test_num]);	// results.txt
 
 	/*
 	 * Determine format of data*.txt filenames based on state->partitionCount[test_num]
@@ -181,6 +161,7 @@ void
 ApproximateEntropy_iterate(struct thread_state *thread_state)
 {
 	struct ApproximateEntropy_private_stats stat;	// Stats for this iteration
+	uint64_t start;		// ticks when the p-value computation started
 	long int m;					// Approximate Entropy Test - block length
 	long int n;					// Length of a single bit stream
 	double p_value;					// p_value iteration test result(s)
@@ -204,6 +185,11 @@ ApproximateEntropy_iterate(struct thread_state *thread_state)
 		    __func__, state->testNames[test_num], test_num);
 	}
 
+	/*
+	 * Zeroize stats before performing the test
+	 */
+	memset(&stat, 0, sizeof(stat));
+
 	/*
 	 * Collect parameters from state
 	 */
@@ -225,13 +211,15 @@ ApproximateEntropy_iterate(struct thread_state *thread_state)
 	/*
 	 * Step 7: compute the test p-value
 	 */
+	start = timing_start();
 	p_value = cephes_igamc((double) ((long int) 1 << (m - 1)), stat.chi_squared / 2.0);
+	timing_stop(thread_state, TIMING_PVALUE, start);
 
 	/*
 	 * Lock mutex before making changes to the shared state
 	 */
 	if (thread_state->mutex != NULL) {
-		pthread_mutex_lock(thread_state->mutex);
+		timing_lock(thread_state, thread_state->mutex);
 	}
 
 	/*
@@ -263,7 +251,7 @@ ApproximateEntropy_iterate(struct thread_state *thread_state)
 	 * Record values computed during this iteration
 	 */
 	if (state->resultstxtFlag == true) {
-		append_value(state->stats[test_num], &stat);
+		recordStats(state, thread_state, test_num, &stat);
 	}
 	append_value(state->p_val[test_num], &p_value);
 
@@ -293,8 +281,7 @@ compute_phi(struct thread_state *thread_state, long int blocksize)
 {
 	long int n;		// Length of a single bit stream
 	long int powLen;	// Number of possible m-bit sub-sequences
-	long int mask;		// Bit-mask used to discard the extra bits of a sequence
-	long int dec;		// Decimal representation of an m-bit sub-sequence
+	long int *C;		// Count of each m-bit sub-sequence
 	double sum;		// Sum of the squares of all the counters, needed to compute psi-squared
 	long int i;
 
@@ -308,24 +295,9 @@ compute_phi(struct thread_state *thread_state, long int blocksize)
 	if (state == NULL) {
 		err(18, __func__, "state arg is NULL");
 	}
-	if (state->epsilon == NULL) {
-		err(18, __func__, "state->epsilon is NULL");
-	}
-	if (state->epsilon[thread_state->thread_id] == NULL) {
-		err(18, __func__, "state->epsilon[%ld] is NULL", thread_state->thread_id);
-	}
 	if (blocksize == 0) {
 		return 0.0;
 	}
-	if (blocksize > (BITS_N_LONGINT - 1)) {	// firewall
-		err(18, __func__, "m is too large, 1 << (m:%ld) can't be longer than %ld bits", blocksize, BITS_N_LONGINT - 1);
-	}
-	if (state->apen_C == NULL) {
-		err(18, __func__, "state->apen_C is NULL");
-	}
-	if (state->apen_C[thread_state->thread_id] == NULL) {
-		err(18, __func__, "state->apen_C[%ld] is NULL", thread_state->thread_id);
-	}
 
 	/*
 	 * Collect parameters from state
@@ -337,67 +309,23 @@ compute_phi(struct thread_state *thread_state, long int blocksize)
 	 * m-bit sub-sequences can possibly exist
 	 */
 	powLen = (long int) 1 << blocksize;
-	if (powLen > state->apen_C_len) {
-		err(18, __func__, "powLen: %ld is too large, "
-				"1 << blockSize: %ld > state->apen_C_len: %ld ", powLen, blocksize, state->apen_C_len);
-	}
-
-	/*
-	 * Zeroize those counters in the array C
-	 */
-	memset(state->apen_C[thread_state->thread_id], 0, powLen * sizeof(state->apen_C[thread_state->thread_id][0]));
-
-	/*
-	 * Compute the mask that will be used by the algorithm
-	 */
-	mask = (1 << blocksize) - 1;
 
 	/*
 	 * Step 2: compute the frequency of all the overlapping sub-sequences
 	 *
-	 * This algorithm works by taking each consecutive overlapping sub-sequence
-	 * of length blocksize from the original sequence epsilon of length n.
-	 *
-	 * For each sub-sequence found, the decimal representation is computed and
-	 * the corresponding counter in the array v is incremented.
-	 *
-	 * It is convenient to use the decimal representation because we can more easily
-	 * store and have access to the counters of each block in the array v with size 2^blocksize.
-	 *
-	 * NOTE: i % n is used to avoid appending blocksize-1 bits in the end (as indicated in the paper)
+	 * Each consecutive overlapping sub-sequence of length blocksize of the sequence epsilon,
+	 * wrapped around its end, is counted under its decimal representation.  The counts are
+	 * shared with the other block lengths of this and the Serial test (see countPatterns()).
 	 */
-	for (dec = 0, i = 0; i < n + blocksize; i++) {
-
-		/*
-		 * Get the decimal representation of the current block.
-		 * This line of code works by shifting the decimal representation of the
-		 * previous number left by 1 bit, adding to it the following bit of epsilon,
-		 * and then discarding the left-most bit by doing an AND with the mask (in fact,
-		 * the mask is used to keep only the right-most blocksize bits of the number).
-		 */
-		dec = ((dec << 1) + (int) state->epsilon[thread_state->thread_id][i % n]) & mask;
-
-		/*
-		 * If we have already counted the first (blocksize - 1) bits of epsilon,
-		 * count the occurrence of the current block in its corresponding counter.
-		 *
-		 * NOTE: this check is important because during the first (blocksize - 1) iterations
-		 * of this loop, dec will be the decimal representation of blocks of length
-		 * which is smaller than blocksize.
-		 */
-		if (i >= blocksize) {
-			state->apen_C[thread_state->thread_id][dec]++;
-		}
-	}
+	C = countPatterns(thread_state, blocksize);
 
 	/*
 	 * Step 3 and 4a: compute the the terms of the phi formula
 	 */
 	sum = 0.0;
 	for (i = 0; i < powLen; i++) {
-		if (state->apen_C[thread_state->thread_id][i]) {
-			sum += (double) state->apen_C[thread_state->thread_id][i] *
-					log(state->apen_C[thread_state->thread_id][i] / (double) n);
+		if (C[i]) {
+			sum += (double) C[i] * log(C[i] / (double) n);
 		}
 	}
 
@@ -577,31 +505,25 @@ ApproximateEntropy_print_p_value(FILE * stream, double p_value)
 
 
 /*
- * ApproximateEntropy_print - print to results.txt, data*.txt, stats.txt for all iterations
+ * ApproximateEntropy_print - print iterations to results.txt, data*.txt, stats.txt
  *
  * given:
  *      state           // run state to test under
+ *      first           // first iteration to print
+ *      last            // print up to but not including this iteration
  *
- * This function is called for once to print dynamic arrays into
- * results.txt, data*.txt, stats.txt.
+ * This function is called by the writer as iterations complete, to append
+ * their records to results.txt, data*.txt, stats.txt.
  *
- * NOTE: The initialize and iterate functions must be called before this function is called.
+ * NOTE: The files must have been opened by writer_open().
  */
 void
-ApproximateEntropy_print(struct state *state)
+ApproximateEntropy_print(struct state *state, long int first, long int last)
 {
 	struct ApproximateEntropy_private_stats *stat;	// Pointer to statistics of an iteration
+	struct test_output *out;	// Open stats.txt, results.txt, data*.txt
 	double p_value;			// p_value iteration test result(s)
-	FILE *stats = NULL;		// Open stats.txt file
-	FILE *results = NULL;		// Open results.txt file
-	FILE *data = NULL;		// Open data*.txt file
-	char *stats_txt = NULL;		// Pathname for stats.txt
-	char *results_txt = NULL;	// Pathname for results.txt
-	char *data_txt = NULL;		// Pathname for data*.txt
-	char data_filename[BUFSIZ + 1];	// Basename for a given data*.txt pathname
 	bool ok;			// true -> I/O was OK
-	int snprintf_ret;		// snprintf return value
-	int io_ret;			// I/O return status
 	long int i;
 	long int j;
 
@@ -625,40 +547,33 @@ ApproximateEntropy_print(struct state *state)
 		    "print driver interface for %s[%d] called with state.partitionCount: %d < 0",
 		    state->testNames[test_num], test_num, state->partitionCount[test_num]);
 	}
-	if (state->p_val[test_num]->count != (state->tp.numOfBitStreams * state->partitionCount[test_num])) {
+	if (state->output == NULL || state->output[test_num].stats == NULL) {
+		err(14, __func__, "print driver interface for %s[%d] called before its files were opened",
+		    state->testNames[test_num], test_num);
+	}
+	out = &state->output[test_num];
+	if (first < out->first || first > last || last > out->first + state->stats[test_num]->count) {
 		err(14, __func__,
-		    "print driver interface for %s[%d] called with p_val count: %ld != %ld*%d=%ld",
-		    state->testNames[test_num], test_num, state->p_val[test_num]->count,
-		    state->tp.numOfBitStreams, state->partitionCount[test_num],
-		    state->tp.numOfBitStreams * state->partitionCount[test_num]);
+		    "print driver interface for %s[%d] called for iterations [%ld, %ld) outside of recorded [%ld, %ld)",
+		    state->testNames[test_num], test_num, first, last, out->first,
+		    out->first + state->stats[test_num]->count);
 	}
-	if (state->datatxt_fmt[test_num] == NULL) {
-		err(14, __func__, "format for data0*.txt filename is NULL");
+	if (state->p_val[test_num]->count < (last * state->partitionCount[test_num])) {
+		err(14, __func__,
+		    "print driver interface for %s[%d] called with p_val count: %ld < %ld*%d=%ld",
+		    state->testNames[test_num], test_num, state->p_val[test_num]->count,
+		    last, state->partitionCount[test_num], last * state->partitionCount[test_num]);
 	}
 
-	/*
-	 * Open stats.txt file
-	 */
-	stats_txt = filePathName(state->subDir[test_num], "stats.txt");
-	dbg(DBG_HIGH, "about to open/truncate: %s", stats_txt);
-	stats = openTruncate(stats_txt);
-
-	/*
-	 * Open results.txt file
-	 */
-	results_txt = filePathName(state->subDir[test_num], "results.txt");
-	dbg(DBG_HIGH, "about to open/truncate: %s", results_txt);
-	results = openTruncate(results_txt);
-
 	/*
 	 * Write results.txt and stats.txt files
 	 */
-	for (i = 0; i < state->stats[test_num]->count; ++i) {
+	for (i = first; i < last; ++i) {
 
 		/*
 		 * Locate stat for this iteration
 		 */
-		stat = addr_value(state->stats[test_num], struct ApproximateEntropy_private_stats, i);
+		stat = addr_value(state->stats[test_num], struct ApproximateEntropy_private_stats, i - out->first);
 
 		/*
 		 * Get p_value for this iteration
@@ -669,115 +584,32 @@ ApproximateEntropy_print(struct state *state)
 		 * Print stat to stats.txt
 		 */
 		errno = 0;	// paranoia
-		ok = ApproximateEntropy_print_stat(stats, state, stat, p_value);
+		ok = ApproximateEntropy_print_stat(out->stats, state, stat, p_value);
 		if (ok == false) {
-			errp(14, __func__, "error in writing to %s", stats_txt);
+			errp(14, __func__, "error in writing to %s", out->stats_txt);
 		}
 
 		/*
 		 * Print p_value to results.txt
 		 */
 		errno = 0;	// paranoia
-		ok = ApproximateEntropy_print_p_value(results, p_value);
+		ok = ApproximateEntropy_print_p_value(out->results, p_value);
 		if (ok == false) {
-			errp(14, __func__, "error in writing to %s", results_txt);
+			errp(14, __func__, "error in writing to %s", out->results_txt);
 		}
-	}
-
-	/*
-	 * Flush and close stats.txt, free pathname
-	 */
-	errno = 0;		// paranoia
-	io_ret = fflush(stats);
-	if (io_ret != 0) {
-		errp(14, __func__, "error flushing to: %s", stats_txt);
-	}
-	errno = 0;		// paranoia
-	io_ret = fclose(stats);
-	if (io_ret != 0) {
-		errp(14, __func__, "error closing: %s", stats_txt);
-	}
-	free(stats_txt);
-	stats_txt = NULL;
-
-	/*
-	 * Flush and close results.txt, free pathname
-	 */
-	errno = 0;		// paranoia
-	io_ret = fflush(results);
-	if (io_ret != 0) {
-		errp(14, __func__, "error flushing to: %s", results_txt);
-	}
-	errno = 0;		// paranoia
-	io_ret = fclose(results);
-	if (io_ret != 0) {
-		errp(14, __func__, "error closing: %s", results_txt);
-	}
-	free(results_txt);
-	results_txt = NULL;
-
-	/*
-	 * Write data*.txt for each data file if we need to partition results
-	 */
-	if (state->partitionCount[test_num] > 1) {
-		for (j = 0; j < state->partitionCount[test_num]; ++j) {
-
-			/*
-			 * Form the data*.txt basename
-			 */
-			errno = 0;	// paranoia
-			snprintf_ret = snprintf(data_filename, BUFSIZ, state->datatxt_fmt[test_num], j + 1);
-			data_filename[BUFSIZ] = '\0';	// paranoia
-			if (snprintf_ret <= 0 || snprintf_ret >= BUFSIZ || errno != 0) {
-				errp(14, __func__, "snprintf failed for %d bytes for data%03ld.txt, returned: %d", BUFSIZ,
-				     j + 1, snprintf_ret);
-			}
-
-			/*
-			 * Form the data*.txt filename
-			 */
-			data_txt = filePathName(state->subDir[test_num], data_filename);
-			dbg(DBG_HIGH, "about to open/truncate: %s", data_txt);
-			data = openTruncate(data_txt);
-
-			/*
-			 * Write this particular data*.txt filename
-			 */
-			if (j < state->p_val[test_num]->count) {
-				for (i = j; i < state->p_val[test_num]->count; i += state->partitionCount[test_num]) {
-
-					/*
-					 * Get p_value for an iteration belonging to this data*.txt filename
-					 */
-					p_value = get_value(state->p_val[test_num], double, i);
-
-					/*
-					 * Print p_value to results.txt
-					 */
-					errno = 0;	// paranoia
-					ok = ApproximateEntropy_print_p_value(data, p_value);
-					if (ok == false) {
-						errp(14, __func__, "error in writing to %s", data_txt);
-					}
 
+		/*
+		 * Print the p_values of this iteration to the data*.txt of their partition
+		 */
+		if (state->partitionCount[test_num] > 1) {
+			for (j = 0; j < state->partitionCount[test_num]; ++j) {
+				p_value = get_value(state->p_val[test_num], double, (i * state->partitionCount[test_num]) + j);
+				errno = 0;	// paranoia
+				ok = ApproximateEntropy_print_p_value(out->data[j], p_value);
+				if (ok == false) {
+					errp(14, __func__, "error in writing to %s", out->data_txt[j]);
 				}
 			}
-
-			/*
-			 * Flush and close data*.txt, free pathname
-			 */
-			errno = 0;	// paranoia
-			io_ret = fflush(data);
-			if (io_ret != 0) {
-				errp(14, __func__, "error flushing to: %s", data_txt);
-			}
-			errno = 0;	// paranoia
-			io_ret = fclose(data);
-			if (io_ret != 0) {
-				errp(14, __func__, "error closing: %s", data_txt);
-			}
-			free(data_txt);
-			data_txt = NULL;
 		}
 	}
 
@@ -1082,8 +914,6 @@ ApproximateEntropy_metrics(struct state *state)
 void
 ApproximateEntropy_destroy(struct state *state)
 {
-	long int i;
-
 	/*
 	 * Check preconditions (firewall)
 	 */
@@ -1120,16 +950,6 @@ ApproximateEntropy_destroy(struct state *state)
 		free(state->subDir[test_num]);
 		state->subDir[test_num] = NULL;
 	}
-	for (i = 0; i < state->numberOfThreads; i++) {
-		if (state->apen_C[i] != NULL) {
-			free(state->apen_C[i]);
-			state->apen_C[i] = NULL;
-		}
-	}
-	if (state->apen_C != NULL) {
-		free(state->apen_C);
-		state->apen_C = NULL;
-	}
 
 	return;
 }
@@ -33,9 +33,13 @@
 #include <string.h>
 #include <stdlib.h>
 #include <errno.h>
+#include <limits.h>
 #include "../utils/externs.h"
 #include "../utils/cephes.h"
 #include "../utils/utilities.h"
+#include "../utils/writer.h"
+#include "../utils/timing.h"
+#include "../utils/split.h"
 #include "../utils/debug.h"
 
 
@@ -57,6 +61,7 @@ static const enum test test_num = TEST_BLOCK_FREQUENCY;	// This test number
 /*
  * Forward static function declarations
  */
+static split_fn BlockFrequency_part;
 static bool BlockFrequency_print_stat(FILE * stream, struct state *state, struct BlockFrequency_private_stats *stat,
 				      double p_value);
 static bool BlockFrequency_print_p_value(FILE * stream, double p_value);
@@ -140,11 +145,9 @@ BlockFrequency_init(struct state *state)
 	 * Allocate dynamic arrays
 	 */
 	if (state->resultstxtFlag == true) {
-		state->stats[test_num] = create_dyn_array(sizeof(struct BlockFrequency_private_stats),
-							  DEFAULT_CHUNK, state->tp.numOfBitStreams, false);	// stats.txt
+		state->stats[test_num] = createResults(state, sizeof(struct BlockFrequency_private_stats), 1);	// stats.txt
 	}
-	state->p_val[test_num] = create_dyn_array(sizeof(double),
-						  DEFAULT_CHUNK, state->tp.numOfBitStreams, false);	// results.txt
+	state->p_val[test_num] = createResults(state, sizeof(double), state->partitionCount[test_num]);	// results.txt
 
 	/*
 	 * Determine format of data*.txt filenames based on state->partitionCount[test_num]
@@ -158,6 +161,50 @@ BlockFrequency_init(struct state *state)
 }
 
 
+/*
+ * BlockFrequency_part - add up the squared deviations of the blocks of a piece of the bit stream
+ *
+ * given:
+ *      thread_state    // state of the thread testing the bit stream
+ *      arg             // array of the sum of each piece
+ *      part            // piece to add up
+ *      first           // first block of the piece
+ *      last            // block after the last block of the piece
+ *
+ * The deviation of a block of M bits with blockSum ones is 2 * blockSum - M, twice M times (pi - 0.5),
+ * so that the sum of their squares is an exact integer whatever the pieces are.
+ */
+static void
+BlockFrequency_part(struct thread_state *thread_state, void *arg, long int part, long int first, long int last)
+{
+	BitSequence *epsilon = thread_state->global_state->epsilon[thread_state->thread_id];
+	long int M = thread_state->global_state->tp.blockFrequencyBlockLength;
+	long int blockSum;	// Number of ones in a block
+	long int sum = 0;	// Sum of the squared deviations of the piece
+	long int i;
+	long int j;
+
+	for (i = first; i < last; i++) {
+
+		/*
+		 * Step 2: determine the proportion of ones in each M-bit block
+		 */
+		blockSum = 0;
+		for (j = 0; j < M; j++) {
+			if (epsilon[j + i * M]) {
+				blockSum++;
+			}
+		}
+
+		/*
+		 * Step 3a: prepare values required for computing the test statistic
+		 */
+		sum += (2 * blockSum - M) * (2 * blockSum - M);
+	}
+	((long int *) arg)[part] = sum;
+}
+
+
 /*
  * BlockFrequency_iterate - iterate one bit stream for Block Frequency test
  *
@@ -172,16 +219,15 @@ void
 BlockFrequency_iterate(struct thread_state *thread_state)
 {
 	struct BlockFrequency_private_stats stat;	// Stats for this iteration
+	uint64_t start;		// ticks when the p-value computation started
 	long int M;		// Length of each block to be tested
 	long int n;		// Length of a single bit stream
 	long int N;		// Number of independent M-bit blocks the bit stream is partitioned into
-	long int blockSum;      // Number of ones in a block
 	double p_value;		// p_value iteration test result(s)
-	double sum;             // Term of the chi squared formula
-	double pi;              // Proportion of ones in a block
-	double v;               // Value used in chi squared formula
+	long int sum[MAX_SPLIT];	// Sum of the squared block deviations of each piece of the bit stream
+	long int sq;		// Sum of the squared block deviations, 4 * M * M times the sum of (pi - 0.5)^2
+	long int parts;		// Number of pieces the bit stream is tested in
 	long int i;
-	long int j;
 
 	/*
 	 * Check preconditions (firewall)
@@ -204,6 +250,11 @@ BlockFrequency_iterate(struct thread_state *thread_state)
 		err(21, __func__, "state->epsilon[%ld] is NULL", thread_state->thread_id);
 	}
 
+	/*
+	 * Zeroize stats before performing the test
+	 */
+	memset(&stat, 0, sizeof(stat));
+
 	/*
 	 * Collect parameters from state
 	 */
@@ -213,43 +264,36 @@ BlockFrequency_iterate(struct thread_state *thread_state)
 
 	/*
 	 * Step 1: partition the sequence into N independent blocks
+	 *
+	 * NOTE: Each block adds at most M * M to the sum, so the sum is below n * M.
 	 */
-	sum = 0.0;
-	for (i = 0; i < N; i++) {
-
-		/*
-		 * Step 2: determine the proportion of ones in each M-bit block
-		 */
-		blockSum = 0;
-		for (j = 0; j < M; j++) {
-			if (state->epsilon[thread_state->thread_id][j + i * M]) {
-				blockSum++;
-			}
-		}
-		pi = (double) blockSum / (double) M;
-
-		/*
-        	 * Step 3a: prepare values required for computing the test statistic
-		 */
-		v = pi - 0.5;
-		sum += v * v;
+	if ((double) n * (double) M >= (double) LONG_MAX) {
+		err(21, __func__, "bitcount(n): %ld times block length(M): %ld is too large", n, M);
+	}
+	parts = split_parts(state, N, M);
+	split_run(thread_state, parts, N, BlockFrequency_part, sum);
+	sq = 0;
+	for (i = 0; i < parts; i++) {
+		sq += sum[i];
 	}
 
 	/*
-	 * Step 3b: compute the test statistic
+	 * Step 3b: compute the test statistic, 4 * M * sum of (pi - 0.5)^2
 	 */
-	stat.chi_squared = 4.0 * M * sum;
+	stat.chi_squared = (double) sq / (double) M;
 
 	/*
 	 * Step 4: compute the test P-value
 	 */
+	start = timing_start();
 	p_value = cephes_igamc(N / 2.0, stat.chi_squared / 2.0);
+	timing_stop(thread_state, TIMING_PVALUE, start);
 
 	/*
 	 * Lock mutex before making changes to the shared state
 	 */
 	if (thread_state->mutex != NULL) {
-		pthread_mutex_lock(thread_state->mutex);
+		timing_lock(thread_state, thread_state->mutex);
 	}
 
 	/*
@@ -281,7 +325,7 @@ BlockFrequency_iterate(struct thread_state *thread_state)
 	 * Record values computed during this iteration
 	 */
 	if (state->resultstxtFlag == true) {
-		append_value(state->stats[test_num], &stat);
+		recordStats(state, thread_state, test_num, &stat);
 	}
 	append_value(state->p_val[test_num], &p_value);
 
@@ -468,31 +512,25 @@ BlockFrequency_print_p_value(FILE * stream, double p_value)
 
 
 /*
- * BlockFrequency_print - print to results.txt, data*.txt, stats.txt for all iterations
+ * BlockFrequency_print - print iterations to results.txt, data*.txt, stats.txt
  *
  * given:
  *      state           // run state to test under
+ *      first           // first iteration to print
+ *      last            // print up to but not including this iteration
  *
- * This function is called for once to print dynamic arrays into
- * results.txt, data*.txt, stats.txt.
+ * This function is called by the writer as iterations complete, to append
+ * their records to results.txt, data*.txt, stats.txt.
  *
- * NOTE: The initialize and iterate functions must be called before this function is called.
+ * NOTE: The files must have been opened by writer_open().
  */
 void
-BlockFrequency_print(struct state *state)
+BlockFrequency_print(struct state *state, long int first, long int last)
 {
 	struct BlockFrequency_private_stats *stat;	// Pointer to statistics of an iteration
+	struct test_output *out;	// Open stats.txt, results.txt, data*.txt
 	double p_value;			// p_value iteration test result(s)
-	FILE *stats = NULL;		// Open stats.txt file
-	FILE *results = NULL;		// Open results.txt file
-	FILE *data = NULL;		// Open data*.txt file
-	char *stats_txt = NULL;		// Pathname for stats.txt
-	char *results_txt = NULL;	// Pathname for results.txt
-	char *data_txt = NULL;		// Pathname for data*.txt
-	char data_filename[BUFSIZ + 1];	// Basename for a given data*.txt pathname
 	bool ok;			// true -> I/O was OK
-	int snprintf_ret;		// snprintf return value
-	int io_ret;			// I/O return status
 	long int i;
 	long int j;
 
@@ -516,40 +554,33 @@ BlockFrequency_print(struct state *state)
 		    "print driver interface for %s[%d] called with state.partitionCount: %d < 0",
 		    state->testNames[test_num], test_num, state->partitionCount[test_num]);
 	}
-	if (state->p_val[test_num]->count != (state->tp.numOfBitStreams * state->partitionCount[test_num])) {
+	if (state->output == NULL || state->output[test_num].stats == NULL) {
+		err(24, __func__, "print driver interface for %s[%d] called before its files were opened",
+		    state->testNames[test_num], test_num);
+	}
+	out = &state->output[test_num];
+	if (first < out->first || first > last || last > out->first + state->stats[test_num]->count) {
 		err(24, __func__,
-		    "print driver interface for %s[%d] called with p_val count: %ld != %ld*%d=%ld",
-		    state->testNames[test_num], test_num, state->p_val[test_num]->count,
-		    state->tp.numOfBitStreams, state->partitionCount[test_num],
-		    state->tp.numOfBitStreams * state->partitionCount[test_num]);
+		    "print driver interface for %s[%d] called for iterations [%ld, %ld) outside of recorded [%ld, %ld)",
+		    state->testNames[test_num], test_num, first, last, out->first,
+		    out->first + state->stats[test_num]->count);
 	}
-	if (state->datatxt_fmt[test_num] == NULL) {
-		err(24, __func__, "format for data0*.txt filename is NULL");
+	if (state->p_val[test_num]->count < (last * state->partitionCount[test_num])) {
+		err(24, __func__,
+		    "print driver interface for %s[%d] called with p_val count: %ld < %ld*%d=%ld",
+		    state->testNames[test_num], test_num, state->p_val[test_num]->count,
+		    last, state->partitionCount[test_num], last * state->partitionCount[test_num]);
 	}
 
-	/*
-	 * Open stats.txt file
-	 */
-	stats_txt = filePathName(state->subDir[test_num], "stats.txt");
-	dbg(DBG_HIGH, "about to open/truncate: %s", stats_txt);
-	stats = openTruncate(stats_txt);
-
-	/*
-	 * Open results.txt file
-	 */
-	results_txt = filePathName(state->subDir[test_num], "results.txt");
-	dbg(DBG_HIGH, "about to open/truncate: %s", results_txt);
-	results = openTruncate(results_txt);
-
 	/*
 	 * Write results.txt and stats.txt files
 	 */
-	for (i = 0; i < state->stats[test_num]->count; ++i) {
+	for (i = first; i < last; ++i) {
 
 		/*
 		 * Locate stat for this iteration
 		 */
-		stat = addr_value(state->stats[test_num], struct BlockFrequency_private_stats, i);
+		stat = addr_value(state->stats[test_num], struct BlockFrequency_private_stats, i - out->first);
 
 		/*
 		 * Get p_value for this iteration
@@ -560,119 +591,32 @@ BlockFrequency_print(struct state *state)
 		 * Print stat to stats.txt
 		 */
 		errno = 0;	// paranoia
-		ok = BlockFrequency_print_stat(stats, state, stat, p_value);
+		ok = BlockFrequency_print_stat(out->stats, state, stat, p_value);
 		if (ok == false) {
-			errp(24, __func__, "error in writing to %s", stats_txt);
+			errp(24, __func__, "error in writing to %s", out->stats_txt);
 		}
 
 		/*
 		 * Print p_value to results.txt
 		 */
 		errno = 0;	// paranoia
-		ok = BlockFrequency_print_p_value(results, p_value);
+		ok = BlockFrequency_print_p_value(out->results, p_value);
 		if (ok == false) {
-			errp(24, __func__, "error in writing to %s", results_txt);
+			errp(24, __func__, "error in writing to %s", out->results_txt);
 		}
-	}
-
-	/*
-	 * Flush and close stats.txt, free pathname
-	 */
-	errno = 0;		// paranoia
-	io_ret = fflush(stats);
-	if (io_ret != 0) {
-		errp(24, __func__, "error flushing to: %s", stats_txt);
-	}
-	errno = 0;		// paranoia
-	io_ret = fclose(stats);
-	if (io_ret != 0) {
-		errp(24, __func__, "error closing: %s", stats_txt);
-	}
-	free(stats_txt);
-	stats_txt = NULL;
-
-	/*
-	 * Flush and close results.txt, free pathname
-	 */
-	errno = 0;		// paranoia
-	io_ret = fflush(results);
-	if (io_ret != 0) {
-		errp(24, __func__, "error flushing to: %s", results_txt);
-	}
-	errno = 0;		// paranoia
-	io_ret = fclose(results);
-	if (io_ret != 0) {
-		errp(24, __func__, "error closing: %s", results_txt);
-	}
-	free(results_txt);
-	results_txt = NULL;
-
-	/*
-	 * Write data*.txt for each data file if we need to partition results
-	 */
-	if (state->partitionCount[test_num] > 1) {
 
 		/*
-		 * For each data file
+		 * Print the p_values of this iteration to the data*.txt of their partition
 		 */
-		for (j = 0; j < state->partitionCount[test_num]; ++j) {
-
-			/*
-			 * Form the data*.txt basename
-			 */
-			errno = 0;	// paranoia
-			snprintf_ret = snprintf(data_filename, BUFSIZ, state->datatxt_fmt[test_num], j + 1);
-			data_filename[BUFSIZ] = '\0';	// paranoia
-			if (snprintf_ret <= 0 || snprintf_ret >= BUFSIZ || errno != 0) {
-				errp(24, __func__, "snprintf failed for %d bytes for data%03ld.txt, returned: %d", BUFSIZ,
-				     j + 1, snprintf_ret);
-			}
-
-			/*
-			 * Form the data*.txt filename
-			 */
-			data_txt = filePathName(state->subDir[test_num], data_filename);
-			dbg(DBG_HIGH, "about to open/truncate: %s", data_txt);
-			data = openTruncate(data_txt);
-
-			/*
-			 * Write this particular data*.txt filename
-			 */
-			if (j < state->p_val[test_num]->count) {
-				for (i = j; i < state->p_val[test_num]->count; i += state->partitionCount[test_num]) {
-
-					/*
-					 * Get p_value for an iteration belonging to this data*.txt filename
-					 */
-					p_value = get_value(state->p_val[test_num], double, i);
-
-					/*
-					 * Print p_value to results.txt
-					 */
-					errno = 0;	// paranoia
-					ok = BlockFrequency_print_p_value(data, p_value);
-					if (ok == false) {
-						errp(24, __func__, "error in writing to %s", data_txt);
-					}
-
+		if (state->partitionCount[test_num] > 1) {
+			for (j = 0; j < state->partitionCount[test_num]; ++j) {
+				p_value = get_value(state->p_val[test_num], double, (i * state->partitionCount[test_num]) + j);
+				errno = 0;	// paranoia
+				ok = BlockFrequency_print_p_value(out->data[j], p_value);
+				if (ok == false) {
+					errp(24, __func__, "error in writing to %s", out->data_txt[j]);
 				}
 			}
-
-			/*
-			 * Flush and close data*.txt, free pathname
-			 */
-			errno = 0;	// paranoia
-			io_ret = fflush(data);
-			if (io_ret != 0) {
-				errp(24, __func__, "error flushing to: %s", data_txt);
-			}
-			errno = 0;	// paranoia
-			io_ret = fclose(data);
-			if (io_ret != 0) {
-				errp(24, __func__, "error closing: %s", data_txt);
-			}
-			free(data_txt);
-			data_txt = NULL;
 		}
 	}
 
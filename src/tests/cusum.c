@@ -36,6 +36,11 @@
 #include "../utils/externs.h"
 #include "../utils/cephes.h"
 #include "../utils/utilities.h"
+#include "../utils/writer.h"
+#include "../utils/timing.h"
+#include "../utils/split.h"
+#include "../utils/slice.h"
+#include "../utils/memo.h"
 #include "../utils/debug.h"
 
 
@@ -50,15 +55,37 @@ struct CumulativeSums_private_stats {
 };
 
 
+/*
+ * Partial sums of a piece of the bit stream, relative to the sum before the piece
+ */
+struct CumulativeSums_piece {
+	long int S;		// Sum of the piece
+	long int S_max;		// Maximum partial sum within the piece, at least 0
+	long int S_min;		// Minimum partial sum within the piece, at most 0
+};
+
+
 /*
  * Static const variables declarations
  */
 static const enum test test_num = TEST_CUSUM;	// This test number
 
 
+/*
+ * The terms of the p-value sums whose normal arguments are all at least CUSUM_TAIL in absolute value
+ * add up to less than 4 * (1 - Phi(CUSUM_TAIL)) < 3.1e-23, and are left out (see compute_pi_value()).
+ *
+ * The p-value of each z up to CUSUM_MEMO_SIGMAS * sqrt(n) is computed once per run, by the first
+ * thread that needs it, and kept in the memo of the test.  Larger z are rare, and have few terms.
+ */
+#define CUSUM_TAIL (10.0)		// normal arguments beyond which the terms of the p-value are left out
+#define CUSUM_MEMO_SIGMAS (8.0)		// largest z whose p-value is kept, in units of sqrt(n)
+
+
 /*
  * Forward static function declarations
  */
+static split_fn CumulativeSums_part;
 static double compute_pi_value(struct state *state, long int z);
 static bool CumulativeSums_print_stat(FILE * stream, struct state *state, struct CumulativeSums_private_stats *stat,
 				      double p_value, double rev_p_value);
@@ -125,11 +152,16 @@ CumulativeSums_init(struct state *state)
 	 * Allocate dynamic arrays
 	 */
 	if (state->resultstxtFlag == true) {
-		state->stats[test_num] = create_dyn_array(sizeof(struct CumulativeSums_private_stats),
-							  DEFAULT_CHUNK, state->tp.numOfBitStreams, false);	// stats.txt
+		state->stats[test_num] = createResults(state, sizeof(struct CumulativeSums_private_stats), 1);	// stats.txt
 	}
-	state->p_val[test_num] = create_dyn_array(sizeof(double),
-						  DEFAULT_CHUNK, 2 * state->tp.numOfBitStreams, false);	// results.txt
+	state->p_val[test_num] = createResults(state, sizeof(double), state->partitionCount[test_num]);	// results.txt
+
+	/*
+	 * Keep the p-value of each z, computed as the iterations first need it
+	 */
+	state->memo[test_num] = memo_create(state->testNames[test_num],
+					    MIN(MIN(n, (long int) (CUSUM_MEMO_SIGMAS * state->c.sqrtn)) + 1,
+						2 * state->tp.numOfBitStreams));
 
 	/*
 	 * Determine format of data*.txt filenames based on state->partitionCount[test_num]
@@ -148,6 +180,37 @@ CumulativeSums_init(struct state *state)
 }
 
 
+/*
+ * CumulativeSums_part - scan the forward partial sums of a piece of the bit stream
+ *
+ * given:
+ *      thread_state    // state of the thread testing the bit stream
+ *      arg             // array of the struct CumulativeSums_piece of each piece
+ *      part            // piece to scan
+ *      first           // first bit of the piece
+ *      last            // bit after the last bit of the piece
+ */
+static void
+CumulativeSums_part(struct thread_state *thread_state, void *arg, long int part, long int first, long int last)
+{
+	BitSequence *epsilon = thread_state->global_state->epsilon[thread_state->thread_id];
+	struct CumulativeSums_piece *piece = (struct CumulativeSums_piece *) arg + part;
+	long int S = 0;
+	long int S_max = 0;
+	long int S_min = 0;
+	long int k;
+
+	for (k = first; k < last; k++) {
+		(epsilon[k] != 0) ? S++ : S--;
+		S_max = MAX(S, S_max);
+		S_min = MIN(S, S_min);
+	}
+	piece->S = S;
+	piece->S_max = S_max;
+	piece->S_min = S_min;
+}
+
+
 /*
  * CumulativeSums_iterate - iterate one bit stream for Cumulative Sums test
  *
@@ -162,12 +225,15 @@ void
 CumulativeSums_iterate(struct thread_state *thread_state)
 {
 	struct CumulativeSums_private_stats stat;	// Stats for this iteration
+	uint64_t start;		// ticks when the p-value computation started
 	long int n;			// Length of a single bit stream
 	long int S;			// Variable used to store the forward partial sums
 	long int S_max;			// Maximum forward partial sum
 	long int S_min;			// Minimum forward partial sum
 	double p_value_forward;		// p_value for forward test
 	double p_value_backward;	// p_value for backward test
+	struct CumulativeSums_piece piece[MAX_SPLIT];	// Partial sums of each piece of the bit stream
+	long int parts;			// Number of pieces the bit stream is scanned in
 	long int k;
 
 	/*
@@ -216,14 +282,28 @@ CumulativeSums_iterate(struct thread_state *thread_state)
 	 * partial sums and S is the final total sum of the adjusted values of epsilon,
 	 * the maximum and the minimum backwards partial sums will be respectively
 	 * (S - S_min) and (S - S_max).
+	 *
+	 * Likewise the extremes of each piece of the bit stream, offset by the sum of
+	 * the pieces before it, give the extremes of the whole bit stream.
+	 *
+	 * Under -B the bit-sliced engine found the extremes already.
 	 */
+	if (thread_state->lane != NULL) {
+		parts = 1;
+		piece[0].S = 2 * thread_state->lane->ones - n;
+		piece[0].S_max = thread_state->lane->S_max;
+		piece[0].S_min = thread_state->lane->S_min;
+	} else {
+		parts = split_parts(state, n, 1);
+		split_run(thread_state, parts, n, CumulativeSums_part, piece);
+	}
 	S = 0;
 	S_max = 0;
 	S_min = 0;
-	for (k = 0; k < n; k++) {
-		(state->epsilon[thread_state->thread_id][k] != 0) ? S++ : S--;
-		S_max = MAX(S, S_max);
-		S_min = MIN(S, S_min);
+	for (k = 0; k < parts; k++) {
+		S_max = MAX(S + piece[k].S_max, S_max);
+		S_min = MIN(S + piece[k].S_min, S_min);
+		S += piece[k].S;
 	}
 
 	/*
@@ -237,14 +317,16 @@ CumulativeSums_iterate(struct thread_state *thread_state)
 	/*
 	 * Step 4: compute test p-values
 	 */
+	start = timing_start();
 	p_value_forward = compute_pi_value(state, stat.z_forward);
 	p_value_backward = compute_pi_value(state, stat.z_backward);
+	timing_stop(thread_state, TIMING_PVALUE, start);
 
 	/*
 	 * Lock mutex before making changes to the shared state
 	 */
 	if (thread_state->mutex != NULL) {
-		pthread_mutex_lock(thread_state->mutex);
+		timing_lock(thread_state, thread_state->mutex);
 	}
 
 	/*
@@ -301,7 +383,7 @@ CumulativeSums_iterate(struct thread_state *thread_state)
 	 * Record values computed during this iteration
 	 */
 	if (state->resultstxtFlag == true) {
-		append_value(state->stats[test_num], &stat);
+		recordStats(state, thread_state, test_num, &stat);
 	}
 	append_value(state->p_val[test_num], &p_value_forward);
 	append_value(state->p_val[test_num], &p_value_backward);
@@ -330,8 +412,11 @@ static double
 compute_pi_value(struct state *state, long int z)
 {
 	long int n;		// Length of a single bit stream
+	double p_value;		// p-value of z
 	double sum1;		// First summation of the p-value formula
 	double sum2;		// Second summation of the p-value formula
+	double tail;		// CUSUM_TAIL in units of z / sqrt(n)
+	long int k_tail;	// Terms with |k| > k_tail have all normal arguments beyond CUSUM_TAIL
 	long int k;
 
 	/*
@@ -349,24 +434,44 @@ compute_pi_value(struct state *state, long int z)
 	 */
 	n = state->tp.n;
 
+	/*
+	 * Use the p-value of z if it was computed already
+	 */
+	if (memo_get(state->memo[test_num], (uint64_t) z, &p_value) == true) {
+		return p_value;
+	}
+
 	/*
 	 * Step 4a: compute terms needed for the test p-value
+	 *
+	 * The arguments of the terms of index k are (4k + c) z / sqrt(n) with c in [-1, 3], of absolute value at least
+	 * (4|k| - 3) z / sqrt(n).  The terms with |k| > k_tail, whose arguments are all beyond CUSUM_TAIL, are left out.
+	 * Each of the 4 runs of them left out telescopes to at most 1 - Phi(CUSUM_TAIL).  The reference implementation
+	 * of -V keeps them all.
 	 */
+	tail = CUSUM_TAIL * state->c.sqrtn / (double) z;
+	k_tail = (tail < (double) n && state->referenceInstance == false) ? (long int) ceil((tail + 3.0) / 4.0) : n;
 	sum1 = 0.0;
-	for (k = (-n / z + 1) / 4; k <= (n / z - 1) / 4; k++) {
+	for (k = MAX((-n / z + 1) / 4, -k_tail); k <= MIN((n / z - 1) / 4, k_tail); k++) {
 		sum1 += cephes_normal(((4 * k + 1) * z) / state->c.sqrtn);
 		sum1 -= cephes_normal(((4 * k - 1) * z) / state->c.sqrtn);
 	}
 	sum2 = 0.0;
-	for (k = (-n / z - 3) / 4; k <= (n / z - 1) / 4; k++) {
+	for (k = MAX((-n / z - 3) / 4, -k_tail); k <= MIN((n / z - 1) / 4, k_tail); k++) {
 		sum2 += cephes_normal(((4 * k + 3) * z) / state->c.sqrtn);
 		sum2 -= cephes_normal(((4 * k + 1) * z) / state->c.sqrtn);
 	}
 
 	/*
 	 * Step 4b: compute the test p-value
+	 *
+	 * Threads computing the same z at once store the same value.
 	 */
-	return 1.0 - sum1 + sum2;
+	p_value = 1.0 - sum1 + sum2;
+	if ((double) z <= CUSUM_MEMO_SIGMAS * state->c.sqrtn) {
+		memo_put(state->memo[test_num], (uint64_t) z, p_value);
+	}
+	return p_value;
 }
 
 
@@ -565,32 +670,26 @@ CumulativeSums_print_p_value(FILE * stream, double p_value)
 
 
 /*
- * CumulativeSums_print - print to results.txt, data*.txt, stats.txt for all iterations
+ * CumulativeSums_print - print iterations to results.txt, data*.txt, stats.txt
  *
  * given:
  *      state           // run state to test under
+ *      first           // first iteration to print
+ *      last            // print up to but not including this iteration
  *
- * This function is called for once to print dynamic arrays into
- * results.txt, data*.txt, stats.txt.
+ * This function is called by the writer as iterations complete, to append
+ * their records to results.txt, data*.txt, stats.txt.
  *
- * NOTE: The initialize and iterate functions must be called before this function is called.
+ * NOTE: The files must have been opened by writer_open().
  */
 void
-CumulativeSums_print(struct state *state)
+CumulativeSums_print(struct state *state, long int first, long int last)
 {
 	struct CumulativeSums_private_stats *stat;	// Pointer to statistics of an iteration
+	struct test_output *out;	// Open stats.txt, results.txt, data*.txt
 	double p_value;			// p_value iteration test result(s) - forward direction
 	double rev_p_value;		// p_value iteration test result(s) - backward direction
-	FILE *stats = NULL;		// Open stats.txt file
-	FILE *results = NULL;		// Open results.txt file
-	FILE *data = NULL;		// Open data*.txt file
-	char *stats_txt = NULL;		// Pathname for stats.txt
-	char *results_txt = NULL;	// Pathname for results.txt
-	char *data_txt = NULL;		// Pathname for data*.txt
-	char data_filename[BUFSIZ + 1];	// Basename for a given data*.txt pathname
 	bool ok;			// true -> I/O was OK
-	int snprintf_ret;		// snprintf return value
-	int io_ret;			// I/O return status
 	long int i;
 	long int j;
 
@@ -614,40 +713,33 @@ CumulativeSums_print(struct state *state)
 		    "print driver interface for %s[%d] called with state.partitionCount: %d < 0",
 		    state->testNames[test_num], test_num, state->partitionCount[test_num]);
 	}
-	if (state->p_val[test_num]->count != (state->tp.numOfBitStreams * state->partitionCount[test_num])) {
+	if (state->output == NULL || state->output[test_num].stats == NULL) {
+		err(34, __func__, "print driver interface for %s[%d] called before its files were opened",
+		    state->testNames[test_num], test_num);
+	}
+	out = &state->output[test_num];
+	if (first < out->first || first > last || last > out->first + state->stats[test_num]->count) {
 		err(34, __func__,
-		    "print driver interface for %s[%d] called with p_val count: %ld != %ld*%d=%ld",
-		    state->testNames[test_num], test_num, state->p_val[test_num]->count,
-		    state->tp.numOfBitStreams, state->partitionCount[test_num],
-		    state->tp.numOfBitStreams * state->partitionCount[test_num]);
+		    "print driver interface for %s[%d] called for iterations [%ld, %ld) outside of recorded [%ld, %ld)",
+		    state->testNames[test_num], test_num, first, last, out->first,
+		    out->first + state->stats[test_num]->count);
 	}
-	if (state->datatxt_fmt[test_num] == NULL) {
-		err(34, __func__, "format for data0*.txt filename is NULL");
+	if (state->p_val[test_num]->count < (last * state->partitionCount[test_num])) {
+		err(34, __func__,
+		    "print driver interface for %s[%d] called with p_val count: %ld < %ld*%d=%ld",
+		    state->testNames[test_num], test_num, state->p_val[test_num]->count,
+		    last, state->partitionCount[test_num], last * state->partitionCount[test_num]);
 	}
 
-	/*
-	 * Open stats.txt file
-	 */
-	stats_txt = filePathName(state->subDir[test_num], "stats.txt");
-	dbg(DBG_HIGH, "about to open/truncate: %s", stats_txt);
-	stats = openTruncate(stats_txt);
-
-	/*
-	 * Open results.txt file
-	 */
-	results_txt = filePathName(state->subDir[test_num], "results.txt");
-	dbg(DBG_HIGH, "about to open/truncate: %s", results_txt);
-	results = openTruncate(results_txt);
-
 	/*
 	 * Write results.txt and stats.txt files
 	 */
-	for (i = 0; i < state->stats[test_num]->count; ++i) {
+	for (i = first; i < last; ++i) {
 
 		/*
 		 * Locate stat for this iteration
 		 */
-		stat = addr_value(state->stats[test_num], struct CumulativeSums_private_stats, i);
+		stat = addr_value(state->stats[test_num], struct CumulativeSums_private_stats, i - out->first);
 
 		/*
 		 * Get p_value pair (forward and backward) for this iteration
@@ -659,119 +751,37 @@ CumulativeSums_print(struct state *state)
 		 * Print stat to stats.txt
 		 */
 		errno = 0;	// paranoia
-		ok = CumulativeSums_print_stat(stats, state, stat, p_value, rev_p_value);
+		ok = CumulativeSums_print_stat(out->stats, state, stat, p_value, rev_p_value);
 		if (ok == false) {
-			errp(34, __func__, "error in writing to %s", stats_txt);
+			errp(34, __func__, "error in writing to %s", out->stats_txt);
 		}
 
 		/*
 		 * Print p_value and rev_p_value to results.txt
 		 */
 		errno = 0;	// paranoia
-		ok = CumulativeSums_print_p_value(results, p_value);
+		ok = CumulativeSums_print_p_value(out->results, p_value);
 		if (ok == false) {
-			errp(34, __func__, "error in writing to %s", results_txt);
+			errp(34, __func__, "error in writing to %s", out->results_txt);
 		}
 		errno = 0;	// paranoia
-		ok = CumulativeSums_print_p_value(results, rev_p_value);
+		ok = CumulativeSums_print_p_value(out->results, rev_p_value);
 		if (ok == false) {
-			errp(34, __func__, "error in writing to %s", results_txt);
+			errp(34, __func__, "error in writing to %s", out->results_txt);
 		}
-	}
-
-	/*
-	 * Flush and close stats.txt, free pathname
-	 */
-	errno = 0;		// paranoia
-	io_ret = fflush(stats);
-	if (io_ret != 0) {
-		errp(34, __func__, "error flushing to: %s", stats_txt);
-	}
-	errno = 0;		// paranoia
-	io_ret = fclose(stats);
-	if (io_ret != 0) {
-		errp(34, __func__, "error closing: %s", stats_txt);
-	}
-	free(stats_txt);
-	stats_txt = NULL;
-
-	/*
-	 * Flush and close results.txt, free pathname
-	 */
-	errno = 0;		// paranoia
-	io_ret = fflush(results);
-	if (io_ret != 0) {
-		errp(34, __func__, "error flushing to: %s", results_txt);
-	}
-	errno = 0;		// paranoia
-	io_ret = fclose(results);
-	if (io_ret != 0) {
-		errp(34, __func__, "error closing: %s", results_txt);
-	}
-	free(results_txt);
-	results_txt = NULL;
-
-	/*
-	 * Write data*.txt for each data file if we need to partition results
-	 */
-	if (state->partitionCount[test_num] > 1) {
-		for (j = 0; j < state->partitionCount[test_num]; ++j) {
-
-			/*
-			 * Form the data*.txt basename
-			 */
-			errno = 0;	// paranoia
-			snprintf_ret = snprintf(data_filename, BUFSIZ, state->datatxt_fmt[test_num], j + 1);
-			data_filename[BUFSIZ] = '\0';	// paranoia
-			if (snprintf_ret <= 0 || snprintf_ret >= BUFSIZ || errno != 0) {
-				errp(34, __func__, "snprintf failed for %d bytes for data%03ld.txt, returned: %d", BUFSIZ,
-				     j + 1, snprintf_ret);
-			}
 
-			/*
-			 * Form the data*.txt filename
-			 */
-			data_txt = filePathName(state->subDir[test_num], data_filename);
-			dbg(DBG_HIGH, "about to open/truncate: %s", data_txt);
-			data = openTruncate(data_txt);
-
-			/*
-			 * Write this particular data*.txt filename
-			 */
-			if (j < state->p_val[test_num]->count) {
-				for (i = j; i < state->p_val[test_num]->count; i += state->partitionCount[test_num]) {
-
-					/*
-					 * Get p_value for an iteration belonging to this data*.txt filename
-					 */
-					p_value = get_value(state->p_val[test_num], double, i);
-
-					/*
-					 * Print p_value to results.txt
-					 */
-					errno = 0;	// paranoia
-					ok = CumulativeSums_print_p_value(data, p_value);
-					if (ok == false) {
-						errp(34, __func__, "error in writing to %s", data_txt);
-					}
+		/*
+		 * Print the p_values of this iteration to the data*.txt of their partition
+		 */
+		if (state->partitionCount[test_num] > 1) {
+			for (j = 0; j < state->partitionCount[test_num]; ++j) {
+				p_value = get_value(state->p_val[test_num], double, (i * state->partitionCount[test_num]) + j);
+				errno = 0;	// paranoia
+				ok = CumulativeSums_print_p_value(out->data[j], p_value);
+				if (ok == false) {
+					errp(34, __func__, "error in writing to %s", out->data_txt[j]);
 				}
 			}
-
-			/*
-			 * Flush and close data*.txt, free pathname
-			 */
-			errno = 0;	// paranoia
-			io_ret = fflush(data);
-			if (io_ret != 0) {
-				errp(34, __func__, "error flushing to: %s", data_txt);
-			}
-			errno = 0;	// paranoia
-			io_ret = fclose(data);
-			if (io_ret != 0) {
-				errp(34, __func__, "error closing: %s", data_txt);
-			}
-			free(data_txt);
-			data_txt = NULL;
 		}
 	}
 
@@ -1114,6 +1124,8 @@ CumulativeSums_destroy(struct state *state)
 		free(state->subDir[test_num]);
 		state->subDir[test_num] = NULL;
 	}
+	memo_free(state->memo[test_num]);
+	state->memo[test_num] = NULL;
 
 	return;
 }
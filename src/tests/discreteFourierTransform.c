@@ -36,8 +36,11 @@
 #include <complex.h>
 #include "../utils/externs.h"
 #include "../utils/utilities.h"
+#include "../utils/writer.h"
+#include "../utils/timing.h"
 #include "../utils/cephes.h"
 #include "../utils/debug.h"
+#include "../utils/arena.h"
 
 #if defined(LEGACY_FFT)
 #include "../utils/dfft.h"
@@ -174,41 +177,23 @@ DiscreteFourierTransform_init(struct state *state)
 	}
 
 	for (i = 0; i < state->numberOfThreads; i++) {
-		state->fft_X[i] = calloc((size_t) state->tp.n, sizeof(state->fft_X[i][0]));
-		if (state->fft_X[i] == NULL) {
-			errp(40, __func__, "cannot calloc of %ld elements of %ld bytes each for state->fft_X[%ld]",
-			     n, sizeof(state->fft_X[i][0]), i);
-		}
+		state->fft_X[i] = arena_alloc(state, i, (size_t) state->tp.n, sizeof(state->fft_X[i][0]));
 #if defined(LEGACY_FFT)
-		state->fft_wsave[i] = calloc((size_t) 2 * state->tp.n, sizeof(state->fft_wsave[i][0]));
-		if (state->fft_wsave[i] == NULL) {
-			errp(40, __func__, "cannot calloc of %ld elements of %ld bytes each for state->fft_wsave[%ld]",
-			     2 * n, sizeof(state->fft_wsave[i][0]), i);
-		}
+		state->fft_wsave[i] = arena_alloc(state, i, (size_t) 2 * state->tp.n, sizeof(state->fft_wsave[i][0]));
 #else /* LEGACY_FFT */
-		state->fftw_out[i] = (fftw_complex*) fftw_malloc(sizeof(fftw_complex) * (n / 2 + 1));
-		if (state->fftw_out[i] == NULL) {
-			errp(40, __func__, "cannot fftw_malloc of %ld elements of %ld bytes each for state->fftw_out[%ld]",
-			     n / 2 + 1, sizeof(fftw_complex), i);
-		}
+		state->fftw_out[i] = arena_alloc(state, i, (size_t) (n / 2 + 1), sizeof(fftw_complex));
 		state->fftw_p[i] = fftw_plan_dft_r2c_1d((int) n, state->fft_X[i], state->fftw_out[i], FFTW_ESTIMATE);
 #endif /* LEGACY_FFT */
-		state->fft_m[i] = calloc((size_t) (n / 2 + 1), sizeof(state->fft_m[i][0]));
-		if (state->fft_m[i] == NULL) {
-			errp(40, __func__, "cannot calloc of %ld elements of %ld bytes each for state->fft_m[%ld]",
-			     n / 2 + 1, sizeof(state->fft_m[i][0]), i);
-		}
+		state->fft_m[i] = arena_alloc(state, i, (size_t) (n / 2 + 1), sizeof(state->fft_m[i][0]));
 	}
 
 	/*
 	 * Allocate dynamic arrays
 	 */
 	if (state->resultstxtFlag == true) {
-		state->stats[test_num] = create_dyn_array(sizeof(struct DiscreteFourierTransform_private_stats),
-							  DEFAULT_CHUNK, state->tp.numOfBitStreams, false);        // stats.txt
+		state->stats[test_num] = createResults(state, sizeof(struct DiscreteFourierTransform_private_stats), 1);        // stats.txt
 	}
-	state->p_val[test_num] = create_dyn_array(sizeof(double),
-						  DEFAULT_CHUNK, state->tp.numOfBitStreams, false);	// results.txt
+	state->p_val[test_num] = createResults(state, sizeof(double), state->partitionCount[test_num]);	// results.txt
 
 	/*
 	 * Determine format of data*.txt filenames based on state->partitionCount[test_num]
@@ -236,6 +221,7 @@ void
 DiscreteFourierTransform_iterate(struct thread_state *thread_state)
 {
 	struct DiscreteFourierTransform_private_stats stat;	// Stats for this iteration
+	uint64_t start;		// ticks when the p-value computation started
 	long int n;			// Length of a single bit stream
 	double p_value;			// p_value iteration test result(s)
 	double *X = NULL;		// Adjusted sequence with +1 and -1 bits
@@ -307,6 +293,11 @@ DiscreteFourierTransform_iterate(struct thread_state *thread_state)
 	}
 #endif /* LEGACY_FFT */
 
+	/*
+	 * Zeroize stats before performing the test
+	 */
+	memset(&stat, 0, sizeof(stat));
+
 	/*
 	 * Collect parameters from state
 	 */
@@ -418,13 +409,15 @@ DiscreteFourierTransform_iterate(struct thread_state *thread_state)
 	/*
 	 * Step 8: compute the test P-value
 	 */
+	start = timing_start();
 	p_value = erfc(fabs(stat.d) / state->c.sqrt2);
+	timing_stop(thread_state, TIMING_PVALUE, start);
 
 	/*
 	 * Lock mutex before making changes to the shared state
 	 */
 	if (thread_state->mutex != NULL) {
-		pthread_mutex_lock(thread_state->mutex);
+		timing_lock(thread_state, thread_state->mutex);
 	}
 
 	/*
@@ -456,7 +449,7 @@ DiscreteFourierTransform_iterate(struct thread_state *thread_state)
 	 * Record values computed during this iteration
 	 */
 	if (state->resultstxtFlag == true) {
-		append_value(state->stats[test_num], &stat);
+		recordStats(state, thread_state, test_num, &stat);
 	}
 	append_value(state->p_val[test_num], &p_value);
 
@@ -623,31 +616,25 @@ DiscreteFourierTransform_print_p_value(FILE * stream, double p_value)
 
 
 /*
- * DiscreteFourierTransform_print - print to results.txt, data*.txt, stats.txt for all iterations
+ * DiscreteFourierTransform_print - print iterations to results.txt, data*.txt, stats.txt
  *
  * given:
  *      state           // run state to test under
+ *      first           // first iteration to print
+ *      last            // print up to but not including this iteration
  *
- * This function is called for once to print dynamic arrays into
- * results.txt, data*.txt, stats.txt.
+ * This function is called by the writer as iterations complete, to append
+ * their records to results.txt, data*.txt, stats.txt.
  *
- * NOTE: The initialize and iterate functions must be called before this function is called.
+ * NOTE: The files must have been opened by writer_open().
  */
 void
-DiscreteFourierTransform_print(struct state *state)
+DiscreteFourierTransform_print(struct state *state, long int first, long int last)
 {
 	struct DiscreteFourierTransform_private_stats *stat;	// Pointer to statistics of an iteration
+	struct test_output *out;	// Open stats.txt, results.txt, data*.txt
 	double p_value;			// p_value iteration test result(s)
-	FILE *stats = NULL;		// Open stats.txt file
-	FILE *results = NULL;		// Open results.txt file
-	FILE *data = NULL;		// Open data*.txt file
-	char *stats_txt = NULL;		// Pathname for stats.txt
-	char *results_txt = NULL;	// Pathname for results.txt
-	char *data_txt = NULL;		// Pathname for data*.txt
-	char data_filename[BUFSIZ + 1];	// Basename for a given data*.txt pathname
 	bool ok;			// true -> I/O was OK
-	int snprintf_ret;		// snprintf return value
-	int io_ret;			// I/O return status
 	long int i;
 	long int j;
 
@@ -671,40 +658,33 @@ DiscreteFourierTransform_print(struct state *state)
 		    "print driver interface for %s[%d] called with state.partitionCount: %d < 0",
 		    state->testNames[test_num], test_num, state->partitionCount[test_num]);
 	}
-	if (state->p_val[test_num]->count != (state->tp.numOfBitStreams * state->partitionCount[test_num])) {
+	if (state->output == NULL || state->output[test_num].stats == NULL) {
+		err(44, __func__, "print driver interface for %s[%d] called before its files were opened",
+		    state->testNames[test_num], test_num);
+	}
+	out = &state->output[test_num];
+	if (first < out->first || first > last || last > out->first + state->stats[test_num]->count) {
 		err(44, __func__,
-		    "print driver interface for %s[%d] called with p_val count: %ld != %ld*%d=%ld",
-		    state->testNames[test_num], test_num, state->p_val[test_num]->count,
-		    state->tp.numOfBitStreams, state->partitionCount[test_num],
-		    state->tp.numOfBitStreams * state->partitionCount[test_num]);
+		    "print driver interface for %s[%d] called for iterations [%ld, %ld) outside of recorded [%ld, %ld)",
+		    state->testNames[test_num], test_num, first, last, out->first,
+		    out->first + state->stats[test_num]->count);
 	}
-	if (state->datatxt_fmt[test_num] == NULL) {
-		err(44, __func__, "format for data0*.txt filename is NULL");
+	if (state->p_val[test_num]->count < (last * state->partitionCount[test_num])) {
+		err(44, __func__,
+		    "print driver interface for %s[%d] called with p_val count: %ld < %ld*%d=%ld",
+		    state->testNames[test_num], test_num, state->p_val[test_num]->count,
+		    last, state->partitionCount[test_num], last * state->partitionCount[test_num]);
 	}
 
-	/*
-	 * Open stats.txt file
-	 */
-	stats_txt = filePathName(state->subDir[test_num], "stats.txt");
-	dbg(DBG_HIGH, "about to open/truncate: %s", stats_txt);
-	stats = openTruncate(stats_txt);
-
-	/*
-	 * Open results.txt file
-	 */
-	results_txt = filePathName(state->subDir[test_num], "results.txt");
-	dbg(DBG_HIGH, "about to open/truncate: %s", results_txt);
-	results = openTruncate(results_txt);
-
 	/*
 	 * Write results.txt and stats.txt files
 	 */
-	for (i = 0; i < state->stats[test_num]->count; ++i) {
+	for (i = first; i < last; ++i) {
 
 		/*
 		 * Locate stat for this iteration
 		 */
-		stat = addr_value(state->stats[test_num], struct DiscreteFourierTransform_private_stats, i);
+		stat = addr_value(state->stats[test_num], struct DiscreteFourierTransform_private_stats, i - out->first);
 
 		/*
 		 * Get p_value for this iteration
@@ -715,119 +695,32 @@ DiscreteFourierTransform_print(struct state *state)
 		 * Print stat to stats.txt
 		 */
 		errno = 0;	// paranoia
-		ok = DiscreteFourierTransform_print_stat(stats, state, stat, p_value);
+		ok = DiscreteFourierTransform_print_stat(out->stats, state, stat, p_value);
 		if (ok == false) {
-			errp(44, __func__, "error in writing to %s", stats_txt);
+			errp(44, __func__, "error in writing to %s", out->stats_txt);
 		}
 
 		/*
 		 * Print p_value to results.txt
 		 */
 		errno = 0;	// paranoia
-		ok = DiscreteFourierTransform_print_p_value(results, p_value);
+		ok = DiscreteFourierTransform_print_p_value(out->results, p_value);
 		if (ok == false) {
-			errp(44, __func__, "error in writing to %s", results_txt);
+			errp(44, __func__, "error in writing to %s", out->results_txt);
 		}
-	}
-
-	/*
-	 * Flush and close stats.txt, free pathname
-	 */
-	errno = 0;		// paranoia
-	io_ret = fflush(stats);
-	if (io_ret != 0) {
-		errp(44, __func__, "error flushing to: %s", stats_txt);
-	}
-	errno = 0;		// paranoia
-	io_ret = fclose(stats);
-	if (io_ret != 0) {
-		errp(44, __func__, "error closing: %s", stats_txt);
-	}
-	free(stats_txt);
-	stats_txt = NULL;
-
-	/*
-	 * Flush and close results.txt, free pathname
-	 */
-	errno = 0;		// paranoia
-	io_ret = fflush(results);
-	if (io_ret != 0) {
-		errp(44, __func__, "error flushing to: %s", results_txt);
-	}
-	errno = 0;		// paranoia
-	io_ret = fclose(results);
-	if (io_ret != 0) {
-		errp(44, __func__, "error closing: %s", results_txt);
-	}
-	free(results_txt);
-	results_txt = NULL;
-
-	/*
-	 * Write data*.txt for each data file if we need to partition results
-	 */
-	if (state->partitionCount[test_num] > 1) {
 
 		/*
-		 * For each data file
+		 * Print the p_values of this iteration to the data*.txt of their partition
 		 */
-		for (j = 0; j < state->partitionCount[test_num]; ++j) {
-
-			/*
-			 * Form the data*.txt basename
-			 */
-			errno = 0;	// paranoia
-			snprintf_ret = snprintf(data_filename, BUFSIZ, state->datatxt_fmt[test_num], j + 1);
-			data_filename[BUFSIZ] = '\0';	// paranoia
-			if (snprintf_ret <= 0 || snprintf_ret >= BUFSIZ || errno != 0) {
-				errp(44, __func__, "snprintf failed for %d bytes for data%03ld.txt, returned: %d", BUFSIZ,
-				     j + 1, snprintf_ret);
-			}
-
-			/*
-			 * Form the data*.txt filename
-			 */
-			data_txt = filePathName(state->subDir[test_num], data_filename);
-			dbg(DBG_HIGH, "about to open/truncate: %s", data_txt);
-			data = openTruncate(data_txt);
-
-			/*
-			 * Write this particular data*.txt filename
-			 */
-			if (j < state->p_val[test_num]->count) {
-				for (i = j; i < state->p_val[test_num]->count; i += state->partitionCount[test_num]) {
-
-					/*
-					 * Get p_value for an iteration belonging to this data*.txt filename
-					 */
-					p_value = get_value(state->p_val[test_num], double, i);
-
-					/*
-					 * Print p_value to results.txt
-					 */
-					errno = 0;	// paranoia
-					ok = DiscreteFourierTransform_print_p_value(data, p_value);
-					if (ok == false) {
-						errp(44, __func__, "error in writing to %s", data_txt);
-					}
-
+		if (state->partitionCount[test_num] > 1) {
+			for (j = 0; j < state->partitionCount[test_num]; ++j) {
+				p_value = get_value(state->p_val[test_num], double, (i * state->partitionCount[test_num]) + j);
+				errno = 0;	// paranoia
+				ok = DiscreteFourierTransform_print_p_value(out->data[j], p_value);
+				if (ok == false) {
+					errp(44, __func__, "error in writing to %s", out->data_txt[j]);
 				}
 			}
-
-			/*
-			 * Flush and close data*.txt, free pathname
-			 */
-			errno = 0;	// paranoia
-			io_ret = fflush(data);
-			if (io_ret != 0) {
-				errp(44, __func__, "error flushing to: %s", data_txt);
-			}
-			errno = 0;	// paranoia
-			io_ret = fclose(data);
-			if (io_ret != 0) {
-				errp(44, __func__, "error closing: %s", data_txt);
-			}
-			free(data_txt);
-			data_txt = NULL;
 		}
 	}
 
@@ -1134,7 +1027,9 @@ DiscreteFourierTransform_metrics(struct state *state)
 void
 DiscreteFourierTransform_destroy(struct state *state)
 {
+#if !defined(LEGACY_FFT)
 	long int i;
+#endif /* LEGACY_FFT */
 
 	/*
 	 * Check preconditions (firewall)
@@ -1174,31 +1069,14 @@ DiscreteFourierTransform_destroy(struct state *state)
 	}
 
 
+#if !defined(LEGACY_FFT)
 	for (i = 0; i < state->numberOfThreads; i++) {
-		if (state->fft_X[i] != NULL) {
-			free(state->fft_X[i]);
-			state->fft_X[i] = NULL;
-		}
-#if defined(LEGACY_FFT)
-		if (state->fft_wsave[i] != NULL) {
-			free(state->fft_wsave[i]);
-			state->fft_wsave[i] = NULL;
-		}
-#else /* LEGACY_FFT */
-		if (state->fftw_out[i] != NULL) {
-			fftw_free(state->fftw_out[i]);
-			state->fftw_out[i] = NULL;
-		}
 		if (state->fftw_p[i] != NULL) {
 			fftw_destroy_plan(state->fftw_p[i]);
 			state->fftw_p[i] = NULL;
 		}
-#endif /* LEGACY_FFT */
-		if (state->fft_m[i] != NULL) {
-			free(state->fft_m[i]);
-			state->fft_m[i] = NULL;
-		}
 	}
+#endif /* LEGACY_FFT */
 
 	if (state->fft_X != NULL) {
 		free(state->fft_X);
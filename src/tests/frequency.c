@@ -35,6 +35,11 @@
 #include <errno.h>
 #include "../utils/externs.h"
 #include "../utils/utilities.h"
+#include "../utils/writer.h"
+#include "../utils/timing.h"
+#include "../utils/split.h"
+#include "../utils/slice.h"
+#include "../utils/memo.h"
 #include "../utils/debug.h"
 #include "../utils/cephes.h"
 
@@ -57,6 +62,7 @@ static const enum test test_num = TEST_FREQUENCY;	// This test number
 /*
  * Forward static function declarations
  */
+static split_fn Frequency_part;
 static bool Frequency_print_stat(FILE * stream, struct state *state, struct Frequency_private_stats *stat, double p_value);
 static bool Frequency_print_p_value(FILE * stream, double p_value);
 static void Frequency_metric_print(struct state *state, long int sampleCount, long int toolow, long int *freqPerBin);
@@ -118,11 +124,14 @@ Frequency_init(struct state *state)
 	 * Allocate dynamic arrays
 	 */
 	if (state->resultstxtFlag == true) {
-		state->stats[test_num] = create_dyn_array(sizeof(struct Frequency_private_stats),
-							  DEFAULT_CHUNK, state->tp.numOfBitStreams, false);        // stats.txt
+		state->stats[test_num] = createResults(state, sizeof(struct Frequency_private_stats), 1);        // stats.txt
 	}
-	state->p_val[test_num] = create_dyn_array(sizeof(double),
-						  DEFAULT_CHUNK, state->tp.numOfBitStreams, false);	// results.txt
+	state->p_val[test_num] = createResults(state, sizeof(double), state->partitionCount[test_num]);	// results.txt
+
+	/*
+	 * Keep the p-value of each |S_n|, of the parity of n
+	 */
+	state->memo[test_num] = memo_create(state->testNames[test_num], MIN(n / 2 + 1, state->tp.numOfBitStreams));
 
 	/*
 	 * Determine format of data*.txt filenames based on state->partitionCount[test_num]
@@ -136,6 +145,36 @@ Frequency_init(struct state *state)
 }
 
 
+/*
+ * Frequency_part - add up the bits of a piece of the bit stream as +1 and -1 values
+ *
+ * given:
+ *      thread_state    // state of the thread testing the bit stream
+ *      arg             // array of the sum of each piece
+ *      part            // piece to add up
+ *      first           // first bit of the piece
+ *      last            // bit after the last bit of the piece
+ */
+static void
+Frequency_part(struct thread_state *thread_state, void *arg, long int part, long int first, long int last)
+{
+	BitSequence *epsilon = thread_state->global_state->epsilon[thread_state->thread_id];
+	long int S_n = 0;	// Sum of the piece
+	long int i;
+
+	for (i = first; i < last; i++) {
+		if ((int) epsilon[i] == 1) {
+			S_n++;
+		} else if ((int) epsilon[i] == 0) {
+			S_n--;
+		} else {
+			err(41, __func__, "found a bit different than 1 or 0 in the sequence");
+		}
+	}
+	((long int *) arg)[part] = S_n;
+}
+
+
 /*
  * Frequency_iterate - iterate one bit stream for Frequency test
  *
@@ -150,10 +189,13 @@ void
 Frequency_iterate(struct thread_state *thread_state)
 {
 	struct Frequency_private_stats stat;	// Stats for this iteration
+	uint64_t start;		// ticks when the p-value computation started
 	long int n;		// Length of a single bit stream
 	double f;		// Term in the p-value formula
 	double s_obs;		// Test statistic
 	double p_value;		// p_value iteration test result(s)
+	long int S_n[MAX_SPLIT];	// Sum of each piece of the bit stream
+	long int parts;		// Number of pieces the bit stream is added up in
 	long int i;
 
 	/*
@@ -182,22 +224,27 @@ Frequency_iterate(struct thread_state *thread_state)
 		    __func__, state->testNames[test_num], test_num);
 	}
 
+	/*
+	 * Zeroize stats before performing the test
+	 */
+	memset(&stat, 0, sizeof(stat));
+
 	/*
 	 * Collect parameters from state
 	 */
 	n = state->tp.n;
 
 	/*
-	 * Step 1: compute S_n
+	 * Step 1: compute S_n, under -B from the 1 bits the bit-sliced engine counted
 	 */
-	stat.S_n = 0;
-	for (i = 0; i < n; i++) {
-		if ((int) state->epsilon[thread_state->thread_id][i] == 1) {
-			stat.S_n++;
-		} else if ((int) state->epsilon[thread_state->thread_id][i] == 0) {
-			stat.S_n--;
-		} else {
-			err(41, __func__, "found a bit different than 1 or 0 in the sequence");
+	if (thread_state->lane != NULL) {
+		stat.S_n = 2 * thread_state->lane->ones - n;
+	} else {
+		parts = split_parts(state, n, 1);
+		split_run(thread_state, parts, n, Frequency_part, S_n);
+		stat.S_n = 0;
+		for (i = 0; i < parts; i++) {
+			stat.S_n += S_n[i];
 		}
 	}
 
@@ -207,16 +254,21 @@ Frequency_iterate(struct thread_state *thread_state)
 	s_obs = fabs((double) stat.S_n) / state->c.sqrtn;
 
 	/*
-	 * Step 3: compute the test P-value
+	 * Step 3: compute the test P-value, unless an iteration with the same |S_n| did
 	 */
-	f = s_obs / state->c.sqrt2;
-	p_value = erfc(f);
+	start = timing_start();
+	if (memo_get(state->memo[test_num], (uint64_t) labs(stat.S_n), &p_value) == false) {
+		f = s_obs / state->c.sqrt2;
+		p_value = erfc(f);
+		memo_put(state->memo[test_num], (uint64_t) labs(stat.S_n), p_value);
+	}
+	timing_stop(thread_state, TIMING_PVALUE, start);
 
 	/*
 	 * Lock mutex before making changes to the shared state
 	 */
 	if (thread_state->mutex != NULL) {
-		pthread_mutex_lock(thread_state->mutex);
+		timing_lock(thread_state, thread_state->mutex);
 	}
 
 	/*
@@ -248,7 +300,7 @@ Frequency_iterate(struct thread_state *thread_state)
 	 * Record values computed during this iteration
 	 */
 	if (state->resultstxtFlag == true) {
-		append_value(state->stats[test_num], &stat);
+		recordStats(state, thread_state, test_num, &stat);
 	}
 	append_value(state->p_val[test_num], &p_value);
 
@@ -410,31 +462,25 @@ Frequency_print_p_value(FILE * stream, double p_value)
 
 
 /*
- * Frequency_print - print to results.txt, data*.txt, stats.txt for all iterations
+ * Frequency_print - print iterations to results.txt, data*.txt, stats.txt
  *
  * given:
  *      state           // run state to test under
+ *      first           // first iteration to print
+ *      last            // print up to but not including this iteration
  *
- * This function is called for once to print dynamic arrays into
- * results.txt, data*.txt, stats.txt.
+ * This function is called by the writer as iterations complete, to append
+ * their records to results.txt, data*.txt, stats.txt.
  *
- * NOTE: The initialize and iterate functions must be called before this function is called.
+ * NOTE: The files must have been opened by writer_open().
  */
 void
-Frequency_print(struct state *state)
+Frequency_print(struct state *state, long int first, long int last)
 {
 	struct Frequency_private_stats *stat;	// Pointer to statistics of an iteration
+	struct test_output *out;		// Open stats.txt, results.txt, data*.txt
 	double p_value;				// p_value iteration test result(s)
-	FILE *stats = NULL;			// Open stats.txt file
-	FILE *results = NULL;			// Open results.txt file
-	FILE *data = NULL;			// Open data*.txt file
-	char *stats_txt = NULL;			// Pathname for stats.txt
-	char *results_txt = NULL;		// Pathname for results.txt
-	char *data_txt = NULL;			// Pathname for data*.txt
-	char data_filename[BUFSIZ + 1];		// Basename for a given data*.txt pathname
 	bool ok;				// true -> I/O was OK
-	int snprintf_ret;			// snprintf return value
-	int io_ret;				// I/O return status
 	long int i;
 	long int j;
 
@@ -458,40 +504,33 @@ Frequency_print(struct state *state)
 		    "print driver interface for %s[%d] called with state.partitionCount: %d < 0",
 		    state->testNames[test_num], test_num, state->partitionCount[test_num]);
 	}
-	if (state->p_val[test_num]->count != (state->tp.numOfBitStreams * state->partitionCount[test_num])) {
+	if (state->output == NULL || state->output[test_num].stats == NULL) {
+		err(74, __func__, "print driver interface for %s[%d] called before its files were opened",
+		    state->testNames[test_num], test_num);
+	}
+	out = &state->output[test_num];
+	if (first < out->first || first > last || last > out->first + state->stats[test_num]->count) {
 		err(74, __func__,
-		    "print driver interface for %s[%d] called with p_val count: %ld != %ld*%d=%ld",
-		    state->testNames[test_num], test_num, state->p_val[test_num]->count,
-		    state->tp.numOfBitStreams, state->partitionCount[test_num],
-		    state->tp.numOfBitStreams * state->partitionCount[test_num]);
+		    "print driver interface for %s[%d] called for iterations [%ld, %ld) outside of recorded [%ld, %ld)",
+		    state->testNames[test_num], test_num, first, last, out->first,
+		    out->first + state->stats[test_num]->count);
 	}
-	if (state->datatxt_fmt[test_num] == NULL) {
-		err(74, __func__, "format for data0*.txt filename is NULL");
+	if (state->p_val[test_num]->count < (last * state->partitionCount[test_num])) {
+		err(74, __func__,
+		    "print driver interface for %s[%d] called with p_val count: %ld < %ld*%d=%ld",
+		    state->testNames[test_num], test_num, state->p_val[test_num]->count,
+		    last, state->partitionCount[test_num], last * state->partitionCount[test_num]);
 	}
 
-	/*
-	 * Open stats.txt file
-	 */
-	stats_txt = filePathName(state->subDir[test_num], "stats.txt");
-	dbg(DBG_HIGH, "about to open/truncate: %s", stats_txt);
-	stats = openTruncate(stats_txt);
-
-	/*
-	 * Open results.txt file
-	 */
-	results_txt = filePathName(state->subDir[test_num], "results.txt");
-	dbg(DBG_HIGH, "about to open/truncate: %s", results_txt);
-	results = openTruncate(results_txt);
-
 	/*
 	 * Write results.txt and stats.txt files
 	 */
-	for (i = 0; i < state->stats[test_num]->count; ++i) {
+	for (i = first; i < last; ++i) {
 
 		/*
 		 * Locate stat for this iteration
 		 */
-		stat = addr_value(state->stats[test_num], struct Frequency_private_stats, i);
+		stat = addr_value(state->stats[test_num], struct Frequency_private_stats, i - out->first);
 
 		/*
 		 * Get p_value for this iteration
@@ -502,115 +541,32 @@ Frequency_print(struct state *state)
 		 * Print stat to stats.txt
 		 */
 		errno = 0;	// paranoia
-		ok = Frequency_print_stat(stats, state, stat, p_value);
+		ok = Frequency_print_stat(out->stats, state, stat, p_value);
 		if (ok == false) {
-			errp(74, __func__, "error in writing to %s", stats_txt);
+			errp(74, __func__, "error in writing to %s", out->stats_txt);
 		}
 
 		/*
 		 * Print p_value to results.txt
 		 */
 		errno = 0;	// paranoia
-		ok = Frequency_print_p_value(results, p_value);
+		ok = Frequency_print_p_value(out->results, p_value);
 		if (ok == false) {
-			errp(74, __func__, "error in writing to %s", results_txt);
+			errp(74, __func__, "error in writing to %s", out->results_txt);
 		}
-	}
-
-	/*
-	 * Flush and close stats.txt, free pathname
-	 */
-	errno = 0;		// paranoia
-	io_ret = fflush(stats);
-	if (io_ret != 0) {
-		errp(74, __func__, "error flushing to: %s", stats_txt);
-	}
-	errno = 0;		// paranoia
-	io_ret = fclose(stats);
-	if (io_ret != 0) {
-		errp(74, __func__, "error closing: %s", stats_txt);
-	}
-	free(stats_txt);
-	stats_txt = NULL;
-
-	/*
-	 * Flush and close results.txt, free pathname
-	 */
-	errno = 0;		// paranoia
-	io_ret = fflush(results);
-	if (io_ret != 0) {
-		errp(74, __func__, "error flushing to: %s", results_txt);
-	}
-	errno = 0;		// paranoia
-	io_ret = fclose(results);
-	if (io_ret != 0) {
-		errp(74, __func__, "error closing: %s", results_txt);
-	}
-	free(results_txt);
-	results_txt = NULL;
-
-	/*
-	 * Write data*.txt for each data file if we need to partition results
-	 */
-	if (state->partitionCount[test_num] > 1) {
-		for (j = 0; j < state->partitionCount[test_num]; ++j) {
-
-			/*
-			 * Form the data*.txt basename
-			 */
-			errno = 0;	// paranoia
-			snprintf_ret = snprintf(data_filename, BUFSIZ, state->datatxt_fmt[test_num], j + 1);
-			data_filename[BUFSIZ] = '\0';	// paranoia
-			if (snprintf_ret <= 0 || snprintf_ret >= BUFSIZ || errno != 0) {
-				errp(74, __func__, "snprintf failed for %d bytes for data%03ld.txt, returned: %d", BUFSIZ,
-				     j + 1, snprintf_ret);
-			}
-
-			/*
-			 * Form the data*.txt filename
-			 */
-			data_txt = filePathName(state->subDir[test_num], data_filename);
-			dbg(DBG_HIGH, "about to open/truncate: %s", data_txt);
-			data = openTruncate(data_txt);
-
-			/*
-			 * Write this particular data*.txt filename
-			 */
-			if (j < state->p_val[test_num]->count) {
-				for (i = j; i < state->p_val[test_num]->count; i += state->partitionCount[test_num]) {
-
-					/*
-					 * Get p_value for an iteration belonging to this data*.txt filename
-					 */
-					p_value = get_value(state->p_val[test_num], double, i);
-
-					/*
-					 * Print p_value to results.txt
-					 */
-					errno = 0;	// paranoia
-					ok = Frequency_print_p_value(data, p_value);
-					if (ok == false) {
-						errp(74, __func__, "error in writing to %s", data_txt);
-					}
 
+		/*
+		 * Print the p_values of this iteration to the data*.txt of their partition
+		 */
+		if (state->partitionCount[test_num] > 1) {
+			for (j = 0; j < state->partitionCount[test_num]; ++j) {
+				p_value = get_value(state->p_val[test_num], double, (i * state->partitionCount[test_num]) + j);
+				errno = 0;	// paranoia
+				ok = Frequency_print_p_value(out->data[j], p_value);
+				if (ok == false) {
+					errp(74, __func__, "error in writing to %s", out->data_txt[j]);
 				}
 			}
-
-			/*
-			 * Flush and close data*.txt, free pathname
-			 */
-			errno = 0;	// paranoia
-			io_ret = fflush(data);
-			if (io_ret != 0) {
-				errp(74, __func__, "error flushing to: %s", data_txt);
-			}
-			errno = 0;	// paranoia
-			io_ret = fclose(data);
-			if (io_ret != 0) {
-				errp(74, __func__, "error closing: %s", data_txt);
-			}
-			free(data_txt);
-			data_txt = NULL;
 		}
 	}
 
@@ -951,6 +907,8 @@ Frequency_destroy(struct state *state)
 		free(state->subDir[test_num]);
 		state->subDir[test_num] = NULL;
 	}
+	memo_free(state->memo[test_num]);
+	state->memo[test_num] = NULL;
 
 	return;
 }
@@ -36,7 +36,11 @@
 #include "../utils/externs.h"
 #include "../utils/cephes.h"
 #include "../utils/utilities.h"
+#include "../utils/writer.h"
+#include "../utils/timing.h"
+#include "../utils/split.h"
 #include "../utils/debug.h"
+#include "../utils/arena.h"
 
 
 /*
@@ -65,6 +69,7 @@ static const double pi_term[K_LINEARCOMPLEXITY + 1] = { 0.01047, 0.03125, 0.1250
 /*
  * Forward static function declarations
  */
+static split_fn LinearComplexity_part;
 static bool LinearComplexity_print_stat(FILE * stream, struct state *state, struct LinearComplexity_private_stats *stat,
 					double p_value);
 static bool LinearComplexity_print_p_value(FILE * stream, double p_value);
@@ -87,6 +92,9 @@ LinearComplexity_init(struct state *state)
 	long int n;		// Length of a single bit stream
 	long int M;		// Length of each block to be tested
 	long int N;		// Number of independent M-bit blocks the bit stream is partitioned into
+	long int slots;		// LFSR arrays of each kind: one per thread and -J piece of its work
+	long int slot;
+	long int part;
 	long int i;
 
 	/*
@@ -146,38 +154,33 @@ LinearComplexity_init(struct state *state)
 	}
 
 	/*
-	 * Allocate special Linear Feedback Shift Register arrays for each thread
+	 * Allocate special Linear Feedback Shift Register arrays for each thread, and each -J piece of its work
 	 */
-	state->linear_b = malloc((size_t) state->numberOfThreads * sizeof(*state->linear_b));
+	slots = state->numberOfThreads * state->splitParts;
+	state->linear_b = malloc((size_t) slots * sizeof(*state->linear_b));
 	if (state->linear_b == NULL) {
-		errp(100, __func__, "cannot malloc for linear_b: %ld elements of %lu bytes each", state->numberOfThreads,
+		errp(100, __func__, "cannot malloc for linear_b: %ld elements of %lu bytes each", slots,
 		     sizeof(*state->linear_b));
 	}
-	state->linear_c = malloc((size_t) state->numberOfThreads * sizeof(*state->linear_c));
+	state->linear_c = malloc((size_t) slots * sizeof(*state->linear_c));
 	if (state->linear_c == NULL) {
-		errp(100, __func__, "cannot malloc for linear_c: %ld elements of %lu bytes each", state->numberOfThreads,
+		errp(100, __func__, "cannot malloc for linear_c: %ld elements of %lu bytes each", slots,
 		     sizeof(*state->linear_c));
 	}
-	state->linear_t = malloc((size_t) state->numberOfThreads * sizeof(*state->linear_t));
-	if (state->linear_b == NULL) {
-		errp(100, __func__, "cannot malloc for linear_t: %ld elements of %lu bytes each", state->numberOfThreads,
+	state->linear_t = malloc((size_t) slots * sizeof(*state->linear_t));
+	if (state->linear_t == NULL) {
+		errp(100, __func__, "cannot malloc for linear_t: %ld elements of %lu bytes each", slots,
 		     sizeof(*state->linear_t));
 	}
 	for (i = 0; i < state->numberOfThreads; i++) {
-		state->linear_b[i] = malloc(state->tp.linearComplexitySequenceLength * sizeof(state->linear_b[i][0]));
-		if (state->linear_b[i] == NULL) {
-			errp(100, __func__, "cannot malloc of %ld elements of %ld bytes each for state->linear_b[%ld]",
-			     state->tp.linearComplexitySequenceLength, sizeof(state->linear_b[i][0]), i);
-		}
-		state->linear_c[i] = malloc(state->tp.linearComplexitySequenceLength * sizeof(state->linear_c[i][0]));
-		if (state->linear_c[i] == NULL) {
-			errp(100, __func__, "cannot malloc of %ld elements of %ld bytes each for state->linear_c[%ld]",
-			     state->tp.linearComplexitySequenceLength, sizeof(state->linear_c[i][0]), i);
-		}
-		state->linear_t[i] = malloc(state->tp.linearComplexitySequenceLength * sizeof(state->linear_t[i][0]));
-		if (state->linear_t[i] == NULL) {
-			errp(100, __func__, "cannot malloc of %ld elements of %ld bytes each for state->linear_t[%ld]",
-			     state->tp.linearComplexitySequenceLength, sizeof(state->linear_t[i][0]), i);
+		for (part = 0; part < state->splitParts; part++) {
+			slot = split_slot(state, i, part);
+			state->linear_b[slot] = arena_alloc(state, i, (size_t) state->tp.linearComplexitySequenceLength,
+							    sizeof(state->linear_b[slot][0]));
+			state->linear_c[slot] = arena_alloc(state, i, (size_t) state->tp.linearComplexitySequenceLength,
+							    sizeof(state->linear_c[slot][0]));
+			state->linear_t[slot] = arena_alloc(state, i, (size_t) state->tp.linearComplexitySequenceLength,
+							    sizeof(state->linear_t[slot][0]));
 		}
 	}
 
@@ -185,11 +188,9 @@ LinearComplexity_init(struct state *state)
 	 * Allocate dynamic arrays
 	 */
 	if (state->resultstxtFlag == true) {
-		state->stats[test_num] = create_dyn_array(sizeof(struct LinearComplexity_private_stats),
-							  DEFAULT_CHUNK, state->tp.numOfBitStreams, false);        // stats.txt
+		state->stats[test_num] = createResults(state, sizeof(struct LinearComplexity_private_stats), 1);        // stats.txt
 	}
-	state->p_val[test_num] = create_dyn_array(sizeof(double),
-						  DEFAULT_CHUNK, state->tp.numOfBitStreams, false);	// results.txt
+	state->p_val[test_num] = createResults(state, sizeof(double), state->partitionCount[test_num]);	// results.txt
 
 	/*
 	 * Determine format of data*.txt filenames based on state->partitionCount[test_num]
@@ -204,99 +205,61 @@ LinearComplexity_init(struct state *state)
 
 
 /*
- * LinearComplexity_iterate - iterate one bit stream for Linear Complexity test
+ * LinearComplexity_part - count the T classes of the blocks of a piece of the bit stream
  *
  * given:
- *      state           // run state to test under
- *
- * This function is called for each and every iteration noted in state->tp.numOfBitStreams.
- *
- * NOTE: The initialize function must be called first.
+ *      thread_state    // state of the thread testing the bit stream
+ *      arg             // array of the struct LinearComplexity_private_stats of each piece
+ *      part            // piece to count
+ *      first           // first block of the piece
+ *      last            // block after the last block of the piece
  */
-void
-LinearComplexity_iterate(struct thread_state *thread_state)
+static void
+LinearComplexity_part(struct thread_state *thread_state, void *arg, long int part, long int first, long int last)
 {
-	struct LinearComplexity_private_stats stat;	// Stats for this iteration
+	struct state *state = thread_state->global_state;
+	struct LinearComplexity_private_stats *stat = (struct LinearComplexity_private_stats *) arg + part;
+	BitSequence *epsilon;	// Bit stream being tested
+	BitSequence *b;		// LFSR array b of the piece
+	BitSequence *c;		// LFSR array c of the piece
+	BitSequence *t;		// LFSR array t of the piece
 	long int M;		// Length of each block to be tested
-	long int n;		// Length of a single bit stream
-	long int N;		// Number of independent M-bit blocks the bit stream is partitioned into
 	long int d;		// Discrepancy for LFSR algorithm
 	long int L;		// Length of the minimal LFSR for the stream
 	long int m;		// Number of iterations since L was updated to 1 for the LFSR algorithm
 	double mean;		// Theoretical mean under an assumption of randomness
 	double T;		// Value used to identify the class v to increment
-	double p_value;		// p_value iteration test result(s)
 	double class;		// Boundary of the lowest v[i] given T[i]
 	long int i;
 	long int j;
 	long int k;
 
 	/*
-	 * Check preconditions (firewall)
+	 * Setup test parameters
 	 */
-	if (thread_state == NULL) {
-		err(101, __func__, "thread_state arg is NULL");
-	}
-	struct state *state = thread_state->global_state;
-	if (state == NULL) {
-		err(101, __func__, "state arg is NULL");
-	}
-	if (state->testVector[test_num] != true) {
-		dbg(DBG_LOW, "iterate function[%d] %s called when test vector was false", test_num, __func__);
-		return;
-	}
-	if (state->epsilon == NULL) {
-		err(101, __func__, "state->epsilon is NULL");
-	}
-	if (state->epsilon[thread_state->thread_id] == NULL) {
-		err(101, __func__, "state->epsilon[%ld] is NULL", thread_state->thread_id);
-	}
-	if (state->linear_b == NULL) {
-		err(101, __func__, "state->linear_b is NULL");
-	}
-	if (state->linear_b[thread_state->thread_id] == NULL) {
-		err(101, __func__, "state->linear_b[%ld] is NULL", thread_state->thread_id);
-	}
-	if (state->linear_c == NULL) {
-		err(101, __func__, "state->linear_c is NULL");
-	}
-	if (state->linear_c[thread_state->thread_id] == NULL) {
-		err(101, __func__, "state->linear_c[%ld] is NULL", thread_state->thread_id);
-	}
-	if (state->linear_t == NULL) {
-		err(101, __func__, "state->linear_t is NULL");
+	epsilon = state->epsilon[thread_state->thread_id];
+	b = state->linear_b[split_slot(state, thread_state->thread_id, part)];
+	c = state->linear_c[split_slot(state, thread_state->thread_id, part)];
+	t = state->linear_t[split_slot(state, thread_state->thread_id, part)];
+	if (b == NULL || c == NULL || t == NULL) {
+		err(101, __func__, "LFSR arrays of thread %ld piece %ld are NULL", thread_state->thread_id, part);
 	}
-	if (state->linear_t[thread_state->thread_id] == NULL) {
-		err(101, __func__, "state->linear_t[%ld] is NULL", thread_state->thread_id);
-	}
-
-	/*
-	 * Collect parameters from state
-	 */
 	M = state->tp.linearComplexitySequenceLength;
-	n = state->tp.n;
-	N = n / M;
-
-	/*
-	 * Zeroize the v counters
-	 */
-	memset(stat.v, 0, sizeof(stat.v));
+	memset(stat->v, 0, sizeof(stat->v));
 
 	/*
-	 * Step 1: partition the sequence into N independent blocks
-	 *
 	 * Step 2: for each block, we will determine the linear complexity using the version of the Berlekamp-Massey
 	 * algorithm specialized for the binary finite field F2. Explanation of the sub-steps: https://goo.gl/Um0YUr
 	 */
-	for (i = 0; i < N; i++) {
+	for (i = first; i < last; i++) {
 
 		/*
 		 * Sub-step 2: Zeroize the two arrays b and c and set b[0] and c[0] to 1
 		 */
-		memset(state->linear_b[thread_state->thread_id], 0, M * sizeof(state->linear_b[thread_state->thread_id][0]));
-		memset(state->linear_c[thread_state->thread_id], 0, M * sizeof(state->linear_c[thread_state->thread_id][0]));
-		state->linear_c[thread_state->thread_id][0] = 1;
-		state->linear_b[thread_state->thread_id][0] = 1;
+		memset(b, 0, M * sizeof(b[0]));
+		memset(c, 0, M * sizeof(c[0]));
+		c[0] = 1;
+		b[0] = 1;
 
 		/*
 		 * Sub-step 3: initialize L and m to their initial values
@@ -313,10 +276,9 @@ LinearComplexity_iterate(struct thread_state *thread_state)
 			/*
 			 * Sub-step 4a: set the discrepancy
 			 */
-			d = (int) state->epsilon[thread_state->thread_id][i * M + j];
+			d = (int) epsilon[i * M + j];
 			for (k = 1; k <= L; k++) {
-				d += state->linear_c[thread_state->thread_id][k] *
-						state->epsilon[thread_state->thread_id][i * M + j - k];
+				d += c[k] * epsilon[i * M + j - k];
 			}
 
 			d = d % 2;
@@ -325,16 +287,13 @@ LinearComplexity_iterate(struct thread_state *thread_state)
 				/*
 				 * Sub-step 4b: let t be a copy of c
 				 */
-				memcpy(state->linear_t[thread_state->thread_id], state->linear_c[thread_state->thread_id],
-				       M * sizeof(state->linear_t[thread_state->thread_id][0]));
+				memcpy(t, c, M * sizeof(t[0]));
 
 				/*
 				 * Sub-step 4c: update c array
 				 */
 				for (k = j - m; k < M; k++) {
-					state->linear_c[thread_state->thread_id][k] =
-							(BitSequence) ((state->linear_c[thread_state->thread_id][k] +
-									state->linear_b[thread_state->thread_id][k - j + m]) % 2);
+					c[k] = (BitSequence) ((c[k] + b[k - j + m]) % 2);
 				}
 
 				/*
@@ -343,8 +302,7 @@ LinearComplexity_iterate(struct thread_state *thread_state)
 				if (L <= j / 2) {
 					L = j + 1 - L;
 					m = j;
-					memcpy(state->linear_b[thread_state->thread_id], state->linear_t[thread_state->thread_id],
-					       M * sizeof(state->linear_b[thread_state->thread_id][0]));
+					memcpy(b, t, M * sizeof(b[0]));
 				}
 			}
 		}
@@ -369,11 +327,93 @@ LinearComplexity_iterate(struct thread_state *thread_state)
 		 */
 		class = (double) (K_LINEARCOMPLEXITY - 1) / 2.0;
 		if (T <= - class) {
-			stat.v[0]++;
+			stat->v[0]++;
 		} else if (T > class) {
-			stat.v[K_LINEARCOMPLEXITY]++;
+			stat->v[K_LINEARCOMPLEXITY]++;
 		} else {
-			stat.v[(int) ceil(T + class)]++;
+			stat->v[(int) ceil(T + class)]++;
+		}
+	}
+}
+
+
+/*
+ * LinearComplexity_iterate - iterate one bit stream for Linear Complexity test
+ *
+ * given:
+ *      state           // run state to test under
+ *
+ * This function is called for each and every iteration noted in state->tp.numOfBitStreams.
+ *
+ * NOTE: The initialize function must be called first.
+ */
+void
+LinearComplexity_iterate(struct thread_state *thread_state)
+{
+	struct LinearComplexity_private_stats stat;	// Stats for this iteration
+	uint64_t start;		// ticks when the p-value computation started
+	struct LinearComplexity_private_stats piece[MAX_SPLIT];	// T class counts of each piece of the bit stream
+	long int parts;		// Number of pieces the bit stream is tested in
+	long int M;		// Length of each block to be tested
+	long int n;		// Length of a single bit stream
+	long int N;		// Number of independent M-bit blocks the bit stream is partitioned into
+	double p_value;		// p_value iteration test result(s)
+	long int i;
+	long int k;
+
+	/*
+	 * Check preconditions (firewall)
+	 */
+	if (thread_state == NULL) {
+		err(101, __func__, "thread_state arg is NULL");
+	}
+	struct state *state = thread_state->global_state;
+	if (state == NULL) {
+		err(101, __func__, "state arg is NULL");
+	}
+	if (state->testVector[test_num] != true) {
+		dbg(DBG_LOW, "iterate function[%d] %s called when test vector was false", test_num, __func__);
+		return;
+	}
+	if (state->epsilon == NULL) {
+		err(101, __func__, "state->epsilon is NULL");
+	}
+	if (state->epsilon[thread_state->thread_id] == NULL) {
+		err(101, __func__, "state->epsilon[%ld] is NULL", thread_state->thread_id);
+	}
+	if (state->linear_b == NULL) {
+		err(101, __func__, "state->linear_b is NULL");
+	}
+	if (state->linear_c == NULL) {
+		err(101, __func__, "state->linear_c is NULL");
+	}
+	if (state->linear_t == NULL) {
+		err(101, __func__, "state->linear_t is NULL");
+	}
+
+	/*
+	 * Zeroize stats before performing the test
+	 */
+	memset(&stat, 0, sizeof(stat));
+
+	/*
+	 * Collect parameters from state
+	 */
+	M = state->tp.linearComplexitySequenceLength;
+	n = state->tp.n;
+	N = n / M;
+
+	/*
+	 * Step 1: partition the sequence into N independent blocks
+	 *
+	 * Steps 2 thru 5, for the blocks of each piece of the bit stream
+	 */
+	parts = split_parts(state, N, M * M / BITS_N_BYTE);
+	split_run(thread_state, parts, N, LinearComplexity_part, piece);
+	memset(stat.v, 0, sizeof(stat.v));
+	for (k = 0; k < parts; k++) {
+		for (i = 0; i < K_LINEARCOMPLEXITY + 1; i++) {
+			stat.v[i] += piece[k].v[i];
 		}
 	}
 
@@ -388,13 +428,15 @@ LinearComplexity_iterate(struct thread_state *thread_state)
 	/*
 	 * Step 7: compute the test P-value
 	 */
+	start = timing_start();
 	p_value = cephes_igamc(K_LINEARCOMPLEXITY / 2.0, stat.chi2 / 2.0);
+	timing_stop(thread_state, TIMING_PVALUE, start);
 
 	/*
 	 * Lock mutex before making changes to the shared state
 	 */
 	if (thread_state->mutex != NULL) {
-		pthread_mutex_lock(thread_state->mutex);
+		timing_lock(thread_state, thread_state->mutex);
 	}
 
 	/*
@@ -426,7 +468,7 @@ LinearComplexity_iterate(struct thread_state *thread_state)
 	 * Record values computed during this iteration
 	 */
 	if (state->resultstxtFlag == true) {
-		append_value(state->stats[test_num], &stat);
+		recordStats(state, thread_state, test_num, &stat);
 	}
 	append_value(state->p_val[test_num], &p_value);
 
@@ -658,31 +700,25 @@ LinearComplexity_print_p_value(FILE * stream, double p_value)
 
 
 /*
- * LinearComplexity_print - print to results.txt, data*.txt, stats.txt for all iterations
+ * LinearComplexity_print - print iterations to results.txt, data*.txt, stats.txt
  *
  * given:
  *      state           // run state to test under
+ *      first           // first iteration to print
+ *      last            // print up to but not including this iteration
  *
- * This function is called for once to print dynamic arrays into
- * results.txt, data*.txt, stats.txt.
+ * This function is called by the writer as iterations complete, to append
+ * their records to results.txt, data*.txt, stats.txt.
  *
- * NOTE: The initialize and iterate functions must be called before this function is called.
+ * NOTE: The files must have been opened by writer_open().
  */
 void
-LinearComplexity_print(struct state *state)
+LinearComplexity_print(struct state *state, long int first, long int last)
 {
 	struct LinearComplexity_private_stats *stat;	// Pointer to statistics of an iteration
+	struct test_output *out;	// Open stats.txt, results.txt, data*.txt
 	double p_value;			// p_value iteration test result(s)
-	FILE *stats = NULL;		// Open stats.txt file
-	FILE *results = NULL;		// Open results.txt file
-	FILE *data = NULL;		// Open data*.txt file
-	char *stats_txt = NULL;		// Pathname for stats.txt
-	char *results_txt = NULL;	// Pathname for results.txt
-	char *data_txt = NULL;		// Pathname for data*.txt
-	char data_filename[BUFSIZ + 1];	// Basename for a given data*.txt pathname
 	bool ok;			// true -> I/O was OK
-	int snprintf_ret;		// snprintf return value
-	int io_ret;			// I/O return status
 	long int i;
 	long int j;
 
@@ -706,40 +742,33 @@ LinearComplexity_print(struct state *state)
 		    "print driver interface for %s[%d] called with state.partitionCount: %d < 0",
 		    state->testNames[test_num], test_num, state->partitionCount[test_num]);
 	}
-	if (state->p_val[test_num]->count != (state->tp.numOfBitStreams * state->partitionCount[test_num])) {
+	if (state->output == NULL || state->output[test_num].stats == NULL) {
+		err(104, __func__, "print driver interface for %s[%d] called before its files were opened",
+		    state->testNames[test_num], test_num);
+	}
+	out = &state->output[test_num];
+	if (first < out->first || first > last || last > out->first + state->stats[test_num]->count) {
 		err(104, __func__,
-		    "print driver interface for %s[%d] called with p_val count: %ld != %ld*%d=%ld",
-		    state->testNames[test_num], test_num, state->p_val[test_num]->count,
-		    state->tp.numOfBitStreams, state->partitionCount[test_num],
-		    state->tp.numOfBitStreams * state->partitionCount[test_num]);
+		    "print driver interface for %s[%d] called for iterations [%ld, %ld) outside of recorded [%ld, %ld)",
+		    state->testNames[test_num], test_num, first, last, out->first,
+		    out->first + state->stats[test_num]->count);
 	}
-	if (state->datatxt_fmt[test_num] == NULL) {
-		err(104, __func__, "format for data0*.txt filename is NULL");
+	if (state->p_val[test_num]->count < (last * state->partitionCount[test_num])) {
+		err(104, __func__,
+		    "print driver interface for %s[%d] called with p_val count: %ld < %ld*%d=%ld",
+		    state->testNames[test_num], test_num, state->p_val[test_num]->count,
+		    last, state->partitionCount[test_num], last * state->partitionCount[test_num]);
 	}
 
-	/*
-	 * Open stats.txt file
-	 */
-	stats_txt = filePathName(state->subDir[test_num], "stats.txt");
-	dbg(DBG_HIGH, "about to open/truncate: %s", stats_txt);
-	stats = openTruncate(stats_txt);
-
-	/*
-	 * Open results.txt file
-	 */
-	results_txt = filePathName(state->subDir[test_num], "results.txt");
-	dbg(DBG_HIGH, "about to open/truncate: %s", results_txt);
-	results = openTruncate(results_txt);
-
 	/*
 	 * Write results.txt and stats.txt files
 	 */
-	for (i = 0; i < state->stats[test_num]->count; ++i) {
+	for (i = first; i < last; ++i) {
 
 		/*
 		 * Locate stat for this iteration
 		 */
-		stat = addr_value(state->stats[test_num], struct LinearComplexity_private_stats, i);
+		stat = addr_value(state->stats[test_num], struct LinearComplexity_private_stats, i - out->first);
 
 		/*
 		 * Get p_value for this iteration
@@ -750,115 +779,32 @@ LinearComplexity_print(struct state *state)
 		 * Print stat to stats.txt
 		 */
 		errno = 0;	// paranoia
-		ok = LinearComplexity_print_stat(stats, state, stat, p_value);
+		ok = LinearComplexity_print_stat(out->stats, state, stat, p_value);
 		if (ok == false) {
-			errp(104, __func__, "error in writing to %s", stats_txt);
+			errp(104, __func__, "error in writing to %s", out->stats_txt);
 		}
 
 		/*
 		 * Print p_value to results.txt
 		 */
 		errno = 0;	// paranoia
-		ok = LinearComplexity_print_p_value(results, p_value);
+		ok = LinearComplexity_print_p_value(out->results, p_value);
 		if (ok == false) {
-			errp(104, __func__, "error in writing to %s", results_txt);
+			errp(104, __func__, "error in writing to %s", out->results_txt);
 		}
-	}
-
-	/*
-	 * Flush and close stats.txt, free pathname
-	 */
-	errno = 0;		// paranoia
-	io_ret = fflush(stats);
-	if (io_ret != 0) {
-		errp(104, __func__, "error flushing to: %s", stats_txt);
-	}
-	errno = 0;		// paranoia
-	io_ret = fclose(stats);
-	if (io_ret != 0) {
-		errp(104, __func__, "error closing: %s", stats_txt);
-	}
-	free(stats_txt);
-	stats_txt = NULL;
-
-	/*
-	 * Flush and close results.txt, free pathname
-	 */
-	errno = 0;		// paranoia
-	io_ret = fflush(results);
-	if (io_ret != 0) {
-		errp(104, __func__, "error flushing to: %s", results_txt);
-	}
-	errno = 0;		// paranoia
-	io_ret = fclose(results);
-	if (io_ret != 0) {
-		errp(104, __func__, "error closing: %s", results_txt);
-	}
-	free(results_txt);
-	results_txt = NULL;
-
-	/*
-	 * Write data*.txt for each data file if we need to partition results
-	 */
-	if (state->partitionCount[test_num] > 1) {
-		for (j = 0; j < state->partitionCount[test_num]; ++j) {
-
-			/*
-			 * Form the data*.txt basename
-			 */
-			errno = 0;	// paranoia
-			snprintf_ret = snprintf(data_filename, BUFSIZ, state->datatxt_fmt[test_num], j + 1);
-			data_filename[BUFSIZ] = '\0';	// paranoia
-			if (snprintf_ret <= 0 || snprintf_ret >= BUFSIZ || errno != 0) {
-				errp(104, __func__,
-				     "snprintf failed for %d bytes for data%03ld.txt, returned: %d", BUFSIZ, j + 1, snprintf_ret);
-			}
-
-			/*
-			 * Form the data*.txt filename
-			 */
-			data_txt = filePathName(state->subDir[test_num], data_filename);
-			dbg(DBG_HIGH, "about to open/truncate: %s", data_txt);
-			data = openTruncate(data_txt);
-
-			/*
-			 * Write this particular data*.txt filename
-			 */
-			if (j < state->p_val[test_num]->count) {
-				for (i = j; i < state->p_val[test_num]->count; i += state->partitionCount[test_num]) {
-
-					/*
-					 * Get p_value for an iteration belonging to this data*.txt filename
-					 */
-					p_value = get_value(state->p_val[test_num], double, i);
-
-					/*
-					 * Print p_value to results.txt
-					 */
-					errno = 0;	// paranoia
-					ok = LinearComplexity_print_p_value(data, p_value);
-					if (ok == false) {
-						errp(104, __func__, "error in writing to %s", data_txt);
-					}
 
+		/*
+		 * Print the p_values of this iteration to the data*.txt of their partition
+		 */
+		if (state->partitionCount[test_num] > 1) {
+			for (j = 0; j < state->partitionCount[test_num]; ++j) {
+				p_value = get_value(state->p_val[test_num], double, (i * state->partitionCount[test_num]) + j);
+				errno = 0;	// paranoia
+				ok = LinearComplexity_print_p_value(out->data[j], p_value);
+				if (ok == false) {
+					errp(104, __func__, "error in writing to %s", out->data_txt[j]);
 				}
 			}
-
-			/*
-			 * Flush and close data*.txt, free pathname
-			 */
-			errno = 0;	// paranoia
-			io_ret = fflush(data);
-			if (io_ret != 0) {
-				errp(104, __func__, "error flushing to: %s", data_txt);
-			}
-			errno = 0;	// paranoia
-			io_ret = fclose(data);
-			if (io_ret != 0) {
-				errp(104, __func__, "error closing: %s", data_txt);
-			}
-			free(data_txt);
-			data_txt = NULL;
 		}
 	}
 
@@ -1165,8 +1111,6 @@ LinearComplexity_metrics(struct state *state)
 void
 LinearComplexity_destroy(struct state *state)
 {
-	long int i;
-
 	/*
 	 * Check preconditions (firewall)
 	 */
@@ -1204,21 +1148,6 @@ LinearComplexity_destroy(struct state *state)
 		state->subDir[test_num] = NULL;
 	}
 
-	for (i = 0; i < state->numberOfThreads; i++) {
-		if (state->linear_b[i] != NULL) {
-			free(state->linear_b[i]);
-			state->linear_b[i] = NULL;
-		}
-		if (state->linear_c[i] != NULL) {
-			free(state->linear_c[i]);
-			state->linear_c[i] = NULL;
-		}
-		if (state->linear_t[i] != NULL) {
-			free(state->linear_t[i]);
-			state->linear_t[i] = NULL;
-		}
-	}
-
 	if (state->linear_b != NULL) {
 		free(state->linear_b);
 		state->linear_b = NULL;
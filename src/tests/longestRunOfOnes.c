@@ -36,6 +36,11 @@
 #include "../utils/externs.h"
 #include "../utils/cephes.h"
 #include "../utils/utilities.h"
+#include "../utils/writer.h"
+#include "../utils/timing.h"
+#include "../utils/split.h"
+#include "../utils/slice.h"
+#include "../utils/memo.h"
 #include "../utils/debug.h"
 
 
@@ -60,6 +65,17 @@ struct LongestRunOfOnes_private_stats {
 };
 
 
+/*
+ * Class counts of the pieces of a bit stream
+ */
+struct LongestRunOfOnes_pieces {
+	long int M;		// Length of each block to be tested
+	int min_class;		// Minimum length to consider
+	int max_class;		// Maximum length to consider
+	unsigned long count[MAX_SPLIT][CLASS_COUNT_LONGEST_RUN + 1];	// stat.count of the blocks of each piece
+};
+
+
 /*
  * Static const variables declarations
  */
@@ -213,6 +229,8 @@ static const struct runs_table runs_table[] = {
 /*
  * Forward static function declarations
  */
+static int LongestRunOfOnes_table_index(long int n);
+static split_fn LongestRunOfOnes_part;
 static bool LongestRunOfOnes_print_stat(FILE * stream, struct state *state, struct LongestRunOfOnes_private_stats *stat,
 					double p_value);
 static bool LongestRunOfOnes_print_p_value(FILE * stream, double p_value);
@@ -233,6 +251,7 @@ void
 LongestRunOfOnes_init(struct state *state)
 {
 	long int n;		// Length of a single bit stream
+	long int N;		// Number of M-bit blocks of a bit stream
 
 	/*
 	 * Check preconditions (firewall)
@@ -265,6 +284,11 @@ LongestRunOfOnes_init(struct state *state)
 		return;
 	}
 
+	/*
+	 * The bit-sliced engine of -B finds the longest runs of ones of the blocks of M bits
+	 */
+	state->sliceRunBlock = runs_table[LongestRunOfOnes_table_index(n)].M;
+
 	/*
 	 * Create working sub-directory if forming files such as results.txt and stats.txt
 	 */
@@ -277,11 +301,18 @@ LongestRunOfOnes_init(struct state *state)
 	 * Allocate dynamic arrays
 	 */
 	if (state->resultstxtFlag == true) {
-		state->stats[test_num] = create_dyn_array(sizeof(struct LongestRunOfOnes_private_stats),
-							  DEFAULT_CHUNK, state->tp.numOfBitStreams, false);        // stats.txt
+		state->stats[test_num] = createResults(state, sizeof(struct LongestRunOfOnes_private_stats), 1);        // stats.txt
+	}
+	state->p_val[test_num] = createResults(state, sizeof(double), state->partitionCount[test_num]);	// results.txt
+
+	/*
+	 * Keep the p-value of each vector of class counts, when it fits a key: the counts add up to N,
+	 * so all but the last are the digits of the key in base N + 1
+	 */
+	N = n / runs_table[LongestRunOfOnes_table_index(n)].M;
+	if (pow((double) (N + 1), (double) CLASS_COUNT_LONGEST_RUN) < (double) ((uint64_t) 1 << 63)) {
+		state->memo[test_num] = memo_create(state->testNames[test_num], state->tp.numOfBitStreams);
 	}
-	state->p_val[test_num] = create_dyn_array(sizeof(double),
-						  DEFAULT_CHUNK, state->tp.numOfBitStreams, false);	// results.txt
 
 	/*
 	 * Determine format of data*.txt filenames based on state->partitionCount[test_num]
@@ -295,6 +326,86 @@ LongestRunOfOnes_init(struct state *state)
 }
 
 
+/*
+ * LongestRunOfOnes_table_index - find the runs_table entry for a bit stream length
+ *
+ * given:
+ *      n               // Length of a single bit stream
+ *
+ * returns:
+ *      Index of the first runs_table entry whose min_n is >= n, or of the last entry.
+ */
+static int
+LongestRunOfOnes_table_index(long int n)
+{
+	unsigned long int i = 0;
+
+	while ((i < (sizeof(runs_table) / sizeof(runs_table[0]))) && (n > runs_table[i].min_n)) {
+		++i;
+	}
+	if (i >= (sizeof(runs_table) / sizeof(runs_table[0]))) {
+		// ran off end of table, use the last table entry
+		i = (sizeof(runs_table) / sizeof(runs_table[0])) - 1;
+	}
+	return (int) i;
+}
+
+
+/*
+ * LongestRunOfOnes_part - count the longest run of ones class of the blocks of a piece of the bit stream
+ *
+ * given:
+ *      thread_state    // state of the thread testing the bit stream
+ *      arg             // struct LongestRunOfOnes_pieces
+ *      part            // piece to count
+ *      first           // first block of the piece
+ *      last            // block after the last block of the piece
+ */
+static void
+LongestRunOfOnes_part(struct thread_state *thread_state, void *arg, long int part, long int first, long int last)
+{
+	BitSequence *epsilon = thread_state->global_state->epsilon[thread_state->thread_id];
+	struct LongestRunOfOnes_pieces *pieces = (struct LongestRunOfOnes_pieces *) arg;
+	unsigned long *count = pieces->count[part];
+	long int M = pieces->M;
+	long int v_obs;		// Current maximum run length for current block
+	long int run;		// Counter used to find longest run of ones
+	long int i;
+	long int j;
+
+	memset(pieces->count[part], 0, sizeof(pieces->count[part]));
+	for (i = first; i < last; i++) {
+
+		/*
+		 * Step 2a: determine maximum 1-bit run length for this block
+		 */
+		v_obs = 0;
+		run = 0;
+		for (j = 0; j < M; j++) {
+			if (epsilon[(i * M) + j] == 1) {
+				run++;
+				if (run > v_obs) {
+					v_obs = run;
+				}
+			} else {
+				run = 0;
+			}
+		}
+
+		/*
+		 * Step 2b: count the class based on the current run length
+		 */
+		if (v_obs <= pieces->min_class) {
+			count[0]++;
+		} else if (v_obs <= pieces->max_class) {
+			count[v_obs - pieces->min_class]++;
+		} else {
+			count[CLASS_COUNT_LONGEST_RUN]++;
+		}
+	}
+}
+
+
 /*
  * LongestRunOfOnes_iterate - iterate one bit stream for Longest Runs test
  *
@@ -309,14 +420,16 @@ void
 LongestRunOfOnes_iterate(struct thread_state *thread_state)
 {
 	struct LongestRunOfOnes_private_stats stat;	// Stats for this iteration
+	uint64_t start;		// ticks when the p-value computation started
 	const double *pi_term;	// Theoretical probabilities (see runs_table struct above)
 	long int n;		// Length of a single bit stream
 	double p_value;		// p_value iteration test result(s)
 	int min_class;		// Minimum length to consider
 	int max_class;		// Maximum length to consider
-	long int v_obs;		// Current maximum run length for current block
 	double chi_term;	// Term for the statistic formula: chi^2 = chi_term * chi_term
-	long int run;		// Counter used to find longest run of ones
+	uint64_t key;		// Key of the p-value in the memo of the test
+	struct LongestRunOfOnes_pieces pieces;	// Class counts of each piece of the bit stream
+	long int parts;		// Number of pieces the bit stream is counted in
 	long int i;
 	long int j;
 
@@ -341,6 +454,11 @@ LongestRunOfOnes_iterate(struct thread_state *thread_state)
 		err(111, __func__, "state->epsilon[%ld] is NULL", thread_state->thread_id);
 	}
 
+	/*
+	 * Zeroize stats before performing the test
+	 */
+	memset(&stat, 0, sizeof(stat));
+
 	/*
 	 * Collect parameters from state
 	 */
@@ -349,15 +467,7 @@ LongestRunOfOnes_iterate(struct thread_state *thread_state)
 	/*
 	 * Find the appropriate runs_table entry that first satisfies the min_n requirement
 	 */
-	stat.runs_table_index = 0;
-	while ((stat.runs_table_index < (sizeof(runs_table) / sizeof(runs_table[0]))) &&
-	       (n > runs_table[stat.runs_table_index].min_n)) {
-		++stat.runs_table_index;
-	}
-	if (stat.runs_table_index >= (sizeof(runs_table) / sizeof(runs_table[0]))) {
-		// ran off end of table, use the last table entry
-		stat.runs_table_index = (sizeof(runs_table) / sizeof(runs_table[0])) - 1;
-	}
+	stat.runs_table_index = LongestRunOfOnes_table_index(n);
 
 	/*
 	 * Setup test parameters
@@ -375,34 +485,32 @@ LongestRunOfOnes_iterate(struct thread_state *thread_state)
 
 	/*
 	 * Step 1: partition the sequence into N independent M-bit blocks
+	 *
+	 * Under -B the bit-sliced engine counted the blocks by their longest run of ones already.
 	 */
-	for (i = 0; i < stat.N; i++) {
-
-		/*
-		 * Step 2a: determine maximum 1-bit run length for this block
-		 */
-		v_obs = 0;
-		run = 0;
-		for (j = 0; j < stat.M; j++) {
-			if (state->epsilon[thread_state->thread_id][(i * stat.M) + j] == 1) {
-				run++;
-				if (run > v_obs) {
-					v_obs = run;
-				}
+	if (thread_state->lane != NULL) {
+		if (max_class >= SLICE_RUNS) {
+			err(111, __func__, "max_class: %d must be < %d for the bit-sliced engine", max_class, SLICE_RUNS);
+		}
+		for (i = 0; i <= SLICE_RUNS; i++) {
+			if (i <= min_class) {
+				stat.count[0] += thread_state->lane->runs[i];
+			} else if (i <= max_class) {
+				stat.count[i - min_class] += thread_state->lane->runs[i];
 			} else {
-				run = 0;
+				stat.count[CLASS_COUNT_LONGEST_RUN] += thread_state->lane->runs[i];
 			}
 		}
-
-		/*
-		 * Step 2b: count the class based on the current run length
-		 */
-		if (v_obs <= min_class) {
-			stat.count[0]++;
-		} else if (v_obs <= max_class) {
-			stat.count[v_obs - min_class]++;
-		} else {
-			stat.count[CLASS_COUNT_LONGEST_RUN]++;
+	} else {
+		pieces.M = stat.M;
+		pieces.min_class = min_class;
+		pieces.max_class = max_class;
+		parts = split_parts(state, stat.N, stat.M);
+		split_run(thread_state, parts, stat.N, LongestRunOfOnes_part, &pieces);
+		for (i = 0; i < parts; i++) {
+			for (j = 0; j <= CLASS_COUNT_LONGEST_RUN; j++) {
+				stat.count[j] += pieces.count[i][j];
+			}
 		}
 	}
 
@@ -416,15 +524,24 @@ LongestRunOfOnes_iterate(struct thread_state *thread_state)
 	}
 
 	/*
-	 * Step 4: compute the test P-value
+	 * Step 4: compute the test P-value, unless an iteration with the same class counts did
 	 */
-	p_value = cephes_igamc((double) CLASS_COUNT_LONGEST_RUN / 2.0, stat.chi2 / 2.0);
+	start = timing_start();
+	key = 0;
+	for (i = 0; i < CLASS_COUNT_LONGEST_RUN; i++) {
+		key = key * (uint64_t) (stat.N + 1) + stat.count[i];
+	}
+	if (memo_get(state->memo[test_num], key, &p_value) == false) {
+		p_value = cephes_igamc((double) CLASS_COUNT_LONGEST_RUN / 2.0, stat.chi2 / 2.0);
+		memo_put(state->memo[test_num], key, p_value);
+	}
+	timing_stop(thread_state, TIMING_PVALUE, start);
 
 	/*
 	 * Lock mutex before making changes to the shared state
 	 */
 	if (thread_state->mutex != NULL) {
-		pthread_mutex_lock(thread_state->mutex);
+		timing_lock(thread_state, thread_state->mutex);
 	}
 
 	/*
@@ -456,7 +573,7 @@ LongestRunOfOnes_iterate(struct thread_state *thread_state)
 	 * Record values computed during this iteration
 	 */
 	if (state->resultstxtFlag == true) {
-		append_value(state->stats[test_num], &stat);
+		recordStats(state, thread_state, test_num, &stat);
 	}
 	append_value(state->p_val[test_num], &p_value);
 
@@ -795,31 +912,25 @@ LongestRunOfOnes_print_p_value(FILE * stream, double p_value)
 
 
 /*
- * LongestRunOfOnes_print - print to results.txt, data*.txt, stats.txt for all iterations
+ * LongestRunOfOnes_print - print iterations to results.txt, data*.txt, stats.txt
  *
  * given:
  *      state           // run state to test under
+ *      first           // first iteration to print
+ *      last            // print up to but not including this iteration
  *
- * This function is called for once to print dynamic arrays into
- * results.txt, data*.txt, stats.txt.
+ * This function is called by the writer as iterations complete, to append
+ * their records to results.txt, data*.txt, stats.txt.
  *
- * NOTE: The initialize and iterate functions must be called before this function is called.
+ * NOTE: The files must have been opened by writer_open().
  */
 void
-LongestRunOfOnes_print(struct state *state)
+LongestRunOfOnes_print(struct state *state, long int first, long int last)
 {
 	struct LongestRunOfOnes_private_stats *stat;	// Pointer to statistics of an iteration
+	struct test_output *out;	// Open stats.txt, results.txt, data*.txt
 	double p_value;			// p_value iteration test result(s)
-	FILE *stats = NULL;		// Open stats.txt file
-	FILE *results = NULL;		// Open results.txt file
-	FILE *data = NULL;		// Open data*.txt file
-	char *stats_txt = NULL;		// Pathname for stats.txt
-	char *results_txt = NULL;	// Pathname for results.txt
-	char *data_txt = NULL;		// Pathname for data*.txt
-	char data_filename[BUFSIZ + 1];	// Basename for a given data*.txt pathname
 	bool ok;			// true -> I/O was OK
-	int snprintf_ret;		// snprintf return value
-	int io_ret;			// I/O return status
 	long int i;
 	long int j;
 
@@ -843,40 +954,33 @@ LongestRunOfOnes_print(struct state *state)
 		    "print driver interface for %s[%d] called with state.partitionCount: %d < 0",
 		    state->testNames[test_num], test_num, state->partitionCount[test_num]);
 	}
-	if (state->p_val[test_num]->count != (state->tp.numOfBitStreams * state->partitionCount[test_num])) {
+	if (state->output == NULL || state->output[test_num].stats == NULL) {
+		err(114, __func__, "print driver interface for %s[%d] called before its files were opened",
+		    state->testNames[test_num], test_num);
+	}
+	out = &state->output[test_num];
+	if (first < out->first || first > last || last > out->first + state->stats[test_num]->count) {
 		err(114, __func__,
-		    "print driver interface for %s[%d] called with p_val count: %ld != %ld*%d=%ld",
-		    state->testNames[test_num], test_num, state->p_val[test_num]->count,
-		    state->tp.numOfBitStreams, state->partitionCount[test_num],
-		    state->tp.numOfBitStreams * state->partitionCount[test_num]);
+		    "print driver interface for %s[%d] called for iterations [%ld, %ld) outside of recorded [%ld, %ld)",
+		    state->testNames[test_num], test_num, first, last, out->first,
+		    out->first + state->stats[test_num]->count);
 	}
-	if (state->datatxt_fmt[test_num] == NULL) {
-		err(114, __func__, "format for data0*.txt filename is NULL");
+	if (state->p_val[test_num]->count < (last * state->partitionCount[test_num])) {
+		err(114, __func__,
+		    "print driver interface for %s[%d] called with p_val count: %ld < %ld*%d=%ld",
+		    state->testNames[test_num], test_num, state->p_val[test_num]->count,
+		    last, state->partitionCount[test_num], last * state->partitionCount[test_num]);
 	}
 
-	/*
-	 * Open stats.txt file
-	 */
-	stats_txt = filePathName(state->subDir[test_num], "stats.txt");
-	dbg(DBG_HIGH, "about to open/truncate: %s", stats_txt);
-	stats = openTruncate(stats_txt);
-
-	/*
-	 * Open results.txt file
-	 */
-	results_txt = filePathName(state->subDir[test_num], "results.txt");
-	dbg(DBG_HIGH, "about to open/truncate: %s", results_txt);
-	results = openTruncate(results_txt);
-
 	/*
 	 * Write results.txt and stats.txt files
 	 */
-	for (i = 0; i < state->stats[test_num]->count; ++i) {
+	for (i = first; i < last; ++i) {
 
 		/*
 		 * Locate stat for this iteration
 		 */
-		stat = addr_value(state->stats[test_num], struct LongestRunOfOnes_private_stats, i);
+		stat = addr_value(state->stats[test_num], struct LongestRunOfOnes_private_stats, i - out->first);
 
 		/*
 		 * Get p_value for this iteration
@@ -887,115 +991,32 @@ LongestRunOfOnes_print(struct state *state)
 		 * Print stat to stats.txt
 		 */
 		errno = 0;	// paranoia
-		ok = LongestRunOfOnes_print_stat(stats, state, stat, p_value);
+		ok = LongestRunOfOnes_print_stat(out->stats, state, stat, p_value);
 		if (ok == false) {
-			errp(114, __func__, "error in writing to %s", stats_txt);
+			errp(114, __func__, "error in writing to %s", out->stats_txt);
 		}
 
 		/*
 		 * Print p_value to results.txt
 		 */
 		errno = 0;	// paranoia
-		ok = LongestRunOfOnes_print_p_value(results, p_value);
+		ok = LongestRunOfOnes_print_p_value(out->results, p_value);
 		if (ok == false) {
-			errp(114, __func__, "error in writing to %s", results_txt);
+			errp(114, __func__, "error in writing to %s", out->results_txt);
 		}
-	}
-
-	/*
-	 * Flush and close stats.txt, free pathname
-	 */
-	errno = 0;		// paranoia
-	io_ret = fflush(stats);
-	if (io_ret != 0) {
-		errp(114, __func__, "error flushing to: %s", stats_txt);
-	}
-	errno = 0;		// paranoia
-	io_ret = fclose(stats);
-	if (io_ret != 0) {
-		errp(114, __func__, "error closing: %s", stats_txt);
-	}
-	free(stats_txt);
-	stats_txt = NULL;
-
-	/*
-	 * Flush and close results.txt, free pathname
-	 */
-	errno = 0;		// paranoia
-	io_ret = fflush(results);
-	if (io_ret != 0) {
-		errp(114, __func__, "error flushing to: %s", results_txt);
-	}
-	errno = 0;		// paranoia
-	io_ret = fclose(results);
-	if (io_ret != 0) {
-		errp(114, __func__, "error closing: %s", results_txt);
-	}
-	free(results_txt);
-	results_txt = NULL;
-
-	/*
-	 * Write data*.txt for each data file if we need to partition results
-	 */
-	if (state->partitionCount[test_num] > 1) {
-		for (j = 0; j < state->partitionCount[test_num]; ++j) {
-
-			/*
-			 * Form the data*.txt basename
-			 */
-			errno = 0;	// paranoia
-			snprintf_ret = snprintf(data_filename, BUFSIZ, state->datatxt_fmt[test_num], j + 1);
-			data_filename[BUFSIZ] = '\0';	// paranoia
-			if (snprintf_ret <= 0 || snprintf_ret >= BUFSIZ || errno != 0) {
-				errp(114, __func__,
-				     "snprintf failed for %d bytes for data%03ld.txt, returned: %d", BUFSIZ, j + 1, snprintf_ret);
-			}
-
-			/*
-			 * Form the data*.txt filename
-			 */
-			data_txt = filePathName(state->subDir[test_num], data_filename);
-			dbg(DBG_HIGH, "about to open/truncate: %s", data_txt);
-			data = openTruncate(data_txt);
-
-			/*
-			 * Write this particular data*.txt filename
-			 */
-			if (j < state->p_val[test_num]->count) {
-				for (i = j; i < state->p_val[test_num]->count; i += state->partitionCount[test_num]) {
-
-					/*
-					 * Get p_value for an iteration belonging to this data*.txt filename
-					 */
-					p_value = get_value(state->p_val[test_num], double, i);
-
-					/*
-					 * Print p_value to results.txt
-					 */
-					errno = 0;	// paranoia
-					ok = LongestRunOfOnes_print_p_value(data, p_value);
-					if (ok == false) {
-						errp(114, __func__, "error in writing to %s", data_txt);
-					}
 
+		/*
+		 * Print the p_values of this iteration to the data*.txt of their partition
+		 */
+		if (state->partitionCount[test_num] > 1) {
+			for (j = 0; j < state->partitionCount[test_num]; ++j) {
+				p_value = get_value(state->p_val[test_num], double, (i * state->partitionCount[test_num]) + j);
+				errno = 0;	// paranoia
+				ok = LongestRunOfOnes_print_p_value(out->data[j], p_value);
+				if (ok == false) {
+					errp(114, __func__, "error in writing to %s", out->data_txt[j]);
 				}
 			}
-
-			/*
-			 * Flush and close data*.txt, free pathname
-			 */
-			errno = 0;	// paranoia
-			io_ret = fflush(data);
-			if (io_ret != 0) {
-				errp(114, __func__, "error flushing to: %s", data_txt);
-			}
-			errno = 0;	// paranoia
-			io_ret = fclose(data);
-			if (io_ret != 0) {
-				errp(114, __func__, "error closing: %s", data_txt);
-			}
-			free(data_txt);
-			data_txt = NULL;
 		}
 	}
 
@@ -1338,6 +1359,8 @@ LongestRunOfOnes_destroy(struct state *state)
 		free(state->subDir[test_num]);
 		state->subDir[test_num] = NULL;
 	}
+	memo_free(state->memo[test_num]);
+	state->memo[test_num] = NULL;
 
 	return;
 }
@@ -35,8 +35,12 @@
 #include <errno.h>
 #include "../utils/externs.h"
 #include "../utils/utilities.h"
+#include "../utils/writer.h"
+#include "../utils/timing.h"
+#include "../utils/split.h"
 #include "../utils/cephes.h"
 #include "../utils/debug.h"
+#include "../utils/arena.h"
 
 
 /*
@@ -162,6 +166,7 @@ static const long int numOfTemplates[MAXTEMPLEN + 1] = {
  * Forward static function declarations
  */
 static void appendTemplate(struct state *state, ULONG value, long int m);
+static split_fn NonOverlappingTemplateMatchings_part;
 static bool NonOverlappingTemplateMatchings_print_stat(FILE * stream, struct state *state,
 						       struct NonOverlappingTemplateMatchings_private_stats *stat,
 						       struct dyn_array *nonover_stats, long int nonstat_index);
@@ -245,19 +250,15 @@ NonOverlappingTemplateMatchings_init(struct state *state)
 	}
 
 	/*
-	 * Allocate special BitSequence
+	 * Allocate the per thread array of template results, so that iterate does not have to
 	 */
-	state->nonper_seq = malloc((size_t) state->numberOfThreads * sizeof(*state->nonper_seq));
-	if (state->nonper_seq == NULL) {
-		errp(130, __func__, "cannot malloc for nonper_seq: %ld elements of %lu bytes each", state->numberOfThreads,
-		     sizeof(*state->nonper_seq));
+	state->nonover_stats = malloc((size_t) state->numberOfThreads * sizeof(*state->nonover_stats));
+	if (state->nonover_stats == NULL) {
+		errp(130, __func__, "cannot malloc for nonover_stats: %ld elements of %lu bytes each", state->numberOfThreads,
+		     sizeof(*state->nonover_stats));
 	}
 	for (i = 0; i < state->numberOfThreads; i++) {
-		state->nonper_seq[i] = malloc(m * sizeof(state->nonper_seq[i][0]));
-		if (state->nonper_seq[i] == NULL) {
-			errp(130, __func__, "cannot malloc of %ld elements of %ld bytes each for state->nonper_seq[%ul]",
-			     m, sizeof(state->nonper_seq[i][0]), i);
-		}
+		state->nonover_stats[i] = arena_alloc(state, i, (size_t) numOfTemplates[m], sizeof(state->nonover_stats[i][0]));
 	}
 
 	/*
@@ -272,11 +273,9 @@ NonOverlappingTemplateMatchings_init(struct state *state)
 	 * NonOverlapping Template Test uses array of struct nonover_stats instead of p_value doubles
 	 */
 	if (state->resultstxtFlag == true) {
-		state->stats[test_num] = create_dyn_array(sizeof(struct NonOverlappingTemplateMatchings_private_stats),
-							  DEFAULT_CHUNK, state->tp.numOfBitStreams, false);        // stats.txt
+		state->stats[test_num] = createResults(state, sizeof(struct NonOverlappingTemplateMatchings_private_stats), 1);        // stats.txt
 	}
-	state->p_val[test_num] = create_dyn_array(sizeof(struct nonover_stats), DEFAULT_CHUNK,
-						  numOfTemplates[m] * state->tp.numOfBitStreams, false);	// results.txt
+	state->p_val[test_num] = createResults(state, sizeof(struct nonover_stats), state->partitionCount[test_num]);	// results.txt
 
 	/*
 	 * Generate nonovTemplates - array of non-overlapping templates
@@ -405,6 +404,129 @@ appendTemplate(struct state *state, ULONG value, long int m)
 }
 
 
+/*
+ * NonOverlappingTemplateMatchings_part - test the templates of a piece of the template pool
+ *
+ * given:
+ *      thread_state    // state of the thread testing the bit stream
+ *      arg             // struct NonOverlappingTemplateMatchings_private_stats of the iteration
+ *      part            // piece to test
+ *      first           // first template of the piece
+ *      last            // template after the last template of the piece
+ *
+ * Each template is tested against the whole bit stream, and its results go to its own
+ * element of the nonover_stats of the thread, so the pieces are cut from the templates.
+ */
+static void
+NonOverlappingTemplateMatchings_part(struct thread_state *thread_state, void *arg, long int part, long int first,
+				     long int last)
+{
+	struct state *state = thread_state->global_state;
+	struct NonOverlappingTemplateMatchings_private_stats *stat;	// Stats of the iteration
+	struct nonover_stats *nonover_stats = state->nonover_stats[thread_state->thread_id];
+	BitSequence *epsilon = state->epsilon[thread_state->thread_id];
+	BitSequence *template;			// Template being searched for
+	long int m = state->tp.nonOverlappingTemplateLength;
+	unsigned int W_obs;			// Counter of the number of occurrences of a template in a block
+	double chi2_term;			// Term used to compute chi squared
+	double half_chi2[IGAMC_BATCH];		// chi2 / 2 of a batch of templates
+	double p_value[IGAMC_BATCH];		// p-values of a batch of templates
+	uint64_t start;				// ticks when the p-value computation started
+	long int batch;				// Templates in the batch
+	bool match;				// Indicator of a match of a template in a block
+	long int i;
+	long int j;
+	long int jj;
+	long int k;
+
+	stat = (struct NonOverlappingTemplateMatchings_private_stats *) arg;
+	for (jj = first; jj < last; jj++) {
+
+		struct nonover_stats nonover_stat;
+
+		/*
+		 * Get the next template from the pool of precomputed ones
+		 */
+		template = addr_value(state->nonovTemplates, BitSequence, m * jj);
+
+		/*
+		 * Zeroize the occurrences counters for this template
+		 */
+		memset(nonover_stat.Wj, 0, sizeof(nonover_stat.Wj));
+
+		/*
+	 	 * Step 2: count the number of times that this template occurs within each block
+	 	 */
+		for (i = 0; i < BLOCKS_NON_OVERLAPPING; i++) {
+			W_obs = 0;
+
+			/*
+			 * Count occurrences of the current template in block i
+			 */
+			for (j = 0; j < stat->M - m + 1; j++) {
+				match = true;
+
+				/*
+				 * Check if all the m bits of the template match the bits being
+				 * considered in the block.
+				 */
+				for (k = 0; k < m; k++) {
+					if (template[k] != epsilon[i * stat->M + j + k]) {
+						match = false;
+						break;
+					}
+				}
+
+				/*
+				 * If all the bits match, count one occurrence of this template and
+				 * slide the window over m bits.
+				 */
+				if (match == true) {
+					W_obs++;
+					j += m - 1;
+				}
+			}
+
+			/*
+			 * Store the count of occurrences found in this block
+			 */
+			nonover_stat.Wj[i] = W_obs;
+		}
+
+		/*
+		 * Step 4: compute the test statistic
+		 */
+		nonover_stat.chi2 = 0.0;
+		for (i = 0; i < BLOCKS_NON_OVERLAPPING; i++) {
+			chi2_term = ((double) nonover_stat.Wj[i] - stat->mu) / sqrt(stat->sigma_squared);
+			nonover_stat.chi2 += (chi2_term * chi2_term);
+		}
+
+		/*
+		 * Store the index of the template just tested in the stats
+		 */
+		nonover_stat.template_index = jj;
+		nonover_stats[jj] = nonover_stat;
+	}
+
+	/*
+	 * Step 5: compute the test p-values of the templates, all chi-squares of the same degrees of freedom
+	 */
+	start = timing_start();
+	for (jj = first; jj < last; jj += batch) {
+		batch = MIN(IGAMC_BATCH, last - jj);
+		for (k = 0; k < batch; k++) {
+			half_chi2[k] = nonover_stats[jj + k].chi2 / 2.0;
+		}
+		cephes_igamc_batch(BLOCKS_NON_OVERLAPPING / 2.0, half_chi2, p_value, batch);
+		for (k = 0; k < batch; k++) {
+			nonover_stats[jj + k].p_value = p_value[k];
+		}
+	}
+	timing_stop(thread_state, TIMING_PVALUE, start);
+}
+
+
 /*
  * NonOverlappingTemplateMatchings_iterate - iterate one bit stream for Nonoverlapping Template test
  *
@@ -422,13 +544,8 @@ NonOverlappingTemplateMatchings_iterate(struct thread_state *thread_state)
 	struct nonover_stats *nonover_stats;	// Stats for a template of this iteration
 	long int n;				// Length of a single bit stream
 	long int m;				// NonOverlapping Template Test - block length
-	unsigned int W_obs;			// Counter of the number of occurrences of a template in a block
-	double chi2_term;			// Term used to compute chi squared
-	bool match;				// Indicator of a match of a template in a block
-	long int i;
-	long int j;
+	long int parts;				// Number of pieces the templates are tested in
 	long int jj;
-	long int k;
 
 	/*
 	 * Check preconditions (firewall)
@@ -454,13 +571,18 @@ NonOverlappingTemplateMatchings_iterate(struct thread_state *thread_state)
 	if (state->epsilon[thread_state->thread_id] == NULL) {
 		err(132, __func__, "state->epsilon[%ld] is NULL", thread_state->thread_id);
 	}
-	if (state->nonper_seq == NULL) {
-		err(132, __func__, "state->nonper_seq is NULL");
+	if (state->nonover_stats == NULL) {
+		err(132, __func__, "state->nonover_stats is NULL");
 	}
-	if (state->nonper_seq[thread_state->thread_id] == NULL) {
-		err(132, __func__, "state->nonper_seq[%ld] is NULL", thread_state->thread_id);
+	if (state->nonover_stats[thread_state->thread_id] == NULL) {
+		err(132, __func__, "state->nonover_stats[%ld] is NULL", thread_state->thread_id);
 	}
 
+	/*
+	 * Zeroize stats before performing the test
+	 */
+	memset(&stat, 0, sizeof(stat));
+
 	/*
 	 * Collect parameters
 	 */
@@ -493,94 +615,21 @@ NonOverlappingTemplateMatchings_iterate(struct thread_state *thread_state)
 	}
 
 	/*
-	 * Initialize array of nonover_stats
+	 * Use this thread's array of nonover_stats
 	 */
-	nonover_stats = malloc((size_t) numOfTemplates[m] * sizeof(*nonover_stats));
+	nonover_stats = state->nonover_stats[thread_state->thread_id];
 
 	/*
-	 * Process all template values
+	 * Process all template values, the templates of each piece in a thread of its own
 	 */
-	for (jj = 0; jj < numOfTemplates[m]; jj++) {
-
-		struct nonover_stats nonover_stat;
-
-		/*
-		 * Get the next template from the pool of precomputed ones
-		 */
-		memcpy(state->nonper_seq[thread_state->thread_id], addr_value(state->nonovTemplates, BitSequence, m * jj),
-		       m * sizeof(BitSequence));
-
-		/*
-		 * Zeroize the occurrences counters for this template
-		 */
-		memset(nonover_stat.Wj, 0, sizeof(nonover_stat.Wj));
-
-		/*
-	 	 * Step 2: count the number of times that this template occurs within each block
-	 	 */
-		for (i = 0; i < BLOCKS_NON_OVERLAPPING; i++) {
-			W_obs = 0;
-
-			/*
-			 * Count occurrences of the current template in block i
-			 */
-			for (j = 0; j < stat.M - m + 1; j++) {
-				match = true;
-
-				/*
-				 * Check if all the m bits of the template match the bits being
-				 * considered in the block.
-				 */
-				for (k = 0; k < m; k++) {
-					if (state->nonper_seq[thread_state->thread_id][k] !=
-							state->epsilon[thread_state->thread_id][i * stat.M + j + k]) {
-						match = false;
-						break;
-					}
-				}
-
-				/*
-				 * If all the bits match, count one occurrence of this template and
-				 * slide the window over m bits.
-				 */
-				if (match == true) {
-					W_obs++;
-					j += m - 1;
-				}
-			}
-
-			/*
-			 * Store the count of occurrences found in this block
-			 */
-			nonover_stat.Wj[i] = W_obs;
-		}
-
-		/*
-		 * Step 4: compute the test statistic
-		 */
-		nonover_stat.chi2 = 0.0;
-		for (i = 0; i < BLOCKS_NON_OVERLAPPING; i++) {
-			chi2_term = ((double) nonover_stat.Wj[i] - stat.mu) / sqrt(stat.sigma_squared);
-			nonover_stat.chi2 += (chi2_term * chi2_term);
-		}
-
-		/*
-		 * Step 5: compute the test p-value
-		 */
-		nonover_stat.p_value = cephes_igamc(BLOCKS_NON_OVERLAPPING / 2.0, nonover_stat.chi2 / 2.0);
-
-		/*
-		 * Store the index of the template just tested in the stats
-		 */
-		nonover_stat.template_index = jj;
-		nonover_stats[jj] = nonover_stat;
-	}
+	parts = split_parts(state, numOfTemplates[m], n);
+	split_run(thread_state, parts, numOfTemplates[m], NonOverlappingTemplateMatchings_part, &stat);
 
 	/*
 	 * Lock mutex before making changes to the shared state
 	 */
 	if (thread_state->mutex != NULL) {
-		pthread_mutex_lock(thread_state->mutex);
+		timing_lock(thread_state, thread_state->mutex);
 	}
 
 	/*
@@ -636,7 +685,7 @@ NonOverlappingTemplateMatchings_iterate(struct thread_state *thread_state)
 	 * NOTE: The number of nonover_stat values in state->p_val is numOfTemplates[m].
 	 */
 	if (state->resultstxtFlag == true) {
-		append_value(state->stats[test_num], &stat);
+		recordStats(state, thread_state, test_num, &stat);
 	}
 
 	/*
@@ -920,32 +969,26 @@ NonOverlappingTemplateMatchings_print_p_value(FILE * stream, double p_value)
 
 
 /*
- * NonOverlappingTemplateMatchings_print - print to results.txt, data*.txt, stats.txt for all iterations
+ * NonOverlappingTemplateMatchings_print - print iterations to results.txt, data*.txt, stats.txt
  *
  * given:
  *      state           // run state to test under
+ *      first           // first iteration to print
+ *      last            // print up to but not including this iteration
  *
- * This function is called for once to print dynamic arrays into
- * results.txt, data*.txt, stats.txt.
+ * This function is called by the writer as iterations complete, to append
+ * their records to results.txt, data*.txt, stats.txt.
  *
- * NOTE: The initialize and iterate functions must be called before this function is called.
+ * NOTE: The files must have been opened by writer_open().
  */
 void
-NonOverlappingTemplateMatchings_print(struct state *state)
+NonOverlappingTemplateMatchings_print(struct state *state, long int first, long int last)
 {
 	struct NonOverlappingTemplateMatchings_private_stats *stat;	// Pointer to statistics of an iteration
+	struct test_output *out;		// Open stats.txt, results.txt, data*.txt
 	struct nonover_stats *nonover_stat;	// current nonover_stats for a given iteration
-	FILE *stats = NULL;			// Open stats.txt file
-	FILE *results = NULL;			// Open results.txt file
-	FILE *data = NULL;			// Open data*.txt file
-	char *stats_txt = NULL;			// Pathname for stats.txt
-	char *results_txt = NULL;		// Pathname for results.txt
-	char *data_txt = NULL;			// Pathname for data*.txt
-	char data_filename[BUFSIZ + 1];		// Basename for a given data*.txt pathname
 	bool ok;				// true -> I/O was OK
 	long int nonstat_index;			// Starting index into state->nonstat from which to print
-	int snprintf_ret;			// snprintf return value
-	int io_ret;				// I/O return status
 	long int i;
 	long int j;
 
@@ -969,49 +1012,42 @@ NonOverlappingTemplateMatchings_print(struct state *state)
 		    "print driver interface for %s[%d] called with state.partitionCount: %d < 0",
 		    state->testNames[test_num], test_num, state->partitionCount[test_num]);
 	}
-	if (state->p_val[test_num]->count != (state->tp.numOfBitStreams * state->partitionCount[test_num])) {
+	if (state->output == NULL || state->output[test_num].stats == NULL) {
+		err(135, __func__, "print driver interface for %s[%d] called before its files were opened",
+		    state->testNames[test_num], test_num);
+	}
+	out = &state->output[test_num];
+	if (first < out->first || first > last || last > out->first + state->stats[test_num]->count) {
 		err(135, __func__,
-		    "print driver interface for %s[%d] called with p_val count: %ld != %ld*%d=%ld",
-		    state->testNames[test_num], test_num, state->p_val[test_num]->count,
-		    state->tp.numOfBitStreams, state->partitionCount[test_num],
-		    state->tp.numOfBitStreams * state->partitionCount[test_num]);
+		    "print driver interface for %s[%d] called for iterations [%ld, %ld) outside of recorded [%ld, %ld)",
+		    state->testNames[test_num], test_num, first, last, out->first,
+		    out->first + state->stats[test_num]->count);
 	}
-	if (state->datatxt_fmt[test_num] == NULL) {
-		err(135, __func__, "format for data0*.txt filename is NULL");
+	if (state->p_val[test_num]->count < (last * state->partitionCount[test_num])) {
+		err(135, __func__,
+		    "print driver interface for %s[%d] called with p_val count: %ld < %ld*%d=%ld",
+		    state->testNames[test_num], test_num, state->p_val[test_num]->count,
+		    last, state->partitionCount[test_num], last * state->partitionCount[test_num]);
 	}
 
-	/*
-	 * Open stats.txt file
-	 */
-	stats_txt = filePathName(state->subDir[test_num], "stats.txt");
-	dbg(DBG_HIGH, "about to open/truncate: %s", stats_txt);
-	stats = openTruncate(stats_txt);
-
-	/*
-	 * Open results.txt file
-	 */
-	results_txt = filePathName(state->subDir[test_num], "results.txt");
-	dbg(DBG_HIGH, "about to open/truncate: %s", results_txt);
-	results = openTruncate(results_txt);
-
 	/*
 	 * Write results.txt and stats.txt files
 	 */
-	nonstat_index = 0;
-	for (i = 0; i < state->stats[test_num]->count; ++i) {
+	nonstat_index = first * numOfTemplates[state->tp.nonOverlappingTemplateLength];
+	for (i = first; i < last; ++i) {
 
 		/*
 		 * Locate stat for this iteration
 		 */
-		stat = addr_value(state->stats[test_num], struct NonOverlappingTemplateMatchings_private_stats, i);
+		stat = addr_value(state->stats[test_num], struct NonOverlappingTemplateMatchings_private_stats, i - out->first);
 
 		/*
 		 * Print stat to stats.txt
 		 */
 		errno = 0;	// paranoia
-		ok = NonOverlappingTemplateMatchings_print_stat(stats, state, stat, state->p_val[test_num], nonstat_index);
+		ok = NonOverlappingTemplateMatchings_print_stat(out->stats, state, stat, state->p_val[test_num], nonstat_index);
 		if (ok == false) {
-			errp(135, __func__, "error in writing to %s", stats_txt);
+			errp(135, __func__, "error in writing to %s", out->stats_txt);
 		}
 
 		/*
@@ -1035,108 +1071,21 @@ NonOverlappingTemplateMatchings_print(struct state *state)
 			 * Print p_value
 			 */
 			errno = 0;	// paranoia
-			ok = NonOverlappingTemplateMatchings_print_p_value(results, nonover_stat->p_value);
+			ok = NonOverlappingTemplateMatchings_print_p_value(out->results, nonover_stat->p_value);
 			if (ok == false) {
-				errp(135, __func__, "error in writing to %s", results_txt);
-			}
-		}
-	}
-
-	/*
-	 * Flush and close stats.txt, free pathname
-	 */
-	errno = 0;		// paranoia
-	io_ret = fflush(stats);
-	if (io_ret != 0) {
-		errp(135, __func__, "error flushing to: %s", stats_txt);
-	}
-	errno = 0;		// paranoia
-	io_ret = fclose(stats);
-	if (io_ret != 0) {
-		errp(135, __func__, "error closing: %s", stats_txt);
-	}
-	free(stats_txt);
-	stats_txt = NULL;
-
-	/*
-	 * Flush and close results.txt, free pathname
-	 */
-	errno = 0;		// paranoia
-	io_ret = fflush(results);
-	if (io_ret != 0) {
-		errp(135, __func__, "error flushing to: %s", results_txt);
-	}
-	errno = 0;		// paranoia
-	io_ret = fclose(results);
-	if (io_ret != 0) {
-		errp(135, __func__, "error closing: %s", results_txt);
-	}
-	free(results_txt);
-	results_txt = NULL;
-
-	/*
-	 * Write data*.txt for each data file if we need to partition results
-	 */
-	if (state->partitionCount[test_num] > 1) {
-		for (j = 0; j < state->partitionCount[test_num]; ++j) {
-
-			/*
-			 * Form the data*.txt basename
-			 */
-			errno = 0;	// paranoia
-			snprintf_ret = snprintf(data_filename, BUFSIZ, state->datatxt_fmt[test_num], j + 1);
-			data_filename[BUFSIZ] = '\0';	// paranoia
-			if (snprintf_ret <= 0 || snprintf_ret >= BUFSIZ || errno != 0) {
-				errp(135, __func__,
-				     "snprintf failed for %d bytes for data%03ld.txt, returned: %d", BUFSIZ, j + 1, snprintf_ret);
+				errp(135, __func__, "error in writing to %s", out->results_txt);
 			}
 
 			/*
-			 * Form the data*.txt filename
+			 * Print p_value to the data*.txt of its partition
 			 */
-			data_txt = filePathName(state->subDir[test_num], data_filename);
-			dbg(DBG_HIGH, "about to open/truncate: %s", data_txt);
-			data = openTruncate(data_txt);
-
-			/*
-			 * Write this particular data*.txt filename
-			 */
-			if (j < state->p_val[test_num]->count) {
-				for (nonstat_index = j; nonstat_index < state->p_val[test_num]->count;
-				     nonstat_index += state->partitionCount[test_num]) {
-
-					/*
-					 * Get p_value for an iteration belonging to this data*.txt filename
-					 */
-					nonover_stat = addr_value(state->p_val[test_num], struct nonover_stats, nonstat_index);
-
-					/*
-					 * Print p_value to results.txt
-					 */
-					errno = 0;	// paranoia
-					ok = NonOverlappingTemplateMatchings_print_p_value(data, nonover_stat->p_value);
-					if (ok == false) {
-						errp(135, __func__, "error in writing to %s", data_txt);
-					}
-
+			if (state->partitionCount[test_num] > 1) {
+				errno = 0;	// paranoia
+				ok = NonOverlappingTemplateMatchings_print_p_value(out->data[j], nonover_stat->p_value);
+				if (ok == false) {
+					errp(135, __func__, "error in writing to %s", out->data_txt[j]);
 				}
 			}
-
-			/*
-			 * Flush and close data*.txt, free pathname
-			 */
-			errno = 0;	// paranoia
-			io_ret = fflush(data);
-			if (io_ret != 0) {
-				errp(135, __func__, "error flushing to: %s", data_txt);
-			}
-			errno = 0;	// paranoia
-			io_ret = fclose(data);
-			if (io_ret != 0) {
-				errp(135, __func__, "error closing: %s", data_txt);
-			}
-			free(data_txt);
-			data_txt = NULL;
 		}
 	}
 
@@ -1446,8 +1395,6 @@ NonOverlappingTemplateMatchings_metrics(struct state *state)
 void
 NonOverlappingTemplateMatchings_destroy(struct state *state)
 {
-	long int i;
-
 	/*
 	 * Check preconditions (firewall)
 	 */
@@ -1489,15 +1436,9 @@ NonOverlappingTemplateMatchings_destroy(struct state *state)
 		free(state->nonovTemplates);
 		state->nonovTemplates = NULL;
 	}
-	for (i = 0; i < state->numberOfThreads; i++) {
-		if (state->nonper_seq[i] != NULL) {
-			free(state->nonper_seq[i]);
-			state->nonper_seq[i] = NULL;
-		}
-	}
-	if (state->nonper_seq != NULL) {
-		free(state->nonper_seq);
-		state->nonper_seq = NULL;
+	if (state->nonover_stats != NULL) {
+		free(state->nonover_stats);
+		state->nonover_stats = NULL;
 	}
 
 	return;
@@ -35,6 +35,9 @@
 #include <errno.h>
 #include "../utils/externs.h"
 #include "../utils/utilities.h"
+#include "../utils/writer.h"
+#include "../utils/timing.h"
+#include "../utils/split.h"
 #include "../utils/cephes.h"
 #include "../utils/debug.h"
 
@@ -52,6 +55,14 @@ struct OverlappingTemplateMatchings_private_stats {
 };
 
 
+/*
+ * Per piece v counters of a bit stream
+ */
+struct OverlappingTemplateMatchings_pieces {
+	long int v[MAX_SPLIT][K_OVERLAPPING + 1];	// stat.v of the blocks of each piece
+};
+
+
 /*
  * Static const variables declarations
  */
@@ -81,6 +92,7 @@ static const double pi_term[K_OVERLAPPING + 1] = {
 /*
  * Forward static function declarations
  */
+static split_fn OverlappingTemplateMatchings_part;
 static bool OverlappingTemplateMatchings_print_stat(FILE * stream, struct state *state,
 						    struct OverlappingTemplateMatchings_private_stats *stat, double p_value);
 static bool OverlappingTemplateMatchings_print_p_value(FILE * stream, double p_value);
@@ -180,11 +192,9 @@ OverlappingTemplateMatchings_init(struct state *state)
 	 * Allocate dynamic arrays
 	 */
 	if (state->resultstxtFlag == true) {
-		state->stats[test_num] = create_dyn_array(sizeof(struct OverlappingTemplateMatchings_private_stats),
-							  DEFAULT_CHUNK, state->tp.numOfBitStreams, false);        // stats.txt
+		state->stats[test_num] = createResults(state, sizeof(struct OverlappingTemplateMatchings_private_stats), 1);        // stats.txt
 	}
-	state->p_val[test_num] = create_dyn_array(sizeof(double),
-						  DEFAULT_CHUNK, state->tp.numOfBitStreams, false);	// results.txt
+	state->p_val[test_num] = createResults(state, sizeof(double), state->partitionCount[test_num]);	// results.txt
 
 	/*
 	 * Determine format of data*.txt filenames based on state->partitionCount[test_num]
@@ -198,6 +208,64 @@ OverlappingTemplateMatchings_init(struct state *state)
 }
 
 
+/*
+ * OverlappingTemplateMatchings_part - count template occurrences in the blocks of a piece of the bit stream
+ *
+ * given:
+ *      thread_state    // state of the thread testing the bit stream
+ *      arg             // struct OverlappingTemplateMatchings_pieces
+ *      part            // piece to count
+ *      first           // first block of the piece
+ *      last            // block after the last block of the piece
+ */
+static void
+OverlappingTemplateMatchings_part(struct thread_state *thread_state, void *arg, long int part, long int first, long int last)
+{
+	BitSequence *epsilon = thread_state->global_state->epsilon[thread_state->thread_id];
+	long int *v = ((struct OverlappingTemplateMatchings_pieces *) arg)->v[part];
+	long int m = thread_state->global_state->tp.overlappingTemplateLength;
+	bool match;		// 1 ==> template match
+	double W_obs;		// Counter of the number of occurrences of a template in a block
+	long int i;
+	long int j;
+	long int k;
+
+	memset(v, 0, (K_OVERLAPPING + 1) * sizeof(v[0]));
+	for (i = first; i < last; i++) {
+
+		/*
+		 * Set the initial counter of the occurrences of the template in block i to zero
+		 */
+		W_obs = 0;
+
+		/*
+		 * Increase the W_obs counter whenever there is an occurrence of the template in block i
+		 */
+		for (j = 0; j < BLOCK_LENGTH_OVERLAPPING - m + 1; j++) {
+			match = true;
+			for (k = 0; k < m; k++) {
+				if (B_VALUE != epsilon[i * BLOCK_LENGTH_OVERLAPPING + j + k]) {
+					match = false;
+					break;
+				}
+			}
+			if (match == true) {
+				W_obs++;
+			}
+		}
+
+		/*
+		 * Increase the counter v depending on the number of occurrences of the template in block i
+		 */
+		if (W_obs < K_OVERLAPPING) {
+			v[(int) W_obs]++;
+		} else {
+			v[K_OVERLAPPING]++;
+		}
+	}
+}
+
+
 /*
  * OverlappingTemplateMatchings_iterate - iterate one bit stream for Overlapping Template test
  *
@@ -212,15 +280,14 @@ void
 OverlappingTemplateMatchings_iterate(struct thread_state *thread_state)
 {
 	struct OverlappingTemplateMatchings_private_stats stat;	// Stats for this iteration
-	long int m;		// Overlapping Template Test - template length
+	uint64_t start;		// ticks when the p-value computation started
 	long int n;		// Length of a single bit stream
-	bool match;		// 1 ==> template match
-	double W_obs;		// Counter of the number of occurrences of a template in a block
 	double chi2_term;	// Term whose square is used to compute chi squared for this iteration
 	double p_value;		// p_value iteration test result(s)
+	struct OverlappingTemplateMatchings_pieces pieces;	// v counters of each piece of the bit stream
+	long int parts;		// Number of pieces the bit stream is counted in
 	long int i;
 	long int j;
-	long int k;
 
 	/*
 	 * Check preconditions (firewall)
@@ -243,10 +310,14 @@ OverlappingTemplateMatchings_iterate(struct thread_state *thread_state)
 		err(141, __func__, "state->epsilon[%ld] is NULL", thread_state->thread_id);
 	}
 
+	/*
+	 * Zeroize stats before performing the test
+	 */
+	memset(&stat, 0, sizeof(stat));
+
 	/*
 	 * Collect parameters
 	 */
-	m = state->tp.overlappingTemplateLength;
 	n = state->tp.n;
 	stat.N = n / BLOCK_LENGTH_OVERLAPPING;
 
@@ -262,36 +333,11 @@ OverlappingTemplateMatchings_iterate(struct thread_state *thread_state)
 	 * NOTE: Because the template we are checking is made only of ones, we don't need to
 	 *       allocate any array for it. We compare with the constant B_VALUE (which is 1) instead.
 	 */
-	for (i = 0; i < stat.N; i++) {
-
-		/*
-		 * Set the initial counter of the occurrences of the template in block i to zero
-		 */
-		W_obs = 0;
-
-		/*
-		 * Increase the W_obs counter whenever there is an occurrence of the template in block i
-		 */
-		for (j = 0; j < BLOCK_LENGTH_OVERLAPPING - m + 1; j++) {
-			match = true;
-			for (k = 0; k < m; k++) {
-				if (B_VALUE != state->epsilon[thread_state->thread_id][i * BLOCK_LENGTH_OVERLAPPING + j + k]) {
-					match = false;
-					break;
-				}
-			}
-			if (match == true) {
-				W_obs++;
-			}
-		}
-
-		/*
-		 * Increase the counter v depending on the number of occurrences of the template in block i
-		 */
-		if (W_obs < K_OVERLAPPING) {
-			stat.v[(int) W_obs]++;
-		} else {
-			stat.v[K_OVERLAPPING]++;
+	parts = split_parts(state, stat.N, BLOCK_LENGTH_OVERLAPPING);
+	split_run(thread_state, parts, stat.N, OverlappingTemplateMatchings_part, &pieces);
+	for (i = 0; i < parts; i++) {
+		for (j = 0; j < K_OVERLAPPING + 1; j++) {
+			stat.v[j] += pieces.v[i][j];
 		}
 	}
 
@@ -307,13 +353,15 @@ OverlappingTemplateMatchings_iterate(struct thread_state *thread_state)
 	/*
 	 * Step 5: compute the test p-value
 	 */
+	start = timing_start();
 	p_value = cephes_igamc(K_OVERLAPPING / 2.0, stat.chi2 / 2.0);
+	timing_stop(thread_state, TIMING_PVALUE, start);
 
 	/*
 	 * Lock mutex before making changes to the shared state
 	 */
 	if (thread_state->mutex != NULL) {
-		pthread_mutex_lock(thread_state->mutex);
+		timing_lock(thread_state, thread_state->mutex);
 	}
 
 	/*
@@ -345,7 +393,7 @@ OverlappingTemplateMatchings_iterate(struct thread_state *thread_state)
 	 * Record values computed during this iteration
 	 */
 	if (state->resultstxtFlag == true) {
-		append_value(state->stats[test_num], &stat);
+		recordStats(state, thread_state, test_num, &stat);
 	}
 	append_value(state->p_val[test_num], &p_value);
 
@@ -560,31 +608,25 @@ OverlappingTemplateMatchings_print_p_value(FILE * stream, double p_value)
 
 
 /*
- * OverlappingTemplateMatchings_print - print to results.txt, data*.txt, stats.txt for all iterations
+ * OverlappingTemplateMatchings_print - print iterations to results.txt, data*.txt, stats.txt
  *
  * given:
  *      state           // run state to test under
+ *      first           // first iteration to print
+ *      last            // print up to but not including this iteration
  *
- * This function is called for once to print dynamic arrays into
- * results.txt, data*.txt, stats.txt.
+ * This function is called by the writer as iterations complete, to append
+ * their records to results.txt, data*.txt, stats.txt.
  *
- * NOTE: The initialize and iterate functions must be called before this function is called.
+ * NOTE: The files must have been opened by writer_open().
  */
 void
-OverlappingTemplateMatchings_print(struct state *state)
+OverlappingTemplateMatchings_print(struct state *state, long int first, long int last)
 {
 	struct OverlappingTemplateMatchings_private_stats *stat;	// Pointer to statistics of an iteration
+	struct test_output *out;	// Open stats.txt, results.txt, data*.txt
 	double p_value;			// p_value iteration test result(s)
-	FILE *stats = NULL;		// Open stats.txt file
-	FILE *results = NULL;		// Open results.txt file
-	FILE *data = NULL;		// Open data*.txt file
-	char *stats_txt = NULL;		// Pathname for stats.txt
-	char *results_txt = NULL;	// Pathname for results.txt
-	char *data_txt = NULL;		// Pathname for data*.txt
-	char data_filename[BUFSIZ + 1];	// Basename for a given data*.txt pathname
 	bool ok;			// true -> I/O was OK
-	int snprintf_ret;		// snprintf return value
-	int io_ret;			// I/O return status
 	long int i;
 	long int j;
 
@@ -608,40 +650,33 @@ OverlappingTemplateMatchings_print(struct state *state)
 		    "print driver interface for %s[%d] called with state.partitionCount: %d < 0",
 		    state->testNames[test_num], test_num, state->partitionCount[test_num]);
 	}
-	if (state->p_val[test_num]->count != (state->tp.numOfBitStreams * state->partitionCount[test_num])) {
+	if (state->output == NULL || state->output[test_num].stats == NULL) {
+		err(144, __func__, "print driver interface for %s[%d] called before its files were opened",
+		    state->testNames[test_num], test_num);
+	}
+	out = &state->output[test_num];
+	if (first < out->first || first > last || last > out->first + state->stats[test_num]->count) {
 		err(144, __func__,
-		    "print driver interface for %s[%d] called with p_val count: %ld != %ld*%d=%ld",
-		    state->testNames[test_num], test_num, state->p_val[test_num]->count,
-		    state->tp.numOfBitStreams, state->partitionCount[test_num],
-		    state->tp.numOfBitStreams * state->partitionCount[test_num]);
+		    "print driver interface for %s[%d] called for iterations [%ld, %ld) outside of recorded [%ld, %ld)",
+		    state->testNames[test_num], test_num, first, last, out->first,
+		    out->first + state->stats[test_num]->count);
 	}
-	if (state->datatxt_fmt[test_num] == NULL) {
-		err(144, __func__, "format for data0*.txt filename is NULL");
+	if (state->p_val[test_num]->count < (last * state->partitionCount[test_num])) {
+		err(144, __func__,
+		    "print driver interface for %s[%d] called with p_val count: %ld < %ld*%d=%ld",
+		    state->testNames[test_num], test_num, state->p_val[test_num]->count,
+		    last, state->partitionCount[test_num], last * state->partitionCount[test_num]);
 	}
 
-	/*
-	 * Open stats.txt file
-	 */
-	stats_txt = filePathName(state->subDir[test_num], "stats.txt");
-	dbg(DBG_HIGH, "about to open/truncate: %s", stats_txt);
-	stats = openTruncate(stats_txt);
-
-	/*
-	 * Open results.txt file
-	 */
-	results_txt = filePathName(state->subDir[test_num], "results.txt");
-	dbg(DBG_HIGH, "about to open/truncate: %s", results_txt);
-	results = openTruncate(results_txt);
-
 	/*
 	 * Write results.txt and stats.txt files
 	 */
-	for (i = 0; i < state->stats[test_num]->count; ++i) {
+	for (i = first; i < last; ++i) {
 
 		/*
 		 * Locate stat for this iteration
 		 */
-		stat = addr_value(state->stats[test_num], struct OverlappingTemplateMatchings_private_stats, i);
+		stat = addr_value(state->stats[test_num], struct OverlappingTemplateMatchings_private_stats, i - out->first);
 
 		/*
 		 * Get p_value for this iteration
@@ -652,115 +687,32 @@ OverlappingTemplateMatchings_print(struct state *state)
 		 * Print stat to stats.txt
 		 */
 		errno = 0;	// paranoia
-		ok = OverlappingTemplateMatchings_print_stat(stats, state, stat, p_value);
+		ok = OverlappingTemplateMatchings_print_stat(out->stats, state, stat, p_value);
 		if (ok == false) {
-			errp(144, __func__, "error in writing to %s", stats_txt);
+			errp(144, __func__, "error in writing to %s", out->stats_txt);
 		}
 
 		/*
 		 * Print p_value to results.txt
 		 */
 		errno = 0;	// paranoia
-		ok = OverlappingTemplateMatchings_print_p_value(results, p_value);
+		ok = OverlappingTemplateMatchings_print_p_value(out->results, p_value);
 		if (ok == false) {
-			errp(144, __func__, "error in writing to %s", results_txt);
+			errp(144, __func__, "error in writing to %s", out->results_txt);
 		}
-	}
-
-	/*
-	 * Flush and close stats.txt, free pathname
-	 */
-	errno = 0;		// paranoia
-	io_ret = fflush(stats);
-	if (io_ret != 0) {
-		errp(144, __func__, "error flushing to: %s", stats_txt);
-	}
-	errno = 0;		// paranoia
-	io_ret = fclose(stats);
-	if (io_ret != 0) {
-		errp(144, __func__, "error closing: %s", stats_txt);
-	}
-	free(stats_txt);
-	stats_txt = NULL;
-
-	/*
-	 * Flush and close results.txt, free pathname
-	 */
-	errno = 0;		// paranoia
-	io_ret = fflush(results);
-	if (io_ret != 0) {
-		errp(144, __func__, "error flushing to: %s", results_txt);
-	}
-	errno = 0;		// paranoia
-	io_ret = fclose(results);
-	if (io_ret != 0) {
-		errp(144, __func__, "error closing: %s", results_txt);
-	}
-	free(results_txt);
-	results_txt = NULL;
-
-	/*
-	 * Write data*.txt for each data file if we need to partition results
-	 */
-	if (state->partitionCount[test_num] > 1) {
-		for (j = 0; j < state->partitionCount[test_num]; ++j) {
-
-			/*
-			 * Form the data*.txt basename
-			 */
-			errno = 0;	// paranoia
-			snprintf_ret = snprintf(data_filename, BUFSIZ, state->datatxt_fmt[test_num], j + 1);
-			data_filename[BUFSIZ] = '\0';	// paranoia
-			if (snprintf_ret <= 0 || snprintf_ret >= BUFSIZ || errno != 0) {
-				errp(144, __func__,
-				     "snprintf failed for %d bytes for data%03ld.txt, returned: %d", BUFSIZ, j + 1, snprintf_ret);
-			}
-
-			/*
-			 * Form the data*.txt filename
-			 */
-			data_txt = filePathName(state->subDir[test_num], data_filename);
-			dbg(DBG_HIGH, "about to open/truncate: %s", data_txt);
-			data = openTruncate(data_txt);
-
-			/*
-			 * Write this particular data*.txt filename
-			 */
-			if (j < state->p_val[test_num]->count) {
-				for (i = j; i < state->p_val[test_num]->count; i += state->partitionCount[test_num]) {
-
-					/*
-					 * Get p_value for an iteration belonging to this data*.txt filename
-					 */
-					p_value = get_value(state->p_val[test_num], double, i);
-
-					/*
-					 * Print p_value to results.txt
-					 */
-					errno = 0;	// paranoia
-					ok = OverlappingTemplateMatchings_print_p_value(data, p_value);
-					if (ok == false) {
-						errp(144, __func__, "error in writing to %s", data_txt);
-					}
 
+		/*
+		 * Print the p_values of this iteration to the data*.txt of their partition
+		 */
+		if (state->partitionCount[test_num] > 1) {
+			for (j = 0; j < state->partitionCount[test_num]; ++j) {
+				p_value = get_value(state->p_val[test_num], double, (i * state->partitionCount[test_num]) + j);
+				errno = 0;	// paranoia
+				ok = OverlappingTemplateMatchings_print_p_value(out->data[j], p_value);
+				if (ok == false) {
+					errp(144, __func__, "error in writing to %s", out->data_txt[j]);
 				}
 			}
-
-			/*
-			 * Flush and close data*.txt, free pathname
-			 */
-			errno = 0;	// paranoia
-			io_ret = fflush(data);
-			if (io_ret != 0) {
-				errp(144, __func__, "error flushing to: %s", data_txt);
-			}
-			errno = 0;	// paranoia
-			io_ret = fclose(data);
-			if (io_ret != 0) {
-				errp(144, __func__, "error closing: %s", data_txt);
-			}
-			free(data_txt);
-			data_txt = NULL;
 		}
 	}
 
@@ -36,7 +36,10 @@
 #include "../utils/externs.h"
 #include "../utils/cephes.h"
 #include "../utils/utilities.h"
+#include "../utils/writer.h"
+#include "../utils/timing.h"
 #include "../utils/debug.h"
+#include "../utils/arena.h"
 
 
 /*
@@ -118,6 +121,10 @@ RandomExcursions_init(struct state *state)
 
 	/*
 	 * Allocate the partial sums and the cycle arrays for each thread
+	 *
+	 * The number of cycles J of a random bit stream is about |Z| * sqrt(n) for a standard normal Z, so
+	 * CYCLE_RESERVE_RND_EXCURSION * sqrt(n) cycle ends are all but always enough.  A bit stream with more
+	 * cycles grows the array once to n/2 cycle ends plus the end of the last cycle, the most there can be.
 	 */
 	state->rnd_excursion_S = malloc((size_t) state->numberOfThreads * sizeof(*state->rnd_excursion_S));
 	if (state->rnd_excursion_S == NULL) {
@@ -130,12 +137,9 @@ RandomExcursions_init(struct state *state)
 		     sizeof(*state->rnd_excursion_cycle));
 	}
 	for (i = 0; i < state->numberOfThreads; i++) {
-		state->rnd_excursion_S[i] = malloc(n * sizeof(state->rnd_excursion_S[i][0]));
-		if (state->rnd_excursion_S[i] == NULL) {
-			errp(150, __func__, "cannot malloc of %ld elements of %ld bytes each for state->rnd_excursion_S[%ld]",
-			     n, sizeof(state->rnd_excursion_S[i][0]), i);
-		}
-		state->rnd_excursion_cycle[i] = create_dyn_array(sizeof(long int), DEFAULT_CHUNK, (long int) state->c.sqrtn, true);
+		state->rnd_excursion_S[i] = arena_alloc(state, i, (size_t) n, sizeof(state->rnd_excursion_S[i][0]));
+		state->rnd_excursion_cycle[i] = create_dyn_array(sizeof(long int), DEFAULT_CHUNK,
+							      (long int) (CYCLE_RESERVE_RND_EXCURSION * state->c.sqrtn) + 2, false);
 	}
 
 	/*
@@ -210,11 +214,9 @@ RandomExcursions_init(struct state *state)
 	 * Allocate dynamic arrays
 	 */
 	if (state->resultstxtFlag == true) {
-		state->stats[test_num] = create_dyn_array(sizeof(struct RandomExcursions_private_stats),
-							  DEFAULT_CHUNK, state->tp.numOfBitStreams, false);        // stats.txt
+		state->stats[test_num] = createResults(state, sizeof(struct RandomExcursions_private_stats), 1);        // stats.txt
 	}
-	state->p_val[test_num] = create_dyn_array(sizeof(double), DEFAULT_CHUNK,
-						  NUMBER_OF_STATES_RND_EXCURSION * state->tp.numOfBitStreams, false); // results.txt
+	state->p_val[test_num] = createResults(state, sizeof(double), state->partitionCount[test_num]);	// results.txt
 
 	/*
 	 * Determine format of data*.txt filenames based on state->partitionCount[test_num]
@@ -242,6 +244,7 @@ void
 RandomExcursions_iterate(struct thread_state *thread_state)
 {
 	struct RandomExcursions_private_stats stat;	// Stats for this iteration
+	uint64_t start;		// ticks when the p-value computation started
 	long int n;					// Length of a single bit stream
 	long int v[DEGREES_OF_FREEDOM_RND_EXCURSION][NUMBER_OF_STATES_RND_EXCURSION];	// Global frequency counters
 	struct dyn_array *cycle;	// Counter used for single iterations
@@ -254,7 +257,8 @@ RandomExcursions_iterate(struct thread_state *thread_state)
 	long int cycleStop;		// Index where a cycle ends
 	long int occurrences;		// Number of occurrences of a given state value in a cycle
 	double p_value;			// p_value iteration test result(s)
-	double *p_values;		// Array of p-values produced by this test
+	double p_values[NUMBER_OF_STATES_RND_EXCURSION];	// p-values produced by this test
+	double half_chi2[NUMBER_OF_STATES_RND_EXCURSION];	// chi2 / 2 of each state
 	double sum_term;		// Value whose square is used to compute the test statistic
 	long int i;
 	long int j;
@@ -299,6 +303,11 @@ RandomExcursions_iterate(struct thread_state *thread_state)
 		    __func__, state->testNames[test_num], test_num);
 	}
 
+	/*
+	 * Zeroize stats before performing the test
+	 */
+	memset(&stat, 0, sizeof(stat));
+
 	/*
 	 * Collect parameters from state
 	 */
@@ -335,6 +344,9 @@ RandomExcursions_iterate(struct thread_state *thread_state)
 		 * ended, append the ending position of that cycle to the cycle array
 		 */
 		if (S[i] == 0) {
+			if (cycle->count == cycle->allocated) {
+				reserve_dyn_array(cycle, n / 2 + 2);
+			}
 			append_value(cycle, &i);
 		}
 	}
@@ -463,8 +475,6 @@ RandomExcursions_iterate(struct thread_state *thread_state)
 			}
 		}
 
-		p_values = malloc(NUMBER_OF_STATES_RND_EXCURSION * sizeof(*p_values));
-
 		/*
 		 * Compute the test statistic and the p-value for each of the states.
 		 */
@@ -497,22 +507,22 @@ RandomExcursions_iterate(struct thread_state *thread_state)
 								       * state->rnd_excursion_pi_terms[labs_x - 1][j]);
 			}
 
-			/*
-			 * Step 8: compute the p-value for this state
-			 */
-			p_value = cephes_igamc((double) (DEGREES_OF_FREEDOM_RND_EXCURSION - 1) / 2.0, stat.chi2[i] / 2.0);
-
-			/*
-			 * Save p-value in the arrays of p-values
-			 */
-			p_values[i] = p_value;
+			half_chi2[i] = stat.chi2[i] / 2.0;
 		}
 
+		/*
+		 * Step 8: compute the p-value of each state, all chi-squares of the same degrees of freedom
+		 */
+		start = timing_start();
+		cephes_igamc_batch((double) (DEGREES_OF_FREEDOM_RND_EXCURSION - 1) / 2.0, half_chi2, p_values,
+				   NUMBER_OF_STATES_RND_EXCURSION);
+		timing_stop(thread_state, TIMING_PVALUE, start);
+
 		/*
 		 * Lock mutex before making changes to the shared state
 		 */
 		if (thread_state->mutex != NULL) {
-			pthread_mutex_lock(thread_state->mutex);
+			timing_lock(thread_state, thread_state->mutex);
 		}
 
 		/*
@@ -560,7 +570,7 @@ RandomExcursions_iterate(struct thread_state *thread_state)
 		 * Record stats of this iteration
 		 */
 		if (state->resultstxtFlag == true) {
-			append_value(state->stats[test_num], &stat);
+			recordStats(state, thread_state, test_num, &stat);
 		}
 	}
 
@@ -572,7 +582,7 @@ RandomExcursions_iterate(struct thread_state *thread_state)
 		 * Lock mutex before making changes to the shared state
 		 */
 		if (thread_state->mutex != NULL) {
-			pthread_mutex_lock(thread_state->mutex);
+			timing_lock(thread_state, thread_state->mutex);
 		}
 
 		/*
@@ -588,7 +598,7 @@ RandomExcursions_iterate(struct thread_state *thread_state)
 		}
 		memset(stat.counter, 0, sizeof(stat.counter));
 		if (state->resultstxtFlag == true) {
-			append_value(state->stats[test_num], &stat);
+			recordStats(state, thread_state, test_num, &stat);
 		}
 
 		/*
@@ -927,31 +937,25 @@ RandomExcursions_print_p_value(FILE * stream, double p_value)
 
 
 /*
- * RandomExcursions_print - print to results.txt, data*.txt, stats.txt for all iterations
+ * RandomExcursions_print - print iterations to results.txt, data*.txt, stats.txt
  *
  * given:
  *      state           // run state to test under
+ *      first           // first iteration to print
+ *      last            // print up to but not including this iteration
  *
- * This function is called for once to print dynamic arrays into
- * results.txt, data*.txt, stats.txt.
+ * This function is called by the writer as iterations complete, to append
+ * their records to results.txt, data*.txt, stats.txt.
  *
- * NOTE: The initialize and iterate functions must be called before this function is called.
+ * NOTE: The files must have been opened by writer_open().
  */
 void
-RandomExcursions_print(struct state *state)
+RandomExcursions_print(struct state *state, long int first, long int last)
 {
 	struct RandomExcursions_private_stats *stat;	// Pointer to statistics of an iteration
+	struct test_output *out;	// Open stats.txt, results.txt, data*.txt
 	double p_value;			// p_value iteration test result(s)
-	FILE *stats = NULL;		// Open stats.txt file
-	FILE *results = NULL;		// Open results.txt file
-	FILE *data = NULL;		// Open data*.txt file
-	char *stats_txt = NULL;		// Pathname for stats.txt
-	char *results_txt = NULL;	// Pathname for results.txt
-	char *data_txt = NULL;		// Pathname for data*.txt
-	char data_filename[BUFSIZ + 1];	// Basename for a given data*.txt pathname
 	bool ok;			// true -> I/O was OK
-	int snprintf_ret;		// snprintf return value
-	int io_ret;			// I/O return status
 	long int i;
 	long int j;
 	long int p;
@@ -976,48 +980,41 @@ RandomExcursions_print(struct state *state)
 		    "print driver interface for %s[%d] called with state.partitionCount: %d < 0",
 		    state->testNames[test_num], test_num, state->partitionCount[test_num]);
 	}
-	if (state->p_val[test_num]->count != (state->tp.numOfBitStreams * state->partitionCount[test_num])) {
+	if (state->output == NULL || state->output[test_num].stats == NULL) {
+		err(155, __func__, "print driver interface for %s[%d] called before its files were opened",
+		    state->testNames[test_num], test_num);
+	}
+	out = &state->output[test_num];
+	if (first < out->first || first > last || last > out->first + state->stats[test_num]->count) {
 		err(155, __func__,
-		    "print driver interface for %s[%d] called with p_val count: %ld != %ld*%d=%ld",
-		    state->testNames[test_num], test_num, state->p_val[test_num]->count,
-		    state->tp.numOfBitStreams, state->partitionCount[test_num],
-		    state->tp.numOfBitStreams * state->partitionCount[test_num]);
+		    "print driver interface for %s[%d] called for iterations [%ld, %ld) outside of recorded [%ld, %ld)",
+		    state->testNames[test_num], test_num, first, last, out->first,
+		    out->first + state->stats[test_num]->count);
 	}
-	if (state->datatxt_fmt[test_num] == NULL) {
-		err(155, __func__, "format for data0*.txt filename is NULL");
+	if (state->p_val[test_num]->count < (last * state->partitionCount[test_num])) {
+		err(155, __func__,
+		    "print driver interface for %s[%d] called with p_val count: %ld < %ld*%d=%ld",
+		    state->testNames[test_num], test_num, state->p_val[test_num]->count,
+		    last, state->partitionCount[test_num], last * state->partitionCount[test_num]);
 	}
 
-	/*
-	 * Open stats.txt file
-	 */
-	stats_txt = filePathName(state->subDir[test_num], "stats.txt");
-	dbg(DBG_HIGH, "about to open/truncate: %s", stats_txt);
-	stats = openTruncate(stats_txt);
-
-	/*
-	 * Open results.txt file
-	 */
-	results_txt = filePathName(state->subDir[test_num], "results.txt");
-	dbg(DBG_HIGH, "about to open/truncate: %s", results_txt);
-	results = openTruncate(results_txt);
-
 	/*
 	 * Write results.txt and stats.txt files
 	 */
-	for (i = 0, j = 0; i < state->stats[test_num]->count; ++i, j += NUMBER_OF_STATES_RND_EXCURSION) {
+	for (i = first, j = first * NUMBER_OF_STATES_RND_EXCURSION; i < last; ++i, j += NUMBER_OF_STATES_RND_EXCURSION) {
 
 		/*
 		 * Locate stat for this iteration
 		 */
-		stat = addr_value(state->stats[test_num], struct RandomExcursions_private_stats, i);
+		stat = addr_value(state->stats[test_num], struct RandomExcursions_private_stats, i - out->first);
 
 		/*
 		 * Print stat to stats.txt
 		 */
 		errno = 0;	// paranoia
-		ok = RandomExcursions_print_stat(stats, state, stat, i);
+		ok = RandomExcursions_print_stat(out->stats, state, stat, i);
 		if (ok == false) {
-			errp(155, __func__, "error in writing to %s", stats_txt);
+			errp(155, __func__, "error in writing to %s", out->stats_txt);
 		}
 
 		/*
@@ -1034,116 +1031,30 @@ RandomExcursions_print(struct state *state)
 			 * Print, if possible, the excursion success or failure, visit and p_value
 			 */
 			errno = 0;	// paranoia
-			ok = RandomExcursions_print_stat2(stats, state, stat, p, p_value);
+			ok = RandomExcursions_print_stat2(out->stats, state, stat, p, p_value);
 			if (ok == false) {
-				errp(155, __func__, "error in writing to %s", stats_txt);
+				errp(155, __func__, "error in writing to %s", out->stats_txt);
 			}
 
 			/*
 			 * Print p_value to results.txt
 			 */
 			errno = 0;	// paranoia
-			ok = RandomExcursions_print_p_value(results, p_value);
+			ok = RandomExcursions_print_p_value(out->results, p_value);
 			if (ok == false) {
-				errp(155, __func__, "error in writing to %s", results_txt);
+				errp(155, __func__, "error in writing to %s", out->results_txt);
 			}
-		}
-	}
-
-	/*
-	 * Flush and close stats.txt, free pathname
-	 */
-	errno = 0;		// paranoia
-	io_ret = fflush(stats);
-	if (io_ret != 0) {
-		errp(155, __func__, "error flushing to: %s", stats_txt);
-	}
-	errno = 0;		// paranoia
-	io_ret = fclose(stats);
-	if (io_ret != 0) {
-		errp(155, __func__, "error closing: %s", stats_txt);
-	}
-	free(stats_txt);
-	stats_txt = NULL;
-
-	/*
-	 * Flush and close results.txt, free pathname
-	 */
-	errno = 0;		// paranoia
-	io_ret = fflush(results);
-	if (io_ret != 0) {
-		errp(155, __func__, "error flushing to: %s", results_txt);
-	}
-	errno = 0;		// paranoia
-	io_ret = fclose(results);
-	if (io_ret != 0) {
-		errp(155, __func__, "error closing: %s", results_txt);
-	}
-	free(results_txt);
-	results_txt = NULL;
-
-	/*
-	 * Write data*.txt for each data file if we need to partition results
-	 */
-	if (state->partitionCount[test_num] > 1) {
-		for (j = 0; j < state->partitionCount[test_num]; ++j) {
-
-			/*
-			 * Form the data*.txt basename
-			 */
-			errno = 0;	// paranoia
-			snprintf_ret = snprintf(data_filename, BUFSIZ, state->datatxt_fmt[test_num], j + 1);
-			data_filename[BUFSIZ] = '\0';	// paranoia
-			if (snprintf_ret <= 0 || snprintf_ret >= BUFSIZ || errno != 0) {
-				errp(155, __func__,
-				     "snprintf failed for %d bytes for data%03ld.txt, returned: %d", BUFSIZ, j + 1, snprintf_ret);
-			}
-
-			/*
-			 * Form the data*.txt filename
-			 */
-			data_txt = filePathName(state->subDir[test_num], data_filename);
-			dbg(DBG_HIGH, "about to open/truncate: %s", data_txt);
-			data = openTruncate(data_txt);
 
 			/*
-			 * Write this particular data*.txt filename
+			 * Print p_value to the data*.txt of its partition
 			 */
-			if (j < state->p_val[test_num]->count) {
-				for (i = j; i < state->p_val[test_num]->count; i += state->partitionCount[test_num]) {
-
-					/*
-					 * Get p_value for an iteration belonging to this data*.txt filename
-					 */
-					p_value = get_value(state->p_val[test_num], double, i);
-
-					/*
-					 * Print p_value to results.txt
-					 */
-					errno = 0;	// paranoia
-					ok = RandomExcursions_print_p_value(data, p_value);
-					if (ok == false) {
-						errp(155, __func__, "error in writing to %s", data_txt);
-					}
-
+			if (state->partitionCount[test_num] > 1) {
+				errno = 0;	// paranoia
+				ok = RandomExcursions_print_p_value(out->data[p], p_value);
+				if (ok == false) {
+					errp(155, __func__, "error in writing to %s", out->data_txt[p]);
 				}
 			}
-
-			/*
-			 * Flush and close data*.txt, free pathname
-			 */
-			errno = 0;	// paranoia
-			io_ret = fflush(data);
-			if (io_ret != 0) {
-				errp(155, __func__, "error flushing to: %s", data_txt);
-			}
-			errno = 0;	// paranoia
-			io_ret = fclose(data);
-			if (io_ret != 0) {
-				errp(155, __func__, "error closing: %s", data_txt);
-			}
-			free(data_txt);
-			data_txt = NULL;
 		}
 	}
 
@@ -1493,10 +1404,6 @@ RandomExcursions_destroy(struct state *state)
 		state->rnd_excursion_stateX = NULL;
 	}
 	for (i = 0; i < state->numberOfThreads; i++) {
-		if (state->rnd_excursion_S[i] != NULL) {
-			free(state->rnd_excursion_S[i]);
-			state->rnd_excursion_S[i] = NULL;
-		}
 		if (state->rnd_excursion_cycle[i] != NULL) {
 			free_dyn_array(state->rnd_excursion_cycle[i]);
 			state->rnd_excursion_cycle[i] = NULL;
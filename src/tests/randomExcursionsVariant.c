@@ -36,7 +36,11 @@
 #include "../utils/externs.h"
 #include "../utils/cephes.h"
 #include "../utils/utilities.h"
+#include "../utils/writer.h"
+#include "../utils/timing.h"
 #include "../utils/debug.h"
+#include "../utils/arena.h"
+#include "../utils/memo.h"
 
 
 /*
@@ -148,22 +152,24 @@ RandomExcursionsVariant_init(struct state *state)
 		     sizeof(*state->ex_var_partial_sums));
 	}
 	for (i = 0; i < state->numberOfThreads; i++) {
-		state->ex_var_partial_sums[i] = malloc(n * sizeof(state->ex_var_partial_sums[i][0]));
-		if (state->ex_var_partial_sums[i] == NULL) {
-			errp(190, __func__, "cannot malloc of %ld elements of %ld bytes each for state->ex_var_partial_sums[%ld]",
-			     state->tp.n, sizeof(state->ex_var_partial_sums[i][0]), i);
-		}
+		state->ex_var_partial_sums[i] = arena_alloc(state, i, (size_t) n, sizeof(state->ex_var_partial_sums[i][0]));
 	}
 
 	/*
 	 * Allocate dynamic arrays
 	 */
 	if (state->resultstxtFlag == true) {
-		state->stats[test_num] = create_dyn_array(sizeof(struct RandomExcursionsVariant_private_stats),
-							  DEFAULT_CHUNK, state->tp.numOfBitStreams, false);        // stats.txt
+		state->stats[test_num] = createResults(state, sizeof(struct RandomExcursionsVariant_private_stats), 1);        // stats.txt
+	}
+	state->p_val[test_num] = createResults(state, sizeof(double), state->partitionCount[test_num]);	// results.txt
+
+	/*
+	 * Keep the p-value of each number of cycles, excess of visits and |state|, when they fit a key
+	 */
+	if (n < ((long int) 1 << 30)) {
+		state->memo[test_num] = memo_create(state->testNames[test_num],
+						    NUMBER_OF_STATES_RND_EXCURSION_VAR * state->tp.numOfBitStreams);
 	}
-	state->p_val[test_num] = create_dyn_array(sizeof(double), DEFAULT_CHUNK, NUMBER_OF_STATES_RND_EXCURSION_VAR *
-			state->tp.numOfBitStreams, false);						// results.txt
 
 	/*
 	 * Determine format of data*.txt filenames based on state->partitionCount[test_num]
@@ -191,10 +197,12 @@ void
 RandomExcursionsVariant_iterate(struct thread_state *thread_state)
 {
 	struct RandomExcursionsVariant_private_stats stat;	// Stats for this iteration
+	uint64_t start;		// ticks when the p-value computation started
 	long int n;		// Length of a single bit stream
 	long int *S;		// Array of the partial sums of the -1/+1 states
 	double p_value;		// p_value iteration test result(s)
-	double *p_values;	// Array of p-values produced by this test
+	double p_values[NUMBER_OF_STATES_RND_EXCURSION_VAR];	// p-values produced by this test
+	uint64_t key;		// Key of a p-value in the memo of the test
 	long int i;
 	long int j;
 
@@ -232,6 +240,11 @@ RandomExcursionsVariant_iterate(struct thread_state *thread_state)
 		    __func__, state->testNames[test_num], test_num);
 	}
 
+	/*
+	 * Zeroize stats before performing the test
+	 */
+	memset(&stat, 0, sizeof(stat));
+
 	/*
 	 * Collect parameters from state
 	 */
@@ -288,8 +301,6 @@ RandomExcursionsVariant_iterate(struct thread_state *thread_state)
 	 */
 	if (stat.test_possible == true) {
 
-		p_values = malloc(NUMBER_OF_STATES_RND_EXCURSION_VAR * sizeof(*p_values));
-
 		/*
 		 * For each of the state values, compute the test statistic and the p-value
 		 */
@@ -306,11 +317,19 @@ RandomExcursionsVariant_iterate(struct thread_state *thread_state)
 			}
 
 			/*
-			 * Step 5: compute the test p-value for this excursion state value
+			 * Step 5: compute the test p-value for this excursion state value, unless an iteration did
 			 */
-			p_value = erfc(labs(stat.counter[i] - stat.number_of_cycles)
-				       / (sqrt(2.0 * stat.number_of_cycles
-					       * (4.0 * labs(state->rnd_excursion_var_stateX[i]) - 2.0))));
+			key = ((uint64_t) stat.number_of_cycles * (uint64_t) (n + 1) +
+			       (uint64_t) labs(stat.counter[i] - stat.number_of_cycles)) * (MAX_EXCURSION_RND_EXCURSION_VAR + 1) +
+			      (uint64_t) labs(state->rnd_excursion_var_stateX[i]);
+			start = timing_start();
+			if (memo_get(state->memo[test_num], key, &p_value) == false) {
+				p_value = erfc(labs(stat.counter[i] - stat.number_of_cycles)
+					       / (sqrt(2.0 * stat.number_of_cycles
+						       * (4.0 * labs(state->rnd_excursion_var_stateX[i]) - 2.0))));
+				memo_put(state->memo[test_num], key, p_value);
+			}
+			timing_stop(thread_state, TIMING_PVALUE, start);
 
 			/*
 			 * Save p-value in the arrays of p-values
@@ -322,7 +341,7 @@ RandomExcursionsVariant_iterate(struct thread_state *thread_state)
 		 * Lock mutex before making changes to the shared state
 		 */
 		if (thread_state->mutex != NULL) {
-			pthread_mutex_lock(thread_state->mutex);
+			timing_lock(thread_state, thread_state->mutex);
 		}
 
 		/*
@@ -370,7 +389,7 @@ RandomExcursionsVariant_iterate(struct thread_state *thread_state)
 		 * Record stats of this iteration
 		 */
 		if (state->resultstxtFlag == true) {
-			append_value(state->stats[test_num], &stat);
+			recordStats(state, thread_state, test_num, &stat);
 		}
 	}
 
@@ -383,7 +402,7 @@ RandomExcursionsVariant_iterate(struct thread_state *thread_state)
 		 * Lock mutex before making changes to the shared state
 		 */
 		if (thread_state->mutex != NULL) {
-			pthread_mutex_lock(thread_state->mutex);
+			timing_lock(thread_state, thread_state->mutex);
 		}
 
 		/*
@@ -399,7 +418,7 @@ RandomExcursionsVariant_iterate(struct thread_state *thread_state)
 		}
 		memset(stat.counter, 0, sizeof(stat.counter));
 		if (state->resultstxtFlag == true) {
-			append_value(state->stats[test_num], &stat);
+			recordStats(state, thread_state, test_num, &stat);
 		}
 
 		/*
@@ -710,31 +729,25 @@ RandomExcursionsVariant_print_p_value(FILE * stream, double p_value)
 
 
 /*
- * RandomExcursionsVariant_print - print to results.txt, data*.txt, stats.txt for all iterations
+ * RandomExcursionsVariant_print - print iterations to results.txt, data*.txt, stats.txt
  *
  * given:
  *      state           // run state to test under
+ *      first           // first iteration to print
+ *      last            // print up to but not including this iteration
  *
- * This function is called for once to print dynamic arrays into
- * results.txt, data*.txt, stats.txt.
+ * This function is called by the writer as iterations complete, to append
+ * their records to results.txt, data*.txt, stats.txt.
  *
- * NOTE: The initialize and iterate functions must be called before this function is called.
+ * NOTE: The files must have been opened by writer_open().
  */
 void
-RandomExcursionsVariant_print(struct state *state)
+RandomExcursionsVariant_print(struct state *state, long int first, long int last)
 {
 	struct RandomExcursionsVariant_private_stats *stat;	// Pointer to statistics of an iteration
+	struct test_output *out;	// Open stats.txt, results.txt, data*.txt
 	double p_value;			// p_value iteration test result(s)
-	FILE *stats = NULL;		// Open stats.txt file
-	FILE *results = NULL;		// Open results.txt file
-	FILE *data = NULL;		// Open data*.txt file
-	char *stats_txt = NULL;		// Pathname for stats.txt
-	char *results_txt = NULL;	// Pathname for results.txt
-	char *data_txt = NULL;		// Pathname for data*.txt
-	char data_filename[BUFSIZ + 1];	// Basename for a given data*.txt pathname
 	bool ok;			// true -> I/O was OK
-	int snprintf_ret;		// snprintf return value
-	int io_ret;			// I/O return status
 	long int i;
 	long int j;
 	long int p;
@@ -759,48 +772,41 @@ RandomExcursionsVariant_print(struct state *state)
 		    "print driver interface for %s[%d] called with state.partitionCount: %d < 0",
 		    state->testNames[test_num], test_num, state->partitionCount[test_num]);
 	}
-	if (state->p_val[test_num]->count != (state->tp.numOfBitStreams * state->partitionCount[test_num])) {
+	if (state->output == NULL || state->output[test_num].stats == NULL) {
+		err(165, __func__, "print driver interface for %s[%d] called before its files were opened",
+		    state->testNames[test_num], test_num);
+	}
+	out = &state->output[test_num];
+	if (first < out->first || first > last || last > out->first + state->stats[test_num]->count) {
 		err(165, __func__,
-		    "print driver interface for %s[%d] called with p_val count: %ld != %ld*%d=%ld",
-		    state->testNames[test_num], test_num, state->p_val[test_num]->count,
-		    state->tp.numOfBitStreams, state->partitionCount[test_num],
-		    state->tp.numOfBitStreams * state->partitionCount[test_num]);
+		    "print driver interface for %s[%d] called for iterations [%ld, %ld) outside of recorded [%ld, %ld)",
+		    state->testNames[test_num], test_num, first, last, out->first,
+		    out->first + state->stats[test_num]->count);
 	}
-	if (state->datatxt_fmt[test_num] == NULL) {
-		err(165, __func__, "format for data0*.txt filename is NULL");
+	if (state->p_val[test_num]->count < (last * state->partitionCount[test_num])) {
+		err(165, __func__,
+		    "print driver interface for %s[%d] called with p_val count: %ld < %ld*%d=%ld",
+		    state->testNames[test_num], test_num, state->p_val[test_num]->count,
+		    last, state->partitionCount[test_num], last * state->partitionCount[test_num]);
 	}
 
-	/*
-	 * Open stats.txt file
-	 */
-	stats_txt = filePathName(state->subDir[test_num], "stats.txt");
-	dbg(DBG_HIGH, "about to open/truncate: %s", stats_txt);
-	stats = openTruncate(stats_txt);
-
-	/*
-	 * Open results.txt file
-	 */
-	results_txt = filePathName(state->subDir[test_num], "results.txt");
-	dbg(DBG_HIGH, "about to open/truncate: %s", results_txt);
-	results = openTruncate(results_txt);
-
 	/*
 	 * Write results.txt and stats.txt files
 	 */
-	for (i = 0, j = 0; i < state->stats[test_num]->count; ++i, j += NUMBER_OF_STATES_RND_EXCURSION_VAR) {
+	for (i = first, j = first * NUMBER_OF_STATES_RND_EXCURSION_VAR; i < last; ++i, j += NUMBER_OF_STATES_RND_EXCURSION_VAR) {
 
 		/*
 		 * Locate stat for this iteration
 		 */
-		stat = addr_value(state->stats[test_num], struct RandomExcursionsVariant_private_stats, i);
+		stat = addr_value(state->stats[test_num], struct RandomExcursionsVariant_private_stats, i - out->first);
 
 		/*
 		 * Print stat to stats.txt
 		 */
 		errno = 0;	// paranoia
-		ok = RandomExcursionsVariant_print_stat(stats, state, stat, i);
+		ok = RandomExcursionsVariant_print_stat(out->stats, state, stat, i);
 		if (ok == false) {
-			errp(165, __func__, "error in writing to %s", stats_txt);
+			errp(165, __func__, "error in writing to %s", out->stats_txt);
 		}
 
 		/*
@@ -817,116 +823,30 @@ RandomExcursionsVariant_print(struct state *state)
 			 * Print, if possible, the excursion success or failure, visit and p_value
 			 */
 			errno = 0;	// paranoia
-			ok = RandomExcursionsVariant_print_stat2(stats, state, stat, p, p_value);
+			ok = RandomExcursionsVariant_print_stat2(out->stats, state, stat, p, p_value);
 			if (ok == false) {
-				errp(165, __func__, "error in writing to %s", stats_txt);
+				errp(165, __func__, "error in writing to %s", out->stats_txt);
 			}
 
 			/*
 			 * Print p_value to results.txt
 			 */
 			errno = 0;	// paranoia
-			ok = RandomExcursionsVariant_print_p_value(results, p_value);
+			ok = RandomExcursionsVariant_print_p_value(out->results, p_value);
 			if (ok == false) {
-				errp(165, __func__, "error in writing to %s", results_txt);
-			}
-		}
-	}
-
-	/*
-	 * Flush and close stats.txt, free pathname
-	 */
-	errno = 0;		// paranoia
-	io_ret = fflush(stats);
-	if (io_ret != 0) {
-		errp(165, __func__, "error flushing to: %s", stats_txt);
-	}
-	errno = 0;		// paranoia
-	io_ret = fclose(stats);
-	if (io_ret != 0) {
-		errp(165, __func__, "error closing: %s", stats_txt);
-	}
-	free(stats_txt);
-	stats_txt = NULL;
-
-	/*
-	 * Flush and close results.txt, free pathname
-	 */
-	errno = 0;		// paranoia
-	io_ret = fflush(results);
-	if (io_ret != 0) {
-		errp(165, __func__, "error flushing to: %s", results_txt);
-	}
-	errno = 0;		// paranoia
-	io_ret = fclose(results);
-	if (io_ret != 0) {
-		errp(165, __func__, "error closing: %s", results_txt);
-	}
-	free(results_txt);
-	results_txt = NULL;
-
-	/*
-	 * Write data*.txt for each data file if we need to partition results
-	 */
-	if (state->partitionCount[test_num] > 1) {
-		for (j = 0; j < state->partitionCount[test_num]; ++j) {
-
-			/*
-			 * Form the data*.txt basename
-			 */
-			errno = 0;	// paranoia
-			snprintf_ret = snprintf(data_filename, BUFSIZ, state->datatxt_fmt[test_num], j + 1);
-			data_filename[BUFSIZ] = '\0';	// paranoia
-			if (snprintf_ret <= 0 || snprintf_ret >= BUFSIZ || errno != 0) {
-				errp(165, __func__,
-				     "snprintf failed for %d bytes for data%03ld.txt, returned: %d", BUFSIZ, j + 1, snprintf_ret);
+				errp(165, __func__, "error in writing to %s", out->results_txt);
 			}
 
 			/*
-			 * Form the data*.txt filename
+			 * Print p_value to the data*.txt of its partition
 			 */
-			data_txt = filePathName(state->subDir[test_num], data_filename);
-			dbg(DBG_HIGH, "about to open/truncate: %s", data_txt);
-			data = openTruncate(data_txt);
-
-			/*
-			 * Write this particular data*.txt filename
-			 */
-			if (j < state->p_val[test_num]->count) {
-				for (i = j; i < state->p_val[test_num]->count; i += state->partitionCount[test_num]) {
-
-					/*
-					 * Get p_value for an iteration belonging to this data*.txt filename
-					 */
-					p_value = get_value(state->p_val[test_num], double, i);
-
-					/*
-					 * Print p_value to results.txt
-					 */
-					errno = 0;	// paranoia
-					ok = RandomExcursionsVariant_print_p_value(data, p_value);
-					if (ok == false) {
-						errp(165, __func__, "error in writing to %s", data_txt);
-					}
-
+			if (state->partitionCount[test_num] > 1) {
+				errno = 0;	// paranoia
+				ok = RandomExcursionsVariant_print_p_value(out->data[p], p_value);
+				if (ok == false) {
+					errp(165, __func__, "error in writing to %s", out->data_txt[p]);
 				}
 			}
-
-			/*
-			 * Flush and close data*.txt, free pathname
-			 */
-			errno = 0;	// paranoia
-			io_ret = fflush(data);
-			if (io_ret != 0) {
-				errp(165, __func__, "error flushing to: %s", data_txt);
-			}
-			errno = 0;	// paranoia
-			io_ret = fclose(data);
-			if (io_ret != 0) {
-				errp(165, __func__, "error closing: %s", data_txt);
-			}
-			free(data_txt);
-			data_txt = NULL;
 		}
 	}
 
@@ -1233,8 +1153,6 @@ RandomExcursionsVariant_metrics(struct state *state)
 void
 RandomExcursionsVariant_destroy(struct state *state)
 {
-	long int i;
-
 	/*
 	 * Check preconditions (firewall)
 	 */
@@ -1275,16 +1193,12 @@ RandomExcursionsVariant_destroy(struct state *state)
 		free(state->rnd_excursion_var_stateX);
 		state->rnd_excursion_var_stateX = NULL;
 	}
-	for (i = 0; i < state->numberOfThreads; i++) {
-		if (state->ex_var_partial_sums[i] != NULL) {
-			free(state->ex_var_partial_sums[i]);
-			state->ex_var_partial_sums[i] = NULL;
-		}
-	}
 	if (state->ex_var_partial_sums != NULL) {
 		free(state->ex_var_partial_sums);
 		state->ex_var_partial_sums = NULL;
 	}
+	memo_free(state->memo[test_num]);
+	state->memo[test_num] = NULL;
 
 	return;
 }
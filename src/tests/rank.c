@@ -38,6 +38,9 @@
 #include "../utils/cephes.h"
 #include "../utils/matrix.h"
 #include "../utils/utilities.h"
+#include "../utils/writer.h"
+#include "../utils/timing.h"
+#include "../utils/split.h"
 #include "../utils/debug.h"
 
 
@@ -71,6 +74,7 @@ static long int matrix_count;		// Total possible matrix for a given bit stream l
 /*
  * Forward static function declarations
  */
+static split_fn Rank_part;
 static bool Rank_print_stat(FILE * stream, struct state *state, struct Rank_private_stats *stat, double p_value);
 static bool Rank_print_p_value(FILE * stream, double p_value);
 static void Rank_metric_print(struct state *state, long int sampleCount, long int toolow, long int *freqPerBin);
@@ -91,6 +95,7 @@ Rank_init(struct state *state)
 {
 	double product;			// Probability product, used when computing values of static variables
 	int r;				// Row count to consider, used when computing values of static variables
+	long int part;			// -J piece of the work of a thread
 	int i;
 
 	/*
@@ -178,15 +183,18 @@ Rank_init(struct state *state)
 	}
 
 	/*
-	 * Allocate the array for the rank test matrices for each thread
+	 * Allocate the array for the rank test matrices for each thread, and each -J piece of its work
 	 */
-	state->rank_matrix = malloc((size_t) state->numberOfThreads * sizeof(*state->rank_matrix));
+	state->rank_matrix = malloc((size_t) (state->numberOfThreads * state->splitParts) * sizeof(*state->rank_matrix));
 	if (state->rank_matrix == NULL) {
-		errp(50, __func__, "cannot malloc for rank_matrix: %ld elements of %ld bytes each", state->numberOfThreads,
-		     sizeof(*state->rank_matrix));
+		errp(50, __func__, "cannot malloc for rank_matrix: %ld elements of %ld bytes each",
+		     state->numberOfThreads * state->splitParts, sizeof(*state->rank_matrix));
 	}
 	for (i = 0; i < state->numberOfThreads; i++) {
-		state->rank_matrix[i] = create_matrix(NUMBER_OF_ROWS_RANK, NUMBER_OF_COLS_RANK);
+		for (part = 0; part < state->splitParts; part++) {
+			state->rank_matrix[split_slot(state, i, part)] = create_matrix(state, i, NUMBER_OF_ROWS_RANK,
+											NUMBER_OF_COLS_RANK);
+		}
 	}
 
 	/*
@@ -201,11 +209,9 @@ Rank_init(struct state *state)
 	 * Allocate dynamic arrays
 	 */
 	if (state->resultstxtFlag == true) {
-		state->stats[test_num] = create_dyn_array(sizeof(struct Rank_private_stats),
-							  DEFAULT_CHUNK, state->tp.numOfBitStreams, false);        // stats.txt
+		state->stats[test_num] = createResults(state, sizeof(struct Rank_private_stats), 1);        // stats.txt
 	}
-	state->p_val[test_num] = create_dyn_array(sizeof(double),
-						  DEFAULT_CHUNK, state->tp.numOfBitStreams, false);	// results.txt
+	state->p_val[test_num] = createResults(state, sizeof(double), state->partitionCount[test_num]);	// results.txt
 
 	/*
 	 * Determine format of data*.txt filenames based on state->partitionCount[test_num]
@@ -220,63 +226,36 @@ Rank_init(struct state *state)
 
 
 /*
- * Rank_iterate - iterate one bit stream for Rank test
+ * Rank_part - count the full rank and full rank - 1 matrices of a piece of the bit stream
  *
  * given:
- *      state           // run state to test under
- *
- * This function is called for each and every iteration noted in state->tp.numOfBitStreams.
- *
- * NOTE: The initialize function must be called first.
+ *      thread_state    // state of the thread testing the bit stream
+ *      arg             // array of the struct Rank_private_stats of each piece
+ *      part            // piece to count
+ *      first           // first matrix of the piece
+ *      last            // matrix after the last matrix of the piece
  */
-void
-Rank_iterate(struct thread_state *thread_state)
+static void
+Rank_part(struct thread_state *thread_state, void *arg, long int part, long int first, long int last)
 {
-	struct Rank_private_stats stat;	// Stats for this iteration
-	BitSequence **matrix;		// The matrix state->rank_matrix
-	BitSequence *row;		// A row of the matrix state->rank_matrix
+	struct state *state = thread_state->global_state;
+	struct Rank_private_stats *stat = (struct Rank_private_stats *) arg + part;
+	BitSequence **matrix;		// The matrix state->rank_matrix of the piece
+	BitSequence *row;		// A row of the matrix
 	int R;				// Rank of a given NUMBER_OF_ROWS_RANK by NUMBER_OF_COLS_RANK matrix
-	double p_value;			// p_value iteration test result(s)
 	long int k;
 	long int i;
 
-	/*
-	 * Check preconditions (firewall)
-	 */
-	if (thread_state == NULL) {
-		err(171, __func__, "thread_state arg is NULL");
-	}
-	struct state *state = thread_state->global_state;
-	if (state == NULL) {
-		err(171, __func__, "state arg is NULL");
-	}
-	if (state->testVector[test_num] != true) {
-		dbg(DBG_LOW, "iterate function[%d] %s called when test vector was false", test_num, __func__);
-		return;
-	}
-	if (state->epsilon == NULL) {
-		err(171, __func__, "state->epsilon is NULL");
-	}
-	if (state->epsilon[thread_state->thread_id] == NULL) {
-		err(171, __func__, "state->epsilon[%ld] is NULL", thread_state->thread_id);
-	}
-	if (state->rank_matrix == NULL) {
-		err(171, __func__, "state->rank_matrix is NULL");
-	}
-	if (state->rank_matrix[thread_state->thread_id] == NULL) {
-		err(171, __func__, "state->rank_matrix[%ld] is NULL", thread_state->thread_id);
-	}
-	if (state->cSetup != true) {
-		err(171, __func__, "test constants not setup prior to calling %s for %s[%d]",
-		    __func__, state->testNames[test_num], test_num);
-	}
-
 	/*
 	 * Setup test parameters
 	 */
-	matrix = state->rank_matrix[thread_state->thread_id];
-	stat.F_M = 0;
-	stat.F_M_minus_one = 0;
+	matrix = state->rank_matrix[split_slot(state, thread_state->thread_id, part)];
+	if (matrix == NULL) {
+		err(171, __func__, "state->rank_matrix of thread %ld piece %ld is NULL", thread_state->thread_id, part);
+	}
+	matrix = matrix_rows(matrix, NUMBER_OF_ROWS_RANK, NUMBER_OF_COLS_RANK);
+	stat->F_M = 0;
+	stat->F_M_minus_one = 0;
 
 	/*
 	 * Zeroize the Rank test matrix
@@ -300,7 +279,7 @@ Rank_iterate(struct thread_state *thread_state)
 	/*
 	 * Step 1a: divide the sequence into disjoint blocks of NUMBER_OF_ROWS_RANK * NUMBER_OF_COLS_RANK bits
 	 */
-	for (k = 0; k < matrix_count; k++) {
+	for (k = first; k < last; k++) {
 
 		/*
 	 	 * Step 1b: copy bits of each block into a NUMBER_OF_ROWS_RANK * NUMBER_OF_COLS_RANK matrix
@@ -316,11 +295,78 @@ Rank_iterate(struct thread_state *thread_state)
 		 * Step 3a: count the number of matrices with rank = (full rank) and rank = (full rank - 1)
 		 */
 		if (R == NUMBER_OF_ROWS_RANK) {
-			stat.F_M++;	// rank NUMBER_OF_ROWS_RANK found
+			stat->F_M++;	// rank NUMBER_OF_ROWS_RANK found
 		} else if (R == (NUMBER_OF_ROWS_RANK - 1)) {
-			stat.F_M_minus_one++;	// rank NUMBER_OF_ROWS_RANK-1 found
+			stat->F_M_minus_one++;	// rank NUMBER_OF_ROWS_RANK-1 found
 		}
 	}
+}
+
+
+/*
+ * Rank_iterate - iterate one bit stream for Rank test
+ *
+ * given:
+ *      state           // run state to test under
+ *
+ * This function is called for each and every iteration noted in state->tp.numOfBitStreams.
+ *
+ * NOTE: The initialize function must be called first.
+ */
+void
+Rank_iterate(struct thread_state *thread_state)
+{
+	struct Rank_private_stats stat;	// Stats for this iteration
+	uint64_t start;		// ticks when the p-value computation started
+	struct Rank_private_stats piece[MAX_SPLIT];	// Matrix counts of each piece of the bit stream
+	long int parts;			// Number of pieces the bit stream is tested in
+	double p_value;			// p_value iteration test result(s)
+	long int k;
+
+	/*
+	 * Check preconditions (firewall)
+	 */
+	if (thread_state == NULL) {
+		err(171, __func__, "thread_state arg is NULL");
+	}
+	struct state *state = thread_state->global_state;
+	if (state == NULL) {
+		err(171, __func__, "state arg is NULL");
+	}
+	if (state->testVector[test_num] != true) {
+		dbg(DBG_LOW, "iterate function[%d] %s called when test vector was false", test_num, __func__);
+		return;
+	}
+	if (state->epsilon == NULL) {
+		err(171, __func__, "state->epsilon is NULL");
+	}
+	if (state->epsilon[thread_state->thread_id] == NULL) {
+		err(171, __func__, "state->epsilon[%ld] is NULL", thread_state->thread_id);
+	}
+	if (state->rank_matrix == NULL) {
+		err(171, __func__, "state->rank_matrix is NULL");
+	}
+	if (state->cSetup != true) {
+		err(171, __func__, "test constants not setup prior to calling %s for %s[%d]",
+		    __func__, state->testNames[test_num], test_num);
+	}
+
+	/*
+	 * Zeroize stats before performing the test
+	 */
+	memset(&stat, 0, sizeof(stat));
+
+	/*
+	 * Steps 1 thru 3a, for the matrices of each piece of the bit stream
+	 */
+	parts = split_parts(state, matrix_count, NUMBER_OF_ROWS_RANK * NUMBER_OF_COLS_RANK);
+	split_run(thread_state, parts, matrix_count, Rank_part, piece);
+	stat.F_M = 0;
+	stat.F_M_minus_one = 0;
+	for (k = 0; k < parts; k++) {
+		stat.F_M += piece[k].F_M;
+		stat.F_M_minus_one += piece[k].F_M_minus_one;
+	}
 
 	/*
 	 * Step 3b: count the number of matrices with rank less than (full rank - 1)
@@ -343,13 +389,15 @@ Rank_iterate(struct thread_state *thread_state)
 	/*
 	 * Step 5: compute the test P-value
 	 */
+	start = timing_start();
 	p_value = exp(-stat.chi_squared / 2.0);
+	timing_stop(thread_state, TIMING_PVALUE, start);
 
 	/*
 	 * Lock mutex before making changes to the shared state
 	 */
 	if (thread_state->mutex != NULL) {
-		pthread_mutex_lock(thread_state->mutex);
+		timing_lock(thread_state, thread_state->mutex);
 	}
 
 	/*
@@ -381,7 +429,7 @@ Rank_iterate(struct thread_state *thread_state)
 	 * Record values computed during this iteration
 	 */
 	if (state->resultstxtFlag == true) {
-		append_value(state->stats[test_num], &stat);
+		recordStats(state, thread_state, test_num, &stat);
 	}
 	append_value(state->p_val[test_num], &p_value);
 
@@ -586,31 +634,25 @@ Rank_print_p_value(FILE * stream, double p_value)
 
 
 /*
- * Rank_print - print to results.txt, data*.txt, stats.txt for all iterations
+ * Rank_print - print iterations to results.txt, data*.txt, stats.txt
  *
  * given:
  *      state           // run state to test under
+ *      first           // first iteration to print
+ *      last            // print up to but not including this iteration
  *
- * This function is called for once to print dynamic arrays into
- * results.txt, data*.txt, stats.txt.
+ * This function is called by the writer as iterations complete, to append
+ * their records to results.txt, data*.txt, stats.txt.
  *
- * NOTE: The initialize and iterate functions must be called before this function is called.
+ * NOTE: The files must have been opened by writer_open().
  */
 void
-Rank_print(struct state *state)
+Rank_print(struct state *state, long int first, long int last)
 {
 	struct Rank_private_stats *stat;	// Pointer to statistics of an iteration
+	struct test_output *out;		// Open stats.txt, results.txt, data*.txt
 	double p_value;				// p_value iteration test result(s)
-	FILE *stats = NULL;			// Open stats.txt file
-	FILE *results = NULL;			// Open results.txt file
-	FILE *data = NULL;			// Open data*.txt file
-	char *stats_txt = NULL;			// Pathname for stats.txt
-	char *results_txt = NULL;		// Pathname for results.txt
-	char *data_txt = NULL;			// Pathname for data*.txt
-	char data_filename[BUFSIZ + 1];		// Basename for a given data*.txt pathname
 	bool ok;				// true -> I/O was OK
-	int snprintf_ret;			// snprintf return value
-	int io_ret;				// I/O return status
 	long int i;
 	long int j;
 
@@ -634,40 +676,33 @@ Rank_print(struct state *state)
 		    "print driver interface for %s[%d] called with state.partitionCount: %d < 0",
 		    state->testNames[test_num], test_num, state->partitionCount[test_num]);
 	}
-	if (state->p_val[test_num]->count != (state->tp.numOfBitStreams * state->partitionCount[test_num])) {
+	if (state->output == NULL || state->output[test_num].stats == NULL) {
+		err(174, __func__, "print driver interface for %s[%d] called before its files were opened",
+		    state->testNames[test_num], test_num);
+	}
+	out = &state->output[test_num];
+	if (first < out->first || first > last || last > out->first + state->stats[test_num]->count) {
 		err(174, __func__,
-		    "print driver interface for %s[%d] called with p_val count: %ld != %ld*%d=%ld",
-		    state->testNames[test_num], test_num, state->p_val[test_num]->count,
-		    state->tp.numOfBitStreams, state->partitionCount[test_num],
-		    state->tp.numOfBitStreams * state->partitionCount[test_num]);
+		    "print driver interface for %s[%d] called for iterations [%ld, %ld) outside of recorded [%ld, %ld)",
+		    state->testNames[test_num], test_num, first, last, out->first,
+		    out->first + state->stats[test_num]->count);
 	}
-	if (state->datatxt_fmt[test_num] == NULL) {
-		err(174, __func__, "format for data0*.txt filename is NULL");
+	if (state->p_val[test_num]->count < (last * state->partitionCount[test_num])) {
+		err(174, __func__,
+		    "print driver interface for %s[%d] called with p_val count: %ld < %ld*%d=%ld",
+		    state->testNames[test_num], test_num, state->p_val[test_num]->count,
+		    last, state->partitionCount[test_num], last * state->partitionCount[test_num]);
 	}
 
-	/*
-	 * Open stats.txt file
-	 */
-	stats_txt = filePathName(state->subDir[test_num], "stats.txt");
-	dbg(DBG_HIGH, "about to open/truncate: %s", stats_txt);
-	stats = openTruncate(stats_txt);
-
-	/*
-	 * Open results.txt file
-	 */
-	results_txt = filePathName(state->subDir[test_num], "results.txt");
-	dbg(DBG_HIGH, "about to open/truncate: %s", results_txt);
-	results = openTruncate(results_txt);
-
 	/*
 	 * Write results.txt and stats.txt files
 	 */
-	for (i = 0; i < state->stats[test_num]->count; ++i) {
+	for (i = first; i < last; ++i) {
 
 		/*
 		 * Locate stat for this iteration
 		 */
-		stat = addr_value(state->stats[test_num], struct Rank_private_stats, i);
+		stat = addr_value(state->stats[test_num], struct Rank_private_stats, i - out->first);
 
 		/*
 		 * Get p_value for this iteration
@@ -678,115 +713,32 @@ Rank_print(struct state *state)
 		 * Print stat to stats.txt
 		 */
 		errno = 0;	// paranoia
-		ok = Rank_print_stat(stats, state, stat, p_value);
+		ok = Rank_print_stat(out->stats, state, stat, p_value);
 		if (ok == false) {
-			errp(174, __func__, "error in writing to %s", stats_txt);
+			errp(174, __func__, "error in writing to %s", out->stats_txt);
 		}
 
 		/*
 		 * Print p_value to results.txt
 		 */
 		errno = 0;	// paranoia
-		ok = Rank_print_p_value(results, p_value);
+		ok = Rank_print_p_value(out->results, p_value);
 		if (ok == false) {
-			errp(174, __func__, "error in writing to %s", results_txt);
+			errp(174, __func__, "error in writing to %s", out->results_txt);
 		}
-	}
-
-	/*
-	 * Flush and close stats.txt, free pathname
-	 */
-	errno = 0;		// paranoia
-	io_ret = fflush(stats);
-	if (io_ret != 0) {
-		errp(174, __func__, "error flushing to: %s", stats_txt);
-	}
-	errno = 0;		// paranoia
-	io_ret = fclose(stats);
-	if (io_ret != 0) {
-		errp(174, __func__, "error closing: %s", stats_txt);
-	}
-	free(stats_txt);
-	stats_txt = NULL;
-
-	/*
-	 * Flush and close results.txt, free pathname
-	 */
-	errno = 0;		// paranoia
-	io_ret = fflush(results);
-	if (io_ret != 0) {
-		errp(174, __func__, "error flushing to: %s", results_txt);
-	}
-	errno = 0;		// paranoia
-	io_ret = fclose(results);
-	if (io_ret != 0) {
-		errp(174, __func__, "error closing: %s", results_txt);
-	}
-	free(results_txt);
-	results_txt = NULL;
-
-	/*
-	 * Write data*.txt for each data file if we need to partition results
-	 */
-	if (state->partitionCount[test_num] > 1) {
-		for (j = 0; j < state->partitionCount[test_num]; ++j) {
-
-			/*
-			 * Form the data*.txt basename
-			 */
-			errno = 0;	// paranoia
-			snprintf_ret = snprintf(data_filename, BUFSIZ, state->datatxt_fmt[test_num], j + 1);
-			data_filename[BUFSIZ] = '\0';	// paranoia
-			if (snprintf_ret <= 0 || snprintf_ret >= BUFSIZ || errno != 0) {
-				errp(174, __func__,
-				     "snprintf failed for %d bytes for data%03ld.txt, returned: %d", BUFSIZ, j + 1, snprintf_ret);
-			}
-
-			/*
-			 * Form the data*.txt filename
-			 */
-			data_txt = filePathName(state->subDir[test_num], data_filename);
-			dbg(DBG_HIGH, "about to open/truncate: %s", data_txt);
-			data = openTruncate(data_txt);
-
-			/*
-			 * Write this particular data*.txt filename
-			 */
-			if (j < state->p_val[test_num]->count) {
-				for (i = j; i < state->p_val[test_num]->count; i += state->partitionCount[test_num]) {
-
-					/*
-					 * Get p_value for an iteration belonging to this data*.txt filename
-					 */
-					p_value = get_value(state->p_val[test_num], double, i);
-
-					/*
-					 * Print p_value to results.txt
-					 */
-					errno = 0;	// paranoia
-					ok = Rank_print_p_value(data, p_value);
-					if (ok == false) {
-						errp(174, __func__, "error in writing to %s", data_txt);
-					}
 
+		/*
+		 * Print the p_values of this iteration to the data*.txt of their partition
+		 */
+		if (state->partitionCount[test_num] > 1) {
+			for (j = 0; j < state->partitionCount[test_num]; ++j) {
+				p_value = get_value(state->p_val[test_num], double, (i * state->partitionCount[test_num]) + j);
+				errno = 0;	// paranoia
+				ok = Rank_print_p_value(out->data[j], p_value);
+				if (ok == false) {
+					errp(174, __func__, "error in writing to %s", out->data_txt[j]);
 				}
 			}
-
-			/*
-			 * Flush and close data*.txt, free pathname
-			 */
-			errno = 0;	// paranoia
-			io_ret = fflush(data);
-			if (io_ret != 0) {
-				errp(174, __func__, "error flushing to: %s", data_txt);
-			}
-			errno = 0;	// paranoia
-			io_ret = fclose(data);
-			if (io_ret != 0) {
-				errp(174, __func__, "error closing: %s", data_txt);
-			}
-			free(data_txt);
-			data_txt = NULL;
 		}
 	}
 
@@ -1093,8 +1045,6 @@ Rank_metrics(struct state *state)
 void
 Rank_destroy(struct state *state)
 {
-	int i, j;
-
 	/*
 	 * Check preconditions (firewall)
 	 */
@@ -1133,20 +1083,8 @@ Rank_destroy(struct state *state)
 	}
 
 	/*
-	 * Free the matrices for each thread
+	 * Free the array of matrices, the matrices themselves live in the per thread arenas
 	 */
-	for (i = 0; i < state->numberOfThreads; i++) {
-		if (state->rank_matrix[i] != NULL) {
-			for (j = 0; j < NUMBER_OF_ROWS_RANK; j++) {
-				if (state->rank_matrix[i][j] != NULL) {
-					free(state->rank_matrix[i][j]);
-					state->rank_matrix[i][j] = NULL;
-				}
-			}
-			free(state->rank_matrix[i]);
-			state->rank_matrix[i] = NULL;
-		}
-	}
 	if (state->rank_matrix != NULL) {
 		free(state->rank_matrix);
 		state->rank_matrix = NULL;
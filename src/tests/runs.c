@@ -36,6 +36,11 @@
 #include "../utils/externs.h"
 #include "../utils/cephes.h"
 #include "../utils/utilities.h"
+#include "../utils/writer.h"
+#include "../utils/timing.h"
+#include "../utils/split.h"
+#include "../utils/slice.h"
+#include "../utils/memo.h"
 #include "../utils/debug.h"
 
 
@@ -51,6 +56,15 @@ struct Runs_private_stats {
 };
 
 
+/*
+ * Counts of a piece of the bit stream
+ */
+struct Runs_piece {
+	long int S;		// Number of 1 bits in the piece
+	long int changes;	// Number of bits of the piece that differ from the bit before them
+};
+
+
 /*
  * Static const variables declarations
  */
@@ -67,6 +81,7 @@ static double two_over_sqrtn;			// 2 / Square root of n
 /*
  * Forward static function declarations
  */
+static split_fn Runs_part;
 static bool Runs_print_stat(FILE * stream, struct state *state, struct Runs_private_stats *stat, double p_value);
 static bool Runs_print_p_value(FILE * stream, double p_value);
 static void Runs_metric_print(struct state *state, long int sampleCount, long int toolow, long int *freqPerBin);
@@ -140,11 +155,16 @@ Runs_init(struct state *state)
 	 * Allocate dynamic arrays
 	 */
 	if (state->resultstxtFlag == true) {
-		state->stats[test_num] = create_dyn_array(sizeof(struct Runs_private_stats),
-							  DEFAULT_CHUNK, state->tp.numOfBitStreams, false);        // stats.txt
+		state->stats[test_num] = createResults(state, sizeof(struct Runs_private_stats), 1);        // stats.txt
+	}
+	state->p_val[test_num] = createResults(state, sizeof(double), state->partitionCount[test_num]);	// results.txt
+
+	/*
+	 * Keep the p-value of each number of ones and of runs, when both fit a key
+	 */
+	if (n < ((long int) 1 << 31)) {
+		state->memo[test_num] = memo_create(state->testNames[test_num], state->tp.numOfBitStreams);
 	}
-	state->p_val[test_num] = create_dyn_array(sizeof(double),
-						  DEFAULT_CHUNK, state->tp.numOfBitStreams, false);	// results.txt
 
 	/*
 	 * Determine format of data*.txt filenames based on state->partitionCount[test_num]
@@ -158,6 +178,38 @@ Runs_init(struct state *state)
 }
 
 
+/*
+ * Runs_part - count the 1 bits and the changes of bit value in a piece of the bit stream
+ *
+ * given:
+ *      thread_state    // state of the thread testing the bit stream
+ *      arg             // array of the struct Runs_piece of each piece
+ *      part            // piece to count
+ *      first           // first bit of the piece
+ *      last            // bit after the last bit of the piece
+ */
+static void
+Runs_part(struct thread_state *thread_state, void *arg, long int part, long int first, long int last)
+{
+	BitSequence *epsilon = thread_state->global_state->epsilon[thread_state->thread_id];
+	struct Runs_piece *piece = (struct Runs_piece *) arg + part;
+	long int S = 0;
+	long int changes = 0;
+	long int k;
+
+	for (k = first; k < last; k++) {
+		if (epsilon[k]) {
+			S++;
+		}
+		if (k > 0 && epsilon[k] != epsilon[k - 1]) {
+			changes++;
+		}
+	}
+	piece->S = S;
+	piece->changes = changes;
+}
+
+
 /*
  * Runs_iterate - iterate one bit stream for Runs test
  *
@@ -172,9 +224,13 @@ void
 Runs_iterate(struct thread_state *thread_state)
 {
 	struct Runs_private_stats stat;	// Stats for this iteration
+	uint64_t start;		// ticks when the p-value computation started
 	long int n;			// Length of a single bit stream
 	long int S;			// Number of 1 bits in the sequence
 	double p_value;			// p_value iteration test result(s)
+	uint64_t key;			// Key of the p-value in the memo of the test
+	struct Runs_piece piece[MAX_SPLIT];	// Counts of each piece of the bit stream
+	long int parts;			// Number of pieces the bit stream is counted in
 	long int k;
 
 	/*
@@ -202,6 +258,11 @@ Runs_iterate(struct thread_state *thread_state)
 		    __func__, state->testNames[test_num], test_num);
 	}
 
+	/*
+	 * Zeroize stats before performing the test
+	 */
+	memset(&stat, 0, sizeof(stat));
+
 	/*
 	 * Collect parameters from state
 	 */
@@ -209,12 +270,20 @@ Runs_iterate(struct thread_state *thread_state)
 
 	/*
 	 * Step 1: determine the proportion of ones in the input sequence
+	 *
+	 * The changes of bit value needed by step 3 are counted in the same pass, or under -B by the bit-sliced engine.
 	 */
+	if (thread_state->lane != NULL) {
+		parts = 1;
+		piece[0].S = thread_state->lane->ones;
+		piece[0].changes = thread_state->lane->changes;
+	} else {
+		parts = split_parts(state, n, 1);
+		split_run(thread_state, parts, n, Runs_part, piece);
+	}
 	S = 0;
-	for (k = 0; k < n; k++) {
-		if (state->epsilon[thread_state->thread_id][k]) {
-			S++;
-		}
+	for (k = 0; k < parts; k++) {
+		S += piece[k].S;
 	}
 	stat.pi = (double) S / (double) n;
 
@@ -232,24 +301,28 @@ Runs_iterate(struct thread_state *thread_state)
 		 * Step 3: compute the test statistic
 		 */
 		stat.V_n = 1;
-		for (k = 1; k < n; k++) {
-			if (state->epsilon[thread_state->thread_id][k] != state->epsilon[thread_state->thread_id][k - 1]) {
-				stat.V_n++;
-			}
+		for (k = 0; k < parts; k++) {
+			stat.V_n += piece[k].changes;
 		}
 
 		/*
 		 * Step 4: compute the test P-value
 		 */
+		start = timing_start();
 		stat.erfc_arg = fabs(stat.V_n - 2.0 * (double) n * stat.pi * (1.0 - stat.pi)) /
 				(2.0 * stat.pi * (1.0 - stat.pi) * sqrt2n);
-		p_value = erfc(stat.erfc_arg);
+		key = (uint64_t) S * (uint64_t) (n + 1) + (uint64_t) stat.V_n;
+		if (memo_get(state->memo[test_num], key, &p_value) == false) {
+			p_value = erfc(stat.erfc_arg);
+			memo_put(state->memo[test_num], key, p_value);
+		}
+		timing_stop(thread_state, TIMING_PVALUE, start);
 
 		/*
 		 * Lock mutex before making changes to the shared state
 		 */
 		if (thread_state->mutex != NULL) {
-			pthread_mutex_lock(thread_state->mutex);
+			timing_lock(thread_state, thread_state->mutex);
 		}
 
 		/*
@@ -281,7 +354,7 @@ Runs_iterate(struct thread_state *thread_state)
 		 * Record values computed during this iteration
 		 */
 		if (state->resultstxtFlag == true) {
-			append_value(state->stats[test_num], &stat);
+			recordStats(state, thread_state, test_num, &stat);
 		}
 		append_value(state->p_val[test_num], &p_value);
 	}
@@ -305,14 +378,14 @@ Runs_iterate(struct thread_state *thread_state)
 		 * Lock mutex before making changes to the shared state
 		 */
 		if (thread_state->mutex != NULL) {
-			pthread_mutex_lock(thread_state->mutex);
+			timing_lock(thread_state, thread_state->mutex);
 		}
 
 		/*
 		 * Record statistics of this invalid iteration
 		 */
 		if (state->resultstxtFlag == true) {
-			append_value(state->stats[test_num], &stat);
+			recordStats(state, thread_state, test_num, &stat);
 		}
 
 		/*
@@ -547,31 +620,25 @@ Runs_print_p_value(FILE * stream, double p_value)
 
 
 /*
- * Runs_print - print to results.txt, data*.txt, stats.txt for all iterations
+ * Runs_print - print iterations to results.txt, data*.txt, stats.txt
  *
  * given:
  *      state           // run state to test under
+ *      first           // first iteration to print
+ *      last            // print up to but not including this iteration
  *
- * This function is called for once to print dynamic arrays into
- * results.txt, data*.txt, stats.txt.
+ * This function is called by the writer as iterations complete, to append
+ * their records to results.txt, data*.txt, stats.txt.
  *
- * NOTE: The initialize and iterate functions must be called before this function is called.
+ * NOTE: The files must have been opened by writer_open().
  */
 void
-Runs_print(struct state *state)
+Runs_print(struct state *state, long int first, long int last)
 {
 	struct Runs_private_stats *stat;	// Pointer to statistics of an iteration
+	struct test_output *out;		// Open stats.txt, results.txt, data*.txt
 	double p_value;				// p_value iteration test result(s)
-	FILE *stats = NULL;			// Open stats.txt file
-	FILE *results = NULL;			// Open results.txt file
-	FILE *data = NULL;			// Open data*.txt file
-	char *stats_txt = NULL;			// Pathname for stats.txt
-	char *results_txt = NULL;		// Pathname for results.txt
-	char *data_txt = NULL;			// Pathname for data*.txt
-	char data_filename[BUFSIZ + 1];		// Basename for a given data*.txt pathname
 	bool ok;				// true -> I/O was OK
-	int snprintf_ret;			// snprintf return value
-	int io_ret;				// I/O return status
 	long int i;
 	long int j;
 
@@ -595,40 +662,33 @@ Runs_print(struct state *state)
 		    "print driver interface for %s[%d] called with state.partitionCount: %d < 0",
 		    state->testNames[test_num], test_num, state->partitionCount[test_num]);
 	}
-	if (state->p_val[test_num]->count != (state->tp.numOfBitStreams * state->partitionCount[test_num])) {
+	if (state->output == NULL || state->output[test_num].stats == NULL) {
+		err(184, __func__, "print driver interface for %s[%d] called before its files were opened",
+		    state->testNames[test_num], test_num);
+	}
+	out = &state->output[test_num];
+	if (first < out->first || first > last || last > out->first + state->stats[test_num]->count) {
 		err(184, __func__,
-		    "print driver interface for %s[%d] called with p_val count: %ld != %ld*%d=%ld",
-		    state->testNames[test_num], test_num, state->p_val[test_num]->count,
-		    state->tp.numOfBitStreams, state->partitionCount[test_num],
-		    state->tp.numOfBitStreams * state->partitionCount[test_num]);
+		    "print driver interface for %s[%d] called for iterations [%ld, %ld) outside of recorded [%ld, %ld)",
+		    state->testNames[test_num], test_num, first, last, out->first,
+		    out->first + state->stats[test_num]->count);
 	}
-	if (state->datatxt_fmt[test_num] == NULL) {
-		err(184, __func__, "format for data0*.txt filename is NULL");
+	if (state->p_val[test_num]->count < (last * state->partitionCount[test_num])) {
+		err(184, __func__,
+		    "print driver interface for %s[%d] called with p_val count: %ld < %ld*%d=%ld",
+		    state->testNames[test_num], test_num, state->p_val[test_num]->count,
+		    last, state->partitionCount[test_num], last * state->partitionCount[test_num]);
 	}
 
-	/*
-	 * Open stats.txt file
-	 */
-	stats_txt = filePathName(state->subDir[test_num], "stats.txt");
-	dbg(DBG_HIGH, "about to open/truncate: %s", stats_txt);
-	stats = openTruncate(stats_txt);
-
-	/*
-	 * Open results.txt file
-	 */
-	results_txt = filePathName(state->subDir[test_num], "results.txt");
-	dbg(DBG_HIGH, "about to open/truncate: %s", results_txt);
-	results = openTruncate(results_txt);
-
 	/*
 	 * Write results.txt and stats.txt files
 	 */
-	for (i = 0; i < state->stats[test_num]->count; ++i) {
+	for (i = first; i < last; ++i) {
 
 		/*
 		 * Locate stat for this iteration
 		 */
-		stat = addr_value(state->stats[test_num], struct Runs_private_stats, i);
+		stat = addr_value(state->stats[test_num], struct Runs_private_stats, i - out->first);
 
 		/*
 		 * Get p_value for this iteration
@@ -639,115 +699,32 @@ Runs_print(struct state *state)
 		 * Print stat to stats.txt
 		 */
 		errno = 0;	// paranoia
-		ok = Runs_print_stat(stats, state, stat, p_value);
+		ok = Runs_print_stat(out->stats, state, stat, p_value);
 		if (ok == false) {
-			errp(184, __func__, "error in writing to %s", stats_txt);
+			errp(184, __func__, "error in writing to %s", out->stats_txt);
 		}
 
 		/*
 		 * Print p_value to results.txt
 		 */
 		errno = 0;	// paranoia
-		ok = Runs_print_p_value(results, p_value);
+		ok = Runs_print_p_value(out->results, p_value);
 		if (ok == false) {
-			errp(184, __func__, "error in writing to %s", results_txt);
+			errp(184, __func__, "error in writing to %s", out->results_txt);
 		}
-	}
-
-	/*
-	 * Flush and close stats.txt, free pathname
-	 */
-	errno = 0;		// paranoia
-	io_ret = fflush(stats);
-	if (io_ret != 0) {
-		errp(184, __func__, "error flushing to: %s", stats_txt);
-	}
-	errno = 0;		// paranoia
-	io_ret = fclose(stats);
-	if (io_ret != 0) {
-		errp(184, __func__, "error closing: %s", stats_txt);
-	}
-	free(stats_txt);
-	stats_txt = NULL;
-
-	/*
-	 * Flush and close results.txt, free pathname
-	 */
-	errno = 0;		// paranoia
-	io_ret = fflush(results);
-	if (io_ret != 0) {
-		errp(184, __func__, "error flushing to: %s", results_txt);
-	}
-	errno = 0;		// paranoia
-	io_ret = fclose(results);
-	if (io_ret != 0) {
-		errp(184, __func__, "error closing: %s", results_txt);
-	}
-	free(results_txt);
-	results_txt = NULL;
-
-	/*
-	 * Write data*.txt for each data file if we need to partition results
-	 */
-	if (state->partitionCount[test_num] > 1) {
-		for (j = 0; j < state->partitionCount[test_num]; ++j) {
-
-			/*
-			 * Form the data*.txt basename
-			 */
-			errno = 0;	// paranoia
-			snprintf_ret = snprintf(data_filename, BUFSIZ, state->datatxt_fmt[test_num], j + 1);
-			data_filename[BUFSIZ] = '\0';	// paranoia
-			if (snprintf_ret <= 0 || snprintf_ret >= BUFSIZ || errno != 0) {
-				errp(184, __func__,
-				     "snprintf failed for %d bytes for data%03ld.txt, returned: %d", BUFSIZ, j + 1, snprintf_ret);
-			}
-
-			/*
-			 * Form the data*.txt filename
-			 */
-			data_txt = filePathName(state->subDir[test_num], data_filename);
-			dbg(DBG_HIGH, "about to open/truncate: %s", data_txt);
-			data = openTruncate(data_txt);
-
-			/*
-			 * Write this particular data*.txt filename
-			 */
-			if (j < state->p_val[test_num]->count) {
-				for (i = j; i < state->p_val[test_num]->count; i += state->partitionCount[test_num]) {
-
-					/*
-					 * Get p_value for an iteration belonging to this data*.txt filename
-					 */
-					p_value = get_value(state->p_val[test_num], double, i);
-
-					/*
-					 * Print p_value to results.txt
-					 */
-					errno = 0;	// paranoia
-					ok = Runs_print_p_value(data, p_value);
-					if (ok == false) {
-						errp(184, __func__, "error in writing to %s", data_txt);
-					}
 
+		/*
+		 * Print the p_values of this iteration to the data*.txt of their partition
+		 */
+		if (state->partitionCount[test_num] > 1) {
+			for (j = 0; j < state->partitionCount[test_num]; ++j) {
+				p_value = get_value(state->p_val[test_num], double, (i * state->partitionCount[test_num]) + j);
+				errno = 0;	// paranoia
+				ok = Runs_print_p_value(out->data[j], p_value);
+				if (ok == false) {
+					errp(184, __func__, "error in writing to %s", out->data_txt[j]);
 				}
 			}
-
-			/*
-			 * Flush and close data*.txt, free pathname
-			 */
-			errno = 0;	// paranoia
-			io_ret = fflush(data);
-			if (io_ret != 0) {
-				errp(184, __func__, "error flushing to: %s", data_txt);
-			}
-			errno = 0;	// paranoia
-			io_ret = fclose(data);
-			if (io_ret != 0) {
-				errp(184, __func__, "error closing: %s", data_txt);
-			}
-			free(data_txt);
-			data_txt = NULL;
 		}
 	}
 
@@ -1090,6 +1067,8 @@ Runs_destroy(struct state *state)
 		free(state->subDir[test_num]);
 		state->subDir[test_num] = NULL;
 	}
+	memo_free(state->memo[test_num]);
+	state->memo[test_num] = NULL;
 
 	return;
 }
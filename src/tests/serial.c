@@ -36,6 +36,8 @@
 #include "../utils/externs.h"
 #include "../utils/cephes.h"
 #include "../utils/utilities.h"
+#include "../utils/writer.h"
+#include "../utils/timing.h"
 #include "../utils/debug.h"
 
 
@@ -83,7 +85,6 @@ void
 Serial_init(struct state *state)
 {
 	long int m;		// Serial block length (state->tp.serialBlockLength)
-	long int i;
 
 	/*
 	 * Check preconditions (firewall)
@@ -117,24 +118,9 @@ Serial_init(struct state *state)
 	}
 
 	/*
-	 * Allocate frequency count v array
+	 * Count the overlapping patterns of up to m bits in each bitstream
 	 */
-	if (m > (BITS_N_LONGINT - 1)) {	// firewall
-		err(190, __func__, "m is too large, 1 << (m:%ld) can't be longer than %ld bits", m, BITS_N_LONGINT - 1);
-	}
-	state->serial_v_len = (long int) 1 << m;
-	state->serial_v = malloc((size_t) state->numberOfThreads * sizeof(*state->serial_v));
-	if (state->serial_v == NULL) {
-		errp(190, __func__, "cannot malloc for serial_v: %ld elements of %ld bytes each", state->numberOfThreads,
-		     sizeof(*state->serial_v));
-	}
-	for (i = 0; i < state->numberOfThreads; i++) {
-		state->serial_v[i] = malloc(state->serial_v_len * sizeof(state->serial_v[i][0]));
-		if (state->serial_v[i] == NULL) {
-			errp(190, __func__, "cannot malloc of %ld elements of %ld bytes each for state->serial_v[%ld]",
-			     state->serial_v_len, sizeof(state->universal_T[i][0]), i);
-		}
-	}
+	reservePatterns(state, m);
 
 	/*
 	 * Create working sub-directory if forming files such as results.txt and stats.txt
@@ -148,11 +134,9 @@ Serial_init(struct state *state)
 	 * Allocate dynamic arrays
 	 */
 	if (state->resultstxtFlag == true) {
-		state->stats[test_num] = create_dyn_array(sizeof(struct Serial_private_stats),
-							  DEFAULT_CHUNK, state->tp.numOfBitStreams, false);        // stats.txt
+		state->stats[test_num] = createResults(state, sizeof(struct Serial_private_stats), 1);        // stats.txt
 	}
-	state->p_val[test_num] = create_dyn_array(sizeof(double),
-						  DEFAULT_CHUNK, 2 * state->tp.numOfBitStreams, false);	// results.txt data
+	state->p_val[test_num] = createResults(state, sizeof(double), state->partitionCount[test_num]);	// results.txt data
 
 	/*
 	 * Determine format of data*.txt filenames based on state->partitionCount[test_num]
@@ -180,6 +164,7 @@ void
 Serial_iterate(struct thread_state *thread_state)
 {
 	struct Serial_private_stats stat;	// Stats for this iteration
+	uint64_t start;		// ticks when the p-value computation started
 	long int m;		// Serial block length (state->tp.serialBlockLength)
 	double p_value1;	// p_value iteration test result(s) - #1
 	double p_value2;	// p_value iteration test result(s) - #2
@@ -199,6 +184,11 @@ Serial_iterate(struct thread_state *thread_state)
 		return;
 	}
 
+	/*
+	 * Zeroize stats before performing the test
+	 */
+	memset(&stat, 0, sizeof(stat));
+
 	/*
 	 * Collect parameters from state
 	 */
@@ -220,8 +210,10 @@ Serial_iterate(struct thread_state *thread_state)
 	/*
 	 * Step 5: compute the test P-values
 	 */
+	start = timing_start();
 	p_value1 = cephes_igamc((double) ((long int) 1 << (m - 1)) / 2.0, stat.del1 / 2.0);
 	p_value2 = cephes_igamc((double) ((long int) 1 << (m - 2)) / 2.0, stat.del2 / 2.0);
+	timing_stop(thread_state, TIMING_PVALUE, start);
 
 	/*
 	 * Record success or failure for this iteration (1st test)
@@ -252,7 +244,7 @@ Serial_iterate(struct thread_state *thread_state)
 	 * Lock mutex before making changes to the shared state
 	 */
 	if (thread_state->mutex != NULL) {
-		pthread_mutex_lock(thread_state->mutex);
+		timing_lock(thread_state, thread_state->mutex);
 	}
 
 	/*
@@ -284,7 +276,7 @@ Serial_iterate(struct thread_state *thread_state)
 	 * Record values computed during this iteration
 	 */
 	if (state->resultstxtFlag == true) {
-		append_value(state->stats[test_num], &stat);
+		recordStats(state, thread_state, test_num, &stat);
 	}
 	append_value(state->p_val[test_num], &p_value1);
 	append_value(state->p_val[test_num], &p_value2);
@@ -314,8 +306,7 @@ compute_psi2(struct thread_state *thread_state, long int blocksize)
 {
 	long int n;		// Length of a single bit stream
 	long int powLen;	// Number of possible m-bit sub-sequences
-	long int mask;		// Bit-mask used to discard the extra bits of a sequence
-	long int dec;		// Decimal representation of an m-bit sub-sequence
+	long int *v;		// Count of each m-bit sub-sequence
 	double sum;		// Sum of the squares of all the counters, needed to compute psi-squared
 	long int i;
 
@@ -329,24 +320,9 @@ compute_psi2(struct thread_state *thread_state, long int blocksize)
 	if (state == NULL) {
 		err(192, __func__, "state arg is NULL");
 	}
-	if (state->epsilon == NULL) {
-		err(192, __func__, "state->epsilon is NULL");
-	}
-	if (state->epsilon[thread_state->thread_id] == NULL) {
-		err(192, __func__, "state->epsilon[%ld] is NULL", thread_state->thread_id);
-	}
 	if ((blocksize == 0) || (blocksize == -1)) {
 		return 0.0;
 	}
-	if (blocksize > (BITS_N_LONGINT - 1)) {	// firewall
-		err(192, __func__, "m is too large, 1 << (m:%ld) can't be longer than %ld bits", blocksize, BITS_N_LONGINT - 1);
-	}
-	if (state->serial_v == NULL) {
-		err(192, __func__, "state->serial_v is NULL");
-	}
-	if (state->serial_v[thread_state->thread_id] == NULL) {
-		err(192, __func__, "state->serial_v[%ld] is NULL", thread_state->thread_id);
-	}
 
 	/*
 	 * Collect parameters from state
@@ -358,65 +334,22 @@ compute_psi2(struct thread_state *thread_state, long int blocksize)
 	 * sub-sequences of the given size can possibly exist
 	 */
 	powLen = (long int) 1 << blocksize;
-	if (powLen > state->serial_v_len) {
-		err(192, __func__, "powLen: %ld is too large, "
-				"1 << blocksize: %ld > state->serial_v_len: %ld ", powLen, blocksize, state->serial_v_len);
-	}
-
-	/*
-	 * Zeroize those counters in the array v
-	 */
-	memset(state->serial_v[thread_state->thread_id], 0, powLen * sizeof(state->serial_v[thread_state->thread_id][0]));
-
-	/*
-	 * Compute the mask that will be used by the algorithm
-	 */
-	mask = (1 << blocksize) - 1;
 
 	/*
 	 * Step 2: compute the frequency of all the overlapping sub-sequences
 	 *
-	 * This algorithm works by taking each consecutive overlapping sub-sequence
-	 * of length blocksize from the original sequence epsilon of length n.
-	 *
-	 * For each sub-sequence found, the decimal representation is computed and
-	 * the corresponding counter in the array v is incremented.
-	 *
-	 * It is convenient to use the decimal representation because we can more easily
-	 * store and have access to the counters of each block in the array v with size 2^blocksize.
-	 *
-	 * NOTE: i % n is used to avoid appending blocksize-1 bits in the end (as indicated in the paper)
+	 * Each consecutive overlapping sub-sequence of length blocksize of the sequence epsilon,
+	 * wrapped around its end, is counted under its decimal representation.  The counts are
+	 * shared with the other block lengths of this and the Approximate Entropy test (see countPatterns()).
 	 */
-	for (dec = 0, i = 0; i < n + blocksize; i++) {
-
-		/*
-		 * Get the decimal representation of the current block.
-		 * This line of code works by shifting the decimal representation of the
-		 * previous number left by 1 bit, adding to it the following bit of epsilon,
-		 * and then discarding the left-most bit by doing an AND with the mask (in fact,
-		 * the mask is used to keep only the right-most blocksize bits of the number).
-		 */
-		dec = ((dec << 1) + (int) state->epsilon[thread_state->thread_id][i % n]) & mask;
-
-		/*
-		 * If we have already counted the first (blocksize - 1) bits of epsilon,
-		 * count the occurrence of the current block in its corresponding counter.
-		 *
-		 * NOTE: this check is important because during the first (blocksize - 1) iterations
-		 * of this loop, dec will be the decimal representation of blocks of length
-		 * which is smaller than blocksize.
-		 */
-		if (i >= blocksize) {
-			state->serial_v[thread_state->thread_id][dec]++;
-		}
-	}
+	v = countPatterns(thread_state, blocksize);
 
 	/*
 	 * Compute the sum of the squares of all the frequencies (needed for step 3)
 	 */
 	sum = 0.0;
 	for (i = 0; i < powLen; i++) {
-		sum += (double) state->serial_v[thread_state->thread_id][i] * (double) state->serial_v[thread_state->thread_id][i];
+		sum += (double) v[i] * (double) v[i];
 	}
 
 	/*
@@ -652,33 +585,27 @@ Serial_print_p_value(FILE * stream, double p_value)
 
 
 /*
- * Serial_print - print to results.txt, data*.txt, stats.txt for all iterations
+ * Serial_print - print iterations to results.txt, data*.txt, stats.txt
  *
  * given:
  *      state           // run state to test under
+ *      first           // first iteration to print
+ *      last            // print up to but not including this iteration
  *
- * This function is called for once to print dynamic arrays into
- * results.txt, data*.txt, stats.txt.
+ * This function is called by the writer as iterations complete, to append
+ * their records to results.txt, data*.txt, stats.txt.
  *
- * NOTE: The initialize and iterate functions must be called before this function is called.
+ * NOTE: The files must have been opened by writer_open().
  */
 void
-Serial_print(struct state *state)
+Serial_print(struct state *state, long int first, long int last)
 {
 	struct Serial_private_stats *stat;	// Pointer to statistics of an iteration
+	struct test_output *out;		// Open stats.txt, results.txt, data*.txt
 	double p_value;				// Generic p_value iteration
 	double p_value1;			// p_value iteration test result(s) - #1
 	double p_value2;			// p_value iteration test result(s) - #2
-	FILE *stats = NULL;			// Open stats.txt file
-	FILE *results = NULL;			// Open results.txt file
-	FILE *data = NULL;			// Open data*.txt file
-	char *stats_txt = NULL;			// Pathname for stats.txt
-	char *results_txt = NULL;		// Pathname for results.txt
-	char *data_txt = NULL;			// Pathname for data*.txt
-	char data_filename[BUFSIZ + 1];		// Basename for a given data*.txt pathname
 	bool ok;				// true -> I/O was OK
-	int snprintf_ret;			// snprintf return value
-	int io_ret;				// I/O return status
 	long int i;
 	long int j;
 
@@ -702,40 +629,33 @@ Serial_print(struct state *state)
 		    "print driver interface for %s[%d] called with state.partitionCount: %d < 0",
 		    state->testNames[test_num], test_num, state->partitionCount[test_num]);
 	}
-	if (state->p_val[test_num]->count != (state->tp.numOfBitStreams * state->partitionCount[test_num])) {
+	if (state->output == NULL || state->output[test_num].stats == NULL) {
+		err(195, __func__, "print driver interface for %s[%d] called before its files were opened",
+		    state->testNames[test_num], test_num);
+	}
+	out = &state->output[test_num];
+	if (first < out->first || first > last || last > out->first + state->stats[test_num]->count) {
 		err(195, __func__,
-		    "print driver interface for %s[%d] called with p_val count: %ld != %ld*%d=%ld",
-		    state->testNames[test_num], test_num, state->p_val[test_num]->count,
-		    state->tp.numOfBitStreams, state->partitionCount[test_num],
-		    state->tp.numOfBitStreams * state->partitionCount[test_num]);
+		    "print driver interface for %s[%d] called for iterations [%ld, %ld) outside of recorded [%ld, %ld)",
+		    state->testNames[test_num], test_num, first, last, out->first,
+		    out->first + state->stats[test_num]->count);
 	}
-	if (state->datatxt_fmt[test_num] == NULL) {
-		err(195, __func__, "format for data0*.txt filename is NULL");
+	if (state->p_val[test_num]->count < (last * state->partitionCount[test_num])) {
+		err(195, __func__,
+		    "print driver interface for %s[%d] called with p_val count: %ld < %ld*%d=%ld",
+		    state->testNames[test_num], test_num, state->p_val[test_num]->count,
+		    last, state->partitionCount[test_num], last * state->partitionCount[test_num]);
 	}
 
-	/*
-	 * Open stats.txt file
-	 */
-	stats_txt = filePathName(state->subDir[test_num], "stats.txt");
-	dbg(DBG_HIGH, "about to open/truncate: %s", stats_txt);
-	stats = openTruncate(stats_txt);
-
-	/*
-	 * Open results.txt file
-	 */
-	results_txt = filePathName(state->subDir[test_num], "results.txt");
-	dbg(DBG_HIGH, "about to open/truncate: %s", results_txt);
-	results = openTruncate(results_txt);
-
 	/*
 	 * Write results.txt and stats.txt files
 	 */
-	for (i = 0; i < state->stats[test_num]->count; ++i) {
+	for (i = first; i < last; ++i) {
 
 		/*
 		 * Locate stat for this iteration
 		 */
-		stat = addr_value(state->stats[test_num], struct Serial_private_stats, i);
+		stat = addr_value(state->stats[test_num], struct Serial_private_stats, i - out->first);
 
 		/*
 		 * Get both p_values for this iteration
@@ -747,124 +667,41 @@ Serial_print(struct state *state)
 		 * Print stat to stats.txt
 		 */
 		errno = 0;	// paranoia
-		ok = Serial_print_stat(stats, state, stat, p_value1, p_value2);
+		ok = Serial_print_stat(out->stats, state, stat, p_value1, p_value2);
 		if (ok == false) {
-			errp(195, __func__, "error in writing to %s", stats_txt);
+			errp(195, __func__, "error in writing to %s", out->stats_txt);
 		}
 
 		/*
 		 * Print 1st p_value to results.txt
 		 */
 		errno = 0;	// paranoia
-		ok = Serial_print_p_value(results, p_value1);
+		ok = Serial_print_p_value(out->results, p_value1);
 		if (ok == false) {
-			errp(195, __func__, "error in writing to %s", results_txt);
+			errp(195, __func__, "error in writing to %s", out->results_txt);
 		}
 
 		/*
 		 * Print 2nd p_value to results.txt
 		 */
 		errno = 0;	// paranoia
-		ok = Serial_print_p_value(results, p_value2);
+		ok = Serial_print_p_value(out->results, p_value2);
 		if (ok == false) {
-			errp(195, __func__, "error in writing to %s", results_txt);
+			errp(195, __func__, "error in writing to %s", out->results_txt);
 		}
-	}
-
-	/*
-	 * Flush and close stats.txt, free pathname
-	 */
-	errno = 0;		// paranoia
-	io_ret = fflush(stats);
-	if (io_ret != 0) {
-		errp(195, __func__, "error flushing to: %s", stats_txt);
-	}
-	errno = 0;		// paranoia
-	io_ret = fclose(stats);
-	if (io_ret != 0) {
-		errp(195, __func__, "error closing: %s", stats_txt);
-	}
-	free(stats_txt);
-	stats_txt = NULL;
-
-	/*
-	 * Flush and close results.txt, free pathname
-	 */
-	errno = 0;		// paranoia
-	io_ret = fflush(results);
-	if (io_ret != 0) {
-		errp(195, __func__, "error flushing to: %s", results_txt);
-	}
-	errno = 0;		// paranoia
-	io_ret = fclose(results);
-	if (io_ret != 0) {
-		errp(195, __func__, "error closing: %s", results_txt);
-	}
-	free(results_txt);
-	results_txt = NULL;
-
-	/*
-	 * Write data*.txt for each data file if we need to partition results
-	 */
-	if (state->partitionCount[test_num] > 1) {
-		for (j = 0; j < state->partitionCount[test_num]; ++j) {
-
-			/*
-			 * Form the data*.txt basename
-			 */
-			errno = 0;	// paranoia
-			snprintf_ret = snprintf(data_filename, BUFSIZ, state->datatxt_fmt[test_num], j + 1);
-			data_filename[BUFSIZ] = '\0';	// paranoia
-			if (snprintf_ret <= 0 || snprintf_ret >= BUFSIZ || errno != 0) {
-				errp(195, __func__,
-				     "snprintf failed for %d bytes for data%03ld.txt, returned: %d", BUFSIZ, j + 1, snprintf_ret);
-			}
-
-			/*
-			 * Form the data*.txt filename
-			 */
-			data_txt = filePathName(state->subDir[test_num], data_filename);
-			dbg(DBG_HIGH, "about to open/truncate: %s", data_txt);
-			data = openTruncate(data_txt);
-
-			/*
-			 * Write this particular data*.txt filename
-			 */
-			if (j < state->p_val[test_num]->count) {
-				for (i = j; i < state->p_val[test_num]->count; i += state->partitionCount[test_num]) {
-
-					/*
-					 * Get p_value for an iteration belonging to this data*.txt filename
-					 */
-					p_value = get_value(state->p_val[test_num], double, i);
-
-					/*
-					 * Print p_value to results.txt
-					 */
-					errno = 0;	// paranoia
-					ok = Serial_print_p_value(data, p_value);
-					if (ok == false) {
-						errp(195, __func__, "error in writing to %s", data_txt);
-					}
 
+		/*
+		 * Print the p_values of this iteration to the data*.txt of their partition
+		 */
+		if (state->partitionCount[test_num] > 1) {
+			for (j = 0; j < state->partitionCount[test_num]; ++j) {
+				p_value = get_value(state->p_val[test_num], double, (i * state->partitionCount[test_num]) + j);
+				errno = 0;	// paranoia
+				ok = Serial_print_p_value(out->data[j], p_value);
+				if (ok == false) {
+					errp(195, __func__, "error in writing to %s", out->data_txt[j]);
 				}
 			}
-
-			/*
-			 * Flush and close data*.txt, free pathname
-			 */
-			errno = 0;	// paranoia
-			io_ret = fflush(data);
-			if (io_ret != 0) {
-				errp(195, __func__, "error flushing to: %s", data_txt);
-			}
-			errno = 0;	// paranoia
-			io_ret = fclose(data);
-			if (io_ret != 0) {
-				errp(195, __func__, "error closing: %s", data_txt);
-			}
-			free(data_txt);
-			data_txt = NULL;
 		}
 	}
 
@@ -1171,8 +1008,6 @@ Serial_metrics(struct state *state)
 void
 Serial_destroy(struct state *state)
 {
-	long int i;
-
 	/*
 	 * Check preconditions (firewall)
 	 */
@@ -1209,16 +1044,6 @@ Serial_destroy(struct state *state)
 		free(state->subDir[test_num]);
 		state->subDir[test_num] = NULL;
 	}
-	for (i = 0; i < state->numberOfThreads; i++) {
-		if (state->serial_v[i] != NULL) {
-			free(state->serial_v[i]);
-			state->serial_v[i] = NULL;
-		}
-	}
-	if (state->serial_v != NULL) {
-		free(state->serial_v);
-		state->serial_v = NULL;
-	}
 
 	return;
 }
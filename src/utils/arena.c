@@ -0,0 +1,263 @@
+// arena.c - per thread arenas for test scratch buffers
+
+/*
+ * This code has been heavily modified by the following people:
+ *
+ *      Landon Curt Noll
+ *      Tom Gilgan
+ *      Riccardo Paccagnella
+ *
+ * See the README.md and the initial comment in sts.c for more information.
+ *
+ * WE (THOSE LISTED ABOVE WHO HEAVILY MODIFIED THIS CODE) DISCLAIM ALL
+ * WARRANTIES WITH REGARD TO THIS SOFTWARE, INCLUDING ALL IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL WE (THOSE LISTED ABOVE
+ * WHO HEAVILY MODIFIED THIS CODE) BE LIABLE FOR ANY SPECIAL, INDIRECT OR
+ * CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF
+ * USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ *
+ * chongo (Landon Curt Noll, http://www.isthe.com/chongo/index.html) /\oo/\
+ *
+ * Share and enjoy! :-)
+ */
+
+
+// Exit codes: 240 thru 244
+
+/*
+ * Every iterate thread owns an arena from which the test init functions carve the thread's scratch
+ * buffers (the bitstream copy, FFT arrays, partial sums, ...).  Allocations are rounded up to whole
+ * cache lines so the buffers of different threads never share a line, and all of a thread's buffers
+ * sit next to each other instead of being scattered over the heap.
+ *
+ * Chunks are anonymous mappings of at least ARENA_CHUNK bytes.  Pages of a mapping are only backed
+ * by memory once written, and init only carves buffers without writing to them, so each page is
+ * first touched (and placed) by the thread that uses it.  With -H the chunks are aligned to and
+ * advised for ARENA_HUGE_PAGE pages.  All arenas are unmapped at once by arena_destroy().
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <stdint.h>
+#include <sys/mman.h>
+#include "../utils/externs.h"
+#include "arena.h"
+#include "debug.h"
+
+
+/*
+ * Forward static function declarations
+ */
+static struct arena_chunk *new_chunk(struct state *state, size_t min_size);
+
+
+/*
+ * new_chunk - map a new chunk of address space for an arena
+ *
+ * given:
+ *      state           // run state
+ *      min_size        // the chunk must be able to hold at least min_size bytes
+ *
+ * returns:
+ *      A new chunk with nothing handed out yet.
+ *
+ * This function does not return on error.
+ */
+static struct arena_chunk *
+new_chunk(struct state *state, size_t min_size)
+{
+	struct arena_chunk *chunk;	// chunk to return
+	size_t size;			// bytes to map
+	size_t slack;			// extra bytes mapped so that a huge page aligned start exists
+	char *map;			// the mapping
+	char *base;			// aligned start of the chunk inside of map
+
+	/*
+	 * Round the size up to whole huge pages so that -H can back the whole chunk
+	 */
+	size = MAX(min_size, (size_t) ARENA_CHUNK);
+	size = (size + ARENA_HUGE_PAGE - 1) & ~((size_t) ARENA_HUGE_PAGE - 1);
+	slack = (state->hugePagesFlag == true) ? (size_t) ARENA_HUGE_PAGE : 0;
+
+	/*
+	 * Reserve the address space, memory is only committed when a page is first written
+	 */
+	map = mmap(NULL, size + slack, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+	if (map == MAP_FAILED) {
+		errp(240, __func__, "cannot mmap %lu bytes for an arena chunk", size + slack);
+	}
+	base = map;
+
+	/*
+	 * Align to a huge page and give the unaligned ends back
+	 */
+	if (state->hugePagesFlag == true) {
+		base = (char *) (((uintptr_t) map + ARENA_HUGE_PAGE - 1) & ~((uintptr_t) ARENA_HUGE_PAGE - 1));
+		if (base > map) {
+			munmap(map, (size_t) (base - map));
+		}
+		if (base + size < map + size + slack) {
+			munmap(base + size, (size_t) (map + size + slack - (base + size)));
+		}
+#if defined(MADV_HUGEPAGE)
+		if (madvise(base, size, MADV_HUGEPAGE) != 0) {
+			warnp(__func__, "cannot use huge pages for an arena chunk of %lu bytes, using normal pages", size);
+		}
+#else /* MADV_HUGEPAGE */
+		warn(__func__, "huge pages are not supported on this system, using normal pages");
+#endif /* MADV_HUGEPAGE */
+	}
+
+	chunk = malloc(sizeof(*chunk));
+	if (chunk == NULL) {
+		errp(240, __func__, "cannot malloc of %lu bytes for an arena chunk", sizeof(*chunk));
+	}
+	chunk->base = base;
+	chunk->size = size;
+	chunk->used = 0;
+	chunk->next = NULL;
+	dbg(DBG_HIGH, "mapped arena chunk of %lu bytes at %p", size, (void *) base);
+
+	return chunk;
+}
+
+
+/*
+ * arena_create - create an empty arena for each iterate thread
+ *
+ * given:
+ *      state           // run state with numberOfThreads set
+ *
+ * This function does not return on error.
+ */
+void
+arena_create(struct state *state)
+{
+	/*
+	 * Check preconditions (firewall)
+	 */
+	if (state == NULL) {
+		err(241, __func__, "state arg is NULL");
+	}
+	if (state->numberOfThreads <= 0) {
+		err(241, __func__, "numberOfThreads: %ld must be > 0", state->numberOfThreads);
+	}
+
+	state->arena = calloc((size_t) state->numberOfThreads, sizeof(state->arena[0]));
+	if (state->arena == NULL) {
+		errp(241, __func__, "cannot calloc for arena: %ld elements of %lu bytes each", state->numberOfThreads,
+		     sizeof(state->arena[0]));
+	}
+}
+
+
+/*
+ * arena_alloc - carve a zeroized buffer out of the arena of a thread
+ *
+ * given:
+ *      state           // run state with arenas created by arena_create()
+ *      thread_id       // thread whose arena to use
+ *      count           // number of elements
+ *      size            // size in bytes of each element
+ *
+ * returns:
+ *      A zeroized buffer of count*size bytes aligned to ARENA_ALIGN.
+ *      The buffer must NOT be freed, it goes away with arena_destroy().
+ *
+ * This function does not return on error.
+ */
+void *
+arena_alloc(struct state *state, long int thread_id, size_t count, size_t size)
+{
+	struct arena *arena;		// arena of thread_id
+	struct arena_chunk *chunk;	// chunk to carve from
+	size_t bytes;			// bytes to hand out, rounded up to ARENA_ALIGN
+	void *ret;			// buffer to return
+
+	/*
+	 * Check preconditions (firewall)
+	 */
+	if (state == NULL) {
+		err(242, __func__, "state arg is NULL");
+	}
+	if (state->arena == NULL) {
+		err(242, __func__, "state->arena is NULL");
+	}
+	if (thread_id < 0 || thread_id >= state->numberOfThreads) {
+		err(242, __func__, "thread_id: %ld must be in [0, %ld)", thread_id, state->numberOfThreads);
+	}
+	if (count == 0 || size == 0) {
+		err(242, __func__, "count: %lu and size: %lu must be > 0", count, size);
+	}
+	if (count > (SIZE_MAX - ARENA_ALIGN) / size) {
+		err(242, __func__, "%lu elements of %lu bytes each would overflow", count, size);
+	}
+	arena = &state->arena[thread_id];
+	bytes = (count * size + ARENA_ALIGN - 1) & ~((size_t) ARENA_ALIGN - 1);
+
+	/*
+	 * Start a new chunk if the current one cannot hold the buffer
+	 *
+	 * The space left in the old chunk is never touched, so it costs address space only.
+	 */
+	chunk = arena->chunk;
+	if (chunk == NULL || chunk->size - chunk->used < bytes) {
+		chunk = new_chunk(state, bytes);
+		chunk->next = arena->chunk;
+		arena->chunk = chunk;
+	}
+
+	/*
+	 * Hand out the buffer, fresh anonymous pages are already zero
+	 */
+	ret = chunk->base + chunk->used;
+	chunk->used += bytes;
+	arena->total += bytes;
+
+	return ret;
+}
+
+
+/*
+ * arena_destroy - unmap the arenas of all threads
+ *
+ * given:
+ *      state           // run state with arenas created by arena_create(), or none
+ *
+ * Every buffer returned by arena_alloc() is invalid after this call.
+ */
+void
+arena_destroy(struct state *state)
+{
+	struct arena_chunk *chunk;	// chunk being unmapped
+	struct arena_chunk *next;	// chunk to unmap after chunk
+	long int i;
+
+	/*
+	 * Check preconditions (firewall)
+	 */
+	if (state == NULL) {
+		err(243, __func__, "state arg is NULL");
+	}
+	if (state->arena == NULL) {
+		return;
+	}
+
+	for (i = 0; i < state->numberOfThreads; i++) {
+		dbg(DBG_MED, "arena of thread %ld held %lu bytes", i, state->arena[i].total);
+		for (chunk = state->arena[i].chunk; chunk != NULL; chunk = next) {
+			next = chunk->next;
+			if (munmap(chunk->base, chunk->size) != 0) {
+				warnp(__func__, "cannot munmap arena chunk of %lu bytes", chunk->size);
+			}
+			free(chunk);
+		}
+	}
+	free(state->arena);
+	state->arena = NULL;
+}
@@ -0,0 +1,62 @@
+/*****************************************************************************
+ A R E N A  F U N C T I O N  P R O T O T Y P E S
+ *****************************************************************************/
+
+/*
+ * This code has been heavily modified by the following people:
+ *
+ *      Landon Curt Noll
+ *      Tom Gilgan
+ *      Riccardo Paccagnella
+ *
+ * See the README.md and the initial comment in sts.c for more information.
+ *
+ * WE (THOSE LISTED ABOVE WHO HEAVILY MODIFIED THIS CODE) DISCLAIM ALL
+ * WARRANTIES WITH REGARD TO THIS SOFTWARE, INCLUDING ALL IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL WE (THOSE LISTED ABOVE
+ * WHO HEAVILY MODIFIED THIS CODE) BE LIABLE FOR ANY SPECIAL, INDIRECT OR
+ * CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF
+ * USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ *
+ * chongo (Landon Curt Noll, http://www.isthe.com/chongo/index.html) /\oo/\
+ *
+ * Share and enjoy! :-)
+ */
+
+#ifndef ARENA_H
+#   define ARENA_H
+
+#   include "defs.h"
+
+#   define ARENA_ALIGN		(64)			// alignment of every arena allocation, one cache line
+#   define ARENA_HUGE_PAGE	(2L * 1024 * 1024)	// size of the huge pages requested by -H
+#   define ARENA_CHUNK		(64L * 1024 * 1024)	// minimum address space reserved per arena chunk
+
+/*
+ * arena_chunk - one mapping of an arena
+ *
+ * The bookkeeping lives outside of the mapping so that no page of the mapping
+ * is touched before the owning thread writes to it.
+ */
+struct arena_chunk {
+	char *base;			// start of the mapping
+	size_t size;			// bytes mapped
+	size_t used;			// bytes handed out
+	struct arena_chunk *next;	// previously filled chunk or NULL
+};
+
+/*
+ * arena - scratch buffers of one iterate thread
+ */
+struct arena {
+	struct arena_chunk *chunk;	// chunk allocations are carved from, NULL until the first allocation
+	size_t total;			// bytes handed out over all chunks
+};
+
+extern void arena_create(struct state *state);
+extern void *arena_alloc(struct state *state, long int thread_id, size_t count, size_t size);
+extern void arena_destroy(struct state *state);
+
+#endif				/* ARENA_H */
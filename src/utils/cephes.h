@@ -29,6 +29,8 @@
 #   endif
 
 extern double cephes_igamc(double a, double x);
+#   define IGAMC_BATCH (64)	// values of x a caller may gather for one cephes_igamc_batch() call
+extern void cephes_igamc_batch(double a, const double *x, double *q, long int count);
 extern double cephes_igam(double a, double x);
 #   if defined(HAVE_LGAMMA)
 #      define cephes_lgam(x) (lgamma(x))
@@ -0,0 +1,684 @@
+// checkpoint.c - checkpoint and resume of the iterate phase
+
+/*
+ * This code has been heavily modified by the following people:
+ *
+ *      Landon Curt Noll
+ *      Tom Gilgan
+ *      Riccardo Paccagnella
+ *
+ * See the README.md and the initial comment in sts.c for more information.
+ *
+ * WE (THOSE LISTED ABOVE WHO HEAVILY MODIFIED THIS CODE) DISCLAIM ALL
+ * WARRANTIES WITH REGARD TO THIS SOFTWARE, INCLUDING ALL IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL WE (THOSE LISTED ABOVE
+ * WHO HEAVILY MODIFIED THIS CODE) BE LIABLE FOR ANY SPECIAL, INDIRECT OR
+ * CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF
+ * USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ *
+ * chongo (Landon Curt Noll, http://www.isthe.com/chongo/index.html) /\oo/\
+ *
+ * Share and enjoy! :-)
+ */
+
+
+// Exit codes: 235 thru 239
+
+/*
+ * A checkpoint file is append-only.  It starts with a header that describes the run:
+ *
+ *      CHECKPOINT_MAGIC, length of the description, the description
+ *
+ * The description is text, one name=value line for each option the results depend on: the
+ * bitstreams, bitcount, jobnum and -s, every -P block length and alpha, the -W parameter sets,
+ * -F format, -X transform, the randdata (its path and size) or -L manifest, and for every test
+ * whether it is enabled and the sizes of its p_val and stats elements.  A resume is refused
+ * unless the description of the run is the same, so that no results mix different options.
+ *
+ * and is followed by one record per checkpoint:
+ *
+ *      CHECKPOINT_RECORD, iterations done,
+ *      count[], valid[], success[], failure[], valid_p_val[],
+ *      then for every enabled test: number of new p_val elements and the elements,
+ *                                   number of new stats elements and the elements (-s only),
+ *      iterations done (again, marks the record as complete)
+ *
+ * A record only holds the results produced since the previous record, so the cost of a checkpoint
+ * stays proportional to the work done since the last one.  A record is taken while no iteration
+ * is in flight, so iterations [0, done) are exactly the ones whose results are in the file.
+ *
+ * Records are made durable with fsync() before the run continues.  A record cut short by a crash
+ * lacks its trailing done count: on resume it is ignored and truncated away, so the file always
+ * holds the last complete checkpoint.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <stdarg.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include "../utils/externs.h"
+#include "utilities.h"
+#include "checkpoint.h"
+#include "writer.h"
+#include "debug.h"
+
+
+/*
+ * Forward static function declarations
+ */
+static void write_long(struct state *state, long int value);
+static bool read_long(struct state *state, long int *value);
+static void write_new_elements(struct state *state, struct dyn_array *array, long int *already_written);
+static bool read_new_elements(struct state *state, struct dyn_array *array);
+static void describe(char **description, char const *fmt, ...) __attribute__((format(printf, 2, 3)));
+static char *describe_run(struct state *state);
+static void write_header(struct state *state);
+static void check_header(struct state *state);
+static long int read_records(struct state *state);
+
+
+/*
+ * write_long - write a long int to the checkpoint file
+ *
+ * given:
+ *      state           // run state with an open checkpoint file
+ *      value           // value to write
+ *
+ * This function does not return on error.
+ */
+static void
+write_long(struct state *state, long int value)
+{
+	if (fwrite(&value, sizeof(value), 1, state->checkpointFile) != 1) {
+		errp(235, __func__, "error writing to checkpoint file: %s", state->checkpointPath);
+	}
+}
+
+
+/*
+ * read_long - read a long int from the checkpoint file
+ *
+ * given:
+ *      state           // run state with an open checkpoint file
+ *      value           // where to store the value read
+ *
+ * returns:
+ *      true ==> value was read, false ==> end of file was reached
+ */
+static bool
+read_long(struct state *state, long int *value)
+{
+	return fread(value, sizeof(*value), 1, state->checkpointFile) == 1;
+}
+
+
+/*
+ * write_new_elements - append the elements of a dynamic array not yet in the checkpoint file
+ *
+ * given:
+ *      state           // run state with an open checkpoint file
+ *      array           // dynamic array of results, or NULL
+ *      already_written // number of elements of array already in the checkpoint file, updated on return
+ *
+ * This function does not return on error.
+ */
+static void
+write_new_elements(struct state *state, struct dyn_array *array, long int *already_written)
+{
+	long int count;		// Number of new elements
+
+	count = (array == NULL) ? 0 : array->count - *already_written;
+	write_long(state, count);
+	if (count > 0 && fwrite((char *) array->data + *already_written * array->elm_size, array->elm_size,
+				(size_t) count, state->checkpointFile) != (size_t) count) {
+		errp(235, __func__, "error writing %ld results to checkpoint file: %s", count, state->checkpointPath);
+	}
+	*already_written += count;
+}
+
+
+/*
+ * read_new_elements - append to a dynamic array the elements of one checkpoint record
+ *
+ * given:
+ *      state           // run state with an open checkpoint file
+ *      array           // dynamic array of results, or NULL
+ *
+ * returns:
+ *      true ==> elements were read, false ==> the record was cut short
+ *
+ * This function does not return on error.
+ */
+static bool
+read_new_elements(struct state *state, struct dyn_array *array)
+{
+	long int count;		// Number of new elements
+	void *buf;		// Elements read
+
+	if (read_long(state, &count) == false || count < 0) {
+		return false;
+	}
+	if (count == 0) {
+		return true;
+	}
+	if (array == NULL) {
+		err(236, __func__, "checkpoint file has results for a test that keeps none: %s", state->checkpointPath);
+	}
+
+	buf = malloc((size_t) count * array->elm_size);
+	if (buf == NULL) {
+		errp(236, __func__, "cannot malloc %ld checkpoint results of %lu bytes each", count, array->elm_size);
+	}
+	if (fread(buf, array->elm_size, (size_t) count, state->checkpointFile) != (size_t) count) {
+		free(buf);
+		return false;
+	}
+	append_array(array, buf, count);
+	free(buf);
+
+	return true;
+}
+
+
+/*
+ * describe - append a line to the description of a run
+ *
+ * given:
+ *      description     // pointer to the malloced description so far, replaced by the longer one
+ *      fmt             // printf format of the line, without its newline
+ *      ...             // args of fmt
+ *
+ * This function does not return on error.
+ */
+static void
+describe(char **description, char const *fmt, ...)
+{
+	va_list ap;		// args of fmt
+	char *line;		// the line formatted
+	char *longer;		// description followed by line
+
+	va_start(ap, fmt);
+	if (vasprintf(&line, fmt, ap) < 0) {
+		errp(235, __func__, "cannot format a line of the run description");
+	}
+	va_end(ap);
+	if (asprintf(&longer, "%s%s\n", *description, line) < 0) {
+		errp(235, __func__, "cannot append to the run description");
+	}
+	free(line);
+	free(*description);
+	*description = longer;
+}
+
+
+/*
+ * describe_run - describe the options the results of a run depend on
+ *
+ * given:
+ *      state           // run state after all tests were initialized
+ *
+ * returns:
+ *      malloced text, one name=value line per option, see the initial comment
+ *
+ * This function does not return on error.
+ */
+static char *
+describe_run(struct state *state)
+{
+	struct stat st;		// randdata file status
+	char *description;	// the description
+	long int j;
+	int i;
+
+	description = strdup("");
+	if (description == NULL) {
+		errp(235, __func__, "cannot strdup the run description");
+	}
+	describe(&description, "bitstreams=%ld", state->tp.numOfBitStreams);
+	describe(&description, "n=%ld", state->tp.n);
+	describe(&description, "jobnum=%ld", state->jobnum);
+	describe(&description, "-s=%d", (int) state->resultstxtFlag);
+
+	/*
+	 * Test parameters that change the results: the block lengths, and alpha that
+	 * counts the successes of each iteration (printed exactly, in hex)
+	 */
+	describe(&description, "-P 1=%ld", state->tp.blockFrequencyBlockLength);
+	describe(&description, "-P 2=%ld", state->tp.nonOverlappingTemplateLength);
+	describe(&description, "-P 3=%ld", state->tp.overlappingTemplateLength);
+	describe(&description, "-P 4=%ld", state->tp.approximateEntropyBlockLength);
+	describe(&description, "-P 5=%ld", state->tp.serialBlockLength);
+	describe(&description, "-P 6=%ld", state->tp.linearComplexitySequenceLength);
+	describe(&description, "-P 11=%a", state->tp.alpha);
+	for (j = 0; j < state->sweepCount; j++) {
+		describe(&description, "-W %ld=%ld", state->sweepParam[j], state->sweepValue[j]);
+	}
+
+	/*
+	 * The bits tested
+	 */
+	describe(&description, "-F=%c", (char) state->dataFormat);
+	describe(&description, "-X=%s%s word=%ld low=%ld every=%ld", state->xformLsbFirst ? "lsb" : "msb",
+		 state->xformLittleEndian ? " le" : "", state->xformWordBytes, state->xformLowBits, state->xformDecimation);
+	if (state->manifestFlag == true) {
+		describe(&description, "-L=%s", state->manifestPath);
+	} else if (state->randomDataPath == NULL) {
+		describe(&description, "randdata=");
+	} else if (stat(state->randomDataPath, &st) == 0 && S_ISREG(st.st_mode)) {
+		describe(&description, "randdata=%s (%lld bytes)", state->randomDataPath, (long long int) st.st_size);
+	} else {
+		describe(&description, "randdata=%s", state->randomDataPath);
+	}
+
+	/*
+	 * The results kept of each test
+	 */
+	for (i = 1; i <= NUMOFTESTS; i++) {
+		describe(&description, "%s[%d]=%d,%lu,%lu", state->testNames[i], i, (int) state->testVector[i],
+			 (state->p_val[i] == NULL) ? 0 : state->p_val[i]->elm_size,
+			 (state->stats[i] == NULL) ? 0 : state->stats[i]->elm_size);
+	}
+
+	return description;
+}
+
+
+/*
+ * write_header - start a new checkpoint file with a description of this run
+ *
+ * given:
+ *      state           // run state with an open, empty checkpoint file
+ *
+ * This function does not return on error.
+ */
+static void
+write_header(struct state *state)
+{
+	char *description;	// description of this run
+	long int length;	// bytes of description
+
+	description = describe_run(state);
+	length = (long int) strlen(description);
+	write_long(state, CHECKPOINT_MAGIC);
+	write_long(state, length);
+	if (fwrite(description, 1, (size_t) length, state->checkpointFile) != (size_t) length) {
+		errp(235, __func__, "error writing the run description to checkpoint file: %s", state->checkpointPath);
+	}
+	if (fflush(state->checkpointFile) != 0) {
+		errp(235, __func__, "error flushing checkpoint file: %s", state->checkpointPath);
+	}
+	free(description);
+}
+
+
+/*
+ * check_header - verify that a checkpoint file was written by a run like this one
+ *
+ * given:
+ *      state           // run state with a checkpoint file open at its beginning
+ *
+ * This function does not return on error.
+ */
+static void
+check_header(struct state *state)
+{
+	char *expected;		// description of this run
+	char *found;		// description read from the file
+	long int length;	// bytes of the description read
+	long int magic;		// first long of the file
+	char *want;		// line of expected being compared
+	char *have;		// line of found being compared
+	char *want_end;		// end of the line of expected
+	char *have_end;		// end of the line of found
+
+	if (read_long(state, &magic) == false || magic != CHECKPOINT_MAGIC) {
+		err(236, __func__, "not a checkpoint file of this version of sts: %s", state->checkpointPath);
+	}
+	if (read_long(state, &length) == false || length < 0 || length > MAX_CHECKPOINT_DESCRIPTION) {
+		err(236, __func__, "checkpoint file header is incomplete: %s", state->checkpointPath);
+	}
+	found = malloc((size_t) length + 1);
+	if (found == NULL) {
+		errp(236, __func__, "cannot malloc %ld bytes for the checkpoint run description", length + 1);
+	}
+	if (fread(found, 1, (size_t) length, state->checkpointFile) != (size_t) length) {
+		err(236, __func__, "checkpoint file header is incomplete: %s", state->checkpointPath);
+	}
+	found[length] = '\0';
+
+	/*
+	 * Refuse to resume with the first option that differs
+	 */
+	expected = describe_run(state);
+	want = expected;
+	have = found;
+	while (*want != '\0' || *have != '\0') {
+		want_end = strchrnul(want, '\n');
+		have_end = strchrnul(have, '\n');
+		if (want_end - want != have_end - have || strncmp(want, have, (size_t) (want_end - want)) != 0) {
+			err(236, __func__, "checkpoint file %s was written with %.*s, this run has %.*s, cannot resume",
+			    state->checkpointPath, (int) (have_end - have), have, (int) (want_end - want), want);
+		}
+		want = (*want_end == '\0') ? want_end : want_end + 1;
+		have = (*have_end == '\0') ? have_end : have_end + 1;
+	}
+	free(expected);
+	free(found);
+}
+
+
+/*
+ * read_records - restore the results of all complete checkpoint records
+ *
+ * given:
+ *      state           // run state with a checkpoint file positioned just after its header
+ *
+ * returns:
+ *      offset of the end of the last complete record
+ *
+ * This function does not return on error.
+ */
+static long int
+read_records(struct state *state)
+{
+	long int good_offset;		// End of the last complete record
+	long int marker;		// Record marker
+	long int done;			// Iterations done according to the record
+	long int done_again;		// Trailing copy of done that completes the record
+	long int counters[5][NUMOFTESTS + 1];	// count, valid, success, failure, valid_p_val
+	long int p_val_count[NUMOFTESTS + 1];	// p_val[i]->count before this record
+	long int stats_count[NUMOFTESTS + 1];	// stats[i]->count before this record
+	bool complete;			// true ==> record was read in full
+	int i;
+
+	good_offset = ftell(state->checkpointFile);
+	while (read_long(state, &marker) == true) {
+
+		/*
+		 * Remember how much we had so that a cut short record can be undone
+		 */
+		for (i = 1; i <= NUMOFTESTS; i++) {
+			p_val_count[i] = (state->p_val[i] == NULL) ? 0 : state->p_val[i]->count;
+			stats_count[i] = (state->stats[i] == NULL) ? 0 : state->stats[i]->count;
+		}
+
+		/*
+		 * Read the record
+		 */
+		complete = (marker == CHECKPOINT_RECORD) && read_long(state, &done) == true &&
+		    fread(counters, sizeof(counters), 1, state->checkpointFile) == 1;
+		for (i = 1; complete == true && i <= NUMOFTESTS; i++) {
+			if (state->testVector[i] == true) {
+				complete = read_new_elements(state, state->p_val[i]) &&
+				    read_new_elements(state, state->stats[i]);
+			}
+		}
+		if (complete == true) {
+			complete = read_long(state, &done_again) == true && done_again == done &&
+			    done >= state->checkpointDone && done <= state->tp.numOfBitStreams;
+		}
+
+		/*
+		 * Drop a record that was cut short, along with anything after it
+		 */
+		if (complete == false) {
+			warn(__func__, "ignoring incomplete checkpoint record at offset %ld of %s",
+			     good_offset, state->checkpointPath);
+			for (i = 1; i <= NUMOFTESTS; i++) {
+				if (state->p_val[i] != NULL) {
+					state->p_val[i]->count = p_val_count[i];
+				}
+				if (state->stats[i] != NULL) {
+					state->stats[i]->count = stats_count[i];
+				}
+			}
+			break;
+		}
+
+		/*
+		 * Keep the record
+		 */
+		memcpy(state->count, counters[0], sizeof(state->count));
+		memcpy(state->valid, counters[1], sizeof(state->valid));
+		memcpy(state->success, counters[2], sizeof(state->success));
+		memcpy(state->failure, counters[3], sizeof(state->failure));
+		memcpy(state->valid_p_val, counters[4], sizeof(state->valid_p_val));
+		state->checkpointDone = done;
+		good_offset = ftell(state->checkpointFile);
+	}
+
+	return good_offset;
+}
+
+
+/*
+ * checkpoint_open - open the checkpoint file of this run, and resume from it if -r was given
+ *
+ * given:
+ *      state           // run state after all tests were initialized
+ *
+ * On return, state->iterationsMissing no longer counts the iterations restored from the checkpoint file.
+ *
+ * This function does not return on error.
+ */
+void
+checkpoint_open(struct state *state)
+{
+	char *filename;		// Checkpoint filename under workDir
+	long int good_offset;	// End of the last complete record
+	int i;
+	long int j;
+
+	/*
+	 * Check preconditions (firewall)
+	 */
+	if (state == NULL) {
+		err(237, __func__, "state arg is NULL");
+	}
+	if (state->checkpointFlag == false && state->resumeFlag == false) {
+		return;
+	}
+
+	/*
+	 * Checkpoint files are named like .pvalues files, one per job and rank
+	 */
+	if (asprintf(&filename, "sts.%04d.%ld.%ld.%ld.checkpoint", job_rank, state->jobnum,
+		     state->tp.numOfBitStreams, state->tp.n) < 0) {
+		errp(237, __func__, "cannot format checkpoint filename");
+	}
+	state->checkpointPath = filePathName(state->workDir, filename);
+	free(filename);
+
+	/*
+	 * Restore the results from an existing checkpoint file
+	 */
+	state->checkpointFile = NULL;
+	if (state->resumeFlag == true) {
+		state->checkpointFile = fopen(state->checkpointPath, "r+b");
+		if (state->checkpointFile == NULL && errno != ENOENT) {
+			errp(237, __func__, "cannot open checkpoint file: %s", state->checkpointPath);
+		}
+	}
+	if (state->checkpointFile != NULL) {
+		check_header(state);
+		good_offset = read_records(state);
+
+		/*
+		 * The restored records are those of the first iterations, in order
+		 */
+		for (i = 1; i <= NUMOFTESTS; i++) {
+			for (j = 0; state->statsIteration[i] != NULL && j < state->stats[i]->count; j++) {
+				append_value(state->statsIteration[i], &j);
+			}
+		}
+
+		/*
+		 * Truncate what follows the last complete record and append from there
+		 */
+		if (fflush(state->checkpointFile) != 0 || ftruncate(fileno(state->checkpointFile), good_offset) != 0 ||
+		    fseek(state->checkpointFile, good_offset, SEEK_SET) != 0) {
+			errp(237, __func__, "cannot truncate checkpoint file %s to %ld bytes", state->checkpointPath,
+			     good_offset);
+		}
+		state->iterationsMissing = state->tp.numOfBitStreams - state->checkpointDone;
+		msg("Resuming after iteration %ld of %ld from %s", state->checkpointDone, state->tp.numOfBitStreams,
+		    state->checkpointPath);
+	}
+
+	/*
+	 * Otherwise start a new checkpoint file
+	 */
+	else {
+		if (state->resumeFlag == true) {
+			warn(__func__, "no checkpoint file to resume from, starting from the first iteration: %s",
+			     state->checkpointPath);
+		}
+		state->checkpointFile = fopen(state->checkpointPath, "w+b");
+		if (state->checkpointFile == NULL) {
+			errp(237, __func__, "cannot create checkpoint file: %s", state->checkpointPath);
+		}
+		write_header(state);
+	}
+
+	/*
+	 * Everything we hold now is in the checkpoint file
+	 */
+	for (i = 1; i <= NUMOFTESTS; i++) {
+		state->checkpointPvals[i] = (state->p_val[i] == NULL) ? 0 : state->p_val[i]->count;
+		state->checkpointStats[i] = (state->stats[i] == NULL) ? 0 : state->stats[i]->count;
+	}
+	dbg(DBG_LOW, "checkpoint file: %s covers %ld iterations", state->checkpointPath, state->checkpointDone);
+}
+
+
+/*
+ * checkpoint_due - determine if enough iterations were claimed to warrant a new checkpoint
+ *
+ * given:
+ *      state           // run state
+ *
+ * returns:
+ *      true ==> stop claiming iterations and write a checkpoint once the ones in flight are done
+ *
+ * NOTE: The caller must hold the iterate mutex.
+ */
+bool
+checkpoint_due(struct state *state)
+{
+	long int claimed;	// Number of iterations handed out so far
+
+	if (state->checkpointFlag == false || state->checkpointFile == NULL) {
+		return false;
+	}
+	claimed = state->tp.numOfBitStreams - state->iterationsMissing;
+
+	return state->iterationsMissing > 0 && claimed - state->checkpointDone >= state->checkpointCycle;
+}
+
+
+/*
+ * checkpoint_write - append a checkpoint record with the results produced since the last one
+ *
+ * given:
+ *      state           // run state with no iteration in flight
+ *
+ * NOTE: The caller must hold the iterate mutex.
+ *
+ * This function does not return on error.
+ */
+void
+checkpoint_write(struct state *state)
+{
+	long int done;		// Number of iterations completed
+	int i;
+
+	/*
+	 * Check preconditions (firewall)
+	 */
+	if (state == NULL) {
+		err(238, __func__, "state arg is NULL");
+	}
+	if (state->checkpointFile == NULL) {
+		err(238, __func__, "checkpoint file is not open");
+	}
+	if (state->iterationsInFlight != 0) {
+		err(238, __func__, "cannot checkpoint with %ld iterations in flight", state->iterationsInFlight);
+	}
+	done = state->tp.numOfBitStreams - state->iterationsMissing;
+
+	/*
+	 * Under -s, the stats and p_values of the iterations done go in the file in iteration order
+	 */
+	writer_order(state);
+
+	/*
+	 * Write the record
+	 */
+	write_long(state, CHECKPOINT_RECORD);
+	write_long(state, done);
+	if (fwrite(state->count, sizeof(state->count), 1, state->checkpointFile) != 1 ||
+	    fwrite(state->valid, sizeof(state->valid), 1, state->checkpointFile) != 1 ||
+	    fwrite(state->success, sizeof(state->success), 1, state->checkpointFile) != 1 ||
+	    fwrite(state->failure, sizeof(state->failure), 1, state->checkpointFile) != 1 ||
+	    fwrite(state->valid_p_val, sizeof(state->valid_p_val), 1, state->checkpointFile) != 1) {
+		errp(238, __func__, "error writing counters to checkpoint file: %s", state->checkpointPath);
+	}
+	for (i = 1; i <= NUMOFTESTS; i++) {
+		if (state->testVector[i] == true) {
+			write_new_elements(state, state->p_val[i], &state->checkpointPvals[i]);
+			write_new_elements(state, state->stats[i], &state->checkpointStats[i]);
+		}
+	}
+	write_long(state, done);
+
+	/*
+	 * Make the record durable before we move on
+	 */
+	if (fflush(state->checkpointFile) != 0 || fsync(fileno(state->checkpointFile)) != 0) {
+		errp(238, __func__, "error syncing checkpoint file: %s", state->checkpointPath);
+	}
+	state->checkpointDone = done;
+	dbg(DBG_MED, "checkpoint of %ld iterations written to %s", done, state->checkpointPath);
+}
+
+
+/*
+ * checkpoint_close - close and remove the checkpoint file of a run whose results are complete
+ *
+ * given:
+ *      state           // run state
+ *
+ * This function does not return on error.
+ */
+void
+checkpoint_close(struct state *state)
+{
+	/*
+	 * Check preconditions (firewall)
+	 */
+	if (state == NULL) {
+		err(239, __func__, "state arg is NULL");
+	}
+
+	if (state->checkpointFile != NULL) {
+		errno = 0;	// paranoia
+		if (fclose(state->checkpointFile) != 0) {
+			errp(239, __func__, "error closing checkpoint file: %s", state->checkpointPath);
+		}
+		state->checkpointFile = NULL;
+		if (unlink(state->checkpointPath) != 0) {
+			warnp(__func__, "unable to remove checkpoint file: %s", state->checkpointPath);
+		}
+	}
+	if (state->checkpointPath != NULL) {
+		free(state->checkpointPath);
+		state->checkpointPath = NULL;
+	}
+}
@@ -0,0 +1,42 @@
+/*****************************************************************************
+ C H E C K P O I N T  F U N C T I O N  P R O T O T Y P E S
+ *****************************************************************************/
+
+/*
+ * This code has been heavily modified by the following people:
+ *
+ *      Landon Curt Noll
+ *      Tom Gilgan
+ *      Riccardo Paccagnella
+ *
+ * See the README.md and the initial comment in sts.c for more information.
+ *
+ * WE (THOSE LISTED ABOVE WHO HEAVILY MODIFIED THIS CODE) DISCLAIM ALL
+ * WARRANTIES WITH REGARD TO THIS SOFTWARE, INCLUDING ALL IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL WE (THOSE LISTED ABOVE
+ * WHO HEAVILY MODIFIED THIS CODE) BE LIABLE FOR ANY SPECIAL, INDIRECT OR
+ * CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF
+ * USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ *
+ * chongo (Landon Curt Noll, http://www.isthe.com/chongo/index.html) /\oo/\
+ *
+ * Share and enjoy! :-)
+ */
+
+#ifndef CHECKPOINT_H
+#   define CHECKPOINT_H
+
+#   include "defs.h"
+
+#   define CHECKPOINT_MAGIC	(0x53545343484b5032L)	// "STSCHKP2": first long of a checkpoint file
+#   define CHECKPOINT_RECORD	(0x53545343484b5245L)	// "STSCHKRE": first long of each checkpoint record
+#   define MAX_CHECKPOINT_DESCRIPTION (1024L * 1024)	// most bytes of the run description of a checkpoint file
+
+extern void checkpoint_open(struct state *state);
+extern bool checkpoint_due(struct state *state);
+extern void checkpoint_write(struct state *state);
+extern void checkpoint_close(struct state *state);
+
+#endif				/* CHECKPOINT_H */
@@ -0,0 +1,434 @@
+// decompress.c - read compressed randdata through a decompressor process
+
+/*
+ * This code has been heavily modified by the following people:
+ *
+ *      Landon Curt Noll
+ *      Tom Gilgan
+ *      Riccardo Paccagnella
+ *
+ * See the README.md and the initial comment in sts.c for more information.
+ *
+ * WE (THOSE LISTED ABOVE WHO HEAVILY MODIFIED THIS CODE) DISCLAIM ALL
+ * WARRANTIES WITH REGARD TO THIS SOFTWARE, INCLUDING ALL IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL WE (THOSE LISTED ABOVE
+ * WHO HEAVILY MODIFIED THIS CODE) BE LIABLE FOR ANY SPECIAL, INDIRECT OR
+ * CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF
+ * USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ *
+ * chongo (Landon Curt Noll, http://www.isthe.com/chongo/index.html) /\oo/\
+ *
+ * Share and enjoy! :-)
+ */
+
+
+
+// Exit codes: 90 thru 94
+
+/*
+ * A randdata file whose name ends in .gz, .xz or .zst is decompressed on the fly: the reader reads
+ * the output of a decompressor process through a pipe, so the decompressed data never touches the
+ * disk and decompression runs alongside the readers and the tests.  Where the decompressor can use
+ * more than one thread (pigz, xz -T0), it does.
+ *
+ * Decompressed data cannot be seeked into, so a compressed randdata is read by a single reader, like
+ * stdin.  Unlike stdin, -j jobnum (and resuming from a checkpoint) still starts at the right bit: the
+ * data before it is decompressed and thrown away.  A zstd file written in the seekable format (zstd's
+ * contrib/seekable_format, a seek table in a skippable frame at the end) lets us skip the frames
+ * before it without decompressing them.
+ *
+ * We run the command line tools rather than link against the libraries, so sts does not gain any
+ * build dependencies and a missing decompressor only matters to those with compressed data.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include "../utils/externs.h"
+#include "utilities.h"
+#include "decompress.h"
+#include "debug.h"
+
+
+#define DECODER_ALTS (2)		// decompressor commands to try, in order
+#define DECODER_ARGS (4)		// argv entries of a decompressor command, including the NULL
+#define ZSTD_SKIPPABLE_MAGIC (0x184D2A5EU)	// skippable frame holding the seek table
+#define ZSTD_SEEKABLE_MAGIC (0x8F92EAB1U)	// last 4 bytes of a seekable zstd file
+#define ZSTD_SEEK_FOOTER (9)		// bytes of the seek table footer
+#define ZSTD_SKIPPABLE_HEADER (8)	// bytes of a skippable frame header
+#define SEEK_ENTRIES (4096)		// seek table entries read at once
+
+/*
+ * decoder - how to recognize and decompress a compressed format
+ */
+struct decoder {
+	const char *suffix;			// randdata file name suffix
+	BYTE magic[6];				// first bytes of the format
+	size_t magic_len;			// number of bytes in magic
+	bool seekable;				// true ==> look for a zstd seek table
+	char *const argv[DECODER_ALTS][DECODER_ARGS];	// commands writing the decompressed stdin to stdout
+};
+
+static const struct decoder decoders[] = {
+	{".gz", {0x1f, 0x8b}, 2, false, {{"pigz", "-dc", NULL}, {"gzip", "-dc", NULL}}},
+	{".xz", {0xfd, '7', 'z', 'X', 'Z', 0x00}, 6, false, {{"xz", "-dc", "-T0", NULL}, {"xz", "-dc", NULL}}},
+	{".zst", {0x28, 0xb5, 0x2f, 0xfd}, 4, true, {{"zstd", "-dcq", NULL}, {"unzstd", "-cq", NULL}}},
+};
+
+/*
+ * The running decompressor
+ */
+static pid_t decoder_pid = -1;				// decompressor process, -1 ==> none
+static const struct decoder *decoder_running = NULL;	// what it decompresses
+
+
+/*
+ * Forward static function declarations
+ */
+static const struct decoder *find_decoder(struct state *state);
+static uint32_t le32(const BYTE *p);
+static long int zstd_seek(int fd, long int offset, long int *skipped);
+
+
+/*
+ * find_decoder - find the decoder for the name of randdata
+ *
+ * given:
+ *      state           // run state
+ *
+ * returns:
+ *      decoder for randdata, or NULL if randdata is not compressed (or is stdin)
+ */
+static const struct decoder *
+find_decoder(struct state *state)
+{
+	size_t len;		// Length of randomDataPath
+	size_t suffix_len;	// Length of a decoder suffix
+	size_t i;
+
+	if (state->stdinData == true || state->randomDataPath == NULL) {
+		return NULL;
+	}
+	len = strlen(state->randomDataPath);
+	for (i = 0; i < sizeof(decoders) / sizeof(decoders[0]); i++) {
+		suffix_len = strlen(decoders[i].suffix);
+		if (len > suffix_len && strcmp(state->randomDataPath + len - suffix_len, decoders[i].suffix) == 0) {
+			return &decoders[i];
+		}
+	}
+	return NULL;
+}
+
+
+/*
+ * decompress_wanted - determine if randdata is compressed
+ *
+ * given:
+ *      state           // run state
+ *
+ * returns:
+ *      true ==> randdata is a .gz, .xz or .zst file, to be read with decompress_open()
+ */
+bool
+decompress_wanted(struct state *state)
+{
+	/*
+	 * Check preconditions (firewall)
+	 */
+	if (state == NULL) {
+		err(90, __func__, "state arg is NULL");
+	}
+
+	return find_decoder(state) != NULL;
+}
+
+
+/*
+ * le32 - decode a little endian 32 bit unsigned integer
+ */
+static uint32_t
+le32(const BYTE *p)
+{
+	return (uint32_t) p[0] | ((uint32_t) p[1] << 8) | ((uint32_t) p[2] << 16) | ((uint32_t) p[3] << 24);
+}
+
+
+/*
+ * zstd_seek - find the last zstd frame starting at or before a decompressed offset
+ *
+ * given:
+ *      fd              // zstd file
+ *      offset          // decompressed byte offset
+ *      skipped         // decompressed bytes before the frame found
+ *
+ * returns:
+ *      Compressed byte offset of the frame, 0 if the file has no seek table.
+ */
+static long int
+zstd_seek(int fd, long int offset, long int *skipped)
+{
+	struct stat st;			// file status
+	BYTE footer[ZSTD_SEEK_FOOTER];	// seek table footer
+	BYTE header[ZSTD_SKIPPABLE_HEADER];	// skippable frame header
+	BYTE *entries;			// seek table entries
+	long int frames;		// number of frames in the seek table
+	long int entry_len;		// bytes of a seek table entry
+	off_t table;			// file offset of the seek table entries
+	long int compressed = 0;	// compressed offset of the frame
+	long int decompressed = 0;	// decompressed offset of the frame
+	long int dsize;			// decompressed size of a frame
+	long int count;			// entries read at once
+	long int i;
+	long int j;
+
+	*skipped = 0;
+	if (offset <= 0 || fstat(fd, &st) != 0 || st.st_size < ZSTD_SEEK_FOOTER + ZSTD_SKIPPABLE_HEADER) {
+		return 0;
+	}
+
+	/*
+	 * Find and check the seek table
+	 */
+	if (pread(fd, footer, ZSTD_SEEK_FOOTER, st.st_size - ZSTD_SEEK_FOOTER) != ZSTD_SEEK_FOOTER ||
+	    le32(footer + 5) != ZSTD_SEEKABLE_MAGIC) {
+		dbg(DBG_LOW, "no zstd seek table, decompressing from the start");
+		return 0;
+	}
+	frames = (long int) le32(footer);
+	entry_len = (footer[4] & 0x80) ? 12 : 8;
+	table = st.st_size - ZSTD_SEEK_FOOTER - (off_t) frames * entry_len;
+	if (table < ZSTD_SKIPPABLE_HEADER ||
+	    pread(fd, header, ZSTD_SKIPPABLE_HEADER, table - ZSTD_SKIPPABLE_HEADER) != ZSTD_SKIPPABLE_HEADER ||
+	    le32(header) != ZSTD_SKIPPABLE_MAGIC) {
+		warn(__func__, "corrupt zstd seek table, decompressing from the start");
+		return 0;
+	}
+
+	/*
+	 * Add up the frames that end before offset
+	 */
+	entries = malloc((size_t) (SEEK_ENTRIES * entry_len));
+	if (entries == NULL) {
+		errp(91, __func__, "cannot malloc %ld seek table entries", (long int) SEEK_ENTRIES);
+	}
+	for (i = 0; i < frames; i += count) {
+		count = MIN(frames - i, SEEK_ENTRIES);
+		if (pread(fd, entries, (size_t) (count * entry_len), table + (off_t) i * entry_len) != count * entry_len) {
+			warn(__func__, "cannot read the zstd seek table, decompressing from the start");
+			free(entries);
+			return 0;
+		}
+		for (j = 0; j < count; j++) {
+			dsize = (long int) le32(entries + j * entry_len + 4);
+			if (decompressed + dsize > offset) {
+				free(entries);
+				*skipped = decompressed;
+				return compressed;
+			}
+			compressed += (long int) le32(entries + j * entry_len);
+			decompressed += dsize;
+		}
+	}
+	free(entries);
+	*skipped = decompressed;
+	return compressed;
+}
+
+
+/*
+ * decompress_open - start decompressing randdata
+ *
+ * given:
+ *      state           // run state
+ *      offset          // decompressed byte offset to start reading at
+ *
+ * returns:
+ *      Stream of the decompressed data from offset on, to be closed with decompress_close().
+ *
+ * This function does not return on error.
+ */
+FILE *
+decompress_open(struct state *state, long int offset)
+{
+	const struct decoder *decoder;	// how to decompress randdata
+	BYTE magic[sizeof(decoders[0].magic)];	// first bytes of randdata
+	BYTE discard[BUFSIZ];		// decompressed data before offset
+	long int skipped = 0;		// decompressed bytes the decompressor does not see
+	long int start = 0;		// compressed offset the decompressor starts at
+	int in;				// randdata
+	int out[2];			// decompressed data pipe
+	int status[2];			// errno of a failed exec, closed on a successful one
+	int exec_errno;			// errno of the failed exec
+	FILE *stream;			// decompressed data
+	size_t got;			// bytes discarded at once
+	int i;
+
+	/*
+	 * Check preconditions (firewall)
+	 */
+	if (state == NULL) {
+		err(92, __func__, "state arg is NULL");
+	}
+	decoder = find_decoder(state);
+	if (decoder == NULL) {
+		err(92, __func__, "randdata is not compressed: %s", state->randomDataPath);
+	}
+	if (decoder_pid >= 0) {
+		err(92, __func__, "a decompressor is already running");
+	}
+	if (offset < 0) {
+		err(92, __func__, "offset arg: %ld must be >= 0", offset);
+	}
+
+	/*
+	 * Check that randdata is what its name says
+	 */
+	in = open(state->randomDataPath, O_RDONLY);
+	if (in < 0) {
+		errp(92, __func__, "cannot open: %s", state->randomDataPath);
+	}
+	if (read(in, magic, decoder->magic_len) != (ssize_t) decoder->magic_len ||
+	    memcmp(magic, decoder->magic, decoder->magic_len) != 0) {
+		err(92, __func__, "%s does not start like a %s file", state->randomDataPath, decoder->suffix);
+	}
+
+	/*
+	 * Decompress from the frame holding offset, if randdata says where frames start
+	 */
+	if (decoder->seekable == true) {
+		start = zstd_seek(in, offset, &skipped);
+		if (start > 0) {
+			dbg(DBG_MED, "skipping %ld compressed bytes to the zstd frame at decompressed byte %ld", start,
+			    skipped);
+		}
+	}
+	if (lseek(in, (off_t) start, SEEK_SET) < 0) {
+		errp(92, __func__, "cannot seek to byte %ld of: %s", start, state->randomDataPath);
+	}
+
+	/*
+	 * Start the decompressor, reading randdata on its stdin and writing to our pipe
+	 */
+	if (pipe(out) != 0 || pipe(status) != 0) {
+		errp(92, __func__, "cannot create the decompressor pipes");
+	}
+	if (fcntl(status[1], F_SETFD, FD_CLOEXEC) != 0) {
+		errp(92, __func__, "cannot set close-on-exec on the decompressor status pipe");
+	}
+	fflush(stdout);
+	fflush(stderr);
+	decoder_pid = fork();
+	if (decoder_pid < 0) {
+		errp(92, __func__, "cannot fork the decompressor");
+	} else if (decoder_pid == 0) {
+		if (dup2(in, STDIN_FILENO) < 0 || dup2(out[1], STDOUT_FILENO) < 0) {
+			exec_errno = errno;
+		} else {
+			close(in);
+			close(out[0]);
+			close(out[1]);
+			close(status[0]);
+			exec_errno = ENOENT;
+			for (i = 0; i < DECODER_ALTS; i++) {
+				execvp(decoder->argv[i][0], decoder->argv[i]);
+				if (errno != ENOENT) {
+					exec_errno = errno;
+				}
+			}
+		}
+		if (write(status[1], &exec_errno, sizeof(exec_errno)) < 0) {
+			_exit(126);
+		}
+		_exit(127);
+	}
+	close(in);
+	close(out[1]);
+	close(status[1]);
+
+	/*
+	 * The status pipe is closed without a word once a decompressor runs
+	 */
+	while ((got = (size_t) read(status[0], &exec_errno, sizeof(exec_errno))) == (size_t) -1 && errno == EINTR) {
+	}
+	close(status[0]);
+	if (got == sizeof(exec_errno)) {
+		waitpid(decoder_pid, NULL, 0);
+		decoder_pid = -1;
+		errno = exec_errno;
+		errp(93, __func__, "cannot run %s or %s to decompress: %s", decoder->argv[0][0], decoder->argv[1][0],
+		     state->randomDataPath);
+	}
+	decoder_running = decoder;
+	dbg(DBG_LOW, "decompressing %s with %s", state->randomDataPath, decoder->argv[0][0]);
+
+	stream = fdopen(out[0], "r");
+	if (stream == NULL) {
+		errp(92, __func__, "cannot fdopen the decompressor pipe");
+	}
+
+	/*
+	 * Throw away the decompressed data before offset
+	 */
+	for (offset -= skipped; offset > 0; offset -= (long int) got) {
+		got = fread(discard, 1, (size_t) MIN(offset, (long int) sizeof(discard)), stream);
+		if (got == 0) {
+			err(93, __func__, "decompressed %s ends %ld bytes before the data to test", state->randomDataPath,
+			    offset);
+		}
+	}
+
+	return stream;
+}
+
+
+/*
+ * decompress_close - stop reading decompressed randdata
+ *
+ * given:
+ *      state           // run state
+ *      stream          // stream returned by decompress_open()
+ *
+ * The decompressor may still have data for us, it is killed by SIGPIPE when we close the pipe.
+ */
+void
+decompress_close(struct state *state, FILE *stream)
+{
+	int status;		// decompressor exit status
+
+	/*
+	 * Check preconditions (firewall)
+	 */
+	if (state == NULL || stream == NULL) {
+		err(94, __func__, "state or stream arg is NULL");
+	}
+	if (decoder_pid < 0) {
+		err(94, __func__, "no decompressor is running");
+	}
+
+	fclose(stream);
+	while (waitpid(decoder_pid, &status, 0) < 0) {
+		if (errno != EINTR) {
+			errp(94, __func__, "cannot wait for the decompressor");
+		}
+	}
+	if (WIFEXITED(status) && WEXITSTATUS(status) != 0) {
+		warn(__func__, "%s exited %d while decompressing: %s", decoder_running->argv[0][0], WEXITSTATUS(status),
+		     state->randomDataPath);
+	} else if (WIFSIGNALED(status) && WTERMSIG(status) != SIGPIPE) {
+		warn(__func__, "%s was killed by signal %d while decompressing: %s", decoder_running->argv[0][0],
+		     WTERMSIG(status), state->randomDataPath);
+	}
+	decoder_pid = -1;
+	decoder_running = NULL;
+}
@@ -192,6 +192,7 @@
 #   define MAX_EXCURSION_RND_EXCURSION		(4)		// Maximum excursion for state values in TEST_RND_EXCURSION
 #   define NUMBER_OF_STATES_RND_EXCURSION	(2*MAX_EXCURSION_RND_EXCURSION)	// Number of states for TEST_RND_EXCURSION
 #   define DEGREES_OF_FREEDOM_RND_EXCURSION	(6)		// Degrees of freedom (including 0) for TEST_RND_EXCURSION
+#   define CYCLE_RESERVE_RND_EXCURSION		(5)		// Cycles reserved for TEST_RND_EXCURSION, in multiples of sqrt(n)
 
 #   define MIN_LENGTH_RND_EXCURSION_VAR		(1000000)	// Minimum n for TEST_RND_EXCURSION_VAR
 #   define MAX_EXCURSION_RND_EXCURSION_VAR	(9)		// Maximum excursion for state values in TEST_RND_EXCURSION_VAR
@@ -252,6 +253,8 @@ enum run_mode {
 #   define MIN_PARAM (1)	// minimum -P parameter number
 #   define MAX_PARAM (11)	// maximum -P parameter number
 #   define MAX_INT_PARAM (9)	// maximum -P parameter that is an integer, beyond this are doubles
+#   define MAX_SWEEP_PARAM (6)	// maximum -W parameter number, the block lengths of a single test
+#   define MAX_SWEEP (32)	// maximum number of -W parameter sets
 
 enum param {
 	PARAM_continue = 0,				// Don't prompt for any more parameters
@@ -351,6 +354,29 @@ struct nonover_stats {
 	unsigned int Wj[BLOCKS_NON_OVERLAPPING]; // Number of times that m-bit template occurs within each block
 };
 
+/*
+ * A test of a bitstream, as scheduled on the threads of a -G team
+ */
+struct task {
+	struct state *state;		// Run state of the test, the main one or that of a -W parameter set
+	enum test test;			// Test to iterate on the bitstream
+	double cost;			// Estimated cost of one iteration, in bit operations
+};
+
+/*
+ * Counts of the overlapping bit patterns of the bitstream being tested by a thread
+ *
+ * The counts of the b bit patterns are at counts[1 << b] thru counts[(2 << b) - 1].  The bitstream
+ * is scanned once for the largest b and the counts of shorter patterns are added up from those, so
+ * the Serial and Approximate Entropy tests, and their -W parameter sets, share a single pass.
+ */
+struct patterns {
+	long int *counts;		// Counts of the patterns of each length up to max bits
+	long int max;			// Length of the longest patterns counted
+	unsigned long int valid;	// Bit b set ==> the counts of the b bit patterns are for the current bitstream
+	long int *parts;		// Counts of the longest patterns by -J pieces 1 and up, 1 << max each
+};
+
 /*
  * Struct representing a node of the filenames linked-list
  */
@@ -360,6 +386,9 @@ struct Node
 	struct Node *next;
 };
 
+struct memo;
+struct validate;
+
 /*
  * state - execution state, initialized and set up by the command line, augmented by test results
  */
@@ -393,17 +422,57 @@ struct state {
 	char *randomDataPath;		// randdata: path to a random data file, or "-" (stdin), or "/dev/null", or NULL (no file)
 	bool stdinData;			// true is reading randdata from standard input (stdin)
 
+	bool manifestFlag;		// true if -L manifest was given
+	char *manifestPath;		// -L manifest: file listing the randdata of each source to test
+	char **sources;			// randdata of each source listed in the manifest, or NULL
+	long int sourceCount;		// Number of sources in the manifest
+	long int source;		// Index in sources of the randdata being tested
+
 	bool dataFormatFlag;		// true if -F format was given
 	enum format dataFormat;		// -F format: 'r': raw binary, 'a': ASCII '0'/'1' chars
 
+	bool xformFlag;			// true if -X xform was given
+	bool xformLsbFirst;		// -X lsb: take the bits of each sample least significant bit first
+	bool xformLittleEndian;		// -X le: samples are little endian
+	long int xformWordBytes;	// -X word=W: bytes per sample
+	long int xformLowBits;		// -X low=K: bits kept from each sample, its low K bits
+	long int xformDecimation;	// -X every=D: keep every D-th bit
+
 	bool numberOfThreadsFlag;	// true if -T numberOfFlag was given
 	long int numberOfThreads;	// Number of threads to use for the current execution
 	long int iterationsMissing;	// Number of iterations that need to be completed
+	bool teamFlag;			// true if -G team was given
+	long int teamSize;		// -G team: threads testing each bitstream together, 0 ==> chosen by cost
+	bool splitFlag;			// true if -J split was given
+	long int splitParts;		// -J split: most pieces the work of a test on a bitstream is cut into
+	bool sliceFlag;			// true if -B was given: test bitstreams SLICE_LANES at a time, bit-sliced
+	long int sliceRunBlock;		// Block length M of TEST_LONGEST_RUN, for the bit-sliced engine
+
+	bool readerThreadsFlag;		// true if -R readers was given
+	long int readerThreads;		// -R readers: number of threads reading bitstreams ahead of the iterate threads
+	bool directIOFlag;		// true if -D qdepth was given
+	long int directIODepth;		// -D qdepth: direct reads of raw binary randdata each reader keeps in flight
+
+	bool pinThreadsFlag;		// true if -C firstcpu was given
+	long int firstCpu;		// -C firstcpu: pin iterate thread i to the (firstcpu+i)th CPU we may run on
+	bool hugePagesFlag;		// -H: back the per thread arenas with huge pages
+	bool numaFlag;			// -N: place threads, their memory and the bitstreams they test on NUMA nodes
+	bool timingFlag;		// -E: time the tests and phases of the run, report the times in the final results file
+	bool traceFlag;			// true if -Y tracefile was given
+	char *tracePath;		// -Y tracefile: write the timeline of the run to tracefile as a Chrome trace
+	bool validateFlag;		// -V: compare the results of each bitstream with the reference implementation
 
 	bool jobnumFlag;		// true if -j jobnum was given
 	long int jobnum;		// -j jobnum: seek into randdata num*bitcount*iterations bits unless reading from stdin
 	long int base_seek;		// Seek position for the input file indicating where we want to start testing it
 
+	bool checkpointFlag;		// true if -k chkptCycle was given
+	long int checkpointCycle;	// -k chkptCycle: write a checkpoint every chkptCycle completed iterations
+	bool resumeFlag;		// -r: resume from the checkpoint file under workDir
+
+	bool memLimitFlag;		// true if -M memlimit was given
+	long int memLimit;		// -M memlimit: keep results under memlimit MiB of RAM, spill the rest under workDir
+
 	char *pvalues_dir;		// Directory where to look for the .pvalues binary files
 	struct Node *filenames;		// Names of the .pvalues files
 
@@ -428,11 +497,14 @@ struct state {
 
 	struct dyn_array *stats[NUMOFTESTS + 1];// Per test dynamic array of per iteration data (for stats.txt if -s)
 	struct dyn_array *p_val[NUMOFTESTS + 1];// Per test dynamic array of p_values (nonover_stats for the nonOverlapping test)
+	struct dyn_array *statsIteration[NUMOFTESTS + 1];	// Per test iteration of each record of stats[test] (-s only)
+	struct memo *memo[NUMOFTESTS + 1];	// Per test memo of p-values by statistic, or NULL (see memo.c)
 
 	bool is_excursion[NUMOFTESTS + 1];	// true --> test is a form of random excursion
 
 	BitSequence **epsilon;			// Bit stream
 	BitSequence *tmpepsilon;		// Buffer to write to file in dataFormat
+	struct arena *arena;			// Per thread arenas holding each thread's test scratch buffers
 
 	long int count[NUMOFTESTS + 1];		// Count of completed iterations, including tests skipped due to conditions
 	long int valid[NUMOFTESTS + 1];		// Count of completed testable iterations, ignores tests skipped due to conditions
@@ -467,13 +539,9 @@ struct state {
 	BitSequence **linear_c;			// LFSR array c for TEST_LINEARCOMPLEXITY
 	BitSequence **linear_t;			// LFSR array t for TEST_LINEARCOMPLEXITY
 
-	long int **apen_C;			// Frequency count for TEST_APEN
-	long int apen_C_len;			// Number of long ints in apen_C for TEST_APEN
-
-	long int **serial_v;			// Frequency count for TEST_SERIAL
-	long int serial_v_len;			// Number of long ints in serial_v for TEST_SERIAL
+	struct patterns *patterns;		// Per thread overlapping pattern counts for TEST_APEN and TEST_SERIAL
 
-	BitSequence **nonper_seq;		// Special BitSequence for TEST_NON_OVERLAPPING
+	struct nonover_stats **nonover_stats;	// Per thread results of each template of an iteration for TEST_NON_OVERLAPPING
 
 	long int universal_L;			// Length of each block for TEST_UNIVERSAL
 	long int **universal_T;			// Working Universal template
@@ -484,13 +552,40 @@ struct state {
 	double **rnd_excursion_pi_terms;	// Theoretical probabilities for states of TEST_RND_EXCURSION_VAR
 
 	bool legacy_output;			// true ==> try to mimic output format of legacy code
+
+	char *checkpointPath;			// Path of the checkpoint file or NULL
+	FILE *checkpointFile;			// Open checkpoint file or NULL
+	long int checkpointDone;		// Number of iterations whose results are in the checkpoint file
+	bool checkpointPending;			// true ==> no new iterations until a checkpoint is written
+	long int iterationsInFlight;		// Number of iterations claimed by a thread but not completed yet
+	long int checkpointPvals[NUMOFTESTS + 1];	// Number of p_val[i] elements in the checkpoint file
+	long int checkpointStats[NUMOFTESTS + 1];	// Number of stats[i] elements in the checkpoint file
+
+	struct test_output *output;		// Per test stats.txt, results.txt, data*.txt being written under -s, or NULL
+	bool resultsReserved;			// true ==> p_val and stats hold the whole run, their records never move
+
+	long int sweepCount;			// Number of -W parameter sets
+	long int sweepParam[MAX_SWEEP];		// -W num=value: parameter num of each parameter set
+	long int sweepValue[MAX_SWEEP];		// -W num=value: value of the parameter of each parameter set
+	enum test sweepTest[MAX_SWEEP];		// Test whose parameter each parameter set changes
+	struct state *sweep;			// Run state of each parameter set, or NULL
+	bool sweepInstance;			// true ==> this run state tests a -W parameter set of another
+
+	struct task *tasks;			// Tests of a bitstream by decreasing cost when teamSize > 1, or NULL
+	long int taskCount;			// Number of tasks
+
+	struct validate *validate;		// Per thread run states comparing results under -V, or NULL
+	bool referenceInstance;			// true ==> this run state tests with the reference implementation
 };
 
+struct slice_lane;
+
 struct thread_state {
 	long int thread_id;
 	struct state *global_state;
 	long int iteration_being_done;
 	pthread_mutex_t *mutex;
+	struct slice_lane *lane;	// results of the bit-sliced engine for the bitstream, or NULL
 };
 
 #define nullptr NULL
@@ -502,10 +597,14 @@ struct thread_state {
  */
 extern void init(struct state *state);
 extern void iterate(struct thread_state *thread_state);
+extern void iterate_task(struct thread_state *thread_state, long int task);
+extern void print_iterations(struct state *state, int test, long int first, long int last);
 extern void print(struct state *state);
 extern void metrics(struct state *state);
+extern bool next_source(struct state *state);
 extern void destroy(struct state *state);
 
 extern void parse_args(struct state *state, int argc, char **argv);
+extern void default_state(struct state *state);
 
 #endif				/* DEFS_H */
@@ -0,0 +1,633 @@
+// direct.c - read raw binary bitstreams around the page cache
+
+/*
+ * This code has been heavily modified by the following people:
+ *
+ *      Landon Curt Noll
+ *      Tom Gilgan
+ *      Riccardo Paccagnella
+ *
+ * See the README.md and the initial comment in sts.c for more information.
+ *
+ * WE (THOSE LISTED ABOVE WHO HEAVILY MODIFIED THIS CODE) DISCLAIM ALL
+ * WARRANTIES WITH REGARD TO THIS SOFTWARE, INCLUDING ALL IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL WE (THOSE LISTED ABOVE
+ * WHO HEAVILY MODIFIED THIS CODE) BE LIABLE FOR ANY SPECIAL, INDIRECT OR
+ * CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF
+ * USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ *
+ * chongo (Landon Curt Noll, http://www.isthe.com/chongo/index.html) /\oo/\
+ *
+ * Share and enjoy! :-)
+ */
+
+
+
+// Exit codes: 85 thru 89
+
+/*
+ * Large captures (multi-TB files, raw partitions given as randdata) are read once, start to end.
+ * Reading them through stdio fills the page cache with data nobody reads again and pushes out
+ * what the rest of the system was using.  Under -D qdepth, each reader opens randdata with O_DIRECT
+ * and keeps up to qdepth reads of whole bitstreams in flight.
+ *
+ * O_DIRECT wants the file offset, the length and the buffer address to be multiples of the
+ * device's logical block size.  A bitstream, after the -j jobnum seek, starts anywhere, so each
+ * read covers the aligned blocks around the bitstream, and direct_wait() returns a pointer to the
+ * first byte of the bitstream inside its buffer.
+ *
+ * On Linux the reads are queued with io_uring, talking to the kernel through the raw system calls.
+ * Where io_uring is missing or not permitted, or where the file system refuses O_DIRECT, we fall
+ * back to plain pread(2), synchronous and (without O_DIRECT) buffered.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/ioctl.h>
+#if defined(__linux__)
+#   include <sys/mman.h>
+#   include <sys/syscall.h>
+#   include <linux/fs.h>
+#   include <linux/io_uring.h>
+#   if defined(__NR_io_uring_setup) && defined(IORING_FEAT_RW_CUR_POS)
+#      define HAVE_IO_URING	// IORING_OP_READ came with IORING_FEAT_RW_CUR_POS in Linux 5.6
+#   endif
+#endif
+#include "../utils/externs.h"
+#include "utilities.h"
+#include "direct.h"
+#include "decompress.h"
+#include "transform.h"
+#include "debug.h"
+
+
+/*
+ * direct_io - one reader's descriptor, buffers and queue
+ */
+struct direct_io {
+	struct state *state;		// run state
+	int fd;				// randdata
+	bool direct;			// true ==> fd was opened with O_DIRECT
+	long int align;			// read offsets, lengths and buffer addresses are multiples of align
+	long int bytes;			// bytes holding one bitstream
+	long int span;			// bytes of a buffer: enough for an unaligned bitstream
+	long int depth;			// number of buffers, and of reads in flight
+	BYTE **buf;			// depth aligned buffers
+	off_t *start;			// aligned file offset each buffer was read from
+	long int *skip;			// bytes from the start of a buffer to its bitstream
+	long int *len;			// aligned number of bytes to read into each buffer
+	long int *got;			// bytes read into each buffer, -1 ==> read in flight
+#if defined(HAVE_IO_URING)
+	int ring_fd;			// io_uring, -1 ==> use pread
+	void *sq_ptr;			// mmapped submission queue ring
+	size_t sq_len;			// bytes mmapped at sq_ptr
+	void *cq_ptr;			// mmapped completion queue ring, may be sq_ptr
+	size_t cq_len;			// bytes mmapped at cq_ptr
+	struct io_uring_sqe *sqes;	// mmapped submission queue entries
+	size_t sqes_len;		// bytes mmapped at sqes
+	unsigned *sq_tail;		// submission queue tail, we produce
+	unsigned *sq_mask;		// submission queue index mask
+	unsigned *sq_array;		// submission queue index array
+	unsigned *cq_head;		// completion queue head, we consume
+	unsigned *cq_tail;		// completion queue tail, the kernel produces
+	unsigned *cq_mask;		// completion queue index mask
+	struct io_uring_cqe *cqes;	// completion queue entries
+#endif
+};
+
+
+/*
+ * Forward static function declarations
+ */
+static void direct_fill(struct direct_io *dio, long int buf);
+#if defined(HAVE_IO_URING)
+static void uring_setup(struct direct_io *dio);
+static bool uring_submit(struct direct_io *dio, long int buf);
+static void uring_reap(struct direct_io *dio, bool wait);
+static void uring_teardown(struct direct_io *dio);
+#endif
+
+
+/*
+ * direct_wanted - determine if the readers read randdata with direct I/O
+ *
+ * given:
+ *      state           // run state
+ *
+ * returns:
+ *      true ==> -D qdepth was given and randdata is an uncompressed raw binary file or device
+ *
+ * ASCII '0'/'1' input is not direct read: each bit is its own byte, it is parsed by fscanf(),
+ * and such files are not the multi-TB captures -D is for.
+ */
+bool
+direct_wanted(struct state *state)
+{
+	/*
+	 * Check preconditions (firewall)
+	 */
+	if (state == NULL) {
+		err(85, __func__, "state arg is NULL");
+	}
+
+	return state->directIOFlag == true && state->stdinData == false && state->dataFormat == FORMAT_RAW_BINARY &&
+	    decompress_wanted(state) == false;
+}
+
+
+/*
+ * direct_size - determine the bytes of buffers one reader needs for direct I/O
+ *
+ * given:
+ *      state           // run state
+ *
+ * returns:
+ *      Bytes of buffers direct_open() allocates, assuming DIRECT_ALIGN byte blocks.
+ */
+long int
+direct_size(struct state *state)
+{
+	long int bytes;		// Bytes holding one bitstream
+
+	/*
+	 * Check preconditions (firewall)
+	 */
+	if (state == NULL) {
+		err(85, __func__, "state arg is NULL");
+	}
+
+	bytes = transform_bytes(state);
+	return state->directIODepth * ((DIRECT_ALIGN - 1 + bytes + DIRECT_ALIGN - 1) / DIRECT_ALIGN) * DIRECT_ALIGN;
+}
+
+
+/*
+ * direct_open - open randdata for direct reads of whole bitstreams
+ *
+ * given:
+ *      state           // run state
+ *      depth           // number of reads to keep in flight
+ *
+ * returns:
+ *      A reader's direct I/O descriptor, to be closed with direct_close().
+ *
+ * This function does not return on error.
+ */
+struct direct_io *
+direct_open(struct state *state, long int depth)
+{
+	struct direct_io *dio;	// Descriptor to return
+	struct stat st;		// randdata status
+	int sector;		// Logical block size of a block device
+	long int i;
+
+	/*
+	 * Check preconditions (firewall)
+	 */
+	if (state == NULL) {
+		err(86, __func__, "state arg is NULL");
+	}
+	if (depth < 1) {
+		err(86, __func__, "depth arg: %ld must be >= 1", depth);
+	}
+	dio = calloc(1, sizeof(*dio));
+	if (dio == NULL) {
+		errp(86, __func__, "cannot calloc a direct I/O descriptor");
+	}
+	dio->state = state;
+	dio->depth = depth;
+	dio->bytes = transform_bytes(state);
+
+	/*
+	 * Open randdata around the page cache if the file system lets us
+	 */
+	dio->fd = -1;
+#if defined(O_DIRECT)
+	dio->fd = open(state->randomDataPath, O_RDONLY | O_DIRECT);
+	if (dio->fd >= 0) {
+		dio->direct = true;
+	} else if (errno != EINVAL) {
+		errp(86, __func__, "cannot open: %s", state->randomDataPath);
+	}
+#endif
+	if (dio->fd < 0) {
+		dio->fd = open(state->randomDataPath, O_RDONLY);
+		if (dio->fd < 0) {
+			errp(86, __func__, "cannot open: %s", state->randomDataPath);
+		}
+#if defined(F_NOCACHE)
+		dio->direct = (fcntl(dio->fd, F_NOCACHE, 1) == 0);
+#endif
+	}
+	if (dio->direct == false) {
+		dbg(DBG_LOW, "%s does not support direct I/O, reading it through the page cache", state->randomDataPath);
+	}
+
+	/*
+	 * Reads must be aligned to the logical block size of a device, or at least DIRECT_ALIGN
+	 */
+	dio->align = DIRECT_ALIGN;
+	if (fstat(dio->fd, &st) == 0 && S_ISBLK(st.st_mode)) {
+#if defined(BLKSSZGET)
+		if (ioctl(dio->fd, BLKSSZGET, &sector) == 0 && sector > dio->align) {
+			dio->align = sector;
+		}
+#endif
+	}
+	dio->span = ((dio->align - 1 + dio->bytes + dio->align - 1) / dio->align) * dio->align;
+
+	/*
+	 * Allocate the aligned buffers
+	 */
+	dio->buf = calloc((size_t) depth, sizeof(dio->buf[0]));
+	dio->start = calloc((size_t) depth, sizeof(dio->start[0]));
+	dio->skip = calloc((size_t) depth, sizeof(dio->skip[0]));
+	dio->len = calloc((size_t) depth, sizeof(dio->len[0]));
+	dio->got = calloc((size_t) depth, sizeof(dio->got[0]));
+	if (dio->buf == NULL || dio->start == NULL || dio->skip == NULL || dio->len == NULL || dio->got == NULL) {
+		errp(86, __func__, "cannot calloc %ld direct I/O buffer descriptors", depth);
+	}
+	for (i = 0; i < depth; i++) {
+		errno = posix_memalign((void **) &dio->buf[i], (size_t) dio->align, (size_t) dio->span);
+		if (errno != 0) {
+			errp(86, __func__, "cannot allocate a %ld byte direct I/O buffer", dio->span);
+		}
+		dio->got[i] = 0;
+	}
+
+	/*
+	 * Queue the reads with io_uring if we can
+	 */
+#if defined(HAVE_IO_URING)
+	uring_setup(dio);
+#endif
+
+	return dio;
+}
+
+
+/*
+ * direct_read - start reading the bitstream at a file offset into a buffer
+ *
+ * given:
+ *      dio             // direct I/O descriptor
+ *      buf             // buffer to read into, 0 <= buf < depth, not in flight
+ *      offset          // byte offset of the bitstream in randdata
+ *
+ * Without io_uring the read is done before returning.
+ *
+ * This function does not return on error.
+ */
+void
+direct_read(struct direct_io *dio, long int buf, long int offset)
+{
+	/*
+	 * Check preconditions (firewall)
+	 */
+	if (dio == NULL) {
+		err(87, __func__, "dio arg is NULL");
+	}
+	if (buf < 0 || buf >= dio->depth) {
+		err(87, __func__, "buf arg: %ld must be in the range [0, %ld)", buf, dio->depth);
+	}
+	if (dio->got[buf] < 0) {
+		err(87, __func__, "buffer %ld is already being read", buf);
+	}
+	if (offset < 0) {
+		err(87, __func__, "offset arg: %ld must be >= 0", offset);
+	}
+
+	/*
+	 * Read the aligned blocks around the bitstream
+	 */
+	dio->skip[buf] = offset % dio->align;
+	dio->start[buf] = (off_t) (offset - dio->skip[buf]);
+	dio->len[buf] = ((dio->skip[buf] + dio->bytes + dio->align - 1) / dio->align) * dio->align;
+	dio->got[buf] = -1;
+#if defined(HAVE_IO_URING)
+	if (uring_submit(dio, buf) == true) {
+		return;
+	}
+#endif
+	dio->got[buf] = 0;
+	direct_fill(dio, buf);
+}
+
+
+/*
+ * direct_wait - wait for a buffer to be read
+ *
+ * given:
+ *      dio             // direct I/O descriptor
+ *      buf             // buffer given to direct_read()
+ *
+ * returns:
+ *      The first byte of the bitstream in the buffer, valid until the buffer is read into again.
+ *
+ * This function does not return on error, or if randdata ends before the bitstream.
+ */
+BYTE *
+direct_wait(struct direct_io *dio, long int buf)
+{
+	/*
+	 * Check preconditions (firewall)
+	 */
+	if (dio == NULL) {
+		err(88, __func__, "dio arg is NULL");
+	}
+	if (buf < 0 || buf >= dio->depth) {
+		err(88, __func__, "buf arg: %ld must be in the range [0, %ld)", buf, dio->depth);
+	}
+
+#if defined(HAVE_IO_URING)
+	while (dio->got[buf] < 0) {
+		uring_reap(dio, true);
+	}
+#endif
+
+	/*
+	 * Finish short reads
+	 */
+	direct_fill(dio, buf);
+
+	return dio->buf[buf] + dio->skip[buf];
+}
+
+
+/*
+ * direct_fill - read with pread(2) what is missing from a buffer
+ *
+ * given:
+ *      dio             // direct I/O descriptor
+ *      buf             // buffer that is not in flight
+ *
+ * This function does not return on error, or if randdata ends before the bitstream.
+ */
+static void
+direct_fill(struct direct_io *dio, long int buf)
+{
+	struct state *state = dio->state;
+	ssize_t ret;		// pread return value
+	long int need;		// Bytes needed to hold the bitstream
+
+	need = dio->skip[buf] + dio->bytes;
+	while (dio->got[buf] < need) {
+
+		/*
+		 * A direct read only ends off a block boundary at the end of the file
+		 */
+		if (dio->direct == true && dio->got[buf] % dio->align != 0) {
+			break;
+		}
+		ret = pread(dio->fd, dio->buf[buf] + dio->got[buf], (size_t) (dio->len[buf] - dio->got[buf]),
+			    dio->start[buf] + dio->got[buf]);
+		if (ret < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			errp(89, __func__, "read error while reading file: %s", state->randomDataPath);
+		} else if (ret == 0) {
+			break;
+		}
+		dio->got[buf] += ret;
+	}
+	if (dio->got[buf] < need) {
+		err(89, __func__, "encounted EOF (end of file) while reading file: %s: %lu bits were read before EOF",
+		    state->randomDataPath, (unsigned long) MAX(dio->got[buf] - dio->skip[buf], 0) * BITS_N_BYTE);
+	}
+}
+
+
+/*
+ * direct_close - close randdata and free a reader's buffers
+ *
+ * given:
+ *      dio             // direct I/O descriptor, may be NULL
+ *
+ * NOTE: No reads may be in flight.
+ */
+void
+direct_close(struct direct_io *dio)
+{
+	long int i;
+
+	if (dio == NULL) {
+		return;
+	}
+
+#if defined(HAVE_IO_URING)
+	uring_teardown(dio);
+#endif
+	close(dio->fd);
+	for (i = 0; i < dio->depth; i++) {
+		free(dio->buf[i]);
+	}
+	free(dio->buf);
+	free(dio->start);
+	free(dio->skip);
+	free(dio->len);
+	free(dio->got);
+	free(dio);
+}
+
+
+#if defined(HAVE_IO_URING)
+
+/*
+ * uring_setup - create the io_uring of a reader, if the kernel lets us
+ *
+ * given:
+ *      dio             // direct I/O descriptor
+ *
+ * Leaves dio->ring_fd < 0 if io_uring cannot be used.
+ */
+static void
+uring_setup(struct direct_io *dio)
+{
+	struct io_uring_params p;	// ring parameters, filled in by the kernel
+	long int ret;			// system call return value
+
+	dio->ring_fd = -1;
+	memset(&p, 0, sizeof(p));
+	ret = syscall(__NR_io_uring_setup, (unsigned) dio->depth, &p);
+	if (ret < 0) {
+		dbg(DBG_LOW, "io_uring is not available: %s, reading with pread", strerror(errno));
+		return;
+	}
+	dio->ring_fd = (int) ret;
+
+	/*
+	 * Map the rings and the submission queue entries
+	 */
+	dio->sq_len = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+	dio->cq_len = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+	if (p.features & IORING_FEAT_SINGLE_MMAP) {
+		dio->sq_len = MAX(dio->sq_len, dio->cq_len);
+		dio->cq_len = 0;
+	}
+	dio->sq_ptr = mmap(NULL, dio->sq_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, dio->ring_fd,
+			   IORING_OFF_SQ_RING);
+	if (dio->sq_ptr == MAP_FAILED) {
+		errp(86, __func__, "cannot mmap the io_uring submission queue");
+	}
+	dio->cq_ptr = dio->sq_ptr;
+	if (dio->cq_len > 0) {
+		dio->cq_ptr = mmap(NULL, dio->cq_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, dio->ring_fd,
+				   IORING_OFF_CQ_RING);
+		if (dio->cq_ptr == MAP_FAILED) {
+			errp(86, __func__, "cannot mmap the io_uring completion queue");
+		}
+	}
+	dio->sqes_len = p.sq_entries * sizeof(struct io_uring_sqe);
+	dio->sqes = mmap(NULL, dio->sqes_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, dio->ring_fd,
+			 IORING_OFF_SQES);
+	if (dio->sqes == MAP_FAILED) {
+		errp(86, __func__, "cannot mmap the io_uring submission queue entries");
+	}
+	dio->sq_tail = (unsigned *) ((char *) dio->sq_ptr + p.sq_off.tail);
+	dio->sq_mask = (unsigned *) ((char *) dio->sq_ptr + p.sq_off.ring_mask);
+	dio->sq_array = (unsigned *) ((char *) dio->sq_ptr + p.sq_off.array);
+	dio->cq_head = (unsigned *) ((char *) dio->cq_ptr + p.cq_off.head);
+	dio->cq_tail = (unsigned *) ((char *) dio->cq_ptr + p.cq_off.tail);
+	dio->cq_mask = (unsigned *) ((char *) dio->cq_ptr + p.cq_off.ring_mask);
+	dio->cqes = (struct io_uring_cqe *) ((char *) dio->cq_ptr + p.cq_off.cqes);
+	dbg(DBG_MED, "reading %s with io_uring, %ld reads in flight", dio->state->randomDataPath, dio->depth);
+}
+
+
+/*
+ * uring_submit - queue the read of a buffer
+ *
+ * given:
+ *      dio             // direct I/O descriptor
+ *      buf             // buffer whose start, len were set and got is -1
+ *
+ * returns:
+ *      true ==> the read was queued, false ==> read it with pread
+ *
+ * NOTE: Never more than depth reads are in flight, so the submission queue cannot be full.
+ */
+static bool
+uring_submit(struct direct_io *dio, long int buf)
+{
+	struct io_uring_sqe *sqe;	// entry to fill
+	unsigned tail;			// submission queue tail
+	unsigned index;			// entry of the tail
+	long int ret;			// system call return value
+
+	if (dio->ring_fd < 0) {
+		return false;
+	}
+
+	/*
+	 * Fill and publish the submission queue entry
+	 */
+	tail = *dio->sq_tail;
+	index = tail & *dio->sq_mask;
+	sqe = &dio->sqes[index];
+	memset(sqe, 0, sizeof(*sqe));
+	sqe->opcode = IORING_OP_READ;
+	sqe->fd = dio->fd;
+	sqe->addr = (unsigned long) dio->buf[buf];
+	sqe->len = (unsigned) dio->len[buf];
+	sqe->off = (unsigned long long) dio->start[buf];
+	sqe->user_data = (unsigned long long) buf;
+	dio->sq_array[index] = index;
+	__atomic_store_n(dio->sq_tail, tail + 1, __ATOMIC_RELEASE);
+
+	/*
+	 * Hand it to the kernel
+	 */
+	do {
+		ret = syscall(__NR_io_uring_enter, dio->ring_fd, 1, 0, 0, NULL, 0);
+	} while (ret < 0 && errno == EINTR);
+	if (ret < 0) {
+		errp(87, __func__, "io_uring_enter failed to submit a read of %s", dio->state->randomDataPath);
+	}
+
+	return true;
+}
+
+
+/*
+ * uring_reap - collect finished reads
+ *
+ * given:
+ *      dio             // direct I/O descriptor
+ *      wait            // true ==> sleep until at least one read finishes
+ *
+ * A failed read is retried by direct_fill() with pread, which reports the error if it persists.
+ */
+static void
+uring_reap(struct direct_io *dio, bool wait)
+{
+	struct io_uring_cqe *cqe;	// completion queue entry
+	unsigned head;			// completion queue head
+	unsigned tail;			// completion queue tail
+	long int buf;			// buffer a read was for
+	long int ret;			// system call return value
+
+	head = *dio->cq_head;
+	tail = __atomic_load_n(dio->cq_tail, __ATOMIC_ACQUIRE);
+	if (head == tail && wait == true) {
+		do {
+			ret = syscall(__NR_io_uring_enter, dio->ring_fd, 0, 1, IORING_ENTER_GETEVENTS, NULL, 0);
+		} while (ret < 0 && errno == EINTR);
+		if (ret < 0) {
+			errp(88, __func__, "io_uring_enter failed to wait for a read of %s", dio->state->randomDataPath);
+		}
+		tail = __atomic_load_n(dio->cq_tail, __ATOMIC_ACQUIRE);
+	}
+	for (; head != tail; head++) {
+		cqe = &dio->cqes[head & *dio->cq_mask];
+		buf = (long int) cqe->user_data;
+		if (buf >= 0 && buf < dio->depth) {
+			if (cqe->res < 0) {
+				dbg(DBG_HIGH, "io_uring read of %s failed: %s, retrying with pread",
+				    dio->state->randomDataPath, strerror(-cqe->res));
+			}
+			dio->got[buf] = MAX(cqe->res, 0);
+		}
+	}
+	__atomic_store_n(dio->cq_head, head, __ATOMIC_RELEASE);
+}
+
+
+/*
+ * uring_teardown - wait for reads in flight and destroy the io_uring of a reader
+ *
+ * given:
+ *      dio             // direct I/O descriptor
+ */
+static void
+uring_teardown(struct direct_io *dio)
+{
+	long int i;
+
+	if (dio->ring_fd < 0) {
+		return;
+	}
+	for (i = 0; i < dio->depth; i++) {
+		while (dio->got[i] < 0) {
+			uring_reap(dio, true);
+		}
+	}
+	munmap(dio->sqes, dio->sqes_len);
+	if (dio->cq_ptr != dio->sq_ptr) {
+		munmap(dio->cq_ptr, dio->cq_len);
+	}
+	munmap(dio->sq_ptr, dio->sq_len);
+	close(dio->ring_fd);
+	dio->ring_fd = -1;
+}
+
+#endif				/* HAVE_IO_URING */
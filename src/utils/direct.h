@@ -0,0 +1,44 @@
+/*****************************************************************************
+ D I R E C T  I / O  F U N C T I O N  P R O T O T Y P E S
+ *****************************************************************************/
+
+/*
+ * This code has been heavily modified by the following people:
+ *
+ *      Landon Curt Noll
+ *      Tom Gilgan
+ *      Riccardo Paccagnella
+ *
+ * See the README.md and the initial comment in sts.c for more information.
+ *
+ * WE (THOSE LISTED ABOVE WHO HEAVILY MODIFIED THIS CODE) DISCLAIM ALL
+ * WARRANTIES WITH REGARD TO THIS SOFTWARE, INCLUDING ALL IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL WE (THOSE LISTED ABOVE
+ * WHO HEAVILY MODIFIED THIS CODE) BE LIABLE FOR ANY SPECIAL, INDIRECT OR
+ * CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF
+ * USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ *
+ * chongo (Landon Curt Noll, http://www.isthe.com/chongo/index.html) /\oo/\
+ *
+ * Share and enjoy! :-)
+ */
+
+#ifndef DIRECT_H
+#   define DIRECT_H
+
+#   include "defs.h"
+
+#   define DIRECT_ALIGN (4096)	// minimum alignment of direct reads, in bytes
+
+struct direct_io;		// opaque, see direct.c
+
+extern bool direct_wanted(struct state *state);
+extern long int direct_size(struct state *state);
+extern struct direct_io *direct_open(struct state *state, long int depth);
+extern void direct_read(struct direct_io *dio, long int buf, long int offset);
+extern BYTE *direct_wait(struct direct_io *dio, long int buf);
+extern void direct_close(struct direct_io *dio);
+
+#endif				/* DIRECT_H */
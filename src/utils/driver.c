@@ -36,6 +36,7 @@
 
 // Exit codes: 50 thru 59
 
+#define _GNU_SOURCE
 #include <stdio.h>
 #include <stdlib.h>
 #include <math.h>
@@ -44,6 +45,13 @@
 #include <errno.h>
 #include "defs.h"
 #include "utilities.h"
+#include "checkpoint.h"
+#include "arena.h"
+#include "writer.h"
+#include "reader.h"
+#include "memo.h"
+#include "timing.h"
+#include "validate.h"
 #include "debug.h"
 #include "stat_fncs.h"
 
@@ -55,7 +63,7 @@ extern long int debuglevel;	// -v lvl: defines the level of verbosity for debugg
 struct driver {
 	void (*init) (struct state *state);			// Initialize the test and check input size recommendations
 	void (*iterate) (struct thread_state * thread_state);	// Perform a single iteration test on the bitstream
-	void (*print) (struct state *state);			// Log iteration info into stats.txt, data*.txt, results.txt if -s
+	void (*print) (struct state *state, long int first, long int last);	// Log iterations into stats.txt, data*.txt, results.txt if -s
 	void (*metrics) (struct state *state);			// Uniformity and proportional analysis of a test
 	void (*destroy) (struct state *state);			// Final test cleanup and memory de-allocation
 };
@@ -195,6 +203,13 @@ static const struct driver testDriver[NUMOFTESTS + 1] = {
  * Forward static function declarations
  */
 static void finishMetricTestsSentence(test_metric_result result, struct state *state);
+static void memoryPlan(struct state *state);
+static void sweepInit(struct state *state);
+static void statsIterationInit(struct state *state);
+static double testCost(struct state *state, enum test test);
+static int taskOrder(const void *a, const void *b);
+static void taskPlan(struct state *state);
+static void clearResults(struct state *state);
 
 /*
  * Init - initialize the variables needed for each test and check if the input size recommendations are respected
@@ -206,7 +221,9 @@ void
 init(struct state *state)
 {
 	int test_count;		// Number of tests enabled after initialization
+	uint64_t start;		// Ticks when the init phase started
 	int i;
+	long int j;
 
 	/*
 	 * Check preconditions (firewall)
@@ -218,6 +235,8 @@ init(struct state *state)
 		err(50, __func__, "state->workDir is NULL");
 	}
 	dbg(DBG_LOW, "Start of init phase");
+	timing_init(state);
+	start = timing_start();
 
 	/*
 	 * Prepare the top of the working directory
@@ -321,6 +340,28 @@ init(struct state *state)
 	 */
 	state->cSetup = true;
 
+	/*
+	 * Create the per thread arenas the tests carve their scratch buffers from
+	 */
+	arena_create(state);
+
+	/*
+	 * Create the per thread overlapping pattern counts, sized by the tests that use them
+	 */
+	state->patterns = calloc((size_t) state->numberOfThreads, sizeof(state->patterns[0]));
+	if (state->patterns == NULL) {
+		errp(50, __func__, "cannot calloc for patterns: %ld elements of %lu bytes each", state->numberOfThreads,
+		     sizeof(state->patterns[0]));
+	}
+
+	/*
+	 * Set up a run state for each -W parameter set
+	 *
+	 * The test inits clear resultsReserved when a result array is too large to reserve up front.
+	 */
+	state->resultsReserved = true;
+	sweepInit(state);
+
 	/*
 	 * Initialize all active tests
 	 */
@@ -329,6 +370,9 @@ init(struct state *state)
 			testDriver[i].init(state);
 		}
 	}
+	for (j = 0; j < state->sweepCount; j++) {
+		testDriver[state->sweepTest[j]].init(&state->sweep[j]);
+	}
 
 	/*
 	 * Some tests may have disabled themselves, be sure we have at least one enabled test
@@ -354,11 +398,39 @@ init(struct state *state)
 		err(50, __func__, "bogus value n: %ld, must be >= %d", state->tp.n, GLOBAL_MIN_BITCOUNT);
 	}
 
+	/*
+	 * Under -G team, decide how many threads test each bitstream and split its tests between them
+	 */
+	if (state->runMode != MODE_ASSESS_ONLY) {
+		taskPlan(state);
+	}
+
 	/*
 	 * Set the number of iterations not done yet to be equal to the total numOfBitstreams
 	 */
 	state->iterationsMissing = state->tp.numOfBitStreams;
 
+	/*
+	 * Now that the tests are sized for the whole run, fit the results in the -M memlimit budget
+	 * before they are reserved, or read back from a checkpoint file
+	 */
+	memoryPlan(state);
+
+	/*
+	 * Under -s, note the iteration of each stats record, for the writer to put them in order
+	 */
+	statsIterationInit(state);
+	for (j = 0; j < state->sweepCount; j++) {
+		statsIterationInit(&state->sweep[j]);
+	}
+
+	/*
+	 * Open the checkpoint file if -k or -r was given, skipping the iterations it already covers
+	 */
+	if (state->runMode != MODE_ASSESS_ONLY) {
+		checkpoint_open(state);
+	}
+
 	/*
 	 * Allocate the array for the bit streams copied to memory
 	 */
@@ -369,25 +441,435 @@ init(struct state *state)
 	}
 
 	/*
-	 * Allocate the array for the bit stream copied to memory for each thread
+	 * Each thread tests the bit stream in the ring slot the readers filled (see reader.c),
+	 * so epsilon[i] only points at a bit stream while thread i performs an iteration.
+	 * The -W parameter sets test the same bit streams.
 	 */
-	for (i = 0; i < state->numberOfThreads; i++) {
-		state->epsilon[i] = calloc((size_t) state->tp.n, sizeof(BitSequence));
-		if (state->epsilon == NULL) {
-			errp(50, __func__, "cannot calloc for epsilon[%d]: %ld elements of %lu bytes each", i,
-			     state->tp.n, sizeof(BitSequence));
-		}
+	for (j = 0; j < state->sweepCount; j++) {
+		state->sweep[j].epsilon = state->epsilon;
 	}
 
+	/*
+	 * Under -V, set up the run states each thread compares the results of its bitstreams with
+	 */
+	validate_init(state);
+
 	/*
 	 * Report the end of the init phase
 	 */
+	timing_stop(NULL, TIMING_INIT, start);
 	dbg(DBG_LOW, "End of init phase\n");
 
 	return;
 }
 
 
+/*
+ * statsIterationInit - create the arrays of the iteration of each stats record
+ *
+ * given:
+ *      state           // run state, with its tests initialized
+ *
+ * Each array is reserved like the stats array it describes.
+ *
+ * This function does not return on error.
+ */
+static void
+statsIterationInit(struct state *state)
+{
+	int i;
+
+	for (i = 1; i <= NUMOFTESTS; i++) {
+		if (state->testVector[i] == true && state->stats[i] != NULL) {
+			state->statsIteration[i] = create_dyn_array(sizeof(long int), DEFAULT_CHUNK,
+								    state->stats[i]->allocated, false);
+		}
+	}
+}
+
+
+/*
+ * sweepInit - set up a run state for each -W parameter set
+ *
+ * given:
+ *      state           // current processing state, with the test constants and arenas set up
+ *
+ * Each parameter set is a copy of state in which the only test enabled is the one whose
+ * parameter it changes, under a name such as Serial-P5=14.  The copies share the bit streams,
+ * the per thread arenas and pattern counts and the final results file of state, so each bit
+ * stream is read and unpacked once for the tests and all of their parameter sets.
+ *
+ * This function does not return on error.
+ */
+static void
+sweepInit(struct state *state)
+{
+	struct state *sweep;	// Run state of a parameter set
+	char *name;		// Name of the test of a parameter set
+	enum test test;		// Test whose parameter a parameter set changes
+	int i;
+	long int j;
+
+	/*
+	 * Check preconditions (firewall)
+	 */
+	if (state == NULL) {
+		err(56, __func__, "state arg is NULL");
+	}
+	if (state->sweepCount <= 0) {
+		return;
+	}
+
+	state->sweep = calloc((size_t) state->sweepCount, sizeof(state->sweep[0]));
+	if (state->sweep == NULL) {
+		errp(56, __func__, "cannot calloc for %ld parameter sets", state->sweepCount);
+	}
+	for (j = 0; j < state->sweepCount; j++) {
+		sweep = &state->sweep[j];
+		test = state->sweepTest[j];
+
+		/*
+		 * Start from the run state, with only the test of the parameter set enabled
+		 */
+		*sweep = *state;
+		sweep->sweepCount = 0;
+		sweep->sweep = NULL;
+		sweep->sweepInstance = true;
+		for (i = 1; i <= NUMOFTESTS; i++) {
+			sweep->testVector[i] = (i == (int) test);
+		}
+
+		/*
+		 * Change the parameter
+		 */
+		switch (state->sweepParam[j]) {
+		case PARAM_blockFrequencyBlockLength:
+			sweep->tp.blockFrequencyBlockLength = state->sweepValue[j];
+			break;
+		case PARAM_nonOverlappingTemplateBlockLength:
+			sweep->tp.nonOverlappingTemplateLength = state->sweepValue[j];
+			break;
+		case PARAM_overlappingTemplateBlockLength:
+			sweep->tp.overlappingTemplateLength = state->sweepValue[j];
+			break;
+		case PARAM_approximateEntropyBlockLength:
+			sweep->tp.approximateEntropyBlockLength = state->sweepValue[j];
+			break;
+		case PARAM_serialBlockLength:
+			sweep->tp.serialBlockLength = state->sweepValue[j];
+			break;
+		case PARAM_linearComplexitySequenceLength:
+			sweep->tp.linearComplexitySequenceLength = state->sweepValue[j];
+			break;
+		default:
+			err(56, __func__, "-W parameter: %ld is not a block length", state->sweepParam[j]);
+			break;
+		}
+
+		/*
+		 * Name the test after the parameter set, its results.txt and stats.txt go under that name
+		 */
+		if (asprintf(&name, "%s-P%ld=%ld", state->testNames[test], state->sweepParam[j], state->sweepValue[j]) < 0) {
+			errp(56, __func__, "asprintf of parameter set name failed");
+		}
+		sweep->testNames[test] = name;
+		dbg(DBG_MED, "parameter set %ld will test %s[%d]", j + 1, name, test);
+	}
+
+	return;
+}
+
+
+/*
+ * testCost - estimate the cost of testing one bitstream
+ *
+ * given:
+ *      state           // run state of the test, with the test initialized
+ *      test            // test to estimate
+ *
+ * returns:
+ *      Rough number of bit operations one iteration of the test takes.
+ *
+ * Only the ratios between tests matter: they decide how tests are split between the threads
+ * of a -G team, not how long the run takes.
+ */
+static double
+testCost(struct state *state, enum test test)
+{
+	double n = (double) state->tp.n;
+
+	switch (test) {
+	case TEST_DFT:
+		return n * log2(n);
+	case TEST_NON_OVERLAPPING:
+		return n * (double) state->partitionCount[test];	// a pass over the bits for each template
+	case TEST_LINEARCOMPLEXITY:
+		return n * (double) state->tp.linearComplexitySequenceLength / 8.0;	// Berlekamp-Massey, on bytes
+	case TEST_RANK:
+		return 4.0 * n;
+	case TEST_CUSUM:
+	case TEST_RUNS:
+	case TEST_APEN:
+	case TEST_SERIAL:
+	case TEST_RND_EXCURSION:
+	case TEST_RND_EXCURSION_VAR:
+		return 2.0 * n;
+	default:
+		return n;
+	}
+}
+
+
+/*
+ * taskOrder - qsort comparator putting the most costly tasks first
+ */
+static int
+taskOrder(const void *a, const void *b)
+{
+	const struct task *x = (const struct task *) a;
+	const struct task *y = (const struct task *) b;
+
+	if (x->cost != y->cost) {
+		return (x->cost < y->cost) ? 1 : -1;
+	}
+	return (int) x->test - (int) y->test;
+}
+
+
+/*
+ * taskPlan - decide how many threads test each bitstream and split its tests between them
+ *
+ * given:
+ *      state           // current processing state, with the tests initialized
+ *
+ * Without -G team, or when the team is a single thread, each thread tests its own bitstreams
+ * with all the enabled tests, as sts always has.  Otherwise the enabled tests of the run and of
+ * its -W parameter sets become the tasks of each bitstream, listed by decreasing cost so that
+ * the threads of a team, each taking the next task no one took yet, finish close together.
+ *
+ * Under -G 0 the team size t comes from an estimate of the time to test all bitstreams:
+ * numberOfThreads/t bitstreams are tested at once, each taking the larger of the cost of its
+ * tests over t and the cost of its most costly test.  The smallest team with the lowest
+ * estimate wins, so a thread per bitstream is kept while there are bitstreams for every thread.
+ *
+ * This function does not return on error.
+ */
+static void
+taskPlan(struct state *state)
+{
+	double total = 0.0;	// Cost of all tasks of a bitstream
+	double estimate;	// Estimated cost of the run with a given team size
+	double best = 0.0;	// Lowest estimate so far
+	long int rounds;	// Bitstreams each team tests
+	long int team;		// Team size being considered
+	long int i;
+	long int j;
+
+	/*
+	 * Check preconditions (firewall)
+	 */
+	if (state == NULL) {
+		err(57, __func__, "state arg is NULL");
+	}
+	if (state->teamFlag == false) {
+		return;
+	}
+
+	/*
+	 * List the tasks of a bitstream, by decreasing cost
+	 */
+	state->tasks = calloc((size_t) (NUMOFTESTS + state->sweepCount), sizeof(state->tasks[0]));
+	if (state->tasks == NULL) {
+		errp(57, __func__, "cannot calloc for %ld tasks", NUMOFTESTS + state->sweepCount);
+	}
+	state->taskCount = 0;
+	for (i = 1; i <= NUMOFTESTS; i++) {
+		if (state->testVector[i] == true && testDriver[i].iterate != NULL) {
+			state->tasks[state->taskCount].state = state;
+			state->tasks[state->taskCount].test = (enum test) i;
+			state->tasks[state->taskCount].cost = testCost(state, (enum test) i);
+			++state->taskCount;
+		}
+	}
+	for (j = 0; j < state->sweepCount; j++) {
+		if (state->sweep[j].testVector[state->sweepTest[j]] == true) {
+			state->tasks[state->taskCount].state = &state->sweep[j];
+			state->tasks[state->taskCount].test = state->sweepTest[j];
+			state->tasks[state->taskCount].cost = testCost(&state->sweep[j], state->sweepTest[j]);
+			++state->taskCount;
+		}
+	}
+	qsort(state->tasks, (size_t) state->taskCount, sizeof(state->tasks[0]), taskOrder);
+	for (i = 0; i < state->taskCount; i++) {
+		total += state->tasks[i].cost;
+		dbg(DBG_HIGH, "task %ld: %s[%d] estimated at %.0f bit operations", i,
+		    state->tasks[i].state->testNames[state->tasks[i].test], state->tasks[i].test, state->tasks[i].cost);
+	}
+
+	/*
+	 * Under -G 0, pick the team size with the lowest estimated cost
+	 */
+	if (state->teamSize == 0) {
+		state->teamSize = 1;
+		for (team = 1; team <= MIN(state->numberOfThreads, state->taskCount); team++) {
+			rounds = (state->tp.numOfBitStreams + state->numberOfThreads / team - 1) / (state->numberOfThreads / team);
+			estimate = (double) rounds * MAX(total / (double) team, state->tasks[0].cost);
+			dbg(DBG_MED, "teams of %ld threads: %ld bitstreams each, estimated at %.0f bit operations",
+			    team, rounds, estimate);
+			if (team == 1 || estimate < best) {
+				best = estimate;
+				state->teamSize = team;
+			}
+		}
+	}
+
+	/*
+	 * There is no use for more threads per bitstream than tasks, or for more teams than bitstreams
+	 */
+	state->teamSize = MAX(1, MIN(state->teamSize, MIN(state->numberOfThreads, state->taskCount)));
+	state->numberOfThreads = MIN(state->numberOfThreads, state->tp.numOfBitStreams * state->teamSize);
+	dbg(DBG_LOW, "each bitstream will be tested by %ld of %ld threads, %ld tasks per bitstream",
+	    state->teamSize, state->numberOfThreads, state->taskCount);
+
+	return;
+}
+
+
+/*
+ * memoryPlan - report the memory the run will use and enforce the -M memlimit budget
+ *
+ * given:
+ *      state           // current processing state, after the tests have been initialized
+ *
+ * The per thread scratch buffers cannot be moved out of memory, so they come off the budget first.
+ * Under -M, init leaves the p_val and stats arrays empty: if their size for the whole run does not
+ * fit in what is left, the largest ones are spilled to files under workDir until the rest does,
+ * and only then is each of them reserved for the whole run, so that the results that do not fit
+ * are never malloc'd.  metrics() and print() read the spilled results back through the page cache.
+ *
+ * This function does not return on error.
+ */
+static void
+memoryPlan(struct state *state)
+{
+	struct dyn_array *results[2 * (NUMOFTESTS + 1)];	// p_val and stats arrays of the enabled tests
+	char *results_kind[2 * (NUMOFTESTS + 1)];		// "p_val" or "stats"
+	int results_test[2 * (NUMOFTESTS + 1)];			// test of each of the results arrays
+	long int results_total[2 * (NUMOFTESTS + 1)];		// elements of each results array for the whole run
+	long int results_bytes[2 * (NUMOFTESTS + 1)];		// bytes of each results array for the whole run
+	int results_count = 0;		// Number of arrays in results
+	long int scratch = 0;		// Bytes of per thread scratch buffers
+	long int in_memory = 0;		// Bytes of results kept in memory
+	long int budget;		// Bytes of the -M memlimit budget left for results
+	char *name;			// Name of a spill file
+	char *path;			// Path of a spill file
+	int largest;			// Index of the largest array still in memory
+	int i;
+
+	/*
+	 * Add up the scratch buffers
+	 */
+	if (state->arena != NULL) {
+		for (i = 0; i < state->numberOfThreads; i++) {
+			scratch += (long int) state->arena[i].total;
+		}
+	}
+	if (state->testVector[TEST_RND_EXCURSION] == true && state->rnd_excursion_cycle != NULL) {
+		for (i = 0; i < state->numberOfThreads; i++) {
+			scratch += state->rnd_excursion_cycle[i]->allocated * (long int) state->rnd_excursion_cycle[i]->elm_size;
+		}
+	}
+	if (state->runMode != MODE_ASSESS_ONLY) {
+		scratch += reader_ring_size(state);
+	}
+	scratch += memo_bytes();
+
+	/*
+	 * Add up the results arrays
+	 */
+	for (i = 1; i <= NUMOFTESTS; i++) {
+		if (state->testVector[i] != true) {
+			continue;
+		}
+		if (state->p_val[i] != NULL) {
+			results_kind[results_count] = "p_val";
+			results_test[results_count] = i;
+			results_total[results_count] = state->partitionCount[i];
+			results[results_count++] = state->p_val[i];
+		}
+		if (state->stats[i] != NULL) {
+			results_kind[results_count] = "stats";
+			results_test[results_count] = i;
+			results_total[results_count] = 1;
+			results[results_count++] = state->stats[i];
+		}
+	}
+	for (i = 0; i < results_count; i++) {
+		if (multiplication_will_overflow_long(results_total[i], state->tp.numOfBitStreams) ||
+		    multiplication_will_overflow_long(results_total[i] * state->tp.numOfBitStreams,
+						      (long int) results[i]->elm_size)) {
+			err(50, __func__, "%s results of test %s[%d] for %ld bitstreams would overflow a long",
+			    results_kind[i], state->testNames[results_test[i]], results_test[i], state->tp.numOfBitStreams);
+		}
+		results_total[i] = MAX(results_total[i] * state->tp.numOfBitStreams, results[i]->allocated);
+		results_bytes[i] = results_total[i] * (long int) results[i]->elm_size;
+		dbg(DBG_HIGH, "%s results of test %s[%d] will take %ld bytes", results_kind[i],
+		    state->testNames[results_test[i]], results_test[i], results_bytes[i]);
+		in_memory += results_bytes[i];
+	}
+	dbg(DBG_LOW, "memory plan: %ld bytes of scratch buffers, %ld bytes of results", scratch, in_memory);
+	if (state->memLimitFlag == false) {
+		return;
+	}
+
+	/*
+	 * Spill the largest results arrays until the rest fits in the budget
+	 */
+	budget = state->memLimit * 1024 * 1024 - scratch;
+	if (budget < 0) {
+		warn(__func__, "-M memlimit: %ld MiB is less than the %ld bytes of scratch buffers, spilling all results",
+		     state->memLimit, scratch);
+	}
+	while (in_memory > budget) {
+		largest = -1;
+		for (i = 0; i < results_count; i++) {
+			if (results[i]->fd < 0 && (largest < 0 || results_bytes[i] > results_bytes[largest])) {
+				largest = i;
+			}
+		}
+		if (largest < 0) {
+			break;
+		}
+
+		if (asprintf(&name, "sts.%04ld.%s.%s.spill", state->jobnum, state->testNames[results_test[largest]],
+			     results_kind[largest]) < 0) {
+			errp(50, __func__, "asprintf of spill file name failed");
+		}
+		path = filePathName(state->workDir, name);
+		in_memory -= results_bytes[largest];
+		spill_dyn_array(results[largest], path);
+		reserve_dyn_array(results[largest], results_total[largest]);
+		dbg(DBG_LOW, "spilled %s results of test %s[%d] to: %s", results_kind[largest],
+		    state->testNames[results_test[largest]], results_test[largest], path);
+		free(path);
+		free(name);
+	}
+	dbg(DBG_LOW, "memory plan: %ld bytes of results kept in memory under a budget of %ld bytes", in_memory, budget);
+
+	/*
+	 * Reserve the results kept in memory for the whole run
+	 */
+	for (i = 0; i < results_count; i++) {
+		if (results[i]->fd < 0) {
+			reserve_dyn_array(results[i], results_total[i]);
+		}
+	}
+	state->resultsReserved = true;
+
+	return;
+}
+
+
 /*
  * iterate - perform a single run of all the enabled tests on a bitstream
  *
@@ -397,6 +879,9 @@ init(struct state *state)
 void
 iterate(struct thread_state *thread_state)
 {
+	struct thread_state sweep_thread;	// thread_state of a -W parameter set
+	uint64_t start;				// ticks when a test started
+	long int j;
 	int i;
 
 	/*
@@ -410,6 +895,13 @@ iterate(struct thread_state *thread_state)
 		err(51, __func__, "state is NULL");
 	}
 
+	/*
+	 * The pattern counts are of the previous bitstream of this thread
+	 */
+	if (state->sweepInstance == false) {
+		forgetPatterns(state, thread_state->thread_id);
+	}
+
 	/*
 	 * Perform an iteration for each test on the current bitstream
 	 */
@@ -419,24 +911,118 @@ iterate(struct thread_state *thread_state)
 		 * Call test iterate function if the test is enabled
 		 */
 		if (state->testVector[i] == true && testDriver[i].iterate != NULL) {
-			testDriver[i].iterate(thread_state);
+			start = timing_start();
+			if (state->validate != NULL) {
+				validate_iterate(thread_state, (enum test) i, testDriver[i].iterate);
+			} else {
+				testDriver[i].iterate(thread_state);
+			}
+			timing_stop(thread_state, (enum timing) i, start);
 		}
 	}
 
+	/*
+	 * Perform an iteration for each -W parameter set on the same bitstream
+	 */
+	for (j = 0; j < state->sweepCount; j++) {
+		sweep_thread = *thread_state;
+		sweep_thread.global_state = &state->sweep[j];
+		iterate(&sweep_thread);
+	}
+
+	return;
+}
+
+
+/*
+ * iterate_task - perform one task of a bitstream tested by a -G team
+ *
+ * given:
+ *      thread_state    // state of the team thread, with its epsilon set to the bitstream
+ *      task            // index into state->tasks of the test to iterate
+ *
+ * NOTE: The team thread must call forgetPatterns() before its first task of each bitstream.
+ */
+void
+iterate_task(struct thread_state *thread_state, long int task)
+{
+	struct thread_state task_thread;	// thread_state of the run state of the task
+	uint64_t start;				// ticks when the task started
+
+	/*
+	 * Check preconditions (firewall)
+	 */
+	if (thread_state == NULL) {
+		err(58, __func__, "thread_state arg is NULL");
+	}
+	struct state *state = thread_state->global_state;
+	if (state == NULL) {
+		err(58, __func__, "state arg is NULL");
+	}
+	if (state->tasks == NULL || task < 0 || task >= state->taskCount) {
+		err(58, __func__, "task: %ld must be >= 0 and < %ld", task, state->taskCount);
+	}
+
+	task_thread = *thread_state;
+	task_thread.global_state = state->tasks[task].state;
+	start = timing_start();
+	if (task_thread.global_state->validate != NULL) {
+		validate_iterate(&task_thread, state->tasks[task].test, testDriver[state->tasks[task].test].iterate);
+	} else {
+		testDriver[state->tasks[task].test].iterate(&task_thread);
+	}
+	timing_stop(thread_state, (enum timing) state->tasks[task].test, start);
+
+	return;
+}
+
+
+/*
+ * print_iterations - print iterations of a test to results.txt, data*.txt, stats.txt
+ *
+ * given:
+ *      state           // current processing state
+ *      test            // test whose iterations to print
+ *      first           // first iteration to print
+ *      last            // print up to but not including this iteration
+ *
+ * NOTE: The files must have been opened by writer_open().
+ */
+void
+print_iterations(struct state *state, int test, long int first, long int last)
+{
+	/*
+	 * Check preconditions (firewall)
+	 */
+	if (state == NULL) {
+		err(52, __func__, "state arg is NULL");
+	}
+	if (test < 1 || test > NUMOFTESTS) {
+		err(52, __func__, "test arg: %d must be in the range [1, %d]", test, NUMOFTESTS);
+	}
+
+	if (state->testVector[test] == true && testDriver[test].print != NULL) {
+		testDriver[test].print(state, first, last);	// print iterations of a test
+	}
+
 	return;
 }
 
 
 /*
- * Print - print to results.txt, data*.txt, stats.txt for all iterations
+ * Print - finish printing to results.txt, data*.txt, stats.txt for all iterations
  *
  * given:
  *      state           // current processing state
+ *
+ * Under -s the writer thread prints iterations while they are being performed (see writer.c),
+ * so this only prints what is left and closes the files.
  */
 void
 print(struct state *state)
 {
-	int i;
+	uint64_t start;		// ticks when the print phase started
+	long int j;
 
 	/*
 	 * Check preconditions (firewall)
@@ -446,22 +1032,19 @@ print(struct state *state)
 	}
 
 	/*
-	 * Print results from each test
-	 *
-	 * or old code: partition results
+	 * Print what the writer did not print yet and close the files of each test
 	 */
 	dbg(DBG_LOW, "Start of print phase");
-	for (i = 1; i <= NUMOFTESTS; i++) {
-		if (state->testVector[i] == true) {
-			if (testDriver[i].print != NULL) {
-				testDriver[i].print(state);	// print results of a test
-			}
-		}
+	start = timing_start();
+	writer_close(state);
+	for (j = 0; j < state->sweepCount; j++) {
+		writer_close(&state->sweep[j]);
 	}
 
 	/*
 	 * Report the end of the print phase
 	 */
+	timing_stop(NULL, TIMING_PRINT, start);
 	dbg(DBG_LOW, "End of print phase\n");
 
 	return;
@@ -483,6 +1066,8 @@ metrics(struct state *state)
 	double p_hat;
 	int io_ret;		// I/O return status
 	bool is_first = false;
+	uint64_t start;		// ticks when the metrics phase started
+	long int j;
 	int i;
 
 	/*
@@ -491,6 +1076,26 @@ metrics(struct state *state)
 	if (state == NULL) {
 		err(53, __func__, "state arg is NULL");
 	}
+	start = timing_start();
+
+	/*
+	 * Each -W parameter set, and under -L manifest each source, gets its own section of the output file
+	 */
+	if (state->sweepInstance == true) {
+		for (i = 1; i < NUMOFTESTS && state->testVector[i] != true; i++) {
+			// find the only test enabled
+		}
+		io_ret = fprintf(state->finalRept, "\n\nParameter set: %s\n\n", state->testNames[i]);
+		if (io_ret <= 0) {
+			errp(53, __func__, "error in writing to finalRept");
+		}
+	} else if (state->manifestFlag == true) {
+		io_ret = fprintf(state->finalRept, "%sSource %ld of %ld listed in %s\n\n", state->source > 0 ? "\n\n" : "",
+				 state->source + 1, state->sourceCount, state->manifestPath);
+		if (io_ret <= 0) {
+			errp(53, __func__, "error in writing to finalRept");
+		}
+	}
 
 	/*
 	 * Print introductory information to the output files
@@ -1109,8 +1714,23 @@ metrics(struct state *state)
 	}
 
 	/*
-	 * Report the end of the metric phase
+	 * Assess each -W parameter set of this bitstream source
+	 */
+	for (j = 0; j < state->sweepCount; j++) {
+		if (state->sweep[j].testVector[state->sweepTest[j]] != true) {
+			continue;	// disabled by its init, say because the block length is too long
+		}
+		state->sweep[j].randomDataPath = state->randomDataPath;
+		state->sweep[j].source = state->source;
+		metrics(&state->sweep[j]);
+	}
+
+	/*
+	 * Report the end of the metric phase, the -W parameter sets are part of it
 	 */
+	if (state->sweepInstance == false) {
+		timing_stop(NULL, TIMING_METRICS, start);
+	}
 	dbg(DBG_LOW, "End of assess phase\n");
 	return;
 }
@@ -1146,6 +1766,95 @@ static void finishMetricTestsSentence(test_metric_result result, struct state *s
 	}
 }
 
+/*
+ * next_source - move on to the next source listed in a -L manifest
+ *
+ * given:
+ *      state           // current processing state
+ *
+ * returns:
+ *      true ==> the next source is open and ready to be iterated on
+ *      false ==> no -L manifest was given, or its last source has been tested
+ *
+ * What init() set up, the constants, templates, FFT plans, per thread scratch buffers and the
+ * number of threads, is kept for all sources.  Only the results of the source just tested
+ * are cleared, so the arrays sized by init() are reused without being allocated again.
+ */
+bool
+next_source(struct state *state)
+{
+	long int j;
+
+	/*
+	 * Check preconditions (firewall)
+	 */
+	if (state == NULL) {
+		err(55, __func__, "state arg is NULL");
+	}
+	if (state->manifestFlag == false || state->source + 1 >= state->sourceCount) {
+		return false;
+	}
+	if (state->streamFile != NULL) {
+		err(55, __func__, "randdata of source %ld is still open: %s", state->source + 1, state->randomDataPath);
+	}
+
+	/*
+	 * Clear the results of the source just tested
+	 */
+	clearResults(state);
+	for (j = 0; j < state->sweepCount; j++) {
+		clearResults(&state->sweep[j]);
+	}
+
+	/*
+	 * Open the randdata of the next source
+	 */
+	++state->source;
+	state->randomDataPath = state->sources[state->source];
+	for (j = 0; j < state->sweepCount; j++) {
+		state->sweep[j].source = state->source;
+		state->sweep[j].randomDataPath = state->randomDataPath;
+	}
+	dbg(DBG_LOW, "testing source %ld of %ld: %s", state->source + 1, state->sourceCount, state->randomDataPath);
+	generatorOptions(state);
+
+	return true;
+}
+
+
+/*
+ * clearResults - clear the test results of a run state so that another source can be tested
+ *
+ * given:
+ *      state           // run state of the main tests or of a -W parameter set
+ */
+static void
+clearResults(struct state *state)
+{
+	int i;
+
+	for (i = 1; i <= NUMOFTESTS; i++) {
+		if (state->testVector[i] != true) {
+			continue;
+		}
+		if (state->p_val[i] != NULL) {
+			clear_dyn_array(state->p_val[i]);
+		}
+		if (state->stats[i] != NULL) {
+			clear_dyn_array(state->stats[i]);
+		}
+		state->count[i] = 0;
+		state->valid[i] = 0;
+		state->success[i] = 0;
+		state->failure[i] = 0;
+		state->valid_p_val[i] = 0;
+	}
+	memset(&state->metric_results, 0, sizeof(state->metric_results));
+	state->successful_tests = 0;
+	state->iterationsMissing = state->tp.numOfBitStreams;
+}
+
+
 /*
  * destroy - free memory, undo init operations and other post processing
  *
@@ -1156,6 +1865,8 @@ void
 destroy(struct state *state)
 {
 	int io_ret;			// I/O return status
+	enum test test;			// Test of a -W parameter set
+	long int j;
 	int i;
 
 	/*
@@ -1181,6 +1892,11 @@ destroy(struct state *state)
 		}
 	}
 
+	/*
+	 * Under -E, the times of the run end the output file, under -Y the trace is written
+	 */
+	timing_report(state);
+
 	/*
 	 * Flush the output file buffer and close the file
 	 */
@@ -1197,6 +1913,16 @@ destroy(struct state *state)
 		}
 	}
 
+	/*
+	 * The results of this run are complete, its checkpoint file is no longer needed
+	 */
+	checkpoint_close(state);
+
+	/*
+	 * Under -V, report the comparisons with the reference implementation, exit if some results differ
+	 */
+	validate_report(state);
+
 	/*
 	 * Perform clean up for each test
 	 */
@@ -1210,6 +1936,26 @@ destroy(struct state *state)
 			testDriver[i].destroy(state);
 		}
 	}
+	for (j = 0; j < state->sweepCount; j++) {
+		test = state->sweepTest[j];
+		if (state->sweep[j].testVector[test] == true && testDriver[test].destroy != NULL) {
+			testDriver[test].destroy(&state->sweep[j]);
+		}
+		free(state->sweep[j].testNames[test]);
+	}
+	if (state->sweep != NULL) {
+		free(state->sweep);
+		state->sweep = NULL;
+	}
+	if (state->patterns != NULL) {
+		free(state->patterns);
+		state->patterns = NULL;
+	}
+	if (state->tasks != NULL) {
+		free(state->tasks);
+		state->tasks = NULL;
+	}
+	validate_free(state);
 
 	/*
 	 * Free global allocated storage
@@ -1222,16 +1968,11 @@ destroy(struct state *state)
 		free(state->tmpepsilon);
 		state->tmpepsilon = NULL;
 	}
-	for (i = 0; i < state->numberOfThreads; i++) {
-		if (state->epsilon[i] != NULL) {
-			free(state->epsilon[i]);
-			state->epsilon[i] = NULL;
-		}
-	}
 	if (state->epsilon != NULL) {
 		free(state->epsilon);
 		state->epsilon = NULL;
 	}
+	arena_destroy(state);
 	if (state->freqFilePath != NULL) {
 		free(state->freqFilePath);
 		state->freqFilePath = NULL;
@@ -1240,6 +1981,24 @@ destroy(struct state *state)
 		free(state->finalReptPath);
 		state->finalReptPath = NULL;
 	}
+	if (state->sources != NULL) {
+		for (i = 0; i < state->sourceCount; i++) {
+			free(state->sources[i]);
+		}
+		free(state->sources);
+		state->sources = NULL;
+		state->randomDataPath = NULL;
+	}
+	if (state->manifestPath != NULL) {
+		free(state->manifestPath);
+		state->manifestPath = NULL;
+	}
+	if (state->tracePath != NULL) {
+		free(state->tracePath);
+		state->tracePath = NULL;
+	}
+
+	timing_free();
 
 	/*
 	 * Report the end of the metric phase
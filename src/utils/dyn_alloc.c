@@ -24,12 +24,16 @@
  */
 
 
-// Exit codes: 60 thru 69
+// Exit codes: 60 thru 67
 
 #define _GNU_SOURCE
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
 #include "../utils/externs.h"
 #include "debug.h"
 #include "utilities.h"
@@ -38,30 +42,35 @@
 extern long int debuglevel;	// -v lvl: defines the level of verbosity for debugging
 
 
+/*
+ * Number of mallocs and reallocs made by dynamic arrays so far, updated atomically
+ */
+long int dyn_alloc_count = 0;
+
+
 /*
  * Forward static function declarations
  */
-static void grow_dyn_array(struct dyn_array *array, long int elms_to_allocate);
+static void resize_dyn_array(struct dyn_array *array, long int new_allocated);
+static void grow_dyn_array(struct dyn_array *array, long int elms_needed);
 
 
 /*
- * grow_dyn_array - grow the allocation of a dynamic array by a specified number of elements
+ * resize_dyn_array - change the allocation of a dynamic array to a given number of elements
  *
  * given:
  *      array           		pointer to the dynamic array
- *      elms_to_allocate	       	number of elements to allocate space for
+ *      new_allocated	       	number of elements to allocate space for, more than currently allocated
  *
- * The dynamic array allocation will be expanded by new_elem elements.  That data will
- * be zeroized according to the type.
+ * Any newly allocated space will be zeroized according to the type.
  *
  * This function does not return on error.
  */
 static void
-grow_dyn_array(struct dyn_array *array, long int elms_to_allocate)
+resize_dyn_array(struct dyn_array *array, long int new_allocated)
 {
 	void *data;			// Reallocated array
 	long int old_allocated;		// Old number of elements allocated
-	long int new_allocated;		// New number of elements allocated
 	long int old_bytes;		// Old size of data in dynamic array
 	long int new_bytes;		// New size of data in dynamic array after allocation
 	unsigned char *p;		// Pointer to the beginning of the new allocated space
@@ -72,8 +81,8 @@ grow_dyn_array(struct dyn_array *array, long int elms_to_allocate)
 	if (array == NULL) {
 		err(61, __func__, "array arg is NULL");
 	}
-	if (elms_to_allocate <= 0) {
-		err(61, __func__, "elms_to_allocate arg must be > 0: %ld", elms_to_allocate);
+	if (new_allocated <= array->allocated) {
+		err(61, __func__, "new_allocated arg: %ld must be > allocated: %ld", new_allocated, array->allocated);
 	}
 
 	/*
@@ -91,15 +100,7 @@ grow_dyn_array(struct dyn_array *array, long int elms_to_allocate)
 	if (array->count > array->allocated) {
 		err(61, __func__, "count: %ld in dynamic array must be <= allocated: %ld", array->count, array->allocated);
 	}
-
-	// firewall - check for overflow
 	old_allocated = array->allocated;
-	if (sum_will_overflow_long(old_allocated, elms_to_allocate)) {
-		err(61, __func__, "allocating %ld new elements would overflow the allocated counter (now %ld) of the dynamic "
-				    "array: %ld + %ld does not fit in a long int",
-		    elms_to_allocate, old_allocated, old_allocated, elms_to_allocate);
-	}
-	new_allocated = old_allocated + elms_to_allocate;
 
 	// firewall - check for size overflow
 	old_bytes = old_allocated * array->elm_size;
@@ -118,27 +119,83 @@ grow_dyn_array(struct dyn_array *array, long int elms_to_allocate)
 	}
 
 	/*
-	 * Reallocate array
+	 * Reallocate array, or extend the file and its mapping if the array was spilled to disk
 	 */
-	data = realloc(array->data, (size_t) new_bytes);
-	if (data == NULL) {
-		errp(61, __func__, "failed to reallocate the dynamic array from a size of %ld bytes to a size of %ld bytes",
-		     old_bytes, new_bytes);
+	if (array->fd >= 0) {
+		if (ftruncate(array->fd, (off_t) new_bytes) != 0) {
+			errp(61, __func__, "cannot extend spill file of dynamic array to %ld bytes", new_bytes);
+		}
+		data = mremap(array->data, (size_t) old_bytes, (size_t) new_bytes, MREMAP_MAYMOVE);
+		if (data == MAP_FAILED) {
+			errp(61, __func__, "failed to remap the spilled dynamic array from %ld bytes to %ld bytes",
+			     old_bytes, new_bytes);
+		}
+	} else {
+		data = realloc(array->data, (size_t) new_bytes);
+		if (data == NULL) {
+			errp(61, __func__, "failed to reallocate the dynamic array from a size of %ld bytes to a size of %ld bytes",
+			     old_bytes, new_bytes);
+		}
 	}
 
 	array->data = data;
 	array->allocated = new_allocated;
-	dbg(DBG_VHIGH, "expanded dynamic array with %ld new allocated elements of %lu bytes: the number of allocated elements "
+	__atomic_add_fetch(&dyn_alloc_count, 1, __ATOMIC_RELAXED);
+	dbg(DBG_VHIGH, "expanded dynamic array of %lu byte elements: the number of allocated elements "
 			    "went from %ld to %ld and the size went from %ld to %ld",
-	    elms_to_allocate, array->elm_size, old_allocated, array->allocated, old_bytes, new_bytes);
+	    array->elm_size, old_allocated, array->allocated, old_bytes, new_bytes);
 
 	/*
 	 * Zeroize new elements if needed
 	 */
 	if (array->zeroize == 1) {
 		p = (unsigned char *) (array->data) + old_bytes;
-		memset(p, 0, elms_to_allocate * array->elm_size);
+		memset(p, 0, (size_t) (new_bytes - old_bytes));
+	}
+
+	return;
+}
+
+
+/*
+ * grow_dyn_array - grow the allocation of a dynamic array to hold more elements
+ *
+ * given:
+ *      array           		pointer to the dynamic array
+ *      elms_needed		       	number of elements needed beyond those currently allocated
+ *
+ * The allocation at least doubles, so that appending one element at a time costs O(1) amortized
+ * instead of a realloc and copy every chunk elements.  The new allocation is a multiple of chunk.
+ *
+ * This function does not return on error.
+ */
+static void
+grow_dyn_array(struct dyn_array *array, long int elms_needed)
+{
+	long int new_allocated;		// New number of elements allocated
+
+	/*
+	 * Check preconditions (firewall) - sanity check args
+	 */
+	if (array == NULL) {
+		err(61, __func__, "array arg is NULL");
+	}
+	if (elms_needed <= 0) {
+		err(61, __func__, "elms_needed arg must be > 0: %ld", elms_needed);
+	}
+	if (array->chunk <= 0) {
+		err(61, __func__, "chunk in dynamic array must be > 0: %ld", array->chunk);
+	}
+
+	// firewall - check for overflow
+	if (sum_will_overflow_long(array->allocated, MAX(elms_needed, array->allocated) + array->chunk)) {
+		err(61, __func__, "allocating %ld new elements would overflow the allocated counter (now %ld) of the dynamic "
+				    "array", MAX(elms_needed, array->allocated), array->allocated);
 	}
+	new_allocated = array->allocated + MAX(elms_needed, array->allocated);
+	new_allocated = array->chunk * ((new_allocated + (array->chunk - 1)) / array->chunk);
+
+	resize_dyn_array(array, new_allocated);
 
 	return;
 }
@@ -245,6 +302,7 @@ create_dyn_array(size_t elm_size, long int chunk, long int start_elm_count, int
 	ret->count = 0;		// Allocated array is empty
 	ret->allocated = chunk * ((start_elm_count + (chunk - 1)) / chunk); // Allocate a number of elements multiple of chunk
 	ret->chunk = chunk;
+	ret->fd = -1;		// Array is in memory
 
 	// firewall - check for size overflow
 	if (multiplication_will_overflow_long(ret->allocated, elm_size)) {
@@ -264,6 +322,7 @@ create_dyn_array(size_t elm_size, long int chunk, long int start_elm_count, int
 		errp(62, __func__, "cannot malloc of %ld elements of %ld bytes each for dyn_array->data", ret->allocated,
 		     elm_size);
 	}
+	__atomic_add_fetch(&dyn_alloc_count, 1, __ATOMIC_RELAXED);
 
 	/*
 	 * Zeroize allocated data according to type
@@ -290,8 +349,6 @@ create_dyn_array(size_t elm_size, long int chunk, long int start_elm_count, int
  *
  * We will add a value of a given type onto the end of the dynamic array.
  * We will grow the dynamic array if all allocated values are used.
- * If after adding the value, all allocated values are used, we will grow
- * the dynamic array as a firewall.
  *
  * This function does not return on error.
  */
@@ -330,7 +387,7 @@ append_value(struct dyn_array *array, void *value_to_add)
 	 * Expand dynamic array if needed
 	 */
 	if (array->count == array->allocated) {
-		grow_dyn_array(array, array->chunk);
+		grow_dyn_array(array, 1);
 	}
 
 	/*
@@ -353,9 +410,7 @@ append_value(struct dyn_array *array, void *value_to_add)
  *      array_to_add_size 	// size of the array to add to the end of the dynamic array
  *
  * We will add the values of the given array (which are of a given type) onto the
- * end of the dynamic array. We will grow the dynamic array if all allocated values are used.
- * If after adding the values of the array, all allocated values are used, we will grow
- * the dynamic array as a firewall.
+ * end of the dynamic array. We will grow the dynamic array if there is not enough room for them.
  *
  * This function does not return on error.
  */
@@ -363,7 +418,6 @@ void
 append_array(struct dyn_array *array, void *array_to_add_p, long int total_elements_to_add)
 {
 	long int available_empty_elements;
-	long int required_elements_to_allocate;
 	unsigned char *p;
 
 	/*
@@ -396,10 +450,8 @@ append_array(struct dyn_array *array, void *array_to_add_p, long int total_eleme
 	 * Expand dynamic array if needed
 	 */
 	available_empty_elements = array->allocated - array->count;
-	required_elements_to_allocate = array->chunk *
-			((total_elements_to_add - available_empty_elements + (array->chunk - 1)) / array->chunk);
-	if (available_empty_elements <= total_elements_to_add) {
-		grow_dyn_array(array, required_elements_to_allocate);
+	if (available_empty_elements < total_elements_to_add) {
+		grow_dyn_array(array, total_elements_to_add - available_empty_elements);
 	}
 
 	/*
@@ -413,6 +465,158 @@ append_array(struct dyn_array *array, void *array_to_add_p, long int total_eleme
 }
 
 
+/*
+ * reserve_dyn_array - make room in a dynamic array for a total number of elements
+ *
+ * given:
+ *      array           	// pointer to the dynamic array
+ *      total_elements		// number of elements, including those already in the array, to make room for
+ *
+ * When the final size of an array is known, reserving it up front means that no later
+ * append will have to reallocate and copy the array.  Unlike growth by append, the
+ * allocation is only rounded up to a multiple of chunk, it is not doubled.
+ *
+ * This function does not return on error.
+ */
+void
+reserve_dyn_array(struct dyn_array *array, long int total_elements)
+{
+	/*
+	 * Check preconditions (firewall) - sanity check args
+	 */
+	if (array == NULL) {
+		err(65, __func__, "array arg is NULL");
+	}
+	if (total_elements < 0) {
+		err(65, __func__, "total_elements arg must be >= 0: %ld", total_elements);
+	}
+	if (array->chunk <= 0) {
+		err(65, __func__, "chunk in dynamic array must be > 0: %ld", array->chunk);
+	}
+
+	/*
+	 * Grow to exactly what was asked for, rounded to chunk, if it does not fit already
+	 */
+	if (total_elements > array->allocated) {
+		if (sum_will_overflow_long(total_elements, array->chunk - 1)) {
+			err(65, __func__, "reserving %ld elements would overflow the allocated counter", total_elements);
+		}
+		resize_dyn_array(array, array->chunk * ((total_elements + (array->chunk - 1)) / array->chunk));
+	}
+
+	return;
+}
+
+
+/*
+ * drop_dyn_array - remove elements from the front of a dynamic array
+ *
+ * given:
+ *      array           	// pointer to the dynamic array
+ *      count			// number of leading elements to remove
+ *
+ * The remaining elements are moved to the front of the array.  The allocation is kept,
+ * so an array that is consumed about as fast as it is appended to keeps reusing the
+ * same few pages.
+ *
+ * This function does not return on error.
+ */
+void
+drop_dyn_array(struct dyn_array *array, long int count)
+{
+	/*
+	 * Check preconditions (firewall) - sanity check args
+	 */
+	if (array == NULL) {
+		err(67, __func__, "array arg is NULL");
+	}
+	if (count < 0 || count > array->count) {
+		err(67, __func__, "count arg: %ld must be >= 0 and <= %ld", count, array->count);
+	}
+	if (count == 0) {
+		return;
+	}
+
+	/*
+	 * Move what is left to the front
+	 */
+	memmove(array->data, (char *) array->data + (count * array->elm_size),
+		(size_t) ((array->count - count) * array->elm_size));
+	array->count -= count;
+
+	return;
+}
+
+
+/*
+ * spill_dyn_array - move the storage of a dynamic array into a file
+ *
+ * given:
+ *      array           	// pointer to the dynamic array
+ *      path			// path of the file to create
+ *
+ * The elements are moved into a file mapped in place of the heap allocation, so users of
+ * array->data keep working unchanged.  The file is append-only: it grows with the array and
+ * the page cache, not the heap, holds whatever part of it fits in memory.
+ *
+ * The file is unlinked as soon as it is mapped, so nothing is left behind if the run dies.
+ *
+ * This function does not return on error.
+ */
+void
+spill_dyn_array(struct dyn_array *array, char *path)
+{
+	long int bytes;		// Size of the allocated elements
+	void *data;		// Mapping of the spill file
+
+	/*
+	 * Check preconditions (firewall) - sanity check args
+	 */
+	if (array == NULL) {
+		err(66, __func__, "array arg is NULL");
+	}
+	if (path == NULL) {
+		err(66, __func__, "path arg is NULL");
+	}
+	if (array->data == NULL) {
+		err(66, __func__, "data for dynamic array is NULL");
+	}
+	if (array->fd >= 0) {
+		return;		// Already spilled
+	}
+	bytes = array->allocated * array->elm_size;
+
+	/*
+	 * Create the file as large as the current allocation and map it
+	 */
+	array->fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0600);
+	if (array->fd < 0) {
+		errp(66, __func__, "cannot create spill file: %s", path);
+	}
+	if (ftruncate(array->fd, (off_t) bytes) != 0) {
+		errp(66, __func__, "cannot size spill file: %s to %ld bytes", path, bytes);
+	}
+	data = mmap(NULL, (size_t) bytes, PROT_READ | PROT_WRITE, MAP_SHARED, array->fd, 0);
+	if (data == MAP_FAILED) {
+		errp(66, __func__, "cannot mmap spill file: %s", path);
+	}
+	if (unlink(path) != 0) {
+		warnp(__func__, "cannot unlink spill file: %s", path);
+	}
+
+	/*
+	 * Move the elements already in the array and release the heap copy
+	 */
+	memcpy(data, array->data, (size_t) (array->count * array->elm_size));
+	free(array->data);
+	array->data = data;
+	(void) madvise(array->data, (size_t) bytes, MADV_SEQUENTIAL);
+	dbg(DBG_MED, "spilled dynamic array of %ld elements of %lu bytes to: %s", array->allocated, array->elm_size, path);
+
+	return;
+}
+
+
 /*
  * Free_dyn_array - free a dynamic array
  *
@@ -433,9 +637,17 @@ free_dyn_array(struct dyn_array *array)
 	 * Free any storage this dynamic array might have
 	 */
 	if (array->data != NULL) {
-		free(array->data);
+		if (array->fd >= 0) {
+			munmap(array->data, (size_t) (array->allocated * array->elm_size));
+		} else {
+			free(array->data);
+		}
 		array->data = NULL;
 	}
+	if (array->fd >= 0) {
+		close(array->fd);
+		array->fd = -1;
+	}
 
 	/*
 	 * Zero the count and allocation
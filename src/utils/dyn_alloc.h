@@ -24,7 +24,8 @@
 #ifndef DYN_ALLOC_H
 #   define DYN_ALLOC_H
 
-#   define DEFAULT_CHUNK (1024)	// by default, allocate DEFAULT_CHUNK at a time
+#   define DEFAULT_CHUNK (1024)	// by default, allocate multiples of DEFAULT_CHUNK elements
+#   define MAX_RESERVE (64L * 1024 * 1024)	// most bytes init reserves up front for a results array
 
 
 /*
@@ -60,15 +61,24 @@ struct dyn_array {
 	long int allocated;	// Number of elements allocated (>= count)
 	long int chunk;		// Number of elements to expand by when allocating
 	void *data;		// allocated dynamic array of identical things or NULL
+	int fd;			// -1 --> data is on the heap, else open spill file mapped at data
 };
 
 
+/*
+ * number of mallocs and reallocs made by dynamic arrays so far
+ */
+extern long int dyn_alloc_count;
+
 /*
  * external allocation functions
  */
 struct dyn_array *create_dyn_array(size_t elm_size, long int chunk, long int start_elm_count, int zeroize);
 extern void append_value(struct dyn_array *array, void *value_to_add);
 extern void append_array(struct dyn_array *array, void *array_to_add_p, long int total_elements_to_add);
+extern void reserve_dyn_array(struct dyn_array *array, long int total_elements);
+extern void drop_dyn_array(struct dyn_array *array, long int count);
+extern void spill_dyn_array(struct dyn_array *array, char *path);
 extern void free_dyn_array(struct dyn_array *array);
 extern void clear_dyn_array(struct dyn_array *array);
 
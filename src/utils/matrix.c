@@ -26,12 +26,13 @@
  */
 
 
-// Exit codes: 120 thru 129
+// Exit codes: 120 thru 122
 
 #include <stdio.h>
 #include <stdlib.h>
 #include "../utils/externs.h"
 #include "matrix.h"
+#include "arena.h"
 #include "debug.h"
 
 
@@ -185,24 +186,61 @@ determine_rank(int m, int M, int Q, BitSequence ** A)
 
 
 /*
- * create_matrix - allocate a 2D matrix of BitSequence values
+ * create_matrix - allocate a 2D matrix of BitSequence values from the arena of a thread
  *
  * given:
- *      M       // Number of rows in the matrix
- *      Q       // Number of columns in each matrix row
+ *      state           // run state with arenas created by arena_create()
+ *      thread_id       // thread whose arena to use
+ *      M               // Number of rows in the matrix
+ *      Q               // Number of columns in each matrix row
  *
  * returns:
- *      An allocated 2D matrix of BitSequence values.
+ *      An allocated 2D matrix of BitSequence values, with the rows stored one after another
+ *      right after the M row pointers.  The matrix must NOT be freed, it goes away with arena_destroy().
+ *
+ * The row pointers are left NULL: the thread using the matrix sets them with matrix_rows(), so
+ * that the pages of the matrix are first touched, and placed, by that thread rather than by init.
  *
  * NOTE: This function does NOT return on error.
+ */
+BitSequence **
+create_matrix(struct state *state, long int thread_id, int M, int Q)
+{
+	/*
+	 * Check preconditions (firewall)
+	 */
+	if (M < 0) {
+		err(120, __func__, "number of rows: %d must be > 0", M);
+	}
+	if (Q < 0) {
+		err(120, __func__, "number of columns per rows: %d must be > 0", Q);
+	}
+
+	/*
+	 * Allocate array of matrix rows followed by the storage of all rows
+	 */
+	return arena_alloc(state, thread_id, (size_t) M * (sizeof(BitSequence *) + (size_t) Q), sizeof(BitSequence));
+}
+
+
+/*
+ * matrix_rows - point the rows of a matrix from create_matrix() to their columns
+ *
+ * given:
+ *      matrix          // matrix returned by create_matrix()
+ *      M               // Number of rows in the matrix
+ *      Q               // Number of columns in each matrix row
+ *
+ * returns:
+ *      matrix, with its row pointers set.
  *
- * NOTE: Unlike older versions of this function, create_matrix()
- *       does not zeroize the matrix.
+ * Only the first call for a matrix writes the row pointers, later calls find them set.  Call it
+ * from the thread that uses the matrix.
  */
 BitSequence **
-create_matrix(int M, int Q)
+matrix_rows(BitSequence **matrix, int M, int Q)
 {
-	BitSequence **matrix;	// matrix top return
+	BitSequence *rows;	// storage of all rows
 	int i;
 
 	/*
@@ -215,24 +253,19 @@ create_matrix(int M, int Q)
 		err(120, __func__, "number of columns per rows: %d must be > 0", Q);
 	}
 
-	/*
-	 * Allocate array of matrix rows
-	 */
-	matrix = malloc(M * sizeof(matrix[0]));
 	if (matrix == NULL) {
-		errp(120, __func__, "cannot malloc of %ld elements of %ld bytes each for matrix rows",
-		     (long int) M, sizeof(BitSequence *));
+		err(120, __func__, "matrix arg is NULL");
+	}
+	if (M <= 0 || matrix[0] != NULL) {
+		return matrix;
 	}
 
 	/*
-	 * Allocate the columns for each matrix row
+	 * Point each matrix row to its columns
 	 */
+	rows = (BitSequence *) (matrix + M);
 	for (i = 0; i < M; i++) {
-		matrix[i] = malloc(Q * sizeof(matrix[0][0]));
-		if (matrix[i] == NULL) {
-			errp(120, __func__, "cannot malloc of %ld elements of %ld bytes each for matrix[%d] column",
-			     (long int) Q, sizeof(BitSequence), i);
-		}
+		matrix[i] = rows + (size_t) i * (size_t) Q;
 	}
 
 	return matrix;
@@ -31,7 +31,8 @@
 #include "../utils/defs.h"
 
 extern int computeRank(int M, int Q, BitSequence ** matrix);
-extern BitSequence **create_matrix(int M, int Q);
+extern BitSequence **create_matrix(struct state *state, long int thread_id, int M, int Q);
+extern BitSequence **matrix_rows(BitSequence **matrix, int M, int Q);
 extern void def_matrix(struct thread_state *thread_state, int M, int Q, BitSequence ** m, long int k);
 
 #endif				/* MATRIX_H */
@@ -0,0 +1,279 @@
+// memo.c - remember values of a function of an integer key, shared by the threads of a run
+
+/*
+ * This code has been heavily modified by the following people:
+ *
+ *      Landon Curt Noll
+ *      Tom Gilgan
+ *      Riccardo Paccagnella
+ *
+ * See the README.md and the initial comment in sts.c for more information.
+ *
+ * WE (THOSE LISTED ABOVE WHO HEAVILY MODIFIED THIS CODE) DISCLAIM ALL
+ * WARRANTIES WITH REGARD TO THIS SOFTWARE, INCLUDING ALL IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL WE (THOSE LISTED ABOVE
+ * WHO HEAVILY MODIFIED THIS CODE) BE LIABLE FOR ANY SPECIAL, INDIRECT OR
+ * CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF
+ * USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ *
+ * chongo (Landon Curt Noll, http://www.isthe.com/chongo/index.html) /\oo/\
+ *
+ * Share and enjoy! :-)
+ */
+
+
+
+// Exit codes: 68 thru 69
+
+/*
+ * Many tests map a small integer statistic of a bitstream (a sum, a maximum excursion, a count) to
+ * a p-value through erfc(), igamc() or a series.  For a given n the statistic takes few values, so
+ * a run over many bitstreams computes the same p-values again and again.  A test may instead keep
+ * them in a memo created by its init function:
+ *
+ *      if (memo_get(memo, key, &p_value) == false) {
+ *              p_value = ...;
+ *              memo_put(memo, key, p_value);
+ *      }
+ *
+ * The key must determine the value: tests fold every integer the value depends on into it.
+ *
+ * A memo is an open addressed hash table of a fixed size, filled lazily by the threads without
+ * locks: a thread takes an empty entry by a compare and swap of its key, then stores its value.
+ * A thread finding the key before its value is stored computes the value itself.  Once a memo
+ * is 3/4 full, or a key is not found within MEMO_PROBES entries, values are no longer stored and
+ * are computed each time.  The memos of a run take at most MEMO_MAX_BYTES.  memo_free() reports
+ * the hit rate of a memo at -v 1.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "../utils/externs.h"
+#include "utilities.h"
+#include "memo.h"
+#include "debug.h"
+
+#define MEMO_EMPTY	(~(uint64_t) 0)			// key of an entry not taken
+#define MEMO_PROBES	(8)				// most entries looked at for a key
+#define MEMO_MIN_SLOTS	(16)				// fewest entries of a memo
+#define MEMO_HASH	(0x9E3779B97F4A7C15ULL)		// 2^64 / golden ratio, spreads consecutive keys
+
+
+/*
+ * Bytes taken by the memos of the run
+ */
+static long int memo_total = 0;
+
+
+/*
+ * Forward static function declarations
+ */
+static long int memo_slot(struct memo *memo, uint64_t key);
+
+
+/*
+ * memo_slot - first entry of the table to look at for a key
+ */
+static long int
+memo_slot(struct memo *memo, uint64_t key)
+{
+	return (long int) ((key * MEMO_HASH) >> 32) & (memo->slots - 1);
+}
+
+
+/*
+ * memo_create - create an empty memo
+ *
+ * given:
+ *      name            // name of the memo, for its report, kept until memo_free()
+ *      keys            // most keys the run is expected to look up
+ *
+ * returns:
+ *      The memo, or NULL when the memos of the run already take MEMO_MAX_BYTES.  The memo functions
+ *      accept a NULL memo, that remembers nothing.
+ *
+ * This function does not return on error.
+ */
+struct memo *
+memo_create(char const *name, long int keys)
+{
+	struct memo *memo;	// the memo
+	long int slots;		// entries of the table
+	long int bytes;		// bytes of the table
+	long int i;
+
+	/*
+	 * Check preconditions (firewall)
+	 */
+	if (name == NULL) {
+		err(68, __func__, "name arg is NULL");
+	}
+	if (keys < 0) {
+		err(68, __func__, "keys: %ld must be >= 0", keys);
+	}
+
+	/*
+	 * Size the table to keep its load under 3/4, within the share of the budget left
+	 */
+	for (slots = MEMO_MIN_SLOTS; slots < keys + keys / 3 && slots < MEMO_MAX_BYTES; slots *= 2) {
+	}
+	while (slots >= MEMO_MIN_SLOTS && (slots * (long int) sizeof(struct memo_entry) > MEMO_MAX_BYTES / MEMO_MAX_SHARE ||
+					   memo_total + slots * (long int) sizeof(struct memo_entry) > MEMO_MAX_BYTES)) {
+		slots /= 2;
+	}
+	if (slots < MEMO_MIN_SLOTS) {
+		dbg(DBG_LOW, "memo %s: memos already take %ld bytes, its values will not be kept", name, memo_total);
+		return NULL;
+	}
+	bytes = slots * (long int) sizeof(struct memo_entry);
+
+	/*
+	 * Create the memo
+	 */
+	memo = calloc(1, sizeof(*memo));
+	if (memo == NULL) {
+		errp(69, __func__, "cannot calloc for memo %s", name);
+	}
+	memo->name = name;
+	memo->entry = malloc((size_t) bytes);
+	if (memo->entry == NULL) {
+		errp(69, __func__, "cannot malloc %ld bytes for memo %s", bytes, name);
+	}
+	for (i = 0; i < slots; i++) {
+		memo->entry[i].key = MEMO_EMPTY;
+		memo->entry[i].value = NAN;
+	}
+	memo->slots = slots;
+	memo->most = slots - slots / 4;
+	memo->counted = (debuglevel >= DBG_LOW);
+	memo_total += bytes;
+	dbg(DBG_MED, "memo %s: %ld entries of %ld bytes for up to %ld keys", name, slots, sizeof(struct memo_entry), keys);
+
+	return memo;
+}
+
+
+/*
+ * memo_get - look up the value of a key
+ *
+ * given:
+ *      memo            // memo to look in, or NULL
+ *      key             // key to look up, not MEMO_EMPTY
+ *      value           // where to put the value of the key
+ *
+ * returns:
+ *      true ==> *value is the value of the key, false ==> the value must be computed
+ *
+ * The lookups and hits are only counted under -v: every thread looking up a memo would
+ * otherwise update the same cache line twice a lookup.
+ */
+bool
+memo_get(struct memo *memo, uint64_t key, double *value)
+{
+	struct memo_entry *entry;	// entry looked at
+	uint64_t found;			// key of the entry
+	long int slot;			// index of the entry
+	int probe;
+
+	if (memo == NULL) {
+		return false;
+	}
+	if (memo->counted == true) {
+		__atomic_add_fetch(&memo->lookups, 1, __ATOMIC_RELAXED);
+	}
+
+	slot = memo_slot(memo, key);
+	for (probe = 0; probe < MEMO_PROBES; probe++) {
+		entry = &memo->entry[(slot + probe) & (memo->slots - 1)];
+		found = __atomic_load_n(&entry->key, __ATOMIC_ACQUIRE);
+		if (found == MEMO_EMPTY) {
+			return false;
+		}
+		if (found == key) {
+			__atomic_load(&entry->value, value, __ATOMIC_ACQUIRE);
+			if (isnan(*value)) {
+				return false;
+			}
+			if (memo->counted == true) {
+				__atomic_add_fetch(&memo->hits, 1, __ATOMIC_RELAXED);
+			}
+			return true;
+		}
+	}
+	return false;
+}
+
+
+/*
+ * memo_put - remember the value of a key
+ *
+ * given:
+ *      memo            // memo to remember in, or NULL
+ *      key             // key, not MEMO_EMPTY
+ *      value           // value of the key, not NaN
+ *
+ * Threads storing the same key at once must store the same value.
+ */
+void
+memo_put(struct memo *memo, uint64_t key, double value)
+{
+	struct memo_entry *entry;	// entry looked at
+	uint64_t found;			// key of the entry
+	long int slot;			// index of the entry
+	int probe;
+
+	if (memo == NULL || key == MEMO_EMPTY || isnan(value) ||
+	    __atomic_load_n(&memo->stored, __ATOMIC_RELAXED) >= memo->most) {
+		return;
+	}
+
+	slot = memo_slot(memo, key);
+	for (probe = 0; probe < MEMO_PROBES; probe++) {
+		entry = &memo->entry[(slot + probe) & (memo->slots - 1)];
+		found = MEMO_EMPTY;
+		if (__atomic_compare_exchange_n(&entry->key, &found, key, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+			__atomic_store(&entry->value, &value, __ATOMIC_RELEASE);
+			__atomic_add_fetch(&memo->stored, 1, __ATOMIC_RELAXED);
+			return;
+		}
+		if (found == key) {
+			return;
+		}
+	}
+}
+
+
+/*
+ * memo_bytes - bytes taken by the memos of the run
+ */
+long int
+memo_bytes(void)
+{
+	return memo_total;
+}
+
+
+/*
+ * memo_free - report the hit rate of a memo, and free it
+ *
+ * given:
+ *      memo            // memo to free, or NULL
+ */
+void
+memo_free(struct memo *memo)
+{
+	if (memo == NULL) {
+		return;
+	}
+
+	dbg(DBG_LOW, "memo %s: %ld lookups, %ld hits (%.1f%%), %ld of %ld entries stored", memo->name, memo->lookups,
+	    memo->hits, (memo->lookups > 0) ? 100.0 * (double) memo->hits / (double) memo->lookups : 0.0, memo->stored,
+	    memo->slots);
+	memo_total -= memo->slots * (long int) sizeof(struct memo_entry);
+	free(memo->entry);
+	free(memo);
+}
@@ -0,0 +1,65 @@
+/*****************************************************************************
+ M E M O  F U N C T I O N  P R O T O T Y P E S
+ *****************************************************************************/
+
+/*
+ * This code has been heavily modified by the following people:
+ *
+ *      Landon Curt Noll
+ *      Tom Gilgan
+ *      Riccardo Paccagnella
+ *
+ * See the README.md and the initial comment in sts.c for more information.
+ *
+ * WE (THOSE LISTED ABOVE WHO HEAVILY MODIFIED THIS CODE) DISCLAIM ALL
+ * WARRANTIES WITH REGARD TO THIS SOFTWARE, INCLUDING ALL IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL WE (THOSE LISTED ABOVE
+ * WHO HEAVILY MODIFIED THIS CODE) BE LIABLE FOR ANY SPECIAL, INDIRECT OR
+ * CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF
+ * USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ *
+ * chongo (Landon Curt Noll, http://www.isthe.com/chongo/index.html) /\oo/\
+ *
+ * Share and enjoy! :-)
+ */
+
+#ifndef MEMO_H
+#   define MEMO_H
+
+#   include <stdint.h>
+#   include "defs.h"
+
+#   define MEMO_MAX_BYTES	(64L * 1024 * 1024)	// most bytes all memos of a run take together
+#   define MEMO_MAX_SHARE	(4)			// a memo takes at most 1/MEMO_MAX_SHARE of MEMO_MAX_BYTES
+
+/*
+ * memo_entry - a key and its value, the key is MEMO_EMPTY until the entry is taken
+ */
+struct memo_entry {
+	uint64_t key;			// key of the entry (accessed atomically)
+	double value;			// value of the key, NaN until it is stored (accessed atomically)
+};
+
+/*
+ * memo - values of a function of an integer key, computed once per run and shared by the threads
+ */
+struct memo {
+	char const *name;		// name of the memo, for its report
+	struct memo_entry *entry;	// open addressed table of entries
+	long int slots;			// number of entries, a power of 2
+	long int most;			// most entries stored, so that probes stay short
+	long int stored;		// entries stored (accessed atomically)
+	bool counted;			// true ==> count lookups and hits for the -v report
+	long int lookups;		// calls to memo_get(), when counted (accessed atomically)
+	long int hits;			// calls to memo_get() that found their value, when counted (accessed atomically)
+};
+
+extern struct memo *memo_create(char const *name, long int keys);
+extern bool memo_get(struct memo *memo, uint64_t key, double *value);
+extern void memo_put(struct memo *memo, uint64_t key, double value);
+extern long int memo_bytes(void);
+extern void memo_free(struct memo *memo);
+
+#endif				/* MEMO_H */
@@ -0,0 +1,615 @@
+// numa.c - place the iterate threads, their memory and the bitstreams they test on NUMA nodes
+
+/*
+ * This code has been heavily modified by the following people:
+ *
+ *      Landon Curt Noll
+ *      Tom Gilgan
+ *      Riccardo Paccagnella
+ *
+ * See the README.md and the initial comment in sts.c for more information.
+ *
+ * WE (THOSE LISTED ABOVE WHO HEAVILY MODIFIED THIS CODE) DISCLAIM ALL
+ * WARRANTIES WITH REGARD TO THIS SOFTWARE, INCLUDING ALL IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL WE (THOSE LISTED ABOVE
+ * WHO HEAVILY MODIFIED THIS CODE) BE LIABLE FOR ANY SPECIAL, INDIRECT OR
+ * CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF
+ * USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ *
+ * chongo (Landon Curt Noll, http://www.isthe.com/chongo/index.html) /\oo/\
+ *
+ * Share and enjoy! :-)
+ */
+
+
+
+// Exit codes: 254 thru 255
+
+/*
+ * On hosts with several sockets, each socket (NUMA node) has memory of its own, and a thread
+ * reading the memory of another node waits longer for it.  Under -N, the iterate threads are
+ * placed node by node: the threads (or -G teams) are cut into one contiguous group per node,
+ * and each thread is pinned to a CPU of its node.  The node of a thread also holds its memory:
+ * the chunks of its arena (see arena.c) are bound to the node, which moves the pages init already
+ * wrote and places the others when the thread first writes them.
+ *
+ * Readers are placed node by node too, reader r on node r % nodes, and without -R readers each
+ * node gets one.  A reader fills the ring slots of its own node.  An iterate thread given a
+ * bitstream read on another node copies it once into a buffer of its own node, rather than have
+ * each of its tests read remote memory.
+ *
+ * The topology is read from /sys/devices/system/node, and limited to the CPUs we may run on.
+ * Without it, all CPUs form a single node and nothing is bound.  No NUMA library is needed:
+ * memory is bound with the mbind(2) system call where the system has it.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <sched.h>
+#include <pthread.h>
+#include <sys/syscall.h>
+#include "../utils/externs.h"
+#include "utilities.h"
+#include "arena.h"
+#include "numa.h"
+#include "debug.h"
+
+#if !defined(MPOL_PREFERRED)
+#   define MPOL_PREFERRED	(1)		// mbind(2) mode: allocate on the node if it can
+#endif /* MPOL_PREFERRED */
+#if !defined(MPOL_MF_MOVE)
+#   define MPOL_MF_MOVE		(1 << 1)	// mbind(2) flag: move the pages already placed elsewhere
+#endif /* MPOL_MF_MOVE */
+
+
+/*
+ * numa_node - a NUMA node threads are placed on
+ */
+struct numa_node {
+	long int id;			// node number in /sys/devices/system/node, -1 ==> no NUMA information
+	cpu_set_t cpus;			// CPUs of the node we may run on
+	long int ncpus;			// number of CPUs in cpus
+	long int threads;		// iterate threads placed on the node
+	long int first;			// first iterate thread placed on the node
+};
+
+static struct numa_node node[MAX_NUMA_NODES];	// nodes with CPUs we may run on
+static cpu_set_t allowed;			// CPUs we may run on, see sched_getaffinity(2)
+static long int node_count = 0;			// number of nodes in node[]
+static pthread_once_t topology_once = PTHREAD_ONCE_INIT;
+static long int *thread_node = NULL;		// node[] index of each iterate thread
+static long int *thread_cpu = NULL;		// CPU each iterate thread is pinned to
+static BitSequence **local_bits = NULL;		// node local copy of a bitstream read on another node, per thread
+static long int routed_local = 0;		// bitstreams tested on the node they were read on (accessed atomically)
+static long int routed_copied = 0;		// bitstreams copied to the node of their thread (accessed atomically)
+static bool bind_failed = false;		// true ==> mbind(2) failed, warned once
+
+
+/*
+ * Forward static function declarations
+ */
+static bool read_cpulist(char *path, cpu_set_t *cpus);
+static void read_topology(void);
+static long int nth_cpu(cpu_set_t *cpus, long int nth);
+
+
+/*
+ * read_cpulist - read a list of CPUs such as 0-3,8-11 from a file
+ *
+ * given:
+ *      path            // file to read
+ *      cpus            // CPU set to fill
+ *
+ * returns:
+ *      true ==> cpus holds the CPUs of the list, false ==> path cannot be read
+ */
+static bool
+read_cpulist(char *path, cpu_set_t *cpus)
+{
+	char list[BUFSIZ + 1];	// the list
+	char *p;		// next character of the list to parse
+	char *end;		// character after a number parsed
+	long int lo;		// first CPU of a range
+	long int hi;		// last CPU of a range
+	long int cpu;
+	FILE *stream;
+
+	stream = fopen(path, "r");
+	if (stream == NULL) {
+		return false;
+	}
+	p = fgets(list, sizeof(list), stream);
+	fclose(stream);
+	if (p == NULL) {
+		return false;
+	}
+
+	CPU_ZERO(cpus);
+	while (*p != '\0' && *p != '\n') {
+		lo = strtol(p, &end, 10);
+		if (end == p) {
+			break;
+		}
+		hi = lo;
+		p = end;
+		if (*p == '-') {
+			hi = strtol(p + 1, &end, 10);
+			p = end;
+		}
+		for (cpu = lo; cpu <= hi && cpu < CPU_SETSIZE; cpu++) {
+			CPU_SET((int) cpu, cpus);
+		}
+		if (*p == ',') {
+			p++;
+		}
+	}
+
+	return true;
+}
+
+
+/*
+ * read_topology - find the NUMA nodes and the CPUs of each we may run on
+ */
+static void
+read_topology(void)
+{
+	char path[BUFSIZ + 1];	// cpulist file of a node
+	long int id;
+	long int cpu;
+
+	/*
+	 * CPUs we may run on, all online ones if we cannot tell
+	 */
+	if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0) {
+		CPU_ZERO(&allowed);
+		for (cpu = 0; cpu < MIN(sysconf(_SC_NPROCESSORS_ONLN), CPU_SETSIZE); cpu++) {
+			CPU_SET((int) cpu, &allowed);
+		}
+	}
+
+	/*
+	 * Nodes with some of those CPUs
+	 */
+	for (id = 0; id < MAX_NUMA_NODES * 4 && node_count < MAX_NUMA_NODES; id++) {
+		snprintf(path, sizeof(path), "/sys/devices/system/node/node%ld/cpulist", id);
+		if (read_cpulist(path, &node[node_count].cpus) == false) {
+			continue;
+		}
+		CPU_AND(&node[node_count].cpus, &node[node_count].cpus, &allowed);
+		node[node_count].ncpus = CPU_COUNT(&node[node_count].cpus);
+		if (node[node_count].ncpus > 0) {
+			node[node_count].id = id;
+			node_count++;
+		}
+	}
+
+	/*
+	 * No NUMA information: a single node of all of our CPUs
+	 */
+	if (node_count == 0) {
+		node[0].id = -1;
+		node[0].cpus = allowed;
+		node[0].ncpus = MAX(CPU_COUNT(&allowed), 1);
+		node_count = 1;
+	}
+}
+
+
+/*
+ * nth_cpu - find the nth CPU of a set
+ *
+ * given:
+ *      cpus            // CPU set
+ *      nth             // 0 for the first CPU, wraps around the CPUs of the set
+ *
+ * returns:
+ *      The CPU, 0 if the set is empty.
+ */
+static long int
+nth_cpu(cpu_set_t *cpus, long int nth)
+{
+	long int count;		// CPUs in cpus
+	long int cpu;
+
+	count = CPU_COUNT(cpus);
+	if (count <= 0) {
+		return 0;
+	}
+	nth %= count;
+	for (cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+		if (CPU_ISSET((int) cpu, cpus) && nth-- == 0) {
+			break;
+		}
+	}
+
+	return cpu;
+}
+
+
+/*
+ * numa_nodes - number of NUMA nodes threads are placed on
+ *
+ * given:
+ *      state           // run state
+ *
+ * returns:
+ *      Number of nodes under -N, 1 without -N.
+ */
+long int
+numa_nodes(struct state *state)
+{
+	/*
+	 * Check preconditions (firewall)
+	 */
+	if (state == NULL) {
+		err(254, __func__, "state arg is NULL");
+	}
+	if (state->numaFlag == false) {
+		return 1;
+	}
+
+	pthread_once(&topology_once, read_topology);
+	return node_count;
+}
+
+
+/*
+ * numa_cpus - number of CPUs we may run on
+ *
+ * returns:
+ *      CPUs of our affinity mask (see sched_getaffinity(2)), the online CPUs if it cannot be read.
+ *
+ * Unlike sysconf(_SC_NPROCESSORS_ONLN), this honors taskset, cgroup cpusets and batch schedulers
+ * that confine the process to some of the CPUs of its host.
+ */
+long int
+numa_cpus(void)
+{
+	pthread_once(&topology_once, read_topology);
+	return MAX(CPU_COUNT(&allowed), 1);
+}
+
+
+/*
+ * numa_cpu - find the nth CPU we may run on
+ *
+ * given:
+ *      nth             // 0 for the first CPU, wraps around the CPUs we may run on
+ *
+ * returns:
+ *      The CPU number, to give to CPU_SET().
+ */
+long int
+numa_cpu(long int nth)
+{
+	/*
+	 * Check preconditions (firewall)
+	 */
+	if (nth < 0) {
+		err(254, __func__, "nth: %ld must be >= 0", nth);
+	}
+
+	pthread_once(&topology_once, read_topology);
+	return nth_cpu(&allowed, nth);
+}
+
+
+/*
+ * numa_setup - place the iterate threads and their memory on NUMA nodes
+ *
+ * given:
+ *      state           // run state, after init() sized numberOfThreads and filled the arenas
+ *
+ * Does nothing without -N.  Reports the topology used.
+ *
+ * This function does not return on error.
+ */
+void
+numa_setup(struct state *state)
+{
+	struct arena_chunk *chunk;	// chunk of the arena of a thread
+	long int team;			// threads placed together: a -G team, or 1
+	long int groups;		// number of teams
+	long int k;
+	long int i;
+
+	/*
+	 * Check preconditions (firewall)
+	 */
+	if (state == NULL) {
+		err(254, __func__, "state arg is NULL");
+	}
+	if (state->numaFlag == false) {
+		return;
+	}
+	if (state->arena == NULL) {
+		err(254, __func__, "state->arena is NULL");
+	}
+	pthread_once(&topology_once, read_topology);
+
+	/*
+	 * Cut the threads into one contiguous group per node, keeping the threads of a team together
+	 */
+	thread_node = calloc((size_t) state->numberOfThreads, sizeof(thread_node[0]));
+	thread_cpu = calloc((size_t) state->numberOfThreads, sizeof(thread_cpu[0]));
+	local_bits = calloc((size_t) state->numberOfThreads, sizeof(local_bits[0]));
+	if (thread_node == NULL || thread_cpu == NULL || local_bits == NULL) {
+		errp(254, __func__, "cannot calloc the placement of %ld threads", state->numberOfThreads);
+	}
+	team = MAX(state->teamSize, 1);
+	groups = (state->numberOfThreads + team - 1) / team;
+	for (k = 0; k < node_count; k++) {
+		node[k].threads = 0;
+		node[k].first = -1;
+	}
+	for (i = 0; i < state->numberOfThreads; i++) {
+		k = ((i / team) * node_count) / groups;
+		thread_node[i] = k;
+		thread_cpu[i] = nth_cpu(&node[k].cpus, node[k].threads);
+		if (node[k].threads++ == 0) {
+			node[k].first = i;
+		}
+	}
+
+	/*
+	 * Keep the memory of each thread on its node, and room to copy a bitstream read on another node
+	 */
+	for (i = 0; i < state->numberOfThreads; i++) {
+		if (node_count > 1) {
+			local_bits[i] = arena_alloc(state, i, (size_t) state->tp.n, sizeof(local_bits[i][0]));
+		}
+		for (chunk = state->arena[i].chunk; chunk != NULL; chunk = chunk->next) {
+			numa_bind(state, chunk->base, chunk->size, thread_node[i]);
+		}
+	}
+	routed_local = 0;
+	routed_copied = 0;
+
+	/*
+	 * Report the topology used
+	 */
+	dbg(DBG_LOW, "-N: placing %ld iterate threads on %ld NUMA node%s", state->numberOfThreads, node_count,
+	    node_count == 1 ? "" : "s");
+	for (k = 0; k < node_count; k++) {
+		if (node[k].threads > 0) {
+			dbg(DBG_LOW, "  NUMA node %ld: %ld CPUs, iterate threads %ld thru %ld", node[k].id, node[k].ncpus,
+			    node[k].first, node[k].first + node[k].threads - 1);
+		} else {
+			dbg(DBG_LOW, "  NUMA node %ld: %ld CPUs, no iterate threads", node[k].id, node[k].ncpus);
+		}
+	}
+	for (i = 0; i < state->numberOfThreads; i++) {
+		dbg(DBG_MED, "  iterate thread %ld on CPU %ld of NUMA node %ld", i, thread_cpu[i], node[thread_node[i]].id);
+	}
+}
+
+
+/*
+ * numa_pin_thread - pin an iterate thread about to be created to its CPU
+ *
+ * given:
+ *      state           // run state, after numa_setup()
+ *      attr            // attributes the thread will be created with
+ *      thread_id       // iterate thread
+ */
+void
+numa_pin_thread(struct state *state, pthread_attr_t *attr, long int thread_id)
+{
+	cpu_set_t cpus;		// CPU of the thread
+	int ret;
+
+	/*
+	 * Check preconditions (firewall)
+	 */
+	if (state == NULL || attr == NULL) {
+		err(254, __func__, "state or attr arg is NULL");
+	}
+	if (thread_cpu == NULL) {
+		err(254, __func__, "numa_setup() was not called");
+	}
+	if (thread_id < 0 || thread_id >= state->numberOfThreads) {
+		err(254, __func__, "thread_id: %ld must be in [0, %ld)", thread_id, state->numberOfThreads);
+	}
+
+	CPU_ZERO(&cpus);
+	CPU_SET((int) thread_cpu[thread_id], &cpus);
+	ret = pthread_attr_setaffinity_np(attr, sizeof(cpus), &cpus);
+	if (ret != 0) {
+		warn(__func__, "unable to pin thread %ld to CPU %ld, error: %d", thread_id, thread_cpu[thread_id], ret);
+	}
+}
+
+
+/*
+ * numa_reader_node - NUMA node a reader is placed on
+ *
+ * given:
+ *      state           // run state
+ *      reader          // reader number
+ *
+ * returns:
+ *      Index of the node of the reader, -1 without -N.
+ */
+long int
+numa_reader_node(struct state *state, long int reader)
+{
+	/*
+	 * Check preconditions (firewall)
+	 */
+	if (state == NULL) {
+		err(254, __func__, "state arg is NULL");
+	}
+	if (state->numaFlag == false) {
+		return -1;
+	}
+
+	return reader % numa_nodes(state);
+}
+
+
+/*
+ * numa_pin_reader - keep a reader about to be created on the CPUs of its NUMA node
+ *
+ * given:
+ *      state           // run state
+ *      attr            // attributes the reader will be created with
+ *      reader          // reader number
+ */
+void
+numa_pin_reader(struct state *state, pthread_attr_t *attr, long int reader)
+{
+	long int k;		// node of the reader
+	int ret;
+
+	/*
+	 * Check preconditions (firewall)
+	 */
+	if (state == NULL || attr == NULL) {
+		err(255, __func__, "state or attr arg is NULL");
+	}
+	k = numa_reader_node(state, reader);
+	if (k < 0) {
+		return;
+	}
+
+	ret = pthread_attr_setaffinity_np(attr, sizeof(node[k].cpus), &node[k].cpus);
+	if (ret != 0) {
+		warn(__func__, "unable to keep reader %ld on the CPUs of NUMA node %ld, error: %d", reader, node[k].id, ret);
+	}
+	dbg(DBG_MED, "reader %ld will run on NUMA node %ld", reader, node[k].id);
+}
+
+
+/*
+ * numa_bind - keep the pages of a buffer on a NUMA node
+ *
+ * given:
+ *      state           // run state
+ *      addr            // start of the buffer
+ *      len             // bytes in the buffer
+ *      k               // index of the node, as returned by numa_reader_node(), -1 ==> anywhere
+ *
+ * Only the whole pages inside of the buffer are bound.  Pages already placed elsewhere move to
+ * the node, the others are placed on it when first written.  Does nothing without -N or without
+ * NUMA information.
+ */
+void
+numa_bind(struct state *state, void *addr, size_t len, long int k)
+{
+	uintptr_t start;	// first whole page of the buffer
+	uintptr_t end;		// end of the last whole page of the buffer
+	uintptr_t page;		// page size
+	unsigned long int mask;	// node mask of the node
+
+	/*
+	 * Check preconditions (firewall)
+	 */
+	if (state == NULL) {
+		err(255, __func__, "state arg is NULL");
+	}
+	if (state->numaFlag == false || addr == NULL || k < 0 || k >= node_count || node[k].id < 0) {
+		return;
+	}
+	if (node[k].id >= (long int) BITS_N_LONGINT) {
+		dbg(DBG_MED, "NUMA node %ld is beyond the node mask, memory is not bound to it", node[k].id);
+		return;
+	}
+
+	page = (uintptr_t) sysconf(_SC_PAGESIZE);
+	start = ((uintptr_t) addr + page - 1) & ~(page - 1);
+	end = ((uintptr_t) addr + len) & ~(page - 1);
+	if (end <= start) {
+		return;
+	}
+	mask = 1UL << node[k].id;
+#if defined(SYS_mbind)
+	if (syscall(SYS_mbind, (void *) start, (unsigned long int) (end - start), MPOL_PREFERRED, &mask,
+		    (unsigned long int) BITS_N_LONGINT + 1, MPOL_MF_MOVE) != 0 && bind_failed == false) {
+		bind_failed = true;
+		warnp(__func__, "cannot bind memory to NUMA node %ld, pages stay where first written", node[k].id);
+	}
+#else /* SYS_mbind */
+	if (bind_failed == false) {
+		bind_failed = true;
+		warn(__func__, "mbind is not supported on this system, pages stay where first written");
+	}
+	(void) mask;
+#endif /* SYS_mbind */
+}
+
+
+/*
+ * numa_route - bits for an iterate thread to test a bitstream from
+ *
+ * given:
+ *      state           // run state
+ *      thread_id       // iterate thread about to test the bitstream
+ *      slot            // ring slot holding the bitstream
+ *
+ * returns:
+ *      The bits of the slot when they are on the node of the thread (or without -N),
+ *      else a copy of them in a buffer on the node of the thread.
+ */
+BitSequence *
+numa_route(struct state *state, long int thread_id, struct ring_slot *slot)
+{
+	/*
+	 * Check preconditions (firewall)
+	 */
+	if (state == NULL || slot == NULL) {
+		err(255, __func__, "state or slot arg is NULL");
+	}
+	if (state->numaFlag == false || local_bits == NULL) {
+		return slot->bits;
+	}
+	if (thread_id < 0 || thread_id >= state->numberOfThreads) {
+		err(255, __func__, "thread_id: %ld must be in [0, %ld)", thread_id, state->numberOfThreads);
+	}
+
+	if (slot->node < 0 || slot->node == thread_node[thread_id] || local_bits[thread_id] == NULL) {
+		__atomic_add_fetch(&routed_local, 1, __ATOMIC_RELAXED);
+		return slot->bits;
+	}
+	memcpy(local_bits[thread_id], slot->bits, (size_t) state->tp.n * sizeof(local_bits[thread_id][0]));
+	__atomic_add_fetch(&routed_copied, 1, __ATOMIC_RELAXED);
+
+	return local_bits[thread_id];
+}
+
+
+/*
+ * numa_stop - report where the bitstreams were tested and forget the placement
+ *
+ * given:
+ *      state           // run state
+ */
+void
+numa_stop(struct state *state)
+{
+	/*
+	 * Check preconditions (firewall)
+	 */
+	if (state == NULL) {
+		err(255, __func__, "state arg is NULL");
+	}
+	if (thread_node == NULL) {
+		return;
+	}
+
+	dbg(DBG_LOW, "-N: %ld bitstreams were tested on the NUMA node they were read on, %ld were copied to "
+	    "the node of their thread", routed_local, routed_copied);
+	free(thread_node);
+	thread_node = NULL;
+	free(thread_cpu);
+	thread_cpu = NULL;
+	free(local_bits);		// the buffers themselves are in the arenas
+	local_bits = NULL;
+}
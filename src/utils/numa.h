@@ -0,0 +1,48 @@
+/*****************************************************************************
+ N U M A  P L A C E M E N T  F U N C T I O N  P R O T O T Y P E S
+ *****************************************************************************/
+
+/*
+ * This code has been heavily modified by the following people:
+ *
+ *      Landon Curt Noll
+ *      Tom Gilgan
+ *      Riccardo Paccagnella
+ *
+ * See the README.md and the initial comment in sts.c for more information.
+ *
+ * WE (THOSE LISTED ABOVE WHO HEAVILY MODIFIED THIS CODE) DISCLAIM ALL
+ * WARRANTIES WITH REGARD TO THIS SOFTWARE, INCLUDING ALL IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL WE (THOSE LISTED ABOVE
+ * WHO HEAVILY MODIFIED THIS CODE) BE LIABLE FOR ANY SPECIAL, INDIRECT OR
+ * CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF
+ * USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ *
+ * chongo (Landon Curt Noll, http://www.isthe.com/chongo/index.html) /\oo/\
+ *
+ * Share and enjoy! :-)
+ */
+
+#ifndef NUMA_H
+#   define NUMA_H
+
+#   include <pthread.h>
+#   include "defs.h"
+#   include "reader.h"
+
+#   define MAX_NUMA_NODES	(64)		// most NUMA nodes -N places threads on, one bit each of a node mask
+
+extern long int numa_nodes(struct state *state);
+extern long int numa_cpus(void);
+extern long int numa_cpu(long int nth);
+extern void numa_setup(struct state *state);
+extern void numa_pin_thread(struct state *state, pthread_attr_t *attr, long int thread_id);
+extern void numa_pin_reader(struct state *state, pthread_attr_t *attr, long int reader);
+extern long int numa_reader_node(struct state *state, long int reader);
+extern void numa_bind(struct state *state, void *addr, size_t len, long int k);
+extern BitSequence *numa_route(struct state *state, long int thread_id, struct ring_slot *slot);
+extern void numa_stop(struct state *state);
+
+#endif				/* NUMA_H */
@@ -32,6 +32,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <ctype.h>
 #include <getopt.h>
 #include <sys/stat.h>
 #include <errno.h>
@@ -40,12 +41,29 @@
 #include <math.h>
 #include "../utils/externs.h"
 #include "utilities.h"
+#include "transform.h"
+#include "split.h"
+#include "slice.h"
 #include "debug.h"
 
 /*
  * Forward static function declarations
  */
 static void change_params(struct state *state, long int parameter, long int value, double d_value);
+static void readManifest(struct state *state);
+
+/*
+ * Test whose block length each -W parameter number changes
+ */
+static const enum test sweepTests[MAX_SWEEP_PARAM + 1] = {
+	TEST_ALL,			// 0: not a parameter
+	TEST_BLOCK_FREQUENCY,		// -W 1=M, Block Frequency Test - block length
+	TEST_NON_OVERLAPPING,		// -W 2=m, NonOverlapping Template Test - block length
+	TEST_OVERLAPPING,		// -W 3=m, Overlapping Template Test - block length
+	TEST_APEN,			// -W 4=m, Approximate Entropy Test - block length
+	TEST_SERIAL,			// -W 5=m, Serial Test - block length
+	TEST_LINEARCOMPLEXITY,		// -W 6=M, Linear Complexity Test - block length
+};
 
 /*
  * Default run state
@@ -93,20 +111,66 @@ static struct state const defaultstate = {
 	"/dev/null",			// default input file is /dev/null
 	false,				// not reading randdata from stdin by default
 
+	// manifestFlag, manifestPath, sources, sourceCount & source
+	false,				// No -L manifest was given
+	NULL,				// No manifest file
+	NULL,				// No sources, just randdata
+	0,				// No sources in a manifest
+	0,				// Testing the first (or only) source
+
 	// dataFormatFlag & dataFormat
 	false,				// -F format was not given
 	FORMAT_RAW_BINARY,		// Read data as raw binary
 
+	// xformFlag, xformLsbFirst, xformLittleEndian, xformWordBytes, xformLowBits & xformDecimation
+	false,				// No -X xform was given
+	false,				// Most significant bit first
+	false,				// Big endian samples
+	1,				// 1 byte samples
+	BITS_N_BYTE,			// Keep all 8 bits of each sample
+	1,				// Keep every bit
+
 	// numberOfThreads
 	false,
 	0,
 	0,
+	false,				// No -G team was given
+	1,				// Each bitstream is tested by one thread
+	false,				// No -J split was given
+	1,				// Each test of a bitstream is done in one piece
+	false,				// No -B was given, test the bitstreams one at a time
+	0,				// Longest run of ones block length, set by LongestRunOfOnes_init
+
+	// readerThreadsFlag & readerThreads
+	false,				// No -R readers was given
+	1,				// One thread reads ahead of the iterate threads
+	false,				// No -D qdepth was given, read randdata through stdio
+	0,				// No direct reads in flight
+
+	// pinThreadsFlag, firstCpu, hugePagesFlag, numaFlag, timingFlag, traceFlag, tracePath & validateFlag
+	false,				// No -C firstcpu was given, let the scheduler place threads
+	0,				// First CPU to pin to if -C was given
+	false,				// No -H, use normal pages for the per thread arenas
+	false,				// No -N, do not place threads and memory on NUMA nodes
+	false,				// No -E, time the run only at -v 1 and up
+	false,				// No -Y tracefile was given
+	NULL,				// Do not trace the run
+	false,				// No -V, do not compare with the reference implementation
 
 	// jobnumFlag, jobnum & base_seek
 	false,				// No -j jobnum was given
 	0,				// Begin at start of randdata (-j 0)
 	0,				// Default seek to 0
 
+	// checkpointFlag, checkpointCycle & resumeFlag
+	false,				// No -k chkptCycle was given
+	0,				// Do not write checkpoints
+	false,				// No -r, start from the first iteration
+
+	// memLimitFlag & memLimit
+	false,				// No -M memlimit was given
+	0,				// Keep all results in memory
+
 	// pvalues_dir & filenames
 	NULL,				// Directory where to look for the .pvalues binary files
 	NULL,				// Names of the .pvalues files
@@ -189,20 +253,29 @@ static struct state const defaultstate = {
 	 NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL,
 	},
 
-	// stats, p_val - per test dynamic arrays
+	// stats, p_val, statsIteration - per test dynamic arrays
 	{NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL,
 	 NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL,
 	},
 	{NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL,
 	 NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL,
 	},
+	{NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL,
+	 NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL,
+	},
+
+	// memo - per test p-value memos
+	{NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL,
+	 NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL,
+	},
 
 	// is_excursion
 	{false, false, false, false, false, false, false, false,
 	 false, false, false, false, true, true, false, false,
 	},
 
-	// epsilon, tmpepsilon
+	// epsilon, tmpepsilon, arena
+	NULL,
 	NULL,
 	NULL,
 
@@ -263,15 +336,10 @@ static struct state const defaultstate = {
 	NULL,
 	NULL,
 
-	// apen_C, apen_C_len
-	NULL,
-	0,
-
-	// serial_v, serial_v_len
+	// patterns
 	NULL,
-	0,
 
-	// nonper_seq
+	// nonover_stats
 	NULL,
 
 	// universal_L, universal_T
@@ -286,6 +354,41 @@ static struct state const defaultstate = {
 
 	// legacy_output
 	false,
+
+	// checkpointPath, checkpointFile, checkpointDone, checkpointPending, iterationsInFlight
+	NULL,				// No checkpoint file
+	NULL,				// Initially the checkpoint file is not open
+	0,				// No iterations checkpointed yet
+	false,				// No checkpoint waiting to be written
+	0,				// No iterations in flight
+
+	// checkpointPvals, checkpointStats
+	{0, 0, 0, 0, 0, 0, 0, 0,
+	 0, 0, 0, 0, 0, 0, 0, 0,
+	},
+	{0, 0, 0, 0, 0, 0, 0, 0,
+	 0, 0, 0, 0, 0, 0, 0, 0,
+	},
+
+	// output, resultsReserved
+	NULL,				// No -s files open
+	false,				// Results arrays may grow
+
+	// sweepCount, sweepParam, sweepValue, sweepTest, sweep, sweepInstance
+	0,				// No -W num=value was given
+	{0},				// No parameter sets
+	{0},
+	{TEST_ALL},
+	NULL,				// No run states of parameter sets
+	false,				// Not testing a -W parameter set
+
+	// tasks, taskCount
+	NULL,				// Tests of a bitstream are not split between threads
+	0,
+
+	// validate, referenceInstance
+	NULL,				// No -V run states
+	false,				// Not the reference implementation
 /* *INDENT-ON* */
 };
 
@@ -296,9 +399,9 @@ static struct state const defaultstate = {
 /* *INDENT-OFF* */
 static const char * const usage =
 "[-v level] [-A] [-t test1[,test2]..]\n"
-"             [-P num=value[,num=value]..] [-i iterations] [-I reportCycle] [-O]\n"
-"             [-w workDir] [-c] [-s] [-F format] [-j jobnum] [-S bitcount]\n"
-"             [-m mode] [-T numOfThreads] [-d pvaluesdir] [-h] [randdata]\n"
+"             [-P num=value[,num=value]..] [-W num=value[,value]..] [-i iterations] [-I reportCycle] [-O]\n"
+"             [-w workDir] [-c] [-s] [-F format] [-X xform] [-L manifest] [-j jobnum] [-S bitcount] [-k chkptCycle] [-r] [-M memlimit]\n"
+"             [-m mode] [-T numOfThreads] [-G team] [-J split] [-B] [-R readers] [-D qdepth] [-C firstcpu] [-N] [-H] [-E] [-Y tracefile] [-V] [-d pvaluesdir] [-h] [randdata]\n"
 "\n"
 "    -v  debuglevel     debug level (def: 0 -> no debug messages)\n"
 "    -A                 ask a human what to do, use obsolete interactive mode (def: batch mode)\n"
@@ -328,7 +431,11 @@ static const char * const usage =
 "       9: Bits to process per iteration (same as -S bitcount):	1048576 (== 1024*1024)\n"
 "      10: Uniformity Cutoff Level:				0.0001\n"
 "      11: Alpha Confidence Level:				0.01\n"
-"      Warning: Change the above parameters only if you really know what you are doing!\n";
+"      Warning: Change the above parameters only if you really know what you are doing!\n"
+"    -W num=value[,value]..         also test with block length parameter num (1-6 above) set to each value\n"
+"                       Each value is an extra instance of the test, run on the same bitstreams and reported in its\n"
+"                       own section of result.txt and, under -s, its own Test-P<num>=<value> directory. -W may be\n"
+"                       repeated. The Serial and Approximate Entropy instances share their pattern counts.\n";
 static const char * const usage2 =
 "\n"
 "    -i iterations      number of iterations (number of bitstreams) to test (if no -A, def: 1) (same as -P 7=iterations)\n"
@@ -341,8 +448,27 @@ static const char * const usage2 =
 "    -s                 create result.txt, data*.txt, and stats.txt (def: don't create)\n"
 "    -F format          randdata format: 'r': raw binary, 'a': ASCII '0'/'1' chars (def: 'r')\n"
 "    -S bitcount        Number of bits to process in a single iteration (def: 1048576 == 1024*1024) (same as -P 9=bitcount)\n"
+"    -X xform           transform raw binary randdata while unpacking it, xform is a comma separated list of:\n"
+"                         msb or lsb      take the bits of each sample most or least significant first (def: msb)\n"
+"                         be or le        samples are big or little endian words (def: be)\n"
+"                         word=W          samples are W bytes long, W is 1, 2, 4 or 8 (def: 1)\n"
+"                         low=K           keep only the low K bits of each sample (def: all 8*W bits)\n"
+"                         every=D         keep only the first and every D-th bit after it (def: 1: keep all)\n"
+"                       bitcount times D must be a multiple of K: each bitstream is made of whole samples.\n"
+"                       -X lsb reads the bit order written by tools/generators.c.\n"
+"    -L manifest        test each randdata listed in manifest, one path per line, instead of a randdata arg\n"
+"                       Blank lines and lines starting with # are ignored.  The sources share one set of test\n"
+"                       threads and tables, each gets its own section of result.txt and, under -s, its own\n"
+"                       sourceNNNN directory under each test directory (requires mode -m b).\n"
 "    -j jobnum          seek into randdata, jobnum * bitcount * iterations bits (def: 0)\n"
 "                       Seeking is disabled if randdata is - and data for all jobs is read from beginning of standard input.\n"
+"    -k chkptCycle      write a checkpoint under workDir after every chkptCycle completed iterations (def: 0: no checkpoints)\n"
+"                       The checkpoint file is workDir/sts.__rank__.__jobnum__.__iterations__.__bitcount__.checkpoint\n"
+"                       and is removed once the run completes.\n"
+"    -r                 resume from the checkpoint file under workDir, skipping the iterations it covers (def: start over)\n"
+"    -M memlimit        keep the scratch buffers and results under memlimit MiB of RAM (def: 0: no limit)\n"
+"                       Result arrays that do not fit are spilled to files under workDir.\n";
+static const char * const usage3 =
 "\n"
 "    -m mode            b --> test pseudo-random data from from randdata (default mode)\n"
 "                       i --> test the given data, but not assess it, and instead save the p-values in a binary filename\n"
@@ -350,6 +476,33 @@ static const char * const usage2 =
 "                       a --> collect the p-values from the binary files specified from '-d pvaluesdir' and assess them\n"
 "\n"
 "    -T numOfThreads    custom number of threads for this run (default: takes the number of cores of the CPU)\n"
+"    -G team            test each bitstream with team threads, each running some of its tests (def: 1 thread)\n"
+"                       -G 0 estimates the cost of the enabled tests and picks the team size that finishes first.\n"
+"                       Helps when there are fewer bitstreams than threads.  A team is never larger than the tests.\n"
+"    -J split           cut the work of a test on a bitstream into up to split pieces, each in a thread (def: 1)\n"
+"                       Applies to tests whose work is made of independent bits, blocks, matrices or templates,\n"
+"                       when each piece gets at least 4 Mbits of work.  Results do not depend on split.\n"
+"    -B                 test the bitstreams 64 at a time, bit-sliced, in Frequency, CumulativeSums, Runs and LongestRun\n"
+"                       (def: one at a time).  Buffers 64 bitstreams per test thread.  Not allowed with -G team.\n"
+"    -R readers         number of threads reading bitstreams ahead of the test threads (def: 1)\n"
+"                       Reading from stdin always uses 1 reader.\n"
+"    -D qdepth          read raw binary randdata around the page cache (O_DIRECT), qdepth reads in flight per reader\n"
+"                       (def: read through stdio). Meant for large captures and block devices given as randdata.\n"
+"                       Uses io_uring where available, else pread. Ignored for ASCII input and stdin.\n"
+"    -C firstcpu        pin iterate thread i to the (firstcpu+i)th of the CPUs sts may run on, modulo their number\n"
+"                       (def: do not pin threads).  Threads that cannot be pinned run unpinned.\n"
+"    -N                 place the test threads node by node on the NUMA nodes, each pinned to a CPU with its memory\n"
+"                       on its node (def: let the scheduler place threads).  Readers fill buffers on their own node,\n"
+"                       one per node by default.  Not allowed with -C firstcpu.\n"
+"    -H                 back each thread's test scratch buffers with 2 MiB huge pages (def: normal pages)\n"
+"    -E                 time each test, the waits for bitstreams and locks, the p-values and the phases of the run,\n"
+"                       and append the times to result.txt, print them under -m i (def: time the run only at -v 1 and up)\n"
+"    -Y tracefile       write the timeline of the run to tracefile as a Chrome trace, for chrome://tracing or Perfetto\n"
+"                       (def: no trace).  Has each bitstream and test of each thread, the waits, reads and phases.\n"
+"    -V                 test each bitstream again with the reference implementation of each test (def: do not):\n"
+"                       byte per bit, in one piece, no memos, the full CumulativeSums sums.  Exits 97 when counts,\n"
+"                       statistics or p-values differ, p-values by more than 4 ulp of 1.0.  Not for -W parameter sets.\n";
+static const char * const usage4 =
 "\n"
 "    -d pvaluesdir      path to the folder with the binary files with previously computed p-values (requires mode -m a)\n"
 "                       This will assess p-values found files of the form:\n"
@@ -363,10 +516,33 @@ static const char * const usage2 =
 "    -h                 print this message and exit\n"
 "\n"
 "    randdata           path to the input file to test (required for -m b and -m i, optional for -A and -m a)\n"
-"                       If randdata is -, data is read from the beginning standard input. No seek for -j jobnum is performed.\n";
+"                       If randdata is -, data is read from the beginning standard input. No seek for -j jobnum is performed.\n"
+"                       If randdata ends in .gz, .xz or .zst, it is decompressed on the fly with pigz or gzip, xz, or zstd.\n";
 /* *INDENT-ON* */
 
 
+/*
+ * default_state - set a run state to the defaults used before parsing any command line
+ *
+ * given:
+ *      state           // run state to initialize
+ *
+ * This function does not return on error.
+ */
+void
+default_state(struct state *state)
+{
+	/*
+	 * Check preconditions (firewall)
+	 */
+	if (state == NULL) {
+		err(1, __func__, "state arg is NULL");
+	}
+
+	*state = defaultstate;
+}
+
+
 /*
  * parse_args - parse command line arguments and setup run state
  *
@@ -393,6 +569,7 @@ parse_args(struct state *state, int argc, char **argv)
 	long int value;		// Parsed parameter integer value
 	double d_value;		// Parsed parameter floating point
 	bool success = false;	// true if str2longint was successful
+	bool lowBitsGiven;	// true if -X xform had a low=K
 	int test_cnt = 0;
 	long int i;
 
@@ -416,7 +593,7 @@ parse_args(struct state *state, int argc, char **argv)
 	/*
 	 * Initialize state to default state
 	 */
-	*state = defaultstate;
+	default_state(state);
 
 	/*
 	 * Parse the command line arguments
@@ -426,7 +603,7 @@ parse_args(struct state *state, int argc, char **argv)
 
 
 
-	while ((option = getopt(argc, argv, "v:Abt:g:pP:S:i:I:Ow:csf:F:j:m:T:d:h")) != -1) {
+	while ((option = getopt(argc, argv, "v:Abt:g:pP:W:S:i:I:Ow:csf:F:X:L:j:k:rM:m:T:G:J:BR:D:C:NHEY:Vd:h")) != -1) {
 
 		switch (option) {
 
@@ -555,6 +732,42 @@ parse_args(struct state *state, int argc, char **argv)
 			}
 			break;
 
+		case 'W':	// -W num=value[,value]..
+
+			/*
+			 * Parse the parameter number
+			 */
+			scan_cnt = sscanf(optarg, "%ld=", &num);
+			if (scan_cnt != 1 || strchr(optarg, '=') == NULL) {
+				usage_err(1, __func__, "-W num=value[,value].. failed to parse num=, expecting integer=: %s", optarg);
+			}
+			if (num < MIN_PARAM || num > MAX_SWEEP_PARAM) {
+				usage_err(1, __func__, "-W num=value[,value].. num: %ld must be in the range [%d-%d]", num,
+					  MIN_PARAM, MAX_SWEEP_PARAM);
+			}
+
+			/*
+			 * Add a parameter set for each comma separated value
+			 */
+			for (phrase = strtok_r(strchr(optarg, '=') + 1, ",", &brkt); phrase != NULL;
+			     phrase = strtok_r(NULL, ",", &brkt)) {
+				value = str2longint(&success, phrase);
+				if (success == false) {
+					usage_errp(1, __func__, "-W %ld=value[,value].. error in parsing value: %s", num, phrase);
+				}
+				if (value <= 0) {
+					usage_err(1, __func__, "-W %ld=value[,value].. value: %ld must be > 0", num, value);
+				}
+				if (state->sweepCount >= MAX_SWEEP) {
+					usage_err(1, __func__, "-W num=value[,value].. no more than %d parameter sets allowed", MAX_SWEEP);
+				}
+				state->sweepParam[state->sweepCount] = num;
+				state->sweepValue[state->sweepCount] = value;
+				state->sweepTest[state->sweepCount] = sweepTests[num];
+				++state->sweepCount;
+			}
+			break;
+
 		case 'p':	// -p is now obsolete because batch is the default
 			usage_err(1, __func__, "-p is no longer needed");
 			break;
@@ -632,6 +845,63 @@ parse_args(struct state *state, int argc, char **argv)
 			}
 			break;
 
+		case 'X':	// -X xform[,xform]..
+			state->xformFlag = true;
+			lowBitsGiven = false;
+			for (phrase = strtok_r(optarg, ",", &brkt); phrase != NULL; phrase = strtok_r(NULL, ",", &brkt)) {
+				if (strcmp(phrase, "msb") == 0) {
+					state->xformLsbFirst = false;
+				} else if (strcmp(phrase, "lsb") == 0) {
+					state->xformLsbFirst = true;
+				} else if (strcmp(phrase, "be") == 0) {
+					state->xformLittleEndian = false;
+				} else if (strcmp(phrase, "le") == 0) {
+					state->xformLittleEndian = true;
+				} else if (strncmp(phrase, "word=", 5) == 0) {
+					state->xformWordBytes = str2longint(&success, phrase + 5);
+					if (success == false) {
+						usage_errp(1, __func__, "-X xform: error in parsing word=W: %s", phrase);
+					}
+					if (state->xformWordBytes != 1 && state->xformWordBytes != 2 &&
+					    state->xformWordBytes != 4 && state->xformWordBytes != MAX_XFORM_WORD) {
+						usage_err(1, __func__, "-X xform: word=W: %ld must be 1, 2, 4 or 8",
+							  state->xformWordBytes);
+					}
+				} else if (strncmp(phrase, "low=", 4) == 0) {
+					state->xformLowBits = str2longint(&success, phrase + 4);
+					if (success == false) {
+						usage_errp(1, __func__, "-X xform: error in parsing low=K: %s", phrase);
+					}
+					lowBitsGiven = true;
+				} else if (strncmp(phrase, "every=", 6) == 0) {
+					state->xformDecimation = str2longint(&success, phrase + 6);
+					if (success == false) {
+						usage_errp(1, __func__, "-X xform: error in parsing every=D: %s", phrase);
+					}
+					if (state->xformDecimation < 1) {
+						usage_err(1, __func__, "-X xform: every=D: %ld must be >= 1", state->xformDecimation);
+					}
+				} else {
+					usage_err(1, __func__, "-X xform: unknown transform: %s", phrase);
+				}
+			}
+			if (lowBitsGiven == false) {
+				state->xformLowBits = state->xformWordBytes * BITS_N_BYTE;
+			}
+			if (state->xformLowBits < 1 || state->xformLowBits > state->xformWordBytes * BITS_N_BYTE) {
+				usage_err(1, __func__, "-X xform: low=K: %ld must be in the range [1, %ld]", state->xformLowBits,
+					  state->xformWordBytes * BITS_N_BYTE);
+			}
+			break;
+
+		case 'L':	// -L manifest
+			state->manifestFlag = true;
+			state->manifestPath = strdup(optarg);
+			if (state->manifestPath == NULL) {
+				errp(1, __func__, "strdup of %lu bytes for -L manifest failed", strlen(optarg));
+			}
+			break;
+
 		case 'f':
 			usage_err(1, __func__, "-f is no longer needed, instead put randdata as last argument");
 			break;
@@ -647,6 +917,32 @@ parse_args(struct state *state, int argc, char **argv)
 			}
 			break;
 
+		case 'k':	// -k chkptCycle
+			state->checkpointCycle = str2longint(&success, optarg);
+			if (success == false) {
+				usage_errp(1, __func__, "error in parsing -k chkptCycle: %s", optarg);
+			}
+			if (state->checkpointCycle < 0) {
+				usage_err(1, __func__, "-k chkptCycle: %ld must be >= 0", state->checkpointCycle);
+			}
+			state->checkpointFlag = (state->checkpointCycle > 0);
+			break;
+
+		case 'r':	// -r (resume from checkpoint)
+			state->resumeFlag = true;
+			break;
+
+		case 'M':	// -M memlimit
+			state->memLimit = str2longint(&success, optarg);
+			if (success == false) {
+				usage_errp(1, __func__, "error in parsing -M memlimit: %s", optarg);
+			}
+			if (state->memLimit < 0) {
+				usage_err(1, __func__, "-M memlimit: %ld must be >= 0", state->memLimit);
+			}
+			state->memLimitFlag = (state->memLimit > 0);
+			break;
+
 		case 'm':	// -m mode (w-->write only. i-->iterate only, a-->assess only, b-->iterate & assess)
 			state->runModeFlag = true;
 			if (optarg[0] == '\0' || optarg[1] != '\0') {
@@ -679,6 +975,89 @@ parse_args(struct state *state, int argc, char **argv)
 			}
 			break;
 
+		case 'G':	// -G team
+			state->teamFlag = true;
+			state->teamSize = str2longint(&success, optarg);
+			if (success == false) {
+				usage_errp(1, __func__, "error in parsing -G team: %s", optarg);
+			}
+			if (state->teamSize < 0) {
+				usage_err(1, __func__, "-G team: %ld must be >= 0", state->teamSize);
+			}
+			break;
+
+		case 'J':	// -J split
+			state->splitFlag = true;
+			state->splitParts = str2longint(&success, optarg);
+			if (success == false) {
+				usage_errp(1, __func__, "error in parsing -J split: %s", optarg);
+			}
+			if (state->splitParts < 1 || state->splitParts > MAX_SPLIT) {
+				usage_err(1, __func__, "-J split: %ld must be in the range [1, %d]", state->splitParts, MAX_SPLIT);
+			}
+			break;
+
+		case 'B':	// -B (test the bitstreams 64 at a time, bit-sliced)
+			state->sliceFlag = true;
+			break;
+
+		case 'R':	// -R readers
+			state->readerThreadsFlag = true;
+			state->readerThreads = str2longint(&success, optarg);
+			if (success == false) {
+				usage_errp(1, __func__, "error in parsing -R readers: %s", optarg);
+			}
+			if (state->readerThreads < 1) {
+				usage_err(1, __func__, "-R readers: %ld must be >= 1", state->readerThreads);
+			}
+			break;
+
+		case 'D':	// -D qdepth
+			state->directIOFlag = true;
+			state->directIODepth = str2longint(&success, optarg);
+			if (success == false) {
+				usage_errp(1, __func__, "error in parsing -D qdepth: %s", optarg);
+			}
+			if (state->directIODepth < 1) {
+				usage_err(1, __func__, "-D qdepth: %ld must be >= 1", state->directIODepth);
+			}
+			break;
+
+		case 'C':	// -C firstcpu
+			state->pinThreadsFlag = true;
+			state->firstCpu = str2longint(&success, optarg);
+			if (success == false) {
+				usage_errp(1, __func__, "error in parsing -C firstcpu: %s", optarg);
+			}
+			if (state->firstCpu < 0) {
+				usage_err(1, __func__, "-C firstcpu: %ld must be >= 0", state->firstCpu);
+			}
+			break;
+
+		case 'H':	// -H (back the per thread arenas with huge pages)
+			state->hugePagesFlag = true;
+			break;
+
+		case 'N':	// -N (place threads, their memory and the bitstreams they test on NUMA nodes)
+			state->numaFlag = true;
+			break;
+
+		case 'E':	// -E (time the tests and phases of the run)
+			state->timingFlag = true;
+			break;
+
+		case 'Y':	// -Y tracefile
+			state->traceFlag = true;
+			state->tracePath = strdup(optarg);
+			if (state->tracePath == NULL) {
+				errp(1, __func__, "strdup of %lu bytes for -Y tracefile failed", strlen(optarg));
+			}
+			break;
+
+		case 'V':	// -V (compare the results of each bitstream with the reference implementation)
+			state->validateFlag = true;
+			break;
+
 		case 'd':	// -d folder with precomputed .pvalues files
 			state->pvalues_dir = strdup(optarg);
 			if (state->pvalues_dir == NULL) {
@@ -688,9 +1067,9 @@ parse_args(struct state *state, int argc, char **argv)
 
 		case 'h':	// -h (print out help)
 			if (program == NULL) {
-				fprintf(stderr, "usage: sts %s%s", usage, usage2);
+				fprintf(stderr, "usage: sts %s%s%s%s", usage, usage2, usage3, usage4);
 			} else {
-				fprintf(stderr, "usage: %s %s%s", program, usage, usage2);
+				fprintf(stderr, "usage: %s %s%s%s%s", program, usage, usage2, usage3, usage4);
 			}
 			fprintf(stderr, "\nVersion: %s\n", version);
 			exit(0);
@@ -719,6 +1098,36 @@ parse_args(struct state *state, int argc, char **argv)
 	} else if (optind < argc - 1) {
 		usage_err(1, __func__, "unexpected arguments");
 	}
+
+	// -N places the threads itself
+	if (state->numaFlag == true && state->pinThreadsFlag == true) {
+		usage_err(1, __func__, "-N not allowed with -C firstcpu, -N pins the threads to the CPUs of their NUMA node");
+	}
+
+	// -B tests whole batches of bitstreams in each thread
+	if (state->sliceFlag == true && state->teamFlag == true) {
+		usage_err(1, __func__, "-B not allowed with -G team, -B tests 64 bitstreams per thread at once");
+	}
+
+	// under -L manifest, the sources listed in the manifest are the randdata, tested one after another
+	if (state->manifestFlag == true) {
+		if (state->randomDataArg == true) {
+			usage_err(1, __func__, "randdata arg not allowed with -L manifest, list it in the manifest instead");
+		}
+		if (state->batchmode == false) {
+			usage_err(1, __func__, "-A not allowed with -L manifest");
+		}
+		if (state->runMode != MODE_ITERATE_AND_ASSESS) {
+			usage_err(1, __func__, "-L manifest requires -m b, each source is iterated and assessed in turn");
+		}
+		if (state->checkpointFlag == true || state->resumeFlag == true) {
+			usage_err(1, __func__, "-k chkptCycle and -r are not allowed with -L manifest");
+		}
+		readManifest(state);
+		state->source = 0;
+		state->randomDataPath = state->sources[0];
+		state->randomDataArg = true;
+	}
 	switch (state->runMode) {
 	case MODE_ITERATE_AND_ASSESS:
 		/*FALLTHRU*/
@@ -728,6 +1137,9 @@ parse_args(struct state *state, int argc, char **argv)
 		}
 		break;
 	case MODE_ASSESS_ONLY:
+		if (state->checkpointFlag == true || state->resumeFlag == true) {
+			usage_err(1, __func__, "-k chkptCycle and -r are not allowed with -m a, there are no iterations to checkpoint");
+		}
 		break;
 	default:
 		err(1, __func__, "unknown run mode: %u", state->runMode);
@@ -744,6 +1156,9 @@ parse_args(struct state *state, int argc, char **argv)
 			usage_err(1, __func__, "-i bitstreams or -m a requited when randdata is - "
 					       "(reading data from standard input)");
 		}
+		if (state->resumeFlag == true) {
+			usage_err(1, __func__, "-r not allowed when randdata is - (cannot skip checkpointed data on standard input)");
+		}
 	}
 
 	/*
@@ -772,6 +1187,27 @@ parse_args(struct state *state, int argc, char **argv)
 		}
 	}
 
+	/*
+	 * Each -W parameter set is an extra instance of an enabled test, iterated and assessed with it
+	 */
+	if (state->sweepCount > 0) {
+		if (state->batchmode == false) {
+			usage_err(1, __func__, "-A not allowed with -W num=value");
+		}
+		if (state->runMode != MODE_ITERATE_AND_ASSESS) {
+			usage_err(1, __func__, "-W num=value requires -m b, parameter sets are assessed with the tests they change");
+		}
+		if (state->checkpointFlag == true || state->resumeFlag == true) {
+			usage_err(1, __func__, "-k chkptCycle and -r are not allowed with -W num=value");
+		}
+		for (i = 0; i < state->sweepCount; i++) {
+			if (state->testVector[state->sweepTest[i]] != true) {
+				usage_err(1, __func__, "-W %ld=%ld: test %s[%d] is not enabled", state->sweepParam[i], state->sweepValue[i],
+					  state->testNames[state->sweepTest[i]], state->sweepTest[i]);
+			}
+		}
+	}
+
 	/*
 	 * Count the number of tests enabled
 	 *
@@ -809,9 +1245,13 @@ parse_args(struct state *state, int argc, char **argv)
 	/*
 	 * If no custom number of threads was set, set the number of threads to be equal to the minimum
 	 * between the number of bitstreams and the number of cores of the computer where sts is running.
+	 * Under -G team, threads can share a bitstream: init() trims the threads once it knows the team size.
 	 */
 	else if (state->numberOfThreadsFlag == false) {
-		state->numberOfThreads = MIN(sysconf(_SC_NPROCESSORS_ONLN), state->tp.numOfBitStreams);
+		state->numberOfThreads = sysconf(_SC_NPROCESSORS_ONLN);
+		if (state->teamFlag == false) {
+			state->numberOfThreads = MIN(state->numberOfThreads, state->tp.numOfBitStreams);
+		}
 	}
 
 	/*
@@ -828,7 +1268,8 @@ parse_args(struct state *state, int argc, char **argv)
 	 * If a custom number of threads was set and this number is greater than the number of bitstreams
 	 * (aka iterations) set, fire a warning to the user that only $numOfBitstreams threads will be used.
 	 */
-	if (state->numberOfThreadsFlag == true && state->numberOfThreads > state->tp.numOfBitStreams) {
+	if (state->numberOfThreadsFlag == true && state->teamFlag == false &&
+	    state->numberOfThreads > state->tp.numOfBitStreams) {
 		warn(__func__, "You chose to use %ld threads. However this number is greater than the number of bitstreams, which"
 				     " you set to %ld. Therefore only %ld threads will be used.", state->numberOfThreads,
 		     state->tp.numOfBitStreams, state->tp.numOfBitStreams);
@@ -937,6 +1378,13 @@ parse_args(struct state *state, int argc, char **argv)
 		}
 	}
 
+	/*
+	 * -X xform transforms raw binary data
+	 */
+	if (state->xformFlag == true && state->dataFormatFlag == true && state->dataFormat == FORMAT_ASCII_01) {
+		usage_err(1, __func__, "-X xform only applies to raw binary data, not to -F a");
+	}
+
 	/*
 	 * verify that bitcount is OK
 	 */
@@ -1017,6 +1465,99 @@ change_params(struct state *state, long int parameter, long int value, double d_
 	return;
 }
 
+
+/*
+ * readManifest - read the randdata of each source listed in a -L manifest
+ *
+ * given:
+ *      state           // run state with manifestPath set
+ *
+ * The manifest lists one randdata path per line.  Leading and trailing whitespace is
+ * ignored, as are blank lines and lines starting with #.  Every source must be a
+ * readable file, so that a typo late in a long manifest is found before testing starts.
+ *
+ * This function does not return on error.
+ */
+static void
+readManifest(struct state *state)
+{
+	FILE *manifest;		// Open manifest file
+	char *line = NULL;	// != NULL --> malloced / realloced line buffer
+	size_t buflen = 0;	// Ignored when line == NULL
+	ssize_t linelen;	// Length of line read from the manifest
+	long int lineno = 0;	// Line number in the manifest
+	long int allocated = 0;	// Number of sources allocated
+	char *path;		// Start of the path on a line
+	char **sources;		// Realloced sources
+	struct stat statbuf;	// Status of a source
+
+	/*
+	 * Check preconditions (firewall)
+	 */
+	if (state == NULL) {
+		err(4, __func__, "state arg is NULL");
+	}
+	if (state->manifestPath == NULL) {
+		err(4, __func__, "manifestPath is NULL");
+	}
+
+	/*
+	 * Read the path on each line
+	 */
+	manifest = fopen(state->manifestPath, "r");
+	if (manifest == NULL) {
+		usage_errp(4, __func__, "-L manifest: cannot open: %s", state->manifestPath);
+	}
+	while ((linelen = getline(&line, &buflen, manifest)) >= 0) {
+		++lineno;
+
+		// trim whitespace, skip blank lines and comments
+		while (linelen > 0 && isspace((unsigned char) line[linelen - 1])) {
+			line[--linelen] = '\0';
+		}
+		for (path = line; isspace((unsigned char) *path); ++path) {
+		}
+		if (*path == '\0' || *path == '#') {
+			continue;
+		}
+		if (strcmp(path, "-") == 0) {
+			usage_err(4, __func__, "-L manifest: %s line %ld: randdata - (standard input) is not allowed",
+				  state->manifestPath, lineno);
+		}
+		if (checkReadPermissions(path) == false || (stat(path, &statbuf) == 0 && S_ISDIR(statbuf.st_mode))) {
+			usage_err(4, __func__, "-L manifest: %s line %ld: randdata not a readable file: %s",
+				  state->manifestPath, lineno, path);
+		}
+
+		// add the source
+		if (state->sourceCount >= allocated) {
+			allocated = (allocated == 0) ? BUFSIZ / sizeof(char *) : 2 * allocated;
+			sources = realloc(state->sources, allocated * sizeof(state->sources[0]));
+			if (sources == NULL) {
+				errp(4, __func__, "cannot realloc %ld manifest sources", allocated);
+			}
+			state->sources = sources;
+		}
+		state->sources[state->sourceCount] = strdup(path);
+		if (state->sources[state->sourceCount] == NULL) {
+			errp(4, __func__, "strdup of %lu bytes for manifest source failed", strlen(path));
+		}
+		++state->sourceCount;
+	}
+	if (ferror(manifest)) {
+		errp(4, __func__, "error reading -L manifest: %s", state->manifestPath);
+	}
+	fclose(manifest);
+	free(line);
+
+	if (state->sourceCount == 0) {
+		usage_err(4, __func__, "-L manifest: %s lists no randdata", state->manifestPath);
+	}
+	dbg(DBG_LOW, "-L manifest: %s lists %ld sources", state->manifestPath, state->sourceCount);
+
+	return;
+}
+
 void
 print_option_summary(struct state *state, char *where)
 {
@@ -1183,6 +1724,30 @@ print_option_summary(struct state *state, char *where)
 		dbg(DBG_MED, "\t  unknown format: %c", (char) state->dataFormat);
 		break;
 	}
+	if (state->xformFlag == true) {
+		dbg(DBG_MED, "\t-X xform was given");
+		dbg(DBG_MED, "\t  raw binary samples of %ld %s endian bytes, keep the low %ld bits %s first, "
+		    "then every %ld-th bit", state->xformWordBytes, state->xformLittleEndian == true ? "little" : "big",
+		    state->xformLowBits, state->xformLsbFirst == true ? "least significant" : "most significant",
+		    state->xformDecimation);
+	} else {
+		dbg(DBG_MED, "\tno -X xform was given");
+	}
+	if (state->sweepCount > 0) {
+		dbg(DBG_MED, "\t-W num=value was given");
+		for (j = 0; j < state->sweepCount; j++) {
+			dbg(DBG_MED, "\t  will also test %s[%d] with -P %ld=%ld", state->testNames[state->sweepTest[j]],
+			    state->sweepTest[j], state->sweepParam[j], state->sweepValue[j]);
+		}
+	} else {
+		dbg(DBG_MED, "\tno -W num=value was given");
+	}
+	if (state->manifestFlag == true) {
+		dbg(DBG_MED, "\t-L manifest was given: %s", state->manifestPath);
+		dbg(DBG_MED, "\t  will test %ld sources, now testing source %ld", state->sourceCount, state->source + 1);
+	} else {
+		dbg(DBG_MED, "\tno -L manifest was given");
+	}
 	dbg(DBG_MED, "\tjobnum: -j %ld", state->jobnum);
 	if (state->jobnumFlag == true) {
 		dbg(DBG_MED, "\t-j jobnum was set to %ld", state->jobnum);
@@ -1205,6 +1770,105 @@ print_option_summary(struct state *state, char *where)
 		dbg(DBG_MED, "\tno -T numOfThreads was given");
 	}
 	dbg(DBG_MED, "\t  will use %ld threads\n", state->numberOfThreads);
+	if (state->teamFlag == true) {
+		dbg(DBG_MED, "\t-G team was given");
+		if (state->teamSize == 0) {
+			dbg(DBG_MED, "\t  will let a cost model pick the threads testing each bitstream\n");
+		} else {
+			dbg(DBG_MED, "\t  will test each bitstream with up to %ld threads\n", state->teamSize);
+		}
+	} else {
+		dbg(DBG_MED, "\tno -G team was given");
+		dbg(DBG_MED, "\t  will test each bitstream with one thread\n");
+	}
+	if (state->splitFlag == true) {
+		dbg(DBG_MED, "\t-J split was given");
+		dbg(DBG_MED, "\t  will cut the work of a test on a bitstream into up to %ld pieces\n", state->splitParts);
+	} else {
+		dbg(DBG_MED, "\tno -J split was given");
+		dbg(DBG_MED, "\t  will test each bitstream in one piece\n");
+	}
+	if (state->sliceFlag == true) {
+		dbg(DBG_MED, "\t-B was given");
+		dbg(DBG_MED, "\t  will test the bitstreams %d at a time, bit-sliced\n", SLICE_LANES);
+	} else {
+		dbg(DBG_MED, "\tno -B was given");
+		dbg(DBG_MED, "\t  will test the bitstreams one at a time\n");
+	}
+	if (state->readerThreadsFlag == true) {
+		dbg(DBG_MED, "\t-R readers was given");
+	} else {
+		dbg(DBG_MED, "\tno -R readers was given");
+	}
+	dbg(DBG_MED, "\t  will read bitstreams with %ld threads\n", state->stdinData == true ? 1 : state->readerThreads);
+	if (state->directIOFlag == true) {
+		dbg(DBG_MED, "\t-D qdepth was given");
+		dbg(DBG_MED, "\t  will read raw binary randdata with direct I/O, %ld reads in flight per reader\n",
+		    state->directIODepth);
+	} else {
+		dbg(DBG_MED, "\tno -D qdepth was given\n");
+	}
+	if (state->checkpointFlag == true) {
+		dbg(DBG_MED, "\t-k chkptCycle was given");
+		dbg(DBG_MED, "\t  will checkpoint every %ld iterations", state->checkpointCycle);
+	} else {
+		dbg(DBG_MED, "\tno -k chkptCycle was given");
+		dbg(DBG_MED, "\t  will not checkpoint");
+	}
+	if (state->resumeFlag == true) {
+		dbg(DBG_MED, "\t-r was given");
+		dbg(DBG_MED, "\t  will resume from the checkpoint file under workDir");
+	}
+	if (state->memLimitFlag == true) {
+		dbg(DBG_MED, "\t-M memlimit was given");
+		dbg(DBG_MED, "\t  will spill results that do not fit in %ld MiB", state->memLimit);
+	} else {
+		dbg(DBG_MED, "\tno -M memlimit was given");
+		dbg(DBG_MED, "\t  will keep all results in memory");
+	}
+	if (state->pinThreadsFlag == true) {
+		dbg(DBG_MED, "\t-C firstcpu was given");
+		dbg(DBG_MED, "\t  will pin threads to CPUs %ld thru %ld of those we may run on\n", state->firstCpu,
+		    state->firstCpu + state->numberOfThreads - 1);
+	} else {
+		dbg(DBG_MED, "\tno -C firstcpu was given");
+		dbg(DBG_MED, "\t  will not pin threads\n");
+	}
+	if (state->numaFlag == true) {
+		dbg(DBG_MED, "\t-N was given");
+		dbg(DBG_MED, "\t  will place threads and their memory on NUMA nodes\n");
+	} else {
+		dbg(DBG_MED, "\tno -N was given");
+		dbg(DBG_MED, "\t  will not place threads on NUMA nodes\n");
+	}
+	if (state->hugePagesFlag == true) {
+		dbg(DBG_MED, "\t-H was given");
+		dbg(DBG_MED, "\t  will use huge pages for the per thread arenas\n");
+	} else {
+		dbg(DBG_MED, "\tno -H was given");
+		dbg(DBG_MED, "\t  will use normal pages for the per thread arenas\n");
+	}
+	if (state->timingFlag == true) {
+		dbg(DBG_MED, "\t-E was given");
+		dbg(DBG_MED, "\t  will report the time of each test and phase in the final results file\n");
+	} else {
+		dbg(DBG_MED, "\tno -E was given");
+		dbg(DBG_MED, "\t  will time the tests and phases at -v 1 and up only\n");
+	}
+	if (state->traceFlag == true) {
+		dbg(DBG_MED, "\t-Y %s was given", state->tracePath);
+		dbg(DBG_MED, "\t  will write the timeline of the run to %s\n", state->tracePath);
+	} else {
+		dbg(DBG_MED, "\tno -Y tracefile was given");
+		dbg(DBG_MED, "\t  will not trace the run\n");
+	}
+	if (state->validateFlag == true) {
+		dbg(DBG_MED, "\t-V was given");
+		dbg(DBG_MED, "\t  will compare the results of each bitstream with the reference implementation\n");
+	} else {
+		dbg(DBG_MED, "\tno -V was given");
+		dbg(DBG_MED, "\t  will not compare with the reference implementation\n");
+	}
 
 	/*
 	 * Report on test parameters
@@ -0,0 +1,737 @@
+// reader.c - read bitstreams ahead of the iterate threads
+
+/*
+ * This code has been heavily modified by the following people:
+ *
+ *      Landon Curt Noll
+ *      Tom Gilgan
+ *      Riccardo Paccagnella
+ *
+ * See the README.md and the initial comment in sts.c for more information.
+ *
+ * WE (THOSE LISTED ABOVE WHO HEAVILY MODIFIED THIS CODE) DISCLAIM ALL
+ * WARRANTIES WITH REGARD TO THIS SOFTWARE, INCLUDING ALL IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL WE (THOSE LISTED ABOVE
+ * WHO HEAVILY MODIFIED THIS CODE) BE LIABLE FOR ANY SPECIAL, INDIRECT OR
+ * CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF
+ * USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ *
+ * chongo (Landon Curt Noll, http://www.isthe.com/chongo/index.html) /\oo/\
+ *
+ * Share and enjoy! :-)
+ */
+
+
+
+// Exit codes: 80 thru 84
+
+/*
+ * Rather than having each iterate thread read and convert its bitstream while holding the iterate
+ * mutex, -R readers reader threads read bitstreams ahead of the iterate threads into a bounded ring
+ * of buffers.  The iterate threads then only take turns to claim an iteration number, input I/O
+ * overlaps with testing, and so does reading from stdin.
+ *
+ * Iteration i is read into slot i % slots.  Reader r reads iterations r, r + readers, ... in order,
+ * each reader through its own stream (a single reader for stdin).  The number of slots is a multiple
+ * of the number of readers, so every slot is only ever filled by the same reader.  An iterate thread
+ * that claimed iteration i waits until slot i % slots holds it, tests the bits in place and then
+ * frees the slot for iteration i + slots.  A reader waits for its next slot to be freed, so no more
+ * than slots bitstreams are ever buffered, no matter how fast the input can be read.
+ *
+ * The iteration a slot holds is published with release/acquire atomics: an iterate thread whose
+ * bitstream is already read takes no lock.  The ring mutex is only used to sleep, either when a
+ * bitstream was not read yet (a stall: the tests outran the input), or when a reader finds its next
+ * slot still in use (the ring is full: the tests are the bottleneck).  Both are counted and reported
+ * at the end of the iterate phase.
+ *
+ * Compressed randdata is read through a decompressor, see decompress.c, by a single reader.
+ *
+ * Under -D qdepth, raw binary randdata is read around the page cache, see direct.c.  Each reader
+ * then keeps its next qdepth bitstreams in flight, ahead of the slots they are unpacked into.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+#include "../utils/externs.h"
+#include "utilities.h"
+#include "reader.h"
+#include "direct.h"
+#include "decompress.h"
+#include "transform.h"
+#include "numa.h"
+#include "slice.h"
+#include "timing.h"
+#include "debug.h"
+
+
+/*
+ * reader_arg - what a reader thread reads
+ */
+struct reader_arg {
+	struct state *state;		// run state
+	long int id;			// reader number, reads iterations id, id + readers, ...
+	FILE *stream;			// stream the reader reads from
+	bool seekable;			// false ==> stream is read in order, without seeking
+	BYTE *bytes;			// raw binary bytes of one bitstream, NULL for ASCII input
+	struct direct_io *dio;		// -D qdepth direct reads, NULL ==> read stream
+	struct thread_state track;	// the reader to timing.c and trace.c: thread_id -1 - id
+};
+
+
+/*
+ * The ring, while the iterate phase runs
+ */
+static struct ring_slot *ring = NULL;				// the slots, NULL ==> no ring
+static long int ring_slots = 0;					// number of slots
+static long int ring_readers = 0;				// number of reader threads
+static long int ring_first = 0;					// first iteration to read
+static long int ring_end = 0;					// iterations up to but not including ring_end are read
+static long int ring_logged = 0;				// next iteration whose counts go to freq.txt (-O)
+static pthread_t *reader_thread = NULL;				// reader threads
+static struct reader_arg *reader_args = NULL;			// what each reader thread reads
+static pthread_mutex_t ring_mutex = PTHREAD_MUTEX_INITIALIZER;	// held to sleep on ring_cond
+static pthread_cond_t ring_cond = PTHREAD_COND_INITIALIZER;	// signaled when a slot is filled or freed
+static long int ring_sleepers = 0;				// threads waiting on ring_cond (accessed atomically)
+static long int ring_stalls = 0;				// bitstreams an iterate thread had to wait for
+static double ring_stall_time = 0.0;				// seconds iterate threads waited for bitstreams
+static long int ring_full = 0;					// times a reader had to wait for a free slot
+
+
+/*
+ * Forward static function declarations
+ */
+static long int reader_count(struct state *state);
+static void ring_wake(void);
+static long int ring_wait(struct ring_slot *slot, long int iteration);
+static void read_ascii(struct reader_arg *arg, struct ring_slot *slot, long int iteration);
+static void read_binary(struct reader_arg *arg, struct ring_slot *slot, long int iteration);
+static void log_counts(struct state *state, struct ring_slot *slot, long int iteration);
+static void direct_reader(struct reader_arg *arg);
+static void *reader(void *thread_arg);
+
+
+/*
+ * reader_count - determine the number of reader threads
+ *
+ * given:
+ *      state           // run state
+ *
+ * returns:
+ *      Number of readers: 1 for stdin and compressed randdata, else -R readers,
+ *      or under -N without -R, one per NUMA node.
+ */
+static long int
+reader_count(struct state *state)
+{
+	if (state->stdinData == true || decompress_wanted(state) == true) {
+		return 1;
+	}
+	if (state->numaFlag == true && state->readerThreadsFlag == false) {
+		return MAX(numa_nodes(state), 1);
+	}
+	return MAX(state->readerThreads, 1);
+}
+
+
+/*
+ * reader_ring_size - determine the bytes of bitstreams the readers buffer
+ *
+ * given:
+ *      state           // run state
+ *
+ * returns:
+ *      Bytes the ring buffers will take during the iterate phase.
+ */
+long int
+reader_ring_size(struct state *state)
+{
+	long int readers;	// Number of reader threads
+	long int slots;		// Number of slots in the ring
+	long int size;		// Bytes of the ring and reader buffers
+
+	/*
+	 * Check preconditions (firewall)
+	 */
+	if (state == NULL) {
+		err(80, __func__, "state arg is NULL");
+	}
+
+	readers = reader_count(state);
+	slots = (((READER_AHEAD + slice_lanes(state) - 1) * state->numberOfThreads + readers - 1) / readers) * readers;
+
+	size = MAX(slots, readers) * state->tp.n * (long int) sizeof(BitSequence);
+	if (direct_wanted(state) == true) {
+		size += readers * direct_size(state);
+	} else if (state->dataFormat != FORMAT_ASCII_01) {
+		size += readers * transform_bytes(state);
+	}
+
+	return size;
+}
+
+
+/*
+ * ring_wake - wake up the threads sleeping on the ring, if any
+ *
+ * NOTE: Called after a slot was filled or freed.
+ */
+static void
+ring_wake(void)
+{
+	if (__atomic_load_n(&ring_sleepers, __ATOMIC_SEQ_CST) > 0) {
+		pthread_mutex_lock(&ring_mutex);
+		pthread_cond_broadcast(&ring_cond);
+		pthread_mutex_unlock(&ring_mutex);
+	}
+}
+
+
+/*
+ * ring_wait - sleep until a slot holds a given iteration (-1: until it is free)
+ *
+ * given:
+ *      slot            // slot to watch
+ *      iteration       // iteration to wait for, or -1
+ *
+ * returns:
+ *      0 if the slot already held iteration, else 1
+ */
+static long int
+ring_wait(struct ring_slot *slot, long int iteration)
+{
+	if (__atomic_load_n(&slot->iteration, __ATOMIC_ACQUIRE) == iteration) {
+		return 0;
+	}
+
+	pthread_mutex_lock(&ring_mutex);
+	__atomic_add_fetch(&ring_sleepers, 1, __ATOMIC_SEQ_CST);
+	while (__atomic_load_n(&slot->iteration, __ATOMIC_SEQ_CST) != iteration) {
+		pthread_cond_wait(&ring_cond, &ring_mutex);
+	}
+	__atomic_sub_fetch(&ring_sleepers, 1, __ATOMIC_SEQ_CST);
+	pthread_mutex_unlock(&ring_mutex);
+
+	return 1;
+}
+
+
+/*
+ * read_ascii - read a bitstream of ASCII '0' and '1' characters into a slot
+ *
+ * given:
+ *      arg             // reader and its stream
+ *      slot            // slot to read into
+ *      iteration       // iteration whose bitstream to read
+ */
+static void
+read_ascii(struct reader_arg *arg, struct ring_slot *slot, long int iteration)
+{
+	struct state *state = arg->state;
+	long int i;
+	int bit;
+	int io_ret;		// I/O return status
+
+	/*
+	 * If not reading randdata from stdin or a decompressor,
+	 * Seek to the position of the first bit which has not been copied into the stream yet
+	 */
+	if (arg->seekable == true &&
+	    fseek(arg->stream, state->base_seek + iteration * state->tp.n, SEEK_SET) != 0) {
+		errp(81, __func__, "could not seek %ld further into file: %s",
+		     (iteration * state->tp.n), state->randomDataPath);
+	}
+
+	/*
+	 * Copy the next n bits from the stream to the slot
+	 */
+	slot->num_0s = 0;
+	slot->num_1s = 0;
+	slot->bitsRead = 0;
+	clearerr(arg->stream);
+	for (i = 0; i < state->tp.n; i++) {
+		io_ret = fscanf(arg->stream, "%1d", &bit);
+		if (io_ret == EOF) {
+			warn(__func__, "Insufficient data in file %s: %ld bits were read", state->randomDataPath,
+			     slot->bitsRead);
+			return;
+		} else {
+			slot->bitsRead++;
+			if (bit == 0) {
+				slot->num_0s++;
+			} else {
+				slot->num_1s++;
+			}
+			slot->bits[i] = (BitSequence) bit;
+		}
+	}
+}
+
+
+/*
+ * read_binary - read a bitstream of raw binary bytes into a slot
+ *
+ * given:
+ *      arg             // reader and its stream
+ *      slot            // slot to read into
+ *      iteration       // iteration whose bitstream to read
+ */
+static void
+read_binary(struct reader_arg *arg, struct ring_slot *slot, long int iteration)
+{
+	struct state *state = arg->state;
+	size_t bytes;		// Number of bytes holding a bitstream
+	size_t got;		// Number of bytes read
+
+	/*
+	 * If not reading randdata from stdin or a decompressor,
+	 * Seek to the position of the first bit which has not been copied into the stream yet
+	 */
+	if (arg->seekable == true &&
+	    fseek(arg->stream, state->base_seek + iteration * transform_bytes(state), SEEK_SET) != 0) {
+		errp(82, __func__, "could not seek %ld further into file: %s",
+		     iteration * transform_bytes(state), state->randomDataPath);
+	}
+
+	/*
+	 * Read all the bytes of the bitstream at once
+	 */
+	bytes = (size_t) transform_bytes(state);
+	clearerr(arg->stream);
+	got = fread(arg->bytes, 1, bytes, arg->stream);
+	if (got < bytes) {
+		if (ferror(arg->stream)) {
+			errp(82, __func__, "read error while reading file: %s", state->randomDataPath);
+		}
+		err(82, __func__, "encounted EOF (end of file) while reading file: %s: %lu bits were read before EOF",
+		    state->randomDataPath, got * BITS_N_BYTE);
+	}
+
+	/*
+	 * Unpack the bits into the slot
+	 */
+	slot->num_0s = 0;
+	slot->num_1s = 0;
+	slot->bitsRead = 0;
+	transform_bits(state, slot->bits, arg->bytes, &slot->num_0s, &slot->num_1s, &slot->bitsRead);
+}
+
+
+/*
+ * log_counts - write the bit counts of a bitstream to freq.txt, in iteration order
+ *
+ * given:
+ *      state           // run state
+ *      slot            // slot holding the bitstream
+ *      iteration       // iteration of the bitstream
+ *
+ * Only done in legacy_output mode.
+ */
+static void
+log_counts(struct state *state, struct ring_slot *slot, long int iteration)
+{
+	int io_ret;		// I/O return status
+
+	/*
+	 * Wait for the readers of the previous iterations to log theirs
+	 */
+	pthread_mutex_lock(&ring_mutex);
+	while (ring_logged != iteration) {
+		__atomic_add_fetch(&ring_sleepers, 1, __ATOMIC_SEQ_CST);
+		pthread_cond_wait(&ring_cond, &ring_mutex);
+		__atomic_sub_fetch(&ring_sleepers, 1, __ATOMIC_SEQ_CST);
+	}
+
+	io_ret = fprintf(state->freqFile, "\t\tBITSREAD = %ld 0s = %ld 1s = %ld\n", slot->bitsRead, slot->num_0s,
+			 slot->num_1s);
+	if (io_ret <= 0) {
+		errp(83, __func__, "error in writing to %s", state->freqFilePath);
+	}
+	io_ret = fflush(state->freqFile);
+	if (io_ret != 0) {
+		errp(83, __func__, "error flushing to %s", state->freqFilePath);
+	}
+
+	ring_logged++;
+	pthread_cond_broadcast(&ring_cond);
+	pthread_mutex_unlock(&ring_mutex);
+}
+
+
+/*
+ * reader - body of a reader thread
+ *
+ * given:
+ *      thread_arg      // struct reader_arg of this reader
+ */
+static void *
+reader(void *thread_arg)
+{
+	struct reader_arg *arg = (struct reader_arg *) thread_arg;
+	struct state *state = arg->state;
+	struct ring_slot *slot;		// slot of the iteration being read
+	uint64_t start;			// ticks when the read started
+	long int i;
+
+	dbg(DBG_HIGH, "Reader thread %ld started.", arg->id);
+	if (arg->dio != NULL) {
+		direct_reader(arg);
+		dbg(DBG_HIGH, "Reader thread %ld done.", arg->id);
+		return NULL;
+	}
+	for (i = ring_first + arg->id; i < ring_end; i += ring_readers) {
+
+		/*
+		 * Wait for the slot to be freed by iteration i - slots
+		 */
+		slot = &ring[i % ring_slots];
+		if (ring_wait(slot, -1) > 0) {
+			__atomic_add_fetch(&ring_full, 1, __ATOMIC_RELAXED);
+		}
+
+		/*
+		 * Read the bitstream and let the iterate threads have it
+		 */
+		start = timing_start();
+		if (state->dataFormat == FORMAT_ASCII_01) {
+			read_ascii(arg, slot, i);
+		} else {
+			read_binary(arg, slot, i);
+		}
+		arg->track.iteration_being_done = i;
+		timing_stop(&arg->track, TIMING_READ, start);
+		if (state->legacy_output == true) {
+			log_counts(state, slot, i);
+		}
+		__atomic_store_n(&slot->iteration, i, __ATOMIC_SEQ_CST);
+		ring_wake();
+	}
+	dbg(DBG_HIGH, "Reader thread %ld done.", arg->id);
+
+	return NULL;
+}
+
+
+/*
+ * direct_reader - body of a reader thread reading with -D qdepth direct I/O
+ *
+ * given:
+ *      arg             // reader and its direct I/O descriptor
+ *
+ * The reads of the next qdepth bitstreams of this reader are kept in flight.  The buffer of a
+ * bitstream is read into again once it was unpacked into its slot.
+ */
+static void
+direct_reader(struct reader_arg *arg)
+{
+	struct state *state = arg->state;
+	struct ring_slot *slot;		// slot of the iteration being read
+	long int depth;			// reads in flight
+	long int stride;		// iterations from one bitstream of this reader to the next
+	long int buf;			// buffer of the iteration being read
+	BYTE *bytes;			// bytes of the bitstream being read
+	uint64_t start;			// ticks when the read started
+	long int i;
+	long int k;
+
+	/*
+	 * Start reading our first qdepth bitstreams
+	 */
+	depth = state->directIODepth;
+	stride = depth * ring_readers;
+	for (k = 0, i = ring_first + arg->id; k < depth && i < ring_end; k++, i += ring_readers) {
+		direct_read(arg->dio, k, state->base_seek + i * transform_bytes(state));
+	}
+
+	for (k = 0, i = ring_first + arg->id; i < ring_end; k++, i += ring_readers) {
+		buf = k % depth;
+		start = timing_start();
+		bytes = direct_wait(arg->dio, buf);
+		arg->track.iteration_being_done = i;
+		timing_stop(&arg->track, TIMING_READ, start);
+
+		/*
+		 * Wait for the slot to be freed by iteration i - slots
+		 */
+		slot = &ring[i % ring_slots];
+		if (ring_wait(slot, -1) > 0) {
+			__atomic_add_fetch(&ring_full, 1, __ATOMIC_RELAXED);
+		}
+
+		/*
+		 * Unpack the bits into the slot, then reuse the buffer for our bitstream qdepth ahead
+		 */
+		start = timing_start();
+		slot->num_0s = 0;
+		slot->num_1s = 0;
+		slot->bitsRead = 0;
+		transform_bits(state, slot->bits, bytes, &slot->num_0s, &slot->num_1s, &slot->bitsRead);
+		if (i + stride < ring_end) {
+			direct_read(arg->dio, buf, state->base_seek + (i + stride) * transform_bytes(state));
+		}
+		timing_stop(&arg->track, TIMING_READ, start);
+
+		/*
+		 * Let the iterate threads have it
+		 */
+		if (state->legacy_output == true) {
+			log_counts(state, slot, i);
+		}
+		__atomic_store_n(&slot->iteration, i, __ATOMIC_SEQ_CST);
+		ring_wake();
+	}
+}
+
+
+/*
+ * reader_start - start reading the bitstreams of the iterations left to do
+ *
+ * given:
+ *      state           // run state with state->streamFile open
+ *
+ * This function does not return on error.
+ */
+void
+reader_start(struct state *state)
+{
+	pthread_attr_t attr;	// attributes of a reader thread
+	long int offset;	// Bytes of randdata before the first iteration to read
+	long int i;
+	int io_ret;		// pthread return status
+
+	/*
+	 * Check preconditions (firewall)
+	 */
+	if (state == NULL) {
+		err(84, __func__, "state arg is NULL");
+	}
+	if (state->streamFile == NULL) {
+		err(84, __func__, "streamFile is NULL");
+	}
+	if (ring != NULL) {
+		err(84, __func__, "readers are already running");
+	}
+	ring_first = state->tp.numOfBitStreams - state->iterationsMissing;
+	ring_end = state->tp.numOfBitStreams;
+	ring_logged = ring_first;
+
+	/*
+	 * Size the ring, under -B each iterate thread holds the bitstreams of a whole batch at once
+	 */
+	ring_readers = MAX(MIN(reader_count(state), state->iterationsMissing), 1);
+	ring_slots = (((READER_AHEAD + slice_lanes(state) - 1) * state->numberOfThreads + ring_readers - 1) /
+		      ring_readers) * ring_readers;
+	ring_slots = MAX(ring_slots, ring_readers);
+	ring = calloc((size_t) ring_slots, sizeof(ring[0]));
+	if (ring == NULL) {
+		errp(84, __func__, "cannot calloc %ld ring slots", ring_slots);
+	}
+	for (i = 0; i < ring_slots; i++) {
+		ring[i].bits = malloc((size_t) state->tp.n * sizeof(BitSequence));
+		if (ring[i].bits == NULL) {
+			errp(84, __func__, "cannot malloc ring slot of %ld bits", state->tp.n);
+		}
+		ring[i].iteration = -1;
+		ring[i].node = numa_reader_node(state, i % ring_readers);
+		numa_bind(state, ring[i].bits, (size_t) state->tp.n * sizeof(BitSequence), ring[i].node);
+	}
+	ring_stalls = 0;
+	ring_stall_time = 0.0;
+	ring_full = 0;
+	dbg(DBG_MED, "%ld readers buffer up to %ld bitstreams", ring_readers, ring_slots);
+
+	/*
+	 * Start the readers, each with its own stream
+	 */
+	reader_thread = malloc((size_t) ring_readers * sizeof(reader_thread[0]));
+	reader_args = calloc((size_t) ring_readers, sizeof(reader_args[0]));
+	if (reader_thread == NULL || reader_args == NULL) {
+		errp(84, __func__, "cannot allocate %ld reader threads", ring_readers);
+	}
+	for (i = 0; i < ring_readers; i++) {
+		reader_args[i].state = state;
+		reader_args[i].id = i;
+		reader_args[i].track.thread_id = -1 - i;
+		reader_args[i].track.global_state = state;
+		reader_args[i].track.iteration_being_done = -1;
+		reader_args[i].track.mutex = NULL;
+		reader_args[i].track.lane = NULL;
+		reader_args[i].seekable = (state->stdinData == false);
+		if (decompress_wanted(state) == true) {
+			offset = (state->dataFormat == FORMAT_ASCII_01) ? ring_first * state->tp.n :
+				ring_first * transform_bytes(state);
+			reader_args[i].stream = decompress_open(state, state->base_seek + offset);
+			reader_args[i].seekable = false;
+		} else if (i == 0) {
+			reader_args[i].stream = state->streamFile;
+		} else {
+			reader_args[i].stream = fopen(state->randomDataPath, "r");
+			if (reader_args[i].stream == NULL) {
+				errp(84, __func__, "cannot open for reader %ld: %s", i, state->randomDataPath);
+			}
+		}
+		if (direct_wanted(state) == true) {
+			reader_args[i].dio = direct_open(state, state->directIODepth);
+		} else if (state->dataFormat != FORMAT_ASCII_01) {
+			reader_args[i].bytes = malloc((size_t) transform_bytes(state));
+			if (reader_args[i].bytes == NULL) {
+				errp(84, __func__, "cannot malloc the input buffer of reader %ld", i);
+			}
+			numa_bind(state, reader_args[i].bytes, (size_t) transform_bytes(state), numa_reader_node(state, i));
+		}
+		pthread_attr_init(&attr);
+		numa_pin_reader(state, &attr, i);
+		io_ret = pthread_create(&reader_thread[i], &attr, reader, &reader_args[i]);
+		if (io_ret != 0 && state->numaFlag == true) {
+			warn(__func__, "cannot start reader %ld on the CPUs of its NUMA node, error: %d, will run it unpinned",
+			     i, io_ret);
+			pthread_attr_destroy(&attr);
+			pthread_attr_init(&attr);
+			io_ret = pthread_create(&reader_thread[i], &attr, reader, &reader_args[i]);
+		}
+		if (io_ret != 0) {
+			errno = io_ret;
+			errp(84, __func__, "error on pthread_create()");
+		}
+		pthread_attr_destroy(&attr);
+	}
+}
+
+
+/*
+ * reader_get - wait for the bitstream of an iteration
+ *
+ * given:
+ *      state           // run state
+ *      iteration       // iteration claimed by the calling iterate thread
+ *
+ * returns:
+ *      The slot holding the bitstream of the iteration, to be freed with reader_put().
+ */
+struct ring_slot *
+reader_get(struct state *state, long int iteration)
+{
+	struct ring_slot *slot;		// slot of the iteration
+	struct timespec start;		// when we started waiting
+	struct timespec end;		// when we stopped waiting
+
+	/*
+	 * Check preconditions (firewall)
+	 */
+	if (state == NULL) {
+		err(84, __func__, "state arg is NULL");
+	}
+	if (ring == NULL) {
+		err(84, __func__, "readers are not running");
+	}
+	if (iteration < ring_first || iteration >= ring_end) {
+		err(84, __func__, "iteration arg: %ld must be in the range [%ld, %ld)", iteration, ring_first, ring_end);
+	}
+	slot = &ring[iteration % ring_slots];
+
+	/*
+	 * Fast path: the bitstream was read already
+	 */
+	if (__atomic_load_n(&slot->iteration, __ATOMIC_ACQUIRE) == iteration) {
+		return slot;
+	}
+
+	/*
+	 * Stall until it is
+	 */
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	(void) ring_wait(slot, iteration);
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	pthread_mutex_lock(&ring_mutex);
+	ring_stalls++;
+	ring_stall_time += (double) (end.tv_sec - start.tv_sec) + (double) (end.tv_nsec - start.tv_nsec) / 1e9;
+	pthread_mutex_unlock(&ring_mutex);
+
+	return slot;
+}
+
+
+/*
+ * reader_put - free the slot of a tested bitstream for the readers
+ *
+ * given:
+ *      state           // run state
+ *      slot            // slot returned by reader_get()
+ */
+void
+reader_put(struct state *state, struct ring_slot *slot)
+{
+	if (state == NULL || slot == NULL) {
+		err(84, __func__, "state or slot arg is NULL");
+	}
+
+	__atomic_store_n(&slot->iteration, -1, __ATOMIC_SEQ_CST);
+	ring_wake();
+}
+
+
+/*
+ * reader_stop - wait for the readers and free the ring
+ *
+ * given:
+ *      state           // run state
+ *
+ * NOTE: Must be called once the iterate threads are done.
+ *
+ * This function does not return on error.
+ */
+void
+reader_stop(struct state *state)
+{
+	long int i;
+	int io_ret;		// pthread return status
+
+	/*
+	 * Check preconditions (firewall)
+	 */
+	if (state == NULL) {
+		err(84, __func__, "state arg is NULL");
+	}
+	if (ring == NULL) {
+		return;
+	}
+
+	/*
+	 * Wait for the readers and close the streams they opened
+	 */
+	for (i = 0; i < ring_readers; i++) {
+		io_ret = pthread_join(reader_thread[i], NULL);
+		if (io_ret != 0) {
+			errno = io_ret;
+			errp(84, __func__, "error on pthread_join()");
+		}
+		if (decompress_wanted(state) == true) {
+			decompress_close(state, reader_args[i].stream);
+		} else if (i > 0) {
+			fclose(reader_args[i].stream);
+		}
+		free(reader_args[i].bytes);
+		direct_close(reader_args[i].dio);
+	}
+	dbg(DBG_LOW, "test threads waited for input on %ld bitstreams for %.3f seconds, readers waited on a full ring %ld times",
+	    ring_stalls, ring_stall_time, ring_full);
+
+	/*
+	 * Free the ring
+	 */
+	for (i = 0; i < ring_slots; i++) {
+		free(ring[i].bits);
+	}
+	free(ring);
+	ring = NULL;
+	free(reader_thread);
+	reader_thread = NULL;
+	free(reader_args);
+	reader_args = NULL;
+}
@@ -0,0 +1,53 @@
+/*****************************************************************************
+ R E A D E R  F U N C T I O N  P R O T O T Y P E S
+ *****************************************************************************/
+
+/*
+ * This code has been heavily modified by the following people:
+ *
+ *      Landon Curt Noll
+ *      Tom Gilgan
+ *      Riccardo Paccagnella
+ *
+ * See the README.md and the initial comment in sts.c for more information.
+ *
+ * WE (THOSE LISTED ABOVE WHO HEAVILY MODIFIED THIS CODE) DISCLAIM ALL
+ * WARRANTIES WITH REGARD TO THIS SOFTWARE, INCLUDING ALL IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL WE (THOSE LISTED ABOVE
+ * WHO HEAVILY MODIFIED THIS CODE) BE LIABLE FOR ANY SPECIAL, INDIRECT OR
+ * CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF
+ * USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ *
+ * chongo (Landon Curt Noll, http://www.isthe.com/chongo/index.html) /\oo/\
+ *
+ * Share and enjoy! :-)
+ */
+
+#ifndef READER_H
+#   define READER_H
+
+#   include "defs.h"
+
+#   define READER_AHEAD	(2)	// bitstreams buffered per iterate thread, counting the one being tested
+
+/*
+ * ring_slot - buffer of one bitstream read ahead of the iterate threads
+ */
+struct ring_slot {
+	BitSequence *bits;		// the bitstream, tp.n bits, one per BitSequence
+	long int num_0s;		// number of 0 bits in the bitstream
+	long int num_1s;		// number of 1 bits in the bitstream
+	long int bitsRead;		// number of bits read into bits
+	long int iteration;		// iteration whose bitstream is in bits, -1 ==> slot is free (accessed atomically)
+	long int node;			// -N: index of the NUMA node bits are on, -1 ==> unknown
+};
+
+extern long int reader_ring_size(struct state *state);
+extern void reader_start(struct state *state);
+extern struct ring_slot *reader_get(struct state *state, long int iteration);
+extern void reader_put(struct state *state, struct ring_slot *slot);
+extern void reader_stop(struct state *state);
+
+#endif				/* READER_H */
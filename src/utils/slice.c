@@ -0,0 +1,438 @@
+// slice.c - test 64 bitstreams at once, bit-sliced, with word-wide logic and vertical counters
+
+/*
+ * This code has been heavily modified by the following people:
+ *
+ *      Landon Curt Noll
+ *      Tom Gilgan
+ *      Riccardo Paccagnella
+ *
+ * See the README.md and the initial comment in sts.c for more information.
+ *
+ * WE (THOSE LISTED ABOVE WHO HEAVILY MODIFIED THIS CODE) DISCLAIM ALL
+ * WARRANTIES WITH REGARD TO THIS SOFTWARE, INCLUDING ALL IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL WE (THOSE LISTED ABOVE
+ * WHO HEAVILY MODIFIED THIS CODE) BE LIABLE FOR ANY SPECIAL, INDIRECT OR
+ * CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF
+ * USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ *
+ * chongo (Landon Curt Noll, http://www.isthe.com/chongo/index.html) /\oo/\
+ *
+ * Share and enjoy! :-)
+ */
+
+
+
+// Exit codes: 125 thru 126
+
+/*
+ * Frequency, Runs, CumulativeSums and LongestRun walk a bitstream one bit at a time through a small
+ * state machine: a count, a partial sum and its extrema, the length of a run.  On random data the
+ * branches of such a walk are mispredicted half of the time.  Under -B, each thread takes its
+ * bitstreams SLICE_LANES at a time and walks all of them at once instead:
+ *
+ *      - The bitstreams are transposed, a block of SLICE_BLOCK bits at a time, into words whose
+ *        bit k is the bit of bitstream k.  Each bitstream is read in order, 8 bits per load.
+ *
+ *      - Each state variable becomes a vertical counter: plane p of the counter is a word holding
+ *        bit p of the variable for every bitstream.  Adding a word of 1 bits to a counter is a
+ *        ripple carry over its planes, and the lanes whose variable is 0 are the complement of
+ *        the OR of its planes.  All of it is branch free.
+ *
+ *      - Counters that only grow are kept to SMALL_PLANES planes, and flushed into the per
+ *        bitstream totals before they can overflow.
+ *
+ * The maxima need no comparisons: as the partial sum S moves by 1, its maximum grows exactly when
+ * S is at the maximum and moves up.  So we count the distance D = S_max - S, down while D > 0, and
+ * count S_max up instead when D is 0.  The same goes for S_min, and for the longest run of ones of
+ * a block, whose distance from the current run goes back to the longest run at each 0 bit.
+ *
+ * The results of each bitstream go to a struct slice_lane, which the iterate functions of the tests
+ * use instead of walking the bitstream themselves, so their results do not change.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include "../utils/externs.h"
+#include "utilities.h"
+#include "slice.h"
+#include "debug.h"
+
+#define SLICE_BLOCK	(512)			// bit positions transposed at a time, a multiple of 8
+#define PLANES		(64)			// most planes of a vertical counter
+#define SMALL_PLANES	(8)			// planes of the counters flushed every SMALL_MAX bits
+#define SMALL_MAX	((1 << SMALL_PLANES) - 1)	// largest value of a counter of SMALL_PLANES planes
+#define PACK_BITS	(0x0102040810204080ULL)	// multiplier gathering the low bits of 8 bytes into the top byte
+
+
+/*
+ * vcount - a vertical counter: plane p holds bit p of the counter of each lane
+ */
+struct vcount {
+	uint64_t plane[PLANES];		// bit planes, from least significant
+	int top;			// planes above top are 0
+};
+
+
+/*
+ * Forward static function declarations
+ */
+static void vadd(struct vcount *v, uint64_t m);
+static void vsub(struct vcount *v, uint64_t m);
+static uint64_t vzero(struct vcount *v);
+static long int vget(struct vcount *v, long int lane);
+static void vclear(struct vcount *v);
+static uint64_t transpose8(uint64_t x);
+static void transpose(BitSequence **bits, long int lanes, long int first, long int count, uint64_t *word);
+
+
+/*
+ * vadd - add 1 to the counter of the lanes set in m
+ */
+static void
+vadd(struct vcount *v, uint64_t m)
+{
+	uint64_t t;		// carry into the next plane
+	int p;
+
+	for (p = 0; p < v->top; p++) {
+		t = v->plane[p] & m;
+		v->plane[p] ^= m;
+		m = t;
+	}
+	if (m != 0) {
+		v->plane[v->top++] = m;
+	}
+}
+
+
+/*
+ * vsub - subtract 1 from the counter of the lanes set in m, where the counter is > 0
+ */
+static void
+vsub(struct vcount *v, uint64_t m)
+{
+	uint64_t t;		// borrow from the next plane
+	int p;
+
+	for (p = 0; p < v->top; p++) {
+		t = ~v->plane[p] & m;
+		v->plane[p] ^= m;
+		m = t;
+	}
+}
+
+
+/*
+ * vzero - find the lanes whose counter is 0
+ */
+static uint64_t
+vzero(struct vcount *v)
+{
+	uint64_t any = 0;	// lanes with some bit set
+	int p;
+
+	for (p = 0; p < v->top; p++) {
+		any |= v->plane[p];
+	}
+	return ~any;
+}
+
+
+/*
+ * vget - value of the counter of a lane
+ */
+static long int
+vget(struct vcount *v, long int lane)
+{
+	long int value = 0;
+	int p;
+
+	for (p = 0; p < v->top; p++) {
+		value |= (long int) ((v->plane[p] >> lane) & 1) << p;
+	}
+	return value;
+}
+
+
+/*
+ * vclear - set the counter of every lane to 0
+ */
+static void
+vclear(struct vcount *v)
+{
+	memset(v->plane, 0, (size_t) v->top * sizeof(v->plane[0]));
+	v->top = 0;
+}
+
+
+/*
+ * transpose8 - transpose an 8 by 8 bit matrix, bit c of byte r going to bit r of byte c
+ */
+static uint64_t
+transpose8(uint64_t x)
+{
+	uint64_t t;
+
+	t = (x ^ (x >> 7)) & 0x00AA00AA00AA00AAULL;
+	x = x ^ t ^ (t << 7);
+	t = (x ^ (x >> 14)) & 0x0000CCCC0000CCCCULL;
+	x = x ^ t ^ (t << 14);
+	t = (x ^ (x >> 28)) & 0x00000000F0F0F0F0ULL;
+	x = x ^ t ^ (t << 28);
+
+	return x;
+}
+
+
+/*
+ * transpose - transpose a block of bits of up to SLICE_LANES bitstreams into words
+ *
+ * given:
+ *      bits            // bits[k] is bitstream k
+ *      lanes           // number of bitstreams, the other lanes are 0
+ *      first           // first bit of the block
+ *      count           // bits in the block, at most SLICE_BLOCK
+ *      word            // word[j] gets bit first+j of bitstream k as its bit k
+ */
+static void
+transpose(BitSequence **bits, long int lanes, long int first, long int count, uint64_t *word)
+{
+	uint8_t packed[SLICE_LANES][SLICE_BLOCK / 8];	// 8 bits of a bitstream per byte, bit b is bit 8*i+b
+	uint64_t v;		// 8 bits of a bitstream, one per byte
+	uint64_t x;		// 8 bits of 8 bitstreams
+	long int whole;		// bits of the block in whole bytes
+	long int i;
+	long int j;
+	long int k;
+	int b;
+
+	/*
+	 * Pack each bitstream, 8 bits per load
+	 */
+	whole = count & ~7L;
+	for (k = 0; k < SLICE_LANES; k++) {
+		if (k >= lanes) {
+			memset(packed[k], 0, sizeof(packed[k]));
+			continue;
+		}
+		for (i = 0; i < whole / 8; i++) {
+			memcpy(&v, bits[k] + first + 8 * i, sizeof(v));
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+			v = __builtin_bswap64(v);
+#endif /* __BYTE_ORDER__ */
+			packed[k][i] = (uint8_t) ((v * PACK_BITS) >> 56);
+		}
+	}
+
+	/*
+	 * Transpose 8 bits of 8 bitstreams at a time
+	 */
+	for (i = 0; i < whole / 8; i++) {
+		memset(word + 8 * i, 0, 8 * sizeof(word[0]));
+		for (k = 0; k < SLICE_LANES; k += 8) {
+			x = 0;
+			for (b = 0; b < 8; b++) {
+				x |= (uint64_t) packed[k + b][i] << (8 * b);
+			}
+			x = transpose8(x);
+			for (b = 0; b < 8; b++) {
+				word[8 * i + b] |= ((x >> (8 * b)) & 0xff) << k;
+			}
+		}
+	}
+
+	/*
+	 * The bits after the last whole byte, one at a time
+	 */
+	for (j = whole; j < count; j++) {
+		word[j] = 0;
+		for (k = 0; k < lanes; k++) {
+			word[j] |= (uint64_t) (bits[k][first + j] & 1) << k;
+		}
+	}
+}
+
+
+/*
+ * slice_lanes - number of bitstreams a thread tests at once
+ *
+ * given:
+ *      state           // run state
+ *
+ * returns:
+ *      SLICE_LANES under -B, 1 without -B.
+ */
+long int
+slice_lanes(struct state *state)
+{
+	/*
+	 * Check preconditions (firewall)
+	 */
+	if (state == NULL) {
+		err(125, __func__, "state arg is NULL");
+	}
+
+	return (state->sliceFlag == true) ? SLICE_LANES : 1;
+}
+
+
+/*
+ * slice_bits - run the bit-sliced state machines of the enabled tests over up to SLICE_LANES bitstreams
+ *
+ * given:
+ *      state           // run state
+ *      bits            // bits[k] is bitstream k, of tp.n bits
+ *      lanes           // number of bitstreams, 1 thru SLICE_LANES
+ *      lane            // lane[k] gets the results of bitstream k
+ *
+ * This function does not return on error.
+ */
+void
+slice_bits(struct state *state, BitSequence **bits, long int lanes, struct slice_lane *lane)
+{
+	uint64_t word[SLICE_BLOCK];	// a block of bits of every lane, transposed
+	struct vcount ones;		// 1 bits since the last flush
+	struct vcount changes;		// changes of bit value since the last flush
+	struct vcount up;		// increments of S_max since the last flush
+	struct vcount down;		// decrements of S_min since the last flush
+	struct vcount to_max;		// S_max - S
+	struct vcount to_min;		// S - S_min
+	struct vcount longest;		// longest run of ones in the current block
+	struct vcount to_longest;	// longest run minus the current run of ones
+	bool want_ones;			// true ==> count the 1 bits
+	bool want_changes;		// true ==> count the changes of bit value
+	bool want_sums;			// true ==> track the extrema of the partial sums
+	bool want_runs;			// true ==> find the longest runs of ones of each block
+	uint64_t live;			// lanes of the bitstreams
+	uint64_t prev = 0;		// the previous word
+	uint64_t w;			// the current word
+	uint64_t nw;			// lanes of the bitstreams whose current bit is 0
+	uint64_t z;			// lanes whose counter is 0
+	long int n;			// Length of a single bit stream
+	long int M;			// Block length of the longest runs of ones
+	long int run_end;		// bits in whole blocks of M bits
+	long int left;			// bits left before the small counters are flushed
+	long int block_left;		// bits left in the current block of M bits
+	long int count;			// bits in the current transposed block
+	long int first;
+	long int j;
+	long int k;
+
+	/*
+	 * Check preconditions (firewall)
+	 */
+	if (state == NULL || bits == NULL || lane == NULL) {
+		err(126, __func__, "state, bits or lane arg is NULL");
+	}
+	if (lanes < 1 || lanes > SLICE_LANES) {
+		err(126, __func__, "lanes: %ld must be in the range [1, %d]", lanes, SLICE_LANES);
+	}
+	for (k = 0; k < lanes; k++) {
+		if (bits[k] == NULL) {
+			err(126, __func__, "bits[%ld] is NULL", k);
+		}
+	}
+
+	/*
+	 * Collect parameters from state
+	 */
+	n = state->tp.n;
+	M = state->sliceRunBlock;
+	want_ones = state->testVector[TEST_FREQUENCY] || state->testVector[TEST_RUNS] || state->testVector[TEST_CUSUM];
+	want_changes = state->testVector[TEST_RUNS];
+	want_sums = state->testVector[TEST_CUSUM];
+	want_runs = state->testVector[TEST_LONGEST_RUN] && M > 0;
+	live = (lanes == SLICE_LANES) ? ~(uint64_t) 0 : (((uint64_t) 1 << lanes) - 1);
+	run_end = (want_runs == true) ? (n / M) * M : 0;
+	memset(lane, 0, (size_t) lanes * sizeof(lane[0]));
+	memset(&ones, 0, sizeof(ones));
+	memset(&changes, 0, sizeof(changes));
+	memset(&up, 0, sizeof(up));
+	memset(&down, 0, sizeof(down));
+	memset(&to_max, 0, sizeof(to_max));
+	memset(&to_min, 0, sizeof(to_min));
+	memset(&longest, 0, sizeof(longest));
+	memset(&to_longest, 0, sizeof(to_longest));
+	left = SMALL_MAX;
+	block_left = M;
+
+	/*
+	 * Walk the bits of every lane at once
+	 */
+	for (first = 0; first < n; first += SLICE_BLOCK) {
+		count = MIN(SLICE_BLOCK, n - first);
+		transpose(bits, lanes, first, count, word);
+		for (j = 0; j < count; j++) {
+			w = word[j];
+			nw = ~w & live;
+
+			/*
+			 * Frequency: 1 bits, Runs: changes of bit value
+			 */
+			if (want_ones == true) {
+				vadd(&ones, w);
+			}
+			if (want_changes == true && first + j > 0) {
+				vadd(&changes, w ^ prev);
+			}
+
+			/*
+			 * CumulativeSums: S_max grows where S is at S_max and goes up, S_min likewise
+			 */
+			if (want_sums == true) {
+				z = vzero(&to_max);
+				vadd(&up, w & z);
+				vsub(&to_max, w & ~z);
+				vadd(&to_max, nw);
+				z = vzero(&to_min);
+				vadd(&down, nw & z);
+				vsub(&to_min, nw & ~z);
+				vadd(&to_min, w);
+			}
+
+			/*
+			 * LongestRun: the longest run grows where the current run reaches it, a 0 bit ends the run
+			 */
+			if (first + j < run_end) {
+				z = vzero(&to_longest);
+				vadd(&longest, w & z);
+				vsub(&to_longest, w & ~z);
+				for (k = 0; k < longest.top; k++) {
+					to_longest.plane[k] = (to_longest.plane[k] & w) | (longest.plane[k] & ~w);
+				}
+				to_longest.top = MAX(to_longest.top, longest.top);
+				if (--block_left == 0) {
+					for (k = 0; k < lanes; k++) {
+						lane[k].runs[MIN(vget(&longest, k), SLICE_RUNS)]++;
+					}
+					vclear(&longest);
+					vclear(&to_longest);
+					block_left = M;
+				}
+			}
+			prev = w;
+
+			/*
+			 * Flush the small counters before they overflow
+			 */
+			if (--left == 0 || first + j == n - 1) {
+				for (k = 0; k < lanes; k++) {
+					lane[k].ones += vget(&ones, k);
+					lane[k].changes += vget(&changes, k);
+					lane[k].S_max += vget(&up, k);
+					lane[k].S_min -= vget(&down, k);
+				}
+				vclear(&ones);
+				vclear(&changes);
+				vclear(&up);
+				vclear(&down);
+				left = SMALL_MAX;
+			}
+		}
+	}
+}
@@ -0,0 +1,52 @@
+/*****************************************************************************
+ B I T - S L I C E D  E N G I N E  F U N C T I O N  P R O T O T Y P E S
+ *****************************************************************************/
+
+/*
+ * This code has been heavily modified by the following people:
+ *
+ *      Landon Curt Noll
+ *      Tom Gilgan
+ *      Riccardo Paccagnella
+ *
+ * See the README.md and the initial comment in sts.c for more information.
+ *
+ * WE (THOSE LISTED ABOVE WHO HEAVILY MODIFIED THIS CODE) DISCLAIM ALL
+ * WARRANTIES WITH REGARD TO THIS SOFTWARE, INCLUDING ALL IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL WE (THOSE LISTED ABOVE
+ * WHO HEAVILY MODIFIED THIS CODE) BE LIABLE FOR ANY SPECIAL, INDIRECT OR
+ * CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF
+ * USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ *
+ * chongo (Landon Curt Noll, http://www.isthe.com/chongo/index.html) /\oo/\
+ *
+ * Share and enjoy! :-)
+ */
+
+#ifndef SLICE_H
+#   define SLICE_H
+
+#   include "defs.h"
+
+#   define SLICE_LANES		(64)	// bitstreams -B tests at once, one per bit of a 64 bit word
+#   define SLICE_RUNS		(32)	// longest runs of ones are counted up to this length, longer ones as it
+
+/*
+ * slice_lane - results of the bit-sliced state machines for one bitstream
+ *
+ * Each field is only set when a test using it is enabled.
+ */
+struct slice_lane {
+	long int ones;				// Number of 1 bits (Frequency, Runs, CumulativeSums)
+	long int changes;			// Number of bits differing from the bit before them (Runs)
+	long int S_max;				// Largest partial sum of the bits as +1/-1, 0 included (CumulativeSums)
+	long int S_min;				// Smallest partial sum of the bits as +1/-1, 0 included (CumulativeSums)
+	long int runs[SLICE_RUNS + 1];		// Blocks of sliceRunBlock bits by longest run of ones, capped (LongestRun)
+};
+
+extern long int slice_lanes(struct state *state);
+extern void slice_bits(struct state *state, BitSequence **bits, long int lanes, struct slice_lane *lane);
+
+#endif				/* SLICE_H */
@@ -0,0 +1,218 @@
+// split.c - cut the work of a test on one bitstream into pieces tested by threads of their own
+
+/*
+ * This code has been heavily modified by the following people:
+ *
+ *      Landon Curt Noll
+ *      Tom Gilgan
+ *      Riccardo Paccagnella
+ *
+ * See the README.md and the initial comment in sts.c for more information.
+ *
+ * WE (THOSE LISTED ABOVE WHO HEAVILY MODIFIED THIS CODE) DISCLAIM ALL
+ * WARRANTIES WITH REGARD TO THIS SOFTWARE, INCLUDING ALL IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL WE (THOSE LISTED ABOVE
+ * WHO HEAVILY MODIFIED THIS CODE) BE LIABLE FOR ANY SPECIAL, INDIRECT OR
+ * CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF
+ * USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ *
+ * chongo (Landon Curt Noll, http://www.isthe.com/chongo/index.html) /\oo/\
+ *
+ * Share and enjoy! :-)
+ */
+
+
+
+// Exit codes: 250 thru 253
+
+/*
+ * Large bitstreams (n = 10^9 bits or more) take most tests seconds each on a single thread.
+ * Under -J split, the tests whose work falls into independent units (bits, blocks, matrices,
+ * templates) cut those units into up to split contiguous pieces.  Each piece runs in a thread
+ * of its own and adds into its own partial results.  The test then combines the partial results,
+ * counts and extrema, in piece order, so the results are the same whatever the number of pieces.
+ *
+ * Pieces get at least SPLIT_MIN_BITS bits of work, so that smaller bitstreams are not split.
+ * The threads of the pieces are started and joined for each test of each bitstream, which
+ * costs little next to the work of a test on SPLIT_MIN_BITS bits.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <pthread.h>
+#include "../utils/externs.h"
+#include "utilities.h"
+#include "split.h"
+#include "debug.h"
+
+
+/*
+ * A piece of the work of a test, as given to its thread
+ */
+struct piece {
+	struct thread_state *thread_state;	// state of the thread that split the work
+	split_fn *fn;				// function testing the units of the piece
+	void *arg;				// argument of fn
+	long int part;				// index of the piece
+	long int first;				// first unit of the piece
+	long int last;				// unit after the last one of the piece
+};
+
+
+/*
+ * Forward static function declarations
+ */
+static void *split_thread(void *arg);
+
+
+/*
+ * split_parts - determine the number of pieces to cut the work of a test into
+ *
+ * given:
+ *      state           // run state
+ *      units           // number of independent units of work of the test
+ *      unitBits        // bits of work in each unit
+ *
+ * returns:
+ *      Number of pieces, 1 without -J split, for the reference implementation of -V, or when the
+ *      units are too few or too small.
+ */
+long int
+split_parts(struct state *state, long int units, long int unitBits)
+{
+	long int parts;		// number of pieces
+
+	/*
+	 * Check preconditions (firewall)
+	 */
+	if (state == NULL) {
+		err(250, __func__, "state arg is NULL");
+	}
+	if (state->splitParts <= 1 || state->referenceInstance == true || units <= 1 || unitBits <= 0) {
+		return 1;
+	}
+
+	parts = MIN(state->splitParts, units);
+	parts = MIN(parts, (long int) (((double) units * (double) unitBits) / (double) SPLIT_MIN_BITS));
+	return MAX(parts, 1);
+}
+
+
+/*
+ * split_slot - index of the scratch buffers of a piece
+ *
+ * given:
+ *      state           // run state
+ *      thread_id       // iterate thread that split the work
+ *      part            // index of the piece
+ *
+ * returns:
+ *      Index into per thread scratch arrays sized numberOfThreads * splitParts.
+ */
+long int
+split_slot(struct state *state, long int thread_id, long int part)
+{
+	/*
+	 * Check preconditions (firewall)
+	 */
+	if (state == NULL) {
+		err(251, __func__, "state arg is NULL");
+	}
+	if (part < 0 || part >= MAX(state->splitParts, 1)) {
+		err(251, __func__, "part: %ld must be in the range [0, %ld)", part, MAX(state->splitParts, 1));
+	}
+
+	return thread_id * MAX(state->splitParts, 1) + part;
+}
+
+
+/*
+ * split_thread - test one piece of the work of a test
+ */
+static void *
+split_thread(void *arg)
+{
+	struct piece *piece = (struct piece *) arg;
+
+	piece->fn(piece->thread_state, piece->arg, piece->part, piece->first, piece->last);
+	return NULL;
+}
+
+
+/*
+ * split_run - test the units of a bitstream in pieces, each in a thread of its own
+ *
+ * given:
+ *      thread_state    // state of the iterate thread testing the bitstream
+ *      parts           // number of pieces, from split_parts()
+ *      units           // number of independent units of work of the test
+ *      fn              // function testing a piece
+ *      arg             // argument of fn, where it finds its partial results
+ *
+ * Returns once every piece is tested.  The pieces are contiguous runs of units, in order, differing
+ * in size by at most one unit.
+ *
+ * This function does not return on error.
+ */
+void
+split_run(struct thread_state *thread_state, long int parts, long int units, split_fn *fn, void *arg)
+{
+	pthread_t thread[MAX_SPLIT];	// threads of pieces 1 and up
+	struct piece piece[MAX_SPLIT];	// pieces of the work
+	int ret;
+	long int i;
+
+	/*
+	 * Check preconditions (firewall)
+	 */
+	if (thread_state == NULL || fn == NULL) {
+		err(252, __func__, "thread_state or fn arg is NULL");
+	}
+	if (parts < 1 || parts > MAX_SPLIT) {
+		err(252, __func__, "parts: %ld must be in the range [1, %d]", parts, MAX_SPLIT);
+	}
+	if (units < 0) {
+		err(252, __func__, "units: %ld must be >= 0", units);
+	}
+
+	/*
+	 * A single piece is tested right here
+	 */
+	if (parts == 1) {
+		fn(thread_state, arg, 0, 0, units);
+		return;
+	}
+
+	/*
+	 * Start pieces 1 and up, and test piece 0 in this thread meanwhile
+	 */
+	dbg(DBG_VHIGH, "thread %ld tests %ld units in %ld pieces", thread_state->thread_id, units, parts);
+	for (i = 0; i < parts; i++) {
+		piece[i].thread_state = thread_state;
+		piece[i].fn = fn;
+		piece[i].arg = arg;
+		piece[i].part = i;
+		piece[i].first = (units / parts) * i + MIN(i, units % parts);
+		piece[i].last = piece[i].first + units / parts + (i < units % parts ? 1 : 0);
+	}
+	for (i = 1; i < parts; i++) {
+		ret = pthread_create(&thread[i], NULL, split_thread, &piece[i]);
+		if (ret != 0) {
+			errno = ret;
+			errp(253, __func__, "error on pthread_create() of piece %ld of %ld", i, parts);
+		}
+	}
+	split_thread(&piece[0]);
+	for (i = 1; i < parts; i++) {
+		ret = pthread_join(thread[i], NULL);
+		if (ret != 0) {
+			errno = ret;
+			errp(253, __func__, "error on pthread_join() of piece %ld of %ld", i, parts);
+		}
+	}
+
+	return;
+}
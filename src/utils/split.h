@@ -0,0 +1,48 @@
+/*****************************************************************************
+ S P L I T  F U N C T I O N  P R O T O T Y P E S
+ *****************************************************************************/
+
+/*
+ * This code has been heavily modified by the following people:
+ *
+ *      Landon Curt Noll
+ *      Tom Gilgan
+ *      Riccardo Paccagnella
+ *
+ * See the README.md and the initial comment in sts.c for more information.
+ *
+ * WE (THOSE LISTED ABOVE WHO HEAVILY MODIFIED THIS CODE) DISCLAIM ALL
+ * WARRANTIES WITH REGARD TO THIS SOFTWARE, INCLUDING ALL IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL WE (THOSE LISTED ABOVE
+ * WHO HEAVILY MODIFIED THIS CODE) BE LIABLE FOR ANY SPECIAL, INDIRECT OR
+ * CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF
+ * USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ *
+ * chongo (Landon Curt Noll, http://www.isthe.com/chongo/index.html) /\oo/\
+ *
+ * Share and enjoy! :-)
+ */
+
+#ifndef SPLIT_H
+#   define SPLIT_H
+
+#   include "defs.h"
+
+#   define MAX_SPLIT		(64)		// most pieces -J split cuts the work of a test into
+#   define SPLIT_MIN_BITS	(1L << 22)	// fewest bits of work worth a thread of its own
+
+/*
+ * split_fn - test units first thru last-1 of a bitstream as piece part of the work
+ *
+ * Piece 0 runs in the calling thread, the others in threads of their own sharing its thread_state.
+ * Scratch buffers of piece part are at index split_slot(state, thread_state->thread_id, part).
+ */
+typedef void (split_fn) (struct thread_state *thread_state, void *arg, long int part, long int first, long int last);
+
+extern long int split_parts(struct state *state, long int units, long int unitBits);
+extern void split_run(struct thread_state *thread_state, long int parts, long int units, split_fn *fn, void *arg);
+extern long int split_slot(struct state *state, long int thread_id, long int part);
+
+#endif				/* SPLIT_H */
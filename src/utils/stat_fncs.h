@@ -69,21 +69,21 @@ extern void Serial_iterate(struct thread_state *thread_state);
 /*
  * Print functions
  */
-extern void Frequency_print(struct state *state);
-extern void BlockFrequency_print(struct state *state);
-extern void CumulativeSums_print(struct state *state);
-extern void Runs_print(struct state *state);
-extern void LongestRunOfOnes_print(struct state *state);
-extern void Rank_print(struct state *state);
-extern void DiscreteFourierTransform_print(struct state *state);
-extern void NonOverlappingTemplateMatchings_print(struct state *state);
-extern void OverlappingTemplateMatchings_print(struct state *state);
-extern void Universal_print(struct state *state);
-extern void ApproximateEntropy_print(struct state *state);
-extern void RandomExcursions_print(struct state *state);
-extern void RandomExcursionsVariant_print(struct state *state);
-extern void LinearComplexity_print(struct state *state);
-extern void Serial_print(struct state *state);
+extern void Frequency_print(struct state *state, long int first, long int last);
+extern void BlockFrequency_print(struct state *state, long int first, long int last);
+extern void CumulativeSums_print(struct state *state, long int first, long int last);
+extern void Runs_print(struct state *state, long int first, long int last);
+extern void LongestRunOfOnes_print(struct state *state, long int first, long int last);
+extern void Rank_print(struct state *state, long int first, long int last);
+extern void DiscreteFourierTransform_print(struct state *state, long int first, long int last);
+extern void NonOverlappingTemplateMatchings_print(struct state *state, long int first, long int last);
+extern void OverlappingTemplateMatchings_print(struct state *state, long int first, long int last);
+extern void Universal_print(struct state *state, long int first, long int last);
+extern void ApproximateEntropy_print(struct state *state, long int first, long int last);
+extern void RandomExcursions_print(struct state *state, long int first, long int last);
+extern void RandomExcursionsVariant_print(struct state *state, long int first, long int last);
+extern void LinearComplexity_print(struct state *state, long int first, long int last);
+extern void Serial_print(struct state *state, long int first, long int last);
 
 /*
  * Compute metrics functions
@@ -0,0 +1,372 @@
+// timing.c - count the time the threads spend in each test and phase of a run
+
+/*
+ * This code has been heavily modified by the following people:
+ *
+ *      Landon Curt Noll
+ *      Tom Gilgan
+ *      Riccardo Paccagnella
+ *
+ * See the README.md and the initial comment in sts.c for more information.
+ *
+ * WE (THOSE LISTED ABOVE WHO HEAVILY MODIFIED THIS CODE) DISCLAIM ALL
+ * WARRANTIES WITH REGARD TO THIS SOFTWARE, INCLUDING ALL IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL WE (THOSE LISTED ABOVE
+ * WHO HEAVILY MODIFIED THIS CODE) BE LIABLE FOR ANY SPECIAL, INDIRECT OR
+ * CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF
+ * USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ *
+ * chongo (Landon Curt Noll, http://www.isthe.com/chongo/index.html) /\oo/\
+ *
+ * Share and enjoy! :-)
+ */
+
+
+
+// Exit codes: 127 thru 129
+
+/*
+ * Under -E, or at -v 1 and up, the iterate threads count the ticks they spend in the iterate
+ * function of each test, waiting for the readers to read their bitstream, waiting for the mutex of
+ * the run state and computing p-values.  The readers count the ticks they spend reading and
+ * unpacking bitstreams, the main thread those of the init, iterate, print and metrics phases.
+ * timing_report() adds up the counts of the threads at the end of the run.  Under -Y tracefile,
+ * timing is on as well, and each interval counted is also recorded for the trace (see trace.c).
+ *
+ * Ticks are read from the time stamp counter on x86, elsewhere from the monotonic clock.  They are
+ * converted to seconds by the ratio of the ticks to the monotonic clock over the whole run, which
+ * assumes an invariant time stamp counter, as every x86 CPU of the last decade has.
+ *
+ * Each iterate thread adds into a slot of its own, so the threads do not share cache lines.  The
+ * adds are atomic all the same: the -J split pieces of a test add into the slot of the thread that
+ * started them, and the readers (thread_id -1 - reader) and the main thread share the last slot.  When timing is off, the
+ * count of a test, a wait or a lock costs a test of timing_on.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <errno.h>
+#include <time.h>
+#include "../utils/externs.h"
+#include "utilities.h"
+#include "timing.h"
+#include "trace.h"
+#include "debug.h"
+
+#define TIMING_LINE	(64)		// bytes of a cache line, slots are aligned to it
+
+
+/*
+ * timing_slot - the ticks a thread spent in each test and phase
+ */
+struct timing_slot {
+	uint64_t ticks[TIMING_KINDS];	// ticks spent in each (accessed atomically)
+	uint64_t calls[TIMING_KINDS];	// times each was timed (accessed atomically)
+};
+
+
+/*
+ * Timing of the run
+ */
+bool timing_on = false;				// true ==> threads count their ticks, and trace them under -Y
+static struct timing_slot *slot = NULL;		// slot of each iterate thread, then of the main thread and readers
+static long int slots = 0;			// number of slots
+static uint64_t first_ticks = 0;		// ticks when timing started
+static struct timespec first_time;		// monotonic clock when timing started
+
+
+/*
+ * Forward static function declarations
+ */
+static void timing_line(struct state *state, char const *fmt, ...);
+
+
+/*
+ * timing_init - start timing the run if -E, -Y tracefile or -v 1 and up was given
+ *
+ * given:
+ *      state           // run state, with its number of iterate threads set
+ *
+ * This function does not return on error.
+ */
+void
+timing_init(struct state *state)
+{
+	int ret;
+
+	/*
+	 * Check preconditions (firewall)
+	 */
+	if (state == NULL) {
+		err(127, __func__, "state arg is NULL");
+	}
+	if (state->timingFlag == false && state->traceFlag == false && debuglevel < DBG_LOW) {
+		return;
+	}
+	if (slot != NULL) {
+		return;		// the run is timed already, from its first source on
+	}
+
+	/*
+	 * One slot per iterate thread, then one for the main thread and the readers
+	 */
+	slots = MAX(state->numberOfThreads, 1) + 1;
+	ret = posix_memalign((void **) &slot, TIMING_LINE, (size_t) slots * sizeof(slot[0]));
+	if (ret != 0) {
+		errno = ret;
+		errp(127, __func__, "cannot allocate %ld timing slots", slots);
+	}
+	memset(slot, 0, (size_t) slots * sizeof(slot[0]));
+
+	trace_init(state);
+	clock_gettime(CLOCK_MONOTONIC, &first_time);
+	timing_on = true;
+	first_ticks = timing_now();
+	dbg(DBG_MED, "timing %ld threads and the phases of the run", slots - 1);
+}
+
+
+/*
+ * timing_now - ticks since an arbitrary moment
+ */
+uint64_t
+timing_now(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+	return __builtin_ia32_rdtsc();
+#else
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (uint64_t) now.tv_sec * 1000000000 + (uint64_t) now.tv_nsec;
+#endif
+}
+
+
+/*
+ * timing_add - count the ticks since start against what
+ *
+ * given:
+ *      thread_state    // state of the iterate thread or reader, NULL ==> main thread
+ *      what            // what the ticks were spent on
+ *      start           // timing_start() when it began
+ *
+ * Use timing_stop(), which only calls this function when timing is on.
+ */
+void
+timing_add(struct thread_state *thread_state, enum timing what, uint64_t start)
+{
+	struct timing_slot *ours;	// slot of the thread
+	uint64_t now;			// ticks when it ended
+
+	if (slot == NULL || what < 1 || what >= TIMING_KINDS) {
+		return;
+	}
+	if (thread_state == NULL || thread_state->thread_id < 0 || thread_state->thread_id >= slots - 1) {
+		ours = &slot[slots - 1];
+	} else {
+		ours = &slot[thread_state->thread_id];
+	}
+	now = timing_now();
+	__atomic_add_fetch(&ours->ticks[what], now - start, __ATOMIC_RELAXED);
+	__atomic_add_fetch(&ours->calls[what], 1, __ATOMIC_RELAXED);
+	if (trace_on == true) {
+		trace_add(thread_state, what, start, now);
+	}
+}
+
+
+/*
+ * timing_lock - lock the mutex of the run state, counting the wait against TIMING_LOCK
+ *
+ * given:
+ *      thread_state    // state of the iterate thread
+ *      mutex           // mutex to lock
+ *
+ * This function does not return on error.
+ */
+void
+timing_lock(struct thread_state *thread_state, pthread_mutex_t *mutex)
+{
+	uint64_t start;		// ticks when we began to wait
+	int ret;
+
+	/*
+	 * Check preconditions (firewall)
+	 */
+	if (mutex == NULL) {
+		err(129, __func__, "mutex arg is NULL");
+	}
+
+	start = timing_start();
+	ret = pthread_mutex_lock(mutex);
+	if (ret != 0) {
+		errno = ret;
+		errp(129, __func__, "error on pthread_mutex_lock()");
+	}
+	timing_stop(thread_state, TIMING_LOCK, start);
+}
+
+
+/*
+ * timing_line - print a line of the timing report at -v 1, and under -E to the final results file
+ *
+ * given:
+ *      state           // run state
+ *      fmt             // format of the line, without a newline
+ */
+static void
+timing_line(struct state *state, char const *fmt, ...)
+{
+	char buf[BUFSIZ + 1];	// the line
+	va_list ap;
+	int io_ret;
+
+	va_start(ap, fmt);
+	vsnprintf(buf, sizeof(buf), fmt, ap);
+	va_end(ap);
+
+	if (buf[0] == '\0') {
+		// blank lines only go to the file
+	} else if (state->timingFlag == true && state->finalRept == NULL) {
+		msg("%s", buf);		// under -m i there is no final results file
+	} else {
+		dbg(DBG_LOW, "%s", buf);
+	}
+	if (state->timingFlag == true && state->finalRept != NULL) {
+		io_ret = fprintf(state->finalRept, "%s\n", buf);
+		if (io_ret <= 0) {
+			errp(128, __func__, "error in writing to finalRept");
+		}
+	}
+}
+
+
+/*
+ * timing_report - report the time the threads of the run spent in each test and phase
+ *
+ * given:
+ *      state           // run state
+ *
+ * The times are summed over the threads.  They are printed at -v 1, and under -E appended to the
+ * final results file, which must still be open, or printed when there is none (-m i).  Under -Y,
+ * the trace is written to the tracefile.
+ *
+ * This function does not return on error.
+ */
+void
+timing_report(struct state *state)
+{
+	struct timespec now;		// monotonic clock at the end of the run
+	uint64_t ticks[TIMING_KINDS];	// ticks of each, summed over the threads
+	uint64_t calls[TIMING_KINDS];	// times each was timed, summed over the threads
+	uint64_t thread_ticks;		// ticks of a thread in the tests
+	double elapsed;			// seconds since timing_init()
+	double rate;			// ticks per second
+	long int t;
+	int k;
+
+	/*
+	 * Check preconditions (firewall)
+	 */
+	if (state == NULL) {
+		err(128, __func__, "state arg is NULL");
+	}
+	if (slot == NULL) {
+		return;
+	}
+
+	/*
+	 * Calibrate the ticks against the monotonic clock
+	 */
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	elapsed = (double) (now.tv_sec - first_time.tv_sec) + (double) (now.tv_nsec - first_time.tv_nsec) / 1e9;
+	rate = (elapsed > 0.0) ? (double) (timing_now() - first_ticks) / elapsed : 1e9;
+	if (rate <= 0.0) {
+		rate = 1e9;
+	}
+
+	/*
+	 * Add up the slots, reporting each iterate thread at -v 2
+	 */
+	memset(ticks, 0, sizeof(ticks));
+	memset(calls, 0, sizeof(calls));
+	for (t = 0; t < slots; t++) {
+		thread_ticks = 0;
+		for (k = 1; k < TIMING_KINDS; k++) {
+			ticks[k] += slot[t].ticks[k];
+			calls[k] += slot[t].calls[k];
+			if (k <= NUMOFTESTS) {
+				thread_ticks += slot[t].ticks[k];
+			}
+		}
+		if (t < slots - 1) {
+			dbg(DBG_MED, "thread %ld: %.6f s in tests, %.6f s waiting for bitstreams, %.6f s waiting for locks", t,
+			    (double) thread_ticks / rate, (double) slot[t].ticks[TIMING_WAIT] / rate,
+			    (double) slot[t].ticks[TIMING_LOCK] / rate);
+		}
+	}
+
+	/*
+	 * Report the phases, then the tests and what the threads waited for
+	 */
+	if (state->timingFlag == true && state->finalRept != NULL) {
+		if (fprintf(state->finalRept, "\n\n") <= 0) {
+			errp(128, __func__, "error in writing to finalRept");
+		}
+	}
+	timing_line(state, "Timing of the run, %.3f seconds at %.0f ticks per second:", elapsed, rate);
+	timing_line(state, "%s", "");
+	timing_line(state, "   %-34s %12s %12s", "phase (main thread)", "seconds", "times");
+	for (k = TIMING_INIT; k <= TIMING_METRICS; k++) {
+		if (calls[k] > 0) {
+			timing_line(state, "   %-34s %12.6f %12lu", k == TIMING_INIT ? "init" : k == TIMING_ITERATE ? "iterate" :
+				    k == TIMING_PRINT ? "print" : "metrics", (double) ticks[k] / rate, (unsigned long) calls[k]);
+		}
+	}
+	timing_line(state, "%s", "");
+	timing_line(state, "   %-34s %12s %12s %14s", "test (summed over the threads)", "seconds", "iterations",
+		    "us/iteration");
+	for (k = 1; k <= NUMOFTESTS; k++) {
+		if (calls[k] > 0) {
+			timing_line(state, "   %-34s %12.6f %12lu %14.3f", state->testNames[k], (double) ticks[k] / rate,
+				    (unsigned long) calls[k], (double) ticks[k] / rate / (double) calls[k] * 1e6);
+		}
+	}
+	timing_line(state, "   %-34s %12.6f %12lu", "computing p-values (in the tests)", (double) ticks[TIMING_PVALUE] / rate,
+		    (unsigned long) calls[TIMING_PVALUE]);
+	timing_line(state, "   %-34s %12.6f %12lu", "waiting for bitstreams", (double) ticks[TIMING_WAIT] / rate,
+		    (unsigned long) calls[TIMING_WAIT]);
+	timing_line(state, "   %-34s %12.6f %12lu", "waiting for locks", (double) ticks[TIMING_LOCK] / rate,
+		    (unsigned long) calls[TIMING_LOCK]);
+	timing_line(state, "   %-34s %12.6f %12lu", "whole iterations of the threads", (double) ticks[TIMING_BITSTREAM] / rate,
+		    (unsigned long) calls[TIMING_BITSTREAM]);
+	timing_line(state, "   %-34s %12.6f %12lu", "reading bitstreams (readers)", (double) ticks[TIMING_READ] / rate,
+		    (unsigned long) calls[TIMING_READ]);
+
+	/*
+	 * Under -Y, write the events on the same clock
+	 */
+	trace_write(state, first_ticks, rate);
+}
+
+
+/*
+ * timing_free - stop timing and free the slots
+ */
+void
+timing_free(void)
+{
+	timing_on = false;
+	trace_free();
+	if (slot != NULL) {
+		free(slot);
+		slot = NULL;
+	}
+	slots = 0;
+}
@@ -0,0 +1,75 @@
+/*****************************************************************************
+ T I M I N G  F U N C T I O N  P R O T O T Y P E S
+ *****************************************************************************/
+
+/*
+ * This code has been heavily modified by the following people:
+ *
+ *      Landon Curt Noll
+ *      Tom Gilgan
+ *      Riccardo Paccagnella
+ *
+ * See the README.md and the initial comment in sts.c for more information.
+ *
+ * WE (THOSE LISTED ABOVE WHO HEAVILY MODIFIED THIS CODE) DISCLAIM ALL
+ * WARRANTIES WITH REGARD TO THIS SOFTWARE, INCLUDING ALL IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL WE (THOSE LISTED ABOVE
+ * WHO HEAVILY MODIFIED THIS CODE) BE LIABLE FOR ANY SPECIAL, INDIRECT OR
+ * CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF
+ * USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ *
+ * chongo (Landon Curt Noll, http://www.isthe.com/chongo/index.html) /\oo/\
+ *
+ * Share and enjoy! :-)
+ */
+
+#ifndef TIMING_H
+#   define TIMING_H
+
+#   include <stdint.h>
+#   include <pthread.h>
+#   include "defs.h"
+
+/*
+ * What a thread spends its time on: 1 thru NUMOFTESTS are the iterate functions of the tests
+ */
+enum timing {
+	TIMING_WAIT = NUMOFTESTS + 1,	// iterate threads waiting for the readers to read their bitstream
+	TIMING_LOCK,			// iterate threads waiting for the mutex of the run state
+	TIMING_PVALUE,			// computing p-values, part of the time of the tests
+	TIMING_READ,			// readers reading and unpacking bitstreams
+	TIMING_BITSTREAM,		// iterate threads testing a bitstream, from getting it to giving it back
+	TIMING_INIT,			// init phase
+	TIMING_ITERATE,			// iterate phase
+	TIMING_PRINT,			// print phase
+	TIMING_METRICS,			// metrics phase
+	TIMING_KINDS			// must be last
+};
+
+/*
+ * timing_start - ticks to time something from, 0 when timing is off
+ * timing_stop - count the ticks since start against what, for a thread or NULL for the main thread
+ *
+ * When timing is off, each costs the test of timing_on.  Under -Y, timing_stop also records the
+ * interval for the trace, see trace.c.
+ */
+#   define timing_start() (timing_on == true ? timing_now() : 0)
+#   define timing_stop(thread_state, what, start) \
+	do { \
+		if (timing_on == true) { \
+			timing_add((thread_state), (what), (start)); \
+		} \
+	} while (0)
+
+extern bool timing_on;
+
+extern void timing_init(struct state *state);
+extern uint64_t timing_now(void);
+extern void timing_add(struct thread_state *thread_state, enum timing what, uint64_t start);
+extern void timing_lock(struct thread_state *thread_state, pthread_mutex_t *mutex);
+extern void timing_report(struct state *state);
+extern void timing_free(void);
+
+#endif				/* TIMING_H */
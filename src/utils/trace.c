@@ -0,0 +1,344 @@
+// trace.c - record the timeline of a run and write it as a Chrome trace
+
+/*
+ * This code has been heavily modified by the following people:
+ *
+ *      Landon Curt Noll
+ *      Tom Gilgan
+ *      Riccardo Paccagnella
+ *
+ * See the README.md and the initial comment in sts.c for more information.
+ *
+ * WE (THOSE LISTED ABOVE WHO HEAVILY MODIFIED THIS CODE) DISCLAIM ALL
+ * WARRANTIES WITH REGARD TO THIS SOFTWARE, INCLUDING ALL IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL WE (THOSE LISTED ABOVE
+ * WHO HEAVILY MODIFIED THIS CODE) BE LIABLE FOR ANY SPECIAL, INDIRECT OR
+ * CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF
+ * USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ *
+ * chongo (Landon Curt Noll, http://www.isthe.com/chongo/index.html) /\oo/\
+ *
+ * Share and enjoy! :-)
+ */
+
+
+
+// Exit codes: 123 thru 124
+
+/*
+ * Under -Y tracefile, each interval timing.c counts is also recorded as an event: the bitstreams an
+ * iterate thread tests, the tests of each, with the p-values, waits and locks within them, the reads
+ * of the readers and the phases of the main thread.  At the end of the run the events are written
+ * to tracefile in the Chrome trace event format, for chrome://tracing or https://ui.perfetto.dev.
+ *
+ * Each iterate thread records its events in a ring of its own, the main thread and the readers
+ * share the last ring.  A thread takes the next entry of a ring by an atomic add, so neither the
+ * -J split pieces of a test nor the readers take a lock.  A ring keeps the last TRACE_EVENTS events
+ * recorded in it, the older ones are lost, as a warning at the end of the run then says.
+ *
+ * Tracing turns timing on.  When neither is asked for, recording an event costs the one test of
+ * timing_on.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include "../utils/externs.h"
+#include "utilities.h"
+#include "timing.h"
+#include "trace.h"
+#include "debug.h"
+
+
+/*
+ * The trace of the run
+ */
+bool trace_on = false;				// true ==> threads record their events
+static struct trace_ring *ring = NULL;		// ring of each iterate thread, then of the main thread and readers
+static long int rings = 0;			// number of rings
+static FILE *trace_file = NULL;			// open -Y tracefile
+
+
+/*
+ * Forward static function declarations
+ */
+static char const *trace_name(struct state *state, int what);
+static char const *trace_category(int what);
+
+
+/*
+ * trace_init - open the -Y tracefile and start recording events
+ *
+ * given:
+ *      state           // run state, with its number of iterate threads set
+ *
+ * NOTE: Called by timing_init(), which turns timing on with tracing.
+ *
+ * This function does not return on error.
+ */
+void
+trace_init(struct state *state)
+{
+	long int i;
+
+	/*
+	 * Check preconditions (firewall)
+	 */
+	if (state == NULL) {
+		err(123, __func__, "state arg is NULL");
+	}
+	if (state->traceFlag == false || ring != NULL) {
+		return;
+	}
+	if (state->tracePath == NULL) {
+		err(123, __func__, "-Y was given without a tracefile");
+	}
+
+	/*
+	 * Open the tracefile now, rather than find it cannot be written at the end of the run
+	 */
+	trace_file = fopen(state->tracePath, "w");
+	if (trace_file == NULL) {
+		errp(123, __func__, "cannot open -Y tracefile: %s", state->tracePath);
+	}
+
+	/*
+	 * One ring per iterate thread, then one for the main thread and the readers
+	 */
+	rings = MAX(state->numberOfThreads, 1) + 1;
+	ring = calloc((size_t) rings, sizeof(ring[0]));
+	if (ring == NULL) {
+		errp(123, __func__, "cannot calloc %ld trace rings", rings);
+	}
+	for (i = 0; i < rings; i++) {
+		ring[i].event = malloc(TRACE_EVENTS * sizeof(ring[i].event[0]));
+		if (ring[i].event == NULL) {
+			errp(123, __func__, "cannot malloc %d events for trace ring %ld", TRACE_EVENTS, i);
+		}
+	}
+	trace_on = true;
+	dbg(DBG_MED, "tracing %ld threads into %s, the last %d events of each", rings - 1, state->tracePath, TRACE_EVENTS);
+}
+
+
+/*
+ * trace_add - record an event
+ *
+ * given:
+ *      thread_state    // state of the iterate thread, of a reader (thread_id -1 - reader), NULL ==> main thread
+ *      what            // what the thread did
+ *      begin           // ticks when it began
+ *      end             // ticks when it ended
+ *
+ * NOTE: Called by timing_add().
+ */
+void
+trace_add(struct thread_state *thread_state, enum timing what, uint64_t begin, uint64_t end)
+{
+	struct trace_ring *ours;	// ring of the thread
+	struct trace_event *event;	// entry of the event
+	int tid;			// trace thread of the event
+
+	if (ring == NULL) {
+		return;
+	}
+	if (thread_state == NULL) {
+		ours = &ring[rings - 1];
+		tid = 0;
+	} else if (thread_state->thread_id < 0) {
+		ours = &ring[rings - 1];
+		tid = (int) (rings - thread_state->thread_id - 1);
+	} else {
+		ours = &ring[MIN(thread_state->thread_id, rings - 1)];
+		tid = (int) (thread_state->thread_id + 1);
+	}
+
+	event = &ours->event[__atomic_fetch_add(&ours->next, 1, __ATOMIC_RELAXED) & (TRACE_EVENTS - 1)];
+	event->begin = begin;
+	event->end = end;
+	event->iteration = (thread_state != NULL) ? thread_state->iteration_being_done : -1;
+	event->what = (int) what;
+	event->tid = tid;
+}
+
+
+/*
+ * trace_name - name of an event
+ */
+static char const *
+trace_name(struct state *state, int what)
+{
+	if (what >= 1 && what <= NUMOFTESTS) {
+		return state->testNames[what];
+	}
+	switch (what) {
+	case TIMING_WAIT:
+		return "wait for bitstream";
+	case TIMING_LOCK:
+		return "lock";
+	case TIMING_PVALUE:
+		return "p-value";
+	case TIMING_READ:
+		return "read";
+	case TIMING_BITSTREAM:
+		return "bitstream";
+	case TIMING_INIT:
+		return "init";
+	case TIMING_ITERATE:
+		return "iterate";
+	case TIMING_PRINT:
+		return "print";
+	case TIMING_METRICS:
+		return "metrics";
+	default:
+		return "unknown";
+	}
+}
+
+
+/*
+ * trace_category - category of an event
+ */
+static char const *
+trace_category(int what)
+{
+	if (what >= 1 && what <= NUMOFTESTS) {
+		return "test";
+	}
+	switch (what) {
+	case TIMING_WAIT:
+	case TIMING_LOCK:
+		return "wait";
+	case TIMING_PVALUE:
+		return "p-value";
+	case TIMING_READ:
+		return "io";
+	case TIMING_BITSTREAM:
+		return "bitstream";
+	default:
+		return "phase";
+	}
+}
+
+
+/*
+ * trace_write - write the recorded events to the -Y tracefile and close it
+ *
+ * given:
+ *      state           // run state
+ *      first           // ticks at time 0 of the trace
+ *      rate            // ticks per second
+ *
+ * NOTE: Called by timing_report(), once every thread that records events is done.
+ *
+ * This function does not return on error.
+ */
+void
+trace_write(struct state *state, uint64_t first, double rate)
+{
+	struct trace_event *event;	// event being written
+	uint64_t kept;			// events a ring still holds
+	uint64_t lost = 0;		// events lost by the rings
+	uint64_t j;
+	int most_tid = 0;		// largest trace thread of an event
+	int io_ret = 0;
+	long int i;
+	int k;
+
+	/*
+	 * Check preconditions (firewall)
+	 */
+	if (state == NULL) {
+		err(124, __func__, "state arg is NULL");
+	}
+	if (ring == NULL || trace_file == NULL) {
+		return;
+	}
+	if (rate <= 0.0) {
+		err(124, __func__, "rate: %f must be > 0", rate);
+	}
+
+	/*
+	 * Events, times in microseconds since timing started
+	 */
+	io_ret |= fprintf(trace_file, "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n");
+	io_ret |= fprintf(trace_file, "{\"name\": \"process_name\", \"ph\": \"M\", \"pid\": 1, \"args\": {\"name\": \"sts\"}}");
+	for (i = 0; i < rings; i++) {
+		kept = MIN(ring[i].next, TRACE_EVENTS);
+		lost += ring[i].next - kept;
+		for (j = ring[i].next - kept; j < ring[i].next; j++) {
+			event = &ring[i].event[j & (TRACE_EVENTS - 1)];
+			most_tid = MAX(most_tid, event->tid);
+			io_ret |= fprintf(trace_file, ",\n{\"name\": \"%s\", \"cat\": \"%s\", \"ph\": \"X\", \"pid\": 1, \"tid\": %d, "
+					  "\"ts\": %.3f, \"dur\": %.3f", trace_name(state, event->what),
+					  trace_category(event->what), event->tid, (double) (event->begin - first) / rate * 1e6,
+					  (double) (event->end - event->begin) / rate * 1e6);
+			if (event->iteration >= 0) {
+				io_ret |= fprintf(trace_file, ", \"args\": {\"iteration\": %ld}", event->iteration + 1);
+			}
+			io_ret |= fprintf(trace_file, "}");
+		}
+	}
+
+	/*
+	 * Name the threads, in the order of their trace thread
+	 */
+	for (k = 0; k <= most_tid; k++) {
+		if (k == 0) {
+			io_ret |= fprintf(trace_file, ",\n{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": 0, "
+					  "\"args\": {\"name\": \"main\"}}");
+		} else if (k < rings) {
+			io_ret |= fprintf(trace_file, ",\n{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": %d, "
+					  "\"args\": {\"name\": \"test thread %d\"}}", k, k - 1);
+		} else {
+			io_ret |= fprintf(trace_file, ",\n{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": %d, "
+					  "\"args\": {\"name\": \"reader %ld\"}}", k, k - rings);
+		}
+		io_ret |= fprintf(trace_file, ",\n{\"name\": \"thread_sort_index\", \"ph\": \"M\", \"pid\": 1, \"tid\": %d, "
+				  "\"args\": {\"sort_index\": %d}}", k, k);
+	}
+	io_ret |= fprintf(trace_file, "\n]}\n");
+	if (io_ret < 0) {
+		errp(124, __func__, "error in writing to -Y tracefile: %s", state->tracePath);
+	}
+
+	errno = 0;	// paranoia
+	if (fclose(trace_file) != 0) {
+		errp(124, __func__, "error closing -Y tracefile: %s", state->tracePath);
+	}
+	trace_file = NULL;
+
+	if (lost > 0) {
+		warn(__func__, "%lu of the oldest events were not kept in %s, the rings keep the last %d events of each thread",
+		     (unsigned long) lost, state->tracePath, TRACE_EVENTS);
+	}
+	dbg(DBG_LOW, "wrote the trace of %ld threads to %s", rings - 1, state->tracePath);
+}
+
+
+/*
+ * trace_free - stop tracing and free the rings
+ */
+void
+trace_free(void)
+{
+	long int i;
+
+	trace_on = false;
+	if (ring != NULL) {
+		for (i = 0; i < rings; i++) {
+			free(ring[i].event);
+		}
+		free(ring);
+		ring = NULL;
+	}
+	rings = 0;
+	if (trace_file != NULL) {
+		fclose(trace_file);
+		trace_file = NULL;
+	}
+}
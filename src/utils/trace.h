@@ -0,0 +1,64 @@
+/*****************************************************************************
+ T R A C E  F U N C T I O N  P R O T O T Y P E S
+ *****************************************************************************/
+
+/*
+ * This code has been heavily modified by the following people:
+ *
+ *      Landon Curt Noll
+ *      Tom Gilgan
+ *      Riccardo Paccagnella
+ *
+ * See the README.md and the initial comment in sts.c for more information.
+ *
+ * WE (THOSE LISTED ABOVE WHO HEAVILY MODIFIED THIS CODE) DISCLAIM ALL
+ * WARRANTIES WITH REGARD TO THIS SOFTWARE, INCLUDING ALL IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL WE (THOSE LISTED ABOVE
+ * WHO HEAVILY MODIFIED THIS CODE) BE LIABLE FOR ANY SPECIAL, INDIRECT OR
+ * CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF
+ * USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ *
+ * chongo (Landon Curt Noll, http://www.isthe.com/chongo/index.html) /\oo/\
+ *
+ * Share and enjoy! :-)
+ */
+
+
+#ifndef TRACE_H
+#   define TRACE_H
+
+#   include <stdint.h>
+#   include "defs.h"
+#   include "timing.h"
+
+#   define TRACE_EVENTS		(1 << 16)	// events a ring keeps, a power of 2
+
+/*
+ * trace_event - an interval of a thread, timed by timing.c
+ */
+struct trace_event {
+	uint64_t begin;			// ticks when it began
+	uint64_t end;			// ticks when it ended
+	long int iteration;		// bitstream it was about, -1 ==> none
+	int what;			// enum timing: what the thread did
+	int tid;			// 0 ==> main thread, then the iterate threads, then the readers
+};
+
+/*
+ * trace_ring - the last TRACE_EVENTS events of a thread
+ */
+struct trace_ring {
+	struct trace_event *event;	// TRACE_EVENTS events, event i in entry i % TRACE_EVENTS
+	uint64_t next;			// events recorded so far (accessed atomically)
+};
+
+extern bool trace_on;
+
+extern void trace_init(struct state *state);
+extern void trace_add(struct thread_state *thread_state, enum timing what, uint64_t begin, uint64_t end);
+extern void trace_write(struct state *state, uint64_t first, double rate);
+extern void trace_free(void);
+
+#endif				/* TRACE_H */
@@ -0,0 +1,223 @@
+// transform.c - unpack raw binary randdata into bitstreams, transforming it on the way
+
+/*
+ * This code has been heavily modified by the following people:
+ *
+ *      Landon Curt Noll
+ *      Tom Gilgan
+ *      Riccardo Paccagnella
+ *
+ * See the README.md and the initial comment in sts.c for more information.
+ *
+ * WE (THOSE LISTED ABOVE WHO HEAVILY MODIFIED THIS CODE) DISCLAIM ALL
+ * WARRANTIES WITH REGARD TO THIS SOFTWARE, INCLUDING ALL IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL WE (THOSE LISTED ABOVE
+ * WHO HEAVILY MODIFIED THIS CODE) BE LIABLE FOR ANY SPECIAL, INDIRECT OR
+ * CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF
+ * USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ *
+ * chongo (Landon Curt Noll, http://www.isthe.com/chongo/index.html) /\oo/\
+ *
+ * Share and enjoy! :-)
+ */
+
+
+
+// Exit codes: 95 thru 96
+
+/*
+ * Raw binary randdata is a sequence of samples, each -X word=W bytes long (def: 1), read as a big
+ * endian (def) or -X le little endian unsigned integer.  Only the low -X low=K bits of each sample
+ * are kept (def: all 8*W), most significant bit first (def) or -X lsb least significant bit first.
+ * Of the bits so obtained, -X every=D keeps the first and every D-th bit after it (def: D = 1).
+ *
+ * The defaults give the bits of each byte most significant first, as sts always read them.
+ * -X lsb reads the files written by tools/generators.c, -X word=2,le,low=12 the 12 bit samples of
+ * a little endian 16 bit ADC, and so on, without first rewriting a capture in the sts bit order.
+ *
+ * A bitstream of n bits consumes n * D / K whole samples, so every bitstream starts on a sample
+ * boundary and can be found with a seek.  transform_bytes() is the size of that input.
+ *
+ * The common cases, whole bytes in either bit order, unpack each input byte by copying its 8
+ * BitSequence values from a table and count its 1 bits from another.  This is faster than the
+ * bit by bit loop sts used to have, and needs no particular instruction set.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <pthread.h>
+#include "../utils/externs.h"
+#include "utilities.h"
+#include "transform.h"
+#include "debug.h"
+
+
+/*
+ * Byte unpacking tables, built once
+ */
+static BitSequence unpack[2][256][BITS_N_BYTE];	// [lsb first][byte]: bits of byte, in order
+static BYTE ones_in[256];			// number of 1 bits in a byte
+static pthread_once_t tables_once = PTHREAD_ONCE_INIT;
+
+
+/*
+ * Forward static function declarations
+ */
+static void build_tables(void);
+
+
+/*
+ * build_tables - fill the byte unpacking tables
+ */
+static void
+build_tables(void)
+{
+	int byte;
+	int j;
+
+	for (byte = 0; byte < 256; byte++) {
+		ones_in[byte] = 0;
+		for (j = 0; j < BITS_N_BYTE; j++) {
+			unpack[0][byte][j] = (BitSequence) ((byte >> (BITS_N_BYTE - 1 - j)) & 1);
+			unpack[1][byte][j] = (BitSequence) ((byte >> j) & 1);
+			ones_in[byte] += unpack[0][byte][j];
+		}
+	}
+}
+
+
+/*
+ * transform_bytes - determine the bytes of raw binary randdata holding one bitstream
+ *
+ * given:
+ *      state           // run state
+ *
+ * returns:
+ *      Bytes of randdata unpacked into tp.n bits.
+ *
+ * This function does not return if a bitstream would not be made of whole samples.
+ */
+long int
+transform_bytes(struct state *state)
+{
+	long int bits;		// Sample bits consumed by one bitstream
+
+	/*
+	 * Check preconditions (firewall)
+	 */
+	if (state == NULL) {
+		err(95, __func__, "state arg is NULL");
+	}
+	if (state->xformFlag == false) {
+		return (state->tp.n + BITS_N_BYTE - 1) / BITS_N_BYTE;
+	}
+
+	bits = state->tp.n * state->xformDecimation;
+	if (bits % state->xformLowBits != 0) {
+		err(95, __func__, "-X xform: bitcount(n): %ld times every=%ld must be a multiple of low=%ld, "
+		    "so that each bitstream is made of whole samples", state->tp.n, state->xformDecimation,
+		    state->xformLowBits);
+	}
+	return (bits / state->xformLowBits) * state->xformWordBytes;
+}
+
+
+/*
+ * transform_bits - unpack the raw binary bytes of one bitstream into a bit array
+ *
+ * given:
+ *      state           // run state
+ *      epsilon         // bit array of tp.n bits to unpack into
+ *      x               // transform_bytes(state) bytes of randdata
+ *      num_0s          // pointer to number of 0 bits unpacked
+ *      num_1s          // pointer to number of 1 bits unpacked
+ *      bitsRead        // pointer to number of bits unpacked
+ */
+void
+transform_bits(struct state *state, BitSequence *epsilon, BYTE *x, long int *num_0s, long int *num_1s,
+	       long int *bitsRead)
+{
+	long int n;		// Bits in a bitstream
+	long int ones = 0;	// 1 bits unpacked
+	long int out = 0;	// bits unpacked
+	long int samples;	// samples in the input
+	long int width;		// bytes per sample
+	long int keep;		// low bits kept from each sample
+	long int every;		// keep every this many bits
+	long int phase = 0;	// bits to drop before the next one kept
+	uint64_t sample;	// current sample
+	int bit;
+	long int i;
+	long int j;
+
+	/*
+	 * Check preconditions (firewall)
+	 */
+	if (state == NULL) {
+		err(96, __func__, "state arg is NULL");
+	}
+	if (epsilon == NULL || x == NULL) {
+		err(96, __func__, "epsilon or x arg is NULL");
+	}
+	if (num_0s == NULL || num_1s == NULL || bitsRead == NULL) {
+		err(96, __func__, "num_0s, num_1s or bitsRead arg is NULL");
+	}
+	pthread_once(&tables_once, build_tables);
+	n = state->tp.n;
+
+	/*
+	 * Whole bytes, in either bit order: tp.n is a multiple of 8
+	 */
+	if (state->xformFlag == false ||
+	    (state->xformWordBytes == 1 && state->xformLowBits == BITS_N_BYTE && state->xformDecimation == 1)) {
+		const int lsb = (state->xformFlag == true && state->xformLsbFirst == true);
+
+		for (i = 0; i < n / BITS_N_BYTE; i++) {
+			memcpy(epsilon + out, unpack[lsb][x[i]], BITS_N_BYTE);
+			ones += ones_in[x[i]];
+			out += BITS_N_BYTE;
+		}
+	}
+
+	/*
+	 * Any sample width, byte order, bit mask and decimation
+	 */
+	else {
+		width = state->xformWordBytes;
+		keep = state->xformLowBits;
+		every = state->xformDecimation;
+		samples = transform_bytes(state) / width;
+		for (i = 0; i < samples && out < n; i++, x += width) {
+
+			// assemble the sample
+			sample = 0;
+			for (j = 0; j < width; j++) {
+				if (state->xformLittleEndian == true) {
+					sample |= (uint64_t) x[j] << (BITS_N_BYTE * j);
+				} else {
+					sample = (sample << BITS_N_BYTE) | x[j];
+				}
+			}
+
+			// take its low keep bits in order, keeping every every-th one
+			for (j = 0; j < keep; j++) {
+				if (phase == 0) {
+					bit = (int) ((state->xformLsbFirst == true) ? (sample >> j) : (sample >> (keep - 1 - j))) & 1;
+					epsilon[out++] = (BitSequence) bit;
+					ones += bit;
+				}
+				if (++phase == every) {
+					phase = 0;
+				}
+			}
+		}
+	}
+
+	*num_1s += ones;
+	*num_0s += out - ones;
+	*bitsRead += out;
+}
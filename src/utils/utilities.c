@@ -40,6 +40,7 @@ int job_rank;
 #include <errno.h>
 #include <limits.h>
 #include <pthread.h>
+#include <sched.h>
 #include <unistd.h>
 
 // for checking dir
@@ -53,6 +54,15 @@ int job_rank;
 // sts includes
 #include "../utils/externs.h"
 #include "utilities.h"
+#include "checkpoint.h"
+#include "writer.h"
+#include "reader.h"
+#include "transform.h"
+#include "arena.h"
+#include "split.h"
+#include "numa.h"
+#include "slice.h"
+#include "timing.h"
 #include "debug.h"
 
 
@@ -61,11 +71,35 @@ int job_rank;
  */
 static double getDouble(FILE * input, FILE * output);
 static char * getString(FILE * stream);
-static bool checkReadPermissions(char *path);
 static void handleFileBasedBitStreams(struct state *state);
+static bool claimIteration(struct thread_state *thread_state);
+static long int claimIterations(struct thread_state *thread_state, long int most);
+static void finishIteration(struct thread_state *thread_state);
 static void *testBits(void *thread_args);
-static void parseBitsASCIIInput(struct thread_state *thread_state);
-static void parseBitsBinaryInput(struct thread_state *thread_state);
+static void *testTeam(void *thread_args);
+static void *testSlices(void *thread_args);
+static split_fn countPatterns_part;
+
+/*
+ * Signalled when a pending checkpoint was written and iterations may be claimed again
+ */
+static pthread_cond_t checkpoint_cond = PTHREAD_COND_INITIALIZER;
+
+/*
+ * Threads testing the same bitstream under -G team
+ *
+ * Thread i is in team i / teamSize, and the first thread of a team claims its bitstreams.
+ * The threads meet at the barrier once the bitstream is ready, take its tasks one at a time
+ * in the order of state->tasks, and meet again before the bitstream is given back to the ring.
+ */
+struct team {
+	pthread_barrier_t barrier;	// Threads of the team meet before and after each bitstream
+	struct ring_slot *slot;		// Bitstream being tested, NULL when no iterations are left
+	BitSequence *bits;		// Bits of the bitstream, on the node of the team under -N
+	long int iteration;		// Iteration being done
+	long int next;			// Next task of the bitstream not taken yet
+};
+static struct team *teams = NULL;	// Teams of a -G team run, or NULL
 
 
 /*
@@ -333,7 +367,7 @@ checkWritePermissions(char *path)
  * Check the write permissions of a path for the current user group and return
  * whether the path readable or not.
  */
-static bool
+bool
 checkReadPermissions(char *path)
 {
 	bool permissions = false;
@@ -1435,6 +1469,7 @@ void
 invokeTestSuite(struct state *state)
 {
 	int io_ret;		// I/O return status
+	uint64_t start;		// ticks when the iterate phase started
 
 	/*
 	 * Check preconditions (firewall)
@@ -1473,7 +1508,9 @@ invokeTestSuite(struct state *state)
 	 * Test data from a file or from an internal generator
 	 * NOTE: Introduce new pseudo random number generators in this switch
 	 */
+	start = timing_start();
 	handleFileBasedBitStreams(state);
+	timing_stop(NULL, TIMING_ITERATE, start);
 }
 
 
@@ -1487,6 +1524,8 @@ handleFileBasedBitStreams(struct state *state)
 	pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
 	struct thread_state *thread_args = malloc(state->numberOfThreads * sizeof(struct thread_state));
 	void *status;
+	long int allocs;	// Dynamic array allocations made by the iterate phase
+	long int count = 0;	// Number of -G teams
 
 	/*
 	 * Check preconditions (firewall)
@@ -1513,18 +1552,11 @@ handleFileBasedBitStreams(struct state *state)
 	}
 
 	/*
-	 * If the input is made of binary data we need to get count that each position is 8 bits.
+	 * If the input is made of binary data, the readers unpack transform_bytes(state) bytes
+	 * into each bitstream, 1 byte for 8 bits unless -X xform was given.
 	 */
 	else if (state->dataFormat == FORMAT_RAW_BINARY) {
-
-		/*
-		 * Get number of bytes that hold a given set of consecutive bits.
-		 *
-		 * We need to round up the byte count to the next whole byte.
-		 * However if the bit count is a multiple of 8, then we do not increase it.
-		 * We only increase by one in the case of a final partial byte.
-		 */
-		state->base_seek = ((state->jobnum * state->tp.n * state->tp.numOfBitStreams) + BITS_N_BYTE - 1) / BITS_N_BYTE;
+		state->base_seek = state->jobnum * state->tp.numOfBitStreams * transform_bytes(state);
 	}
 
 	/*
@@ -1535,6 +1567,42 @@ handleFileBasedBitStreams(struct state *state)
 
 	dbg(DBG_LOW, "Start of iterate phase");
 
+	/*
+	 * Under -s, write results.txt, data*.txt, stats.txt as iterations complete
+	 */
+	writer_start(state, &mutex);
+	allocs = dyn_alloc_count;
+
+	/*
+	 * Under -N, place the iterate threads and their memory on NUMA nodes
+	 */
+	numa_setup(state);
+
+	/*
+	 * Start reading bitstreams ahead of the iterate threads
+	 */
+	reader_start(state);
+
+	/*
+	 * Under -G team, threads are grouped into teams testing a bitstream together, the last one may be smaller
+	 */
+	if (state->teamSize > 1) {
+		count = (state->numberOfThreads + state->teamSize - 1) / state->teamSize;
+		teams = calloc((size_t) count, sizeof(teams[0]));
+		if (teams == NULL) {
+			errp(224, __func__, "cannot calloc for %ld teams", count);
+		}
+		for (i = 0; i < count; i++) {
+			io_ret = pthread_barrier_init(&teams[i].barrier, NULL,
+						      (unsigned int) MIN(state->teamSize, state->numberOfThreads - i * state->teamSize));
+			if (io_ret != 0) {
+				errno = io_ret;
+				errp(224, __func__, "error on pthread_barrier_init()");
+			}
+		}
+		dbg(DBG_MED, "%ld teams of up to %ld threads will test the bitstreams", count, state->teamSize);
+	}
+
 	/*
 	 * Run numberOfThreads threads
 	 */
@@ -1542,9 +1610,46 @@ handleFileBasedBitStreams(struct state *state)
 		thread_args[i].global_state = state;
 		thread_args[i].thread_id = i;
 		thread_args[i].mutex = &mutex;
+		thread_args[i].lane = NULL;
+
+		/*
+		 * Under -C firstcpu, pin thread i to its own CPU before it starts so that
+		 * ranks sharing a node (see mpi_sts) each keep to their own set of cores.
+		 * Thread i gets the (firstcpu+i)th of the CPUs we may run on, which taskset,
+		 * cgroups or the batch scheduler may limit, wrapping around when there are too few.
+		 * Under -N, thread i goes to the CPU of its NUMA node numa_setup() chose.
+		 */
+		if (state->numaFlag == true) {
+			numa_pin_thread(state, &attr, i);
+		} else if (state->pinThreadsFlag == true) {
+			cpu_set_t cpus;
+
+			CPU_ZERO(&cpus);
+			CPU_SET((int) numa_cpu(state->firstCpu + i), &cpus);
+			io_ret = pthread_attr_setaffinity_np(&attr, sizeof(cpus), &cpus);
+			if (io_ret != 0) {
+				warn(__func__, "unable to pin thread %ld to CPU %ld, error: %d",
+				     i, numa_cpu(state->firstCpu + i), io_ret);
+			}
+		}
+
+		io_ret = pthread_create(&thread[i], &attr,
+					teams != NULL ? testTeam : (state->sliceFlag == true ? testSlices : testBits), &thread_args[i]);
 
-		io_ret = pthread_create(&thread[i], &attr, testBits, &thread_args[i]);
+		/*
+		 * A CPU we were allowed to pin to may have been taken from us since: run the thread unpinned
+		 */
+		if (io_ret != 0 && (state->numaFlag == true || state->pinThreadsFlag == true)) {
+			warn(__func__, "cannot start thread %ld pinned to its CPU, error: %d, will run it unpinned", i, io_ret);
+			pthread_attr_destroy(&attr);
+			pthread_attr_init(&attr);
+			pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_JOINABLE);
+			io_ret = pthread_create(&thread[i], &attr,
+						teams != NULL ? testTeam : (state->sliceFlag == true ? testSlices : testBits),
+						&thread_args[i]);
+		}
 		if (io_ret != 0) {
+			errno = io_ret;
 			errp(224, __func__, "error on pthread_create()");
 		}
 	}
@@ -1561,7 +1666,35 @@ handleFileBasedBitStreams(struct state *state)
 			errp(224, __func__, "error on pthread_join()");
 		}
 	}
+	reader_stop(state);
+	numa_stop(state);
+	writer_stop(state);
 	pthread_mutex_destroy(&mutex);
+	if (teams != NULL) {
+		for (i = 0; i < count; i++) {
+			pthread_barrier_destroy(&teams[i].barrier);
+		}
+		free(teams);
+		teams = NULL;
+	}
+
+	/*
+	 * init sizes every buffer and result array for the whole run, so the iterate phase should not allocate
+	 *
+	 * Results that outgrow their reserve, or a -M spill, still can: only test and bench builds,
+	 * compiled with -DSTRICT_ALLOCS, treat an allocation as fatal.
+	 */
+	allocs = dyn_alloc_count - allocs;
+	dbg(DBG_LOW, "iterate phase made %ld dynamic array allocations", allocs);
+#if defined(STRICT_ALLOCS)
+	if (allocs > 0) {
+		err(224, __func__, "iterate phase made %ld dynamic array allocations, expected none", allocs);
+	}
+#else /* STRICT_ALLOCS */
+	if (allocs > 0 && debuglevel >= DBG_LOW) {
+		warn(__func__, "iterate phase made %ld dynamic array allocations, expected none", allocs);
+	}
+#endif /* STRICT_ALLOCS */
 
 	dbg(DBG_LOW, "End of iterate phase\n");
 
@@ -1579,85 +1712,111 @@ handleFileBasedBitStreams(struct state *state)
 }
 
 
-static void
-*testBits(void *thread_args)
+/*
+ * claimIteration - claim the next iteration to be done
+ *
+ * given:
+ *      thread_state    // state of the thread claiming it
+ *
+ * returns:
+ *      true ==> thread_state->iteration_being_done is claimed, false ==> no iterations are left
+ *
+ * Waits while a checkpoint is pending.
+ */
+static bool
+claimIteration(struct thread_state *thread_state)
 {
-	struct thread_state *thread_state = (struct thread_state *) thread_args;
-	char buf[BUFSIZ + 1];	// time string buffer
+	return claimIterations(thread_state, 1) == 1;
+}
 
-	/*
-	 * Check preconditions (firewall)
-	 */
-	if (thread_state == NULL) {
-		err(225, __func__, "thread_state arg is NULL");
-	}
-	struct state *state = thread_state->global_state;
-	if (state == NULL) {
-		err(225, __func__, "state arg is NULL");
-	}
 
-	dbg(DBG_HIGH, "Thread %ld started.", thread_state->thread_id);
+/*
+ * claimIterations - claim the next consecutive iterations to be done
+ *
+ * given:
+ *      thread_state    // state of the thread claiming them
+ *      most            // most iterations to claim
+ *
+ * returns:
+ *      Number of iterations claimed, from thread_state->iteration_being_done on, 0 ==> no iterations are left
+ *
+ * Waits while a checkpoint is pending, and claims no more once a checkpoint becomes due.
+ */
+static long int
+claimIterations(struct thread_state *thread_state, long int most)
+{
+	struct state *state = thread_state->global_state;
+	long int claimed = 0;	// iterations claimed
 
-	while (1) {
-		pthread_mutex_lock(thread_state->mutex);
+	timing_lock(thread_state, thread_state->mutex);
 
-		if (state->iterationsMissing == 0) {
-			pthread_mutex_unlock(thread_state->mutex);
-			break;
-		}
+	/*
+	 * Do not start new iterations while a checkpoint waits for the ones in flight
+	 */
+	while (state->checkpointPending == true) {
+		pthread_cond_wait(&checkpoint_cond, thread_state->mutex);
+	}
 
-		thread_state->iteration_being_done = state->tp.numOfBitStreams - state->iterationsMissing;
+	thread_state->iteration_being_done = state->tp.numOfBitStreams - state->iterationsMissing;
+	while (claimed < most && state->iterationsMissing > 0 && state->checkpointPending == false) {
 		state->iterationsMissing -= 1;
-
-		/*
-		 * Parse and data for this iteration
-		 */
-		if (state->dataFormat == FORMAT_ASCII_01) {
-			parseBitsASCIIInput(thread_state);
-		} else {
-			parseBitsBinaryInput(thread_state);
-		}
-
-		pthread_mutex_unlock(thread_state->mutex);
-
-		/*
-		 * Perform one iteration on the bitstreams read from the streamFile
-		 */
-		iterate(thread_state);
-
-		/*
-		 * Report iteration done (if requested)
-		 */
-		if (state->reportCycle > 0 && (((thread_state->iteration_being_done % state->reportCycle) == 0) ||
-					       (thread_state->iteration_being_done == state->tp.numOfBitStreams))) {
-			getTimestamp(buf, BUFSIZ);
-			msg("Completed iteration %ld of %ld at %s", thread_state->iteration_being_done + 1,
-			    state->tp.numOfBitStreams, buf);
+		state->iterationsInFlight += 1;
+		claimed += 1;
+		if (checkpoint_due(state) == true) {
+			state->checkpointPending = true;
 		}
 	}
 
-	pthread_exit((void *) thread_state->thread_id);
+	pthread_mutex_unlock(thread_state->mutex);
+	return claimed;
 }
 
 
 /*
- * parseBitsASCIIInput - read bits from the streamFile and save them into epsilon bit array
+ * finishIteration - account for a completed iteration
  *
  * given:
- *      state           // pointer to run state
+ *      thread_state    // state of the thread that claimed it
  *
- * Given the open steam streamFile, from file state->randomDataPath, convert its ASCII characters
- * into 'bits' for the epsilon bit array.
+ * The last iteration in flight writes a pending checkpoint.
  */
 static void
-parseBitsASCIIInput(struct thread_state *thread_state)
+finishIteration(struct thread_state *thread_state)
 {
-	long int i;
-	long int num_0s;
-	long int num_1s;
-	long int bitsRead;
-	int bit;
-	int io_ret;		// I/O return status
+	struct state *state = thread_state->global_state;
+	char buf[BUFSIZ + 1];	// time string buffer
+
+	/*
+	 * The last iteration in flight writes the pending checkpoint and lets the others go on
+	 */
+	timing_lock(thread_state, thread_state->mutex);
+	state->iterationsInFlight -= 1;
+	writer_notify(state);
+	if (state->checkpointPending == true && state->iterationsInFlight == 0) {
+		checkpoint_write(state);
+		state->checkpointPending = false;
+		pthread_cond_broadcast(&checkpoint_cond);
+	}
+	pthread_mutex_unlock(thread_state->mutex);
+
+	/*
+	 * Report iteration done (if requested)
+	 */
+	if (state->reportCycle > 0 && (((thread_state->iteration_being_done % state->reportCycle) == 0) ||
+				       (thread_state->iteration_being_done == state->tp.numOfBitStreams))) {
+		getTimestamp(buf, BUFSIZ);
+		msg("Completed iteration %ld of %ld at %s", thread_state->iteration_being_done + 1,
+		    state->tp.numOfBitStreams, buf);
+	}
+}
+
+
+static void
+*testBits(void *thread_args)
+{
+	struct thread_state *thread_state = (struct thread_state *) thread_args;
+	struct ring_slot *slot;	// bitstream of the iteration being done
+	uint64_t start;		// ticks when we began to wait for the bitstream of the iteration
 
 	/*
 	 * Check preconditions (firewall)
@@ -1669,224 +1828,187 @@ parseBitsASCIIInput(struct thread_state *thread_state)
 	if (state == NULL) {
 		err(225, __func__, "state arg is NULL");
 	}
-	if (state->streamFile == NULL) {
-		err(225, __func__, "streamFile arg is NULL");
-	}
-	if (state->epsilon[thread_state->thread_id] == NULL) {
-		err(227, __func__, "state->epsilon[%ld] is NULL", thread_state->thread_id);
-	}
 
-	/*
-	 * If not reading randdata from stdin,
-	 * Seek to the position of the first bit which has not been copied into the stream yet
-	 */
-	if (state->stdinData == false &&
-	    fseek(state->streamFile, state->base_seek + thread_state->iteration_being_done * state->tp.n, SEEK_SET) != 0) {
-		errp(226, __func__, "could not seek %ld further into file: %s",
-		     (thread_state->iteration_being_done * state->tp.n), state->randomDataPath);
-	}
+	dbg(DBG_HIGH, "Thread %ld started.", thread_state->thread_id);
 
-	/*
-	 * Copy the next n bits from the streamFile to epsilon
-	 */
-	num_0s = 0;
-	num_1s = 0;
-	bitsRead = 0;
-	clearerr(state->streamFile);
-	for (i = 0; i < state->tp.n; i++) {
-		io_ret = fscanf(state->streamFile, "%1d", &bit);
-		if (io_ret == EOF) {
-			warn(__func__, "Insufficient data in file %s: %ld bits were read", state->randomDataPath,
-			     bitsRead);
-			return;
-		} else {
-			bitsRead++;
-			if (bit == 0) {
-				num_0s++;
-			} else {
-				num_1s++;
-			}
-			state->epsilon[thread_state->thread_id][i] = (BitSequence) bit;
-		}
-	}
+	while (claimIteration(thread_state) == true) {
 
-	/*
-	 * Write stats to freq.txt if in legacy_output mode
-	 */
-	if (state->legacy_output == true) {
-		io_ret = fprintf(state->freqFile, "\t\tBITSREAD = %ld 0s = %ld 1s = %ld\n", bitsRead, num_0s, num_1s);
-		if (io_ret <= 0) {
-			errp(225, __func__, "error in writing to %s", state->freqFilePath);
-		}
-		io_ret = fflush(state->freqFile);
-		if (io_ret != 0) {
-			errp(225, __func__, "error flushing to %s", state->freqFilePath);
-		}
+		/*
+		 * Perform one iteration on the bitstream the readers read from the streamFile, in place
+		 */
+		start = timing_start();
+		slot = reader_get(state, thread_state->iteration_being_done);
+		timing_stop(thread_state, TIMING_WAIT, start);
+		state->epsilon[thread_state->thread_id] = numa_route(state, thread_state->thread_id, slot);
+		iterate(thread_state);
+		state->epsilon[thread_state->thread_id] = NULL;
+		reader_put(state, slot);
+
+		finishIteration(thread_state);
+		timing_stop(thread_state, TIMING_BITSTREAM, start);
 	}
 
-	return;
+	pthread_exit((void *) thread_state->thread_id);
 }
 
 
 /*
- * parseBitsBinaryInput - read bits from the streamFile and convert them into epsilon bit array
+ * testSlices - test the bitstreams SLICE_LANES at a time, running the bit-sliced engine over each batch
  *
  * given:
- *      state           // pointer to run state
+ *      thread_args     // state of the thread
  *
- * Given the open steam streamFile, from file state->randomDataPath, convert its bytes into 'bits'
- * found in the epsilon bit array.
+ * The engine walks the bits of the batch once for Frequency, Runs, CumulativeSums and LongestRun, then
+ * each bitstream of the batch is iterated in order, those tests taking their counts from its lane.
  */
 static void
-parseBitsBinaryInput(struct thread_state *thread_state)
+*testSlices(void *thread_args)
 {
-	long int num_0s;	// Count of 0 bits processed
-	long int num_1s;	// Count of 1 bits processed
-	long int bitsRead;	// Number of bits to read and process
-	bool done;		// true ==> we have converted enough data
-	BYTE byte;		// single bite
-	int io_ret;		// I/O return status
+	struct thread_state *thread_state = (struct thread_state *) thread_args;
+	struct ring_slot *slot[SLICE_LANES];	// bitstreams of the batch
+	BitSequence *bits[SLICE_LANES];		// bits of the bitstreams of the batch
+	struct slice_lane lane[SLICE_LANES];	// results of the engine for each bitstream of the batch
+	long int first;				// first iteration of the batch
+	long int lanes;				// iterations in the batch
+	uint64_t start;				// ticks when we began to wait for the bitstreams, then to test one
+	long int k;
 
 	/*
 	 * Check preconditions (firewall)
 	 */
 	if (thread_state == NULL) {
-		err(225, __func__, "thread_state arg is NULL");
+		err(227, __func__, "thread_state arg is NULL");
 	}
 	struct state *state = thread_state->global_state;
 	if (state == NULL) {
-		err(226, __func__, "state arg is NULL");
-	}
-	if (state->streamFile == NULL) {
-		err(226, __func__, "streamFile arg is NULL");
+		err(227, __func__, "state arg is NULL");
 	}
 
-	/*
-	 * If not reading randdata from stdin,
-	 * Seek to the position of the first bit which has not been copied into the stream yet
-	 */
-	if (state->stdinData == false &&
-	    fseek(state->streamFile, state->base_seek + thread_state->iteration_being_done * state->tp.n /
-							BITS_N_BYTE, SEEK_SET) != 0) {
+	dbg(DBG_HIGH, "Thread %ld started, testing up to %d bitstreams at once.", thread_state->thread_id, SLICE_LANES);
 
-		errp(226, __func__, "could not seek %ld further into file: %s",
-		     thread_state->iteration_being_done * state->tp.n / BITS_N_BYTE, state->randomDataPath);
-	}
+	while ((lanes = claimIterations(thread_state, SLICE_LANES)) > 0) {
+		first = thread_state->iteration_being_done;
 
-	/*
-	 * Copy the next n bits from the streamFile to epsilon
-	 */
-	num_0s = 0;
-	num_1s = 0;
-	bitsRead = 0;
-	clearerr(state->streamFile);
-	do {
 		/*
-		 * Read the next binary octet
+		 * Run the engine over the bitstreams of the batch, in place in the ring
 		 */
-		io_ret = fgetc(state->streamFile);
-		if (ferror(state->streamFile)) {
-			errp(226, __func__, "read error while reading file: %s", state->randomDataPath);
-		} else if (feof(state->streamFile) || io_ret == EOF) {
-			err(226, __func__, "encounted EOF (end of file) while reading file: %s: %ld bits were read before EOF",
-			    state->randomDataPath, bitsRead);
-		} else if (io_ret < 0) {
-			errp(226, __func__, "unexpected fgetc return while reading file: %s", state->randomDataPath);
+		start = timing_start();
+		for (k = 0; k < lanes; k++) {
+			slot[k] = reader_get(state, first + k);
+			bits[k] = slot[k]->bits;
 		}
-		byte = (BYTE) io_ret;
+		timing_stop(thread_state, TIMING_WAIT, start);
+		slice_bits(state, bits, lanes, lane);
 
 		/*
-		 * Add bits of the octet to the epsilon bit stream
+		 * Perform one iteration on each bitstream of the batch, in order
 		 */
-		done = copyBitsToEpsilon(state, thread_state->thread_id, &byte, BITS_N_BYTE, &num_0s, &num_1s, &bitsRead);
-	} while (done == false);
-
-	/*
-	 * Write stats to freq.txt if in legacy_output mode
-	 */
-	if (state->legacy_output == true) {
-		io_ret = fprintf(state->freqFile, "\t\tBITSREAD = %ld 0s = %ld 1s = %ld\n", bitsRead, num_0s, num_1s);
-		if (io_ret <= 0) {
-			errp(226, __func__, "error in writing to %s", state->freqFilePath);
-		}
-		io_ret = fflush(state->freqFile);
-		if (io_ret != 0) {
-			errp(226, __func__, "error flushing to %s", state->freqFilePath);
+		for (k = 0; k < lanes; k++) {
+			start = timing_start();
+			thread_state->iteration_being_done = first + k;
+			thread_state->lane = &lane[k];
+			state->epsilon[thread_state->thread_id] = bits[k];
+			iterate(thread_state);
+			state->epsilon[thread_state->thread_id] = NULL;
+			thread_state->lane = NULL;
+			reader_put(state, slot[k]);
+
+			finishIteration(thread_state);
+			timing_stop(thread_state, TIMING_BITSTREAM, start);
 		}
 	}
 
-	return;
+	pthread_exit((void *) thread_state->thread_id);
 }
 
 
 /*
- * copyBitsToEpsilon - convert binary bytes into the end of an epsilon bit array
+ * testTeam - test bitstreams together with the other threads of a -G team
  *
  * given:
- *      state           // pointer to run state
- *      x               // pointer to an array (even just 1) binary bytes
- *      xBitLength      // Number of bits to convert
- *      bitsNeeded      // Total number of bits we want to convert this run
- *      num_0s          // pointer to number of 0 bits converted so far
- *      num_1s          // pointer to number of 1 bits converted so far
- *      bitsRead        // pointer to number of bits converted so far
- *
- * returns:
- *      true ==> we have converted enough bits
- *      false ==> we have NOT converted enough bits, yet
+ *      thread_args     // struct thread_state of the thread
  */
-bool
-copyBitsToEpsilon(struct state *state, long int thread_id, BYTE *x, long int xBitLength, long int *num_0s, long int *num_1s,
-		  long int *bitsRead)
+static void
+*testTeam(void *thread_args)
 {
-	long int i;
-	long int j;
-	long int count;
-	int bit;
-	BYTE mask;
-	long int zeros;
-	long int ones;
-	long int bitsNeeded;
+	struct thread_state *thread_state = (struct thread_state *) thread_args;
+	struct team *team;	// team of this thread
+	bool first;		// true ==> this thread claims the bitstreams of its team
+	long int task;		// task of the bitstream taken by this thread
+	uint64_t start;		// ticks when we began to wait for the bitstream, then to test it
+	int ret;
 
 	/*
 	 * Check preconditions (firewall)
 	 */
+	if (thread_state == NULL) {
+		err(226, __func__, "thread_state arg is NULL");
+	}
+	struct state *state = thread_state->global_state;
 	if (state == NULL) {
-		err(227, __func__, "state arg is NULL");
+		err(226, __func__, "state arg is NULL");
 	}
-	if (state->epsilon[thread_id] == NULL) {
-		err(227, __func__, "state->epsilon[%ld] is NULL", thread_id);
+	if (teams == NULL || state->teamSize < 1) {
+		err(226, __func__, "no -G teams were set up");
 	}
+	team = &teams[thread_state->thread_id / state->teamSize];
+	first = (thread_state->thread_id % state->teamSize == 0);
 
-	bitsNeeded = state->tp.n;
+	dbg(DBG_HIGH, "Thread %ld started in team %ld.", thread_state->thread_id, thread_state->thread_id / state->teamSize);
 
-	count = 0;
-	zeros = ones = 0;
-	for (i = 0; i < (xBitLength + BITS_N_BYTE - 1) / BITS_N_BYTE; i++) {
-		mask = 0x80;
-		for (j = 0; j < 8; j++) {
-			if (*(x + i) & mask) {
-				bit = 1;
-				(*num_1s)++;
-				ones++;
-			} else {
-				bit = 0;
-				(*num_0s)++;
-				zeros++;
-			}
-			mask >>= 1;
-			state->epsilon[thread_id][*bitsRead] = (BitSequence) bit;
-			(*bitsRead)++;
-			if (*bitsRead == bitsNeeded) {
-				return true;
-			}
-			if (++count == xBitLength) {
-				return false;
+	while (1) {
+
+		/*
+		 * The first thread of the team claims the next bitstream for all of them
+		 */
+		if (first == true) {
+			team->slot = NULL;
+			if (claimIteration(thread_state) == true) {
+				team->iteration = thread_state->iteration_being_done;
+				team->next = 0;
+				start = timing_start();
+				team->slot = reader_get(state, team->iteration);
+				timing_stop(thread_state, TIMING_WAIT, start);
+				team->bits = numa_route(state, thread_state->thread_id, team->slot);
 			}
 		}
+		ret = pthread_barrier_wait(&team->barrier);
+		if (ret != 0 && ret != PTHREAD_BARRIER_SERIAL_THREAD) {
+			errno = ret;
+			errp(226, __func__, "error on pthread_barrier_wait()");
+		}
+		if (team->slot == NULL) {
+			break;
+		}
+
+		/*
+		 * Take tasks of the bitstream until none are left, each with this thread's own scratch buffers
+		 */
+		start = timing_start();
+		thread_state->iteration_being_done = team->iteration;
+		state->epsilon[thread_state->thread_id] = team->bits;
+		forgetPatterns(state, thread_state->thread_id);
+		while ((task = __atomic_fetch_add(&team->next, 1, __ATOMIC_RELAXED)) < state->taskCount) {
+			iterate_task(thread_state, task);
+		}
+		state->epsilon[thread_state->thread_id] = NULL;
+		timing_stop(thread_state, TIMING_BITSTREAM, start);
+
+		/*
+		 * Once every thread of the team is done, the first one gives the bitstream back
+		 */
+		ret = pthread_barrier_wait(&team->barrier);
+		if (ret != 0 && ret != PTHREAD_BARRIER_SERIAL_THREAD) {
+			errno = ret;
+			errp(226, __func__, "error on pthread_barrier_wait()");
+		}
+		if (first == true) {
+			reader_put(state, team->slot);
+			finishIteration(thread_state);
+		}
 	}
 
-	return false;
+	pthread_exit((void *) thread_state->thread_id);
 }
 
 
@@ -2138,6 +2260,13 @@ void read_from_p_val_file(struct state *state)
 				break;
 			}
 
+			/*
+			 * Make room for all of them at once
+			 */
+			if (test_num >= 1 && test_num <= NUMOFTESTS && number_of_p_vals > 0 && state->p_val[test_num] != NULL) {
+				reserve_dyn_array(state->p_val[test_num], state->p_val[test_num]->count + number_of_p_vals);
+			}
+
 			/*
 			 * Read all the p-values for this test
 			 */
@@ -2279,3 +2408,313 @@ multiplication_will_overflow_long(long int si_a, long int si_b)
 
 	return 0;		// will not overflow
 }
+
+
+/*
+ * createResults - create a p_val or stats array of a test
+ *
+ * given:
+ *      state           // run state
+ *      elm_size        // size of a result
+ *      per_bitstream   // results recorded for each bitstream
+ *
+ * returns:
+ *      An empty dynamic array with room for the results of the whole run when they fit in
+ *      MAX_RESERVE bytes, else for MAX_RESERVE bytes of them: a large -i grows the array as
+ *      the results come instead of failing up front for memory the run may never get to use.
+ *
+ * Under -M memlimit, nothing is reserved here: memoryPlan() decides which arrays fit in memory
+ * and which are spilled to files before it reserves them for the whole run.
+ *
+ * Clears state->resultsReserved when the array was not reserved for the whole run, so that its
+ * records may move when it grows.
+ *
+ * This function does not return on error.
+ */
+struct dyn_array *
+createResults(struct state *state, size_t elm_size, long int per_bitstream)
+{
+	long int total;		// results of the whole run
+	long int most;		// results that fit in MAX_RESERVE bytes
+
+	/*
+	 * Check preconditions (firewall)
+	 */
+	if (state == NULL) {
+		err(234, __func__, "state arg is NULL");
+	}
+	if (elm_size <= 0 || per_bitstream <= 0) {
+		err(234, __func__, "elm_size: %lu and per_bitstream: %ld must be > 0", elm_size, per_bitstream);
+	}
+
+	/*
+	 * Under -M, leave the reservation to memoryPlan()
+	 */
+	if (state->memLimitFlag == true) {
+		state->resultsReserved = false;
+		return create_dyn_array(elm_size, DEFAULT_CHUNK, per_bitstream, false);
+	}
+
+	/*
+	 * Reserve the whole run, or as much of it as fits in MAX_RESERVE bytes
+	 */
+	most = MAX(MAX_RESERVE / (long int) elm_size, per_bitstream);
+	if (multiplication_will_overflow_long(per_bitstream, state->tp.numOfBitStreams) ||
+	    per_bitstream * state->tp.numOfBitStreams > most) {
+		dbg(DBG_MED, "reserving %ld of the results of %ld bitstreams of %lu bytes each, the rest will grow as needed",
+		    most, state->tp.numOfBitStreams, elm_size);
+		state->resultsReserved = false;
+		return create_dyn_array(elm_size, DEFAULT_CHUNK, most, false);
+	}
+	total = MAX(per_bitstream * state->tp.numOfBitStreams, per_bitstream);
+
+	return create_dyn_array(elm_size, DEFAULT_CHUNK, total, false);
+}
+
+
+/*
+ * recordStats - record the stats of a test of a bitstream in stats[test]
+ *
+ * given:
+ *      state           // run state the test records its results into
+ *      thread_state    // thread that tested the bitstream
+ *      test            // test of the bitstream
+ *      stat            // stats of the test of the bitstream
+ *
+ * Threads record their iterations as they complete them, out of order: the iteration of each
+ * record is noted in statsIteration[test], so that the writer puts the records back in order.
+ *
+ * NOTE: The caller must hold the iterate mutex when the iterate threads are running.
+ *
+ * This function does not return on error.
+ */
+void
+recordStats(struct state *state, struct thread_state *thread_state, enum test test, void *stat)
+{
+	/*
+	 * Check preconditions (firewall)
+	 */
+	if (state == NULL || thread_state == NULL || stat == NULL) {
+		err(220, __func__, "state, thread_state and stat args must not be NULL");
+	}
+	if (state->stats[test] == NULL) {
+		err(220, __func__, "test %s[%d] keeps no stats", state->testNames[test], test);
+	}
+
+	append_value(state->stats[test], stat);
+	if (state->statsIteration[test] != NULL) {
+		append_value(state->statsIteration[test], &thread_state->iteration_being_done);
+	}
+}
+
+
+/*
+ * reservePatterns - make room to count overlapping patterns of up to blocksize bits
+ *
+ * given:
+ *      state           // run state, after init() created the per thread patterns
+ *      blocksize       // longest patterns a test will ask countPatterns() for
+ *
+ * Called by the init function of each test using countPatterns(), so that the
+ * bitstream is scanned once for the longest patterns any enabled test needs.
+ *
+ * This function does not return on error.
+ */
+void
+reservePatterns(struct state *state, long int blocksize)
+{
+	long int i;
+
+	/*
+	 * Check preconditions (firewall)
+	 */
+	if (state == NULL) {
+		err(230, __func__, "state arg is NULL");
+	}
+	if (state->patterns == NULL) {
+		err(230, __func__, "state->patterns is NULL");
+	}
+	if (blocksize < 1 || blocksize > (long int) BITS_N_LONGINT - 2) {
+		err(230, __func__, "blocksize: %ld must be in the range [1, %ld]", blocksize, (long int) BITS_N_LONGINT - 2);
+	}
+
+	/*
+	 * Room for the counts of the patterns of each length up to blocksize bits
+	 */
+	for (i = 0; i < state->numberOfThreads; i++) {
+		if (state->patterns[i].max < blocksize) {
+			state->patterns[i].counts = arena_alloc(state, i, (size_t) 2 << blocksize,
+								sizeof(state->patterns[i].counts[0]));
+			state->patterns[i].max = blocksize;
+			state->patterns[i].valid = 0;
+			if (state->splitParts > 1) {
+				state->patterns[i].parts = arena_alloc(state, i, (size_t) (state->splitParts - 1) << blocksize,
+								       sizeof(state->patterns[i].parts[0]));
+			}
+		}
+	}
+	dbg(DBG_HIGH, "will count overlapping patterns of up to %ld bits", state->patterns[0].max);
+
+	return;
+}
+
+
+/*
+ * countPatterns_part - count the longest overlapping patterns starting in a piece of a bitstream
+ *
+ * given:
+ *      thread_state    // thread whose bitstream to count
+ *      arg             // struct patterns of the thread
+ *      part            // piece to count: 0 into the counts, the others into the parts
+ *      first           // first pattern of the piece
+ *      last            // pattern after the last pattern of the piece
+ *
+ * Pattern j is made of the max bits after bit j, wrapping around the end of the bitstream.
+ */
+static void
+countPatterns_part(struct thread_state *thread_state, void *arg, long int part, long int first, long int last)
+{
+	struct patterns *patterns = (struct patterns *) arg;
+	BitSequence *epsilon;		// Bitstream being tested by this thread
+	long int *counts;		// Counts of the piece
+	long int n;			// Length of a single bit stream
+	long int max;			// Length of the longest patterns counted
+	long int mask;			// Bit-mask used to discard the extra bits of a sequence
+	long int dec;			// Decimal representation of a pattern
+	long int i;
+
+	n = thread_state->global_state->tp.n;
+	epsilon = thread_state->global_state->epsilon[thread_state->thread_id];
+	max = patterns->max;
+	if (part == 0) {
+		counts = patterns->counts + ((long int) 1 << max);
+	} else {
+		counts = patterns->parts + ((part - 1) << max);
+	}
+	memset(counts, 0, ((size_t) 1 << max) * sizeof(counts[0]));
+	mask = ((long int) 1 << max) - 1;
+
+	/*
+	 * NOTE: i % n is used to avoid appending max-1 bits in the end (as indicated in the paper)
+	 */
+	for (dec = 0, i = first + 1; i < first + max; i++) {
+		dec = (dec << 1) + (int) epsilon[i % n];
+	}
+	for (i = first + max; i < last + max; i++) {
+		dec = ((dec << 1) + (int) epsilon[i % n]) & mask;
+		counts[dec]++;
+	}
+}
+
+
+/*
+ * countPatterns - count the overlapping patterns of a given length in the bitstream of a thread
+ *
+ * given:
+ *      thread_state    // thread whose bitstream to count
+ *      blocksize       // length of the patterns in bits
+ *
+ * returns:
+ *      Array of 2^blocksize counts, indexed by the value of the pattern read most significant
+ *      bit first.  The bitstream wraps around, so that each of its n bits starts a pattern.
+ *
+ * The first call for a bitstream counts the longest patterns reserved, the counts of each
+ * shorter length are then the sum of the counts of the two patterns they are a prefix of.
+ * iterate() calls forgetPatterns() before moving on to the next bitstream.
+ *
+ * This function does not return on error.
+ */
+long int *
+countPatterns(struct thread_state *thread_state, long int blocksize)
+{
+	struct patterns *patterns;	// Pattern counts of this thread
+	long int *counts;		// Counts of the patterns of a given length
+	long int *longer;		// Counts of the patterns one bit longer
+	long int *part;			// Counts of a -J piece of the bitstream
+	long int parts;			// Number of pieces the bitstream is counted in
+	long int max;			// Length of the longest patterns counted
+	long int b;
+	long int k;
+	long int i;
+
+	/*
+	 * Check preconditions (firewall)
+	 */
+	if (thread_state == NULL) {
+		err(231, __func__, "thread_state arg is NULL");
+	}
+	struct state *state = thread_state->global_state;
+	if (state == NULL) {
+		err(231, __func__, "state arg is NULL");
+	}
+	if (state->epsilon == NULL || state->epsilon[thread_state->thread_id] == NULL) {
+		err(231, __func__, "state->epsilon[%ld] is NULL", thread_state->thread_id);
+	}
+	if (state->patterns == NULL) {
+		err(231, __func__, "state->patterns is NULL");
+	}
+	patterns = &state->patterns[thread_state->thread_id];
+	max = patterns->max;
+	if (blocksize < 1 || blocksize > max) {
+		err(231, __func__, "blocksize: %ld must be in the range [1, %ld] reserved by reservePatterns()", blocksize, max);
+	}
+
+	/*
+	 * Count the longest patterns, wrapping around the end of the bitstream, by -J pieces
+	 */
+	if (patterns->valid == 0) {
+		parts = (patterns->parts == NULL) ? 1 : split_parts(state, state->tp.n, 1);
+		split_run(thread_state, parts, state->tp.n, countPatterns_part, patterns);
+		counts = patterns->counts + ((long int) 1 << max);
+		for (k = 1; k < parts; k++) {
+			part = patterns->parts + ((k - 1) << max);
+			for (i = 0; i < ((long int) 1 << max); i++) {
+				counts[i] += part[i];
+			}
+		}
+		patterns->valid = 1UL << max;
+	}
+
+	/*
+	 * Add up the counts of shorter patterns from the shortest longer ones already counted
+	 */
+	for (b = blocksize; (patterns->valid & (1UL << b)) == 0; b++) {
+	}
+	for (--b; b >= blocksize; b--) {
+		counts = patterns->counts + ((long int) 1 << b);
+		longer = patterns->counts + ((long int) 2 << b);
+		for (i = 0; i < ((long int) 1 << b); i++) {
+			counts[i] = longer[2 * i] + longer[2 * i + 1];
+		}
+		patterns->valid |= 1UL << b;
+	}
+
+	return patterns->counts + ((long int) 1 << blocksize);
+}
+
+
+/*
+ * forgetPatterns - forget the pattern counts of the bitstream a thread tested
+ *
+ * given:
+ *      state           // run state
+ *      thread_id       // thread moving on to its next bitstream
+ */
+void
+forgetPatterns(struct state *state, long int thread_id)
+{
+	/*
+	 * Check preconditions (firewall)
+	 */
+	if (state == NULL) {
+		err(233, __func__, "state arg is NULL");
+	}
+	if (state->patterns == NULL) {
+		return;
+	}
+	if (thread_id < 0 || thread_id >= state->numberOfThreads) {
+		err(233, __func__, "thread_id: %ld must be in [0, %ld)", thread_id, state->numberOfThreads);
+	}
+
+	state->patterns[thread_id].valid = 0;
+}
@@ -31,6 +31,7 @@
 extern long int getNumber(FILE * input, FILE * output);
 extern void makePath(char *dir);
 extern bool checkWritePermissions(char *dir);
+extern bool checkReadPermissions(char *path);
 extern FILE *openTruncate(char *filename);
 extern char *filePathName(char *head, char *tail);
 extern char *data_filename_format(int partitionCount);
@@ -40,8 +41,6 @@ extern long int str2longint(bool * success_p, char *string);
 extern void generatorOptions(struct state *state);
 extern void chooseTests(struct state *state);
 extern void fixParameters(struct state *state);
-extern bool copyBitsToEpsilon(struct state *state, long int thread_id, BYTE *x, long int xBitLength, long int *num_0s,
-			      long int *num_1s, long int *bitsRead);
 extern void invokeTestSuite(struct state *state);
 extern void read_from_p_val_file(struct state *state);
 extern void write_p_val_to_file(struct state *state);
@@ -50,6 +49,11 @@ extern int sum_will_overflow_long(long int si_a, long int si_b);
 extern int multiplication_will_overflow_long(long int si_a, long int si_b);
 extern void getTimestamp(char *buf, size_t len);
 extern void append_string_to_linked_list(struct Node **head, char* string);
+extern struct dyn_array *createResults(struct state *state, size_t elm_size, long int per_bitstream);
+extern void recordStats(struct state *state, struct thread_state *thread_state, enum test test, void *stat);
+extern void reservePatterns(struct state *state, long int blocksize);
+extern long int *countPatterns(struct thread_state *thread_state, long int blocksize);
+extern void forgetPatterns(struct state *state, long int thread_id);
 
 extern int job_rank;
 
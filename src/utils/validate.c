@@ -0,0 +1,559 @@
+// validate.c - test each bitstream again with the reference implementation of its tests and compare
+
+/*
+ * This code has been heavily modified by the following people:
+ *
+ *      Landon Curt Noll
+ *      Tom Gilgan
+ *      Riccardo Paccagnella
+ *
+ * See the README.md and the initial comment in sts.c for more information.
+ *
+ * WE (THOSE LISTED ABOVE WHO HEAVILY MODIFIED THIS CODE) DISCLAIM ALL
+ * WARRANTIES WITH REGARD TO THIS SOFTWARE, INCLUDING ALL IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL WE (THOSE LISTED ABOVE
+ * WHO HEAVILY MODIFIED THIS CODE) BE LIABLE FOR ANY SPECIAL, INDIRECT OR
+ * CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF
+ * USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ *
+ * chongo (Landon Curt Noll, http://www.isthe.com/chongo/index.html) /\oo/\
+ *
+ * Share and enjoy! :-)
+ */
+
+
+// Exit codes: 97 thru 99
+
+/*
+ * The tests take shortcuts on the way to their results: under -B the bit-sliced engine counts the
+ * bits of Frequency, CumulativeSums, Runs and LongestRun 64 bitstreams at a time, under -J split
+ * the work of a test is cut into pieces, the memos hand out p-values computed for an earlier
+ * bitstream, ApproximateEntropy and Serial share their pattern counts, and CumulativeSums leaves
+ * out the terms of its p-value beyond CUSUM_TAIL.  Under -V, the thread testing a bitstream runs
+ * each test twice: as the run is set up, into a copy of the run state private to the thread, then
+ * with the reference implementation, that walks the bitstream one byte per bit, in one piece, with
+ * no memo, counting its own patterns, and with every term of the CumulativeSums p-value.
+ *
+ * The counts of the iterations, the statistics (under -s) and the p-values of the two must be the
+ * same, except that a p-value may differ by VALIDATE_ULP units in the last place of 1.0.  p-values
+ * lie in [0, 1] and are computed from terms up to 1, so that is the size of the rounding errors of
+ * a reordered or shortened sum, however small the p-value.  The results are then added to the run
+ * state as if the test had recorded them there, so the output of the run is that of the run as set
+ * up.  Both implementations call the same cephes functions, and the -W parameter sets are not
+ * compared.  The run completes, then exits 97 if some results differ.
+ *
+ * Statistics are compared byte for byte, the tests zeroize them before testing a bitstream.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <float.h>
+#include "../utils/externs.h"
+#include "utilities.h"
+#include "validate.h"
+#include "timing.h"
+#include "debug.h"
+
+
+/*
+ * Forward static function declarations
+ */
+static void validate_copy(struct state *copy, struct state *state);
+static void validate_clear(struct state *copy, enum test test);
+static bool validate_value(double value, double reference, bool *rounded);
+static void validate_compare(struct validate *validate, struct thread_state *thread_state, enum test test);
+static void validate_merge(struct thread_state *thread_state, struct state *alternate, enum test test);
+static void validate_free_copy(struct state *copy);
+
+
+/*
+ * validate_copy - copy the run state, with empty results of its own
+ *
+ * given:
+ *      copy            // run state to set up
+ *      state           // run state to copy, with its tests initialized
+ *
+ * The copy shares the bitstreams, arenas, scratch buffers and memos of state.  It has its own
+ * arrays of p-values and statistics for the results of one bitstream, and its own counts.
+ *
+ * This function does not return on error.
+ */
+static void
+validate_copy(struct state *copy, struct state *state)
+{
+	int i;
+
+	*copy = *state;
+	copy->sweepCount = 0;
+	copy->sweep = NULL;
+	copy->tasks = NULL;
+	copy->taskCount = 0;
+	copy->output = NULL;
+	copy->checkpointFile = NULL;
+	copy->validate = NULL;
+	for (i = 1; i <= NUMOFTESTS; i++) {
+		copy->count[i] = 0;
+		copy->valid[i] = 0;
+		copy->success[i] = 0;
+		copy->failure[i] = 0;
+		copy->valid_p_val[i] = 0;
+		copy->p_val[i] = NULL;
+		copy->stats[i] = NULL;
+		copy->statsIteration[i] = NULL;
+		if (state->testVector[i] != true) {
+			continue;
+		}
+		if (state->p_val[i] != NULL) {
+			copy->p_val[i] = create_dyn_array(state->p_val[i]->elm_size, DEFAULT_CHUNK, state->partitionCount[i], false);
+		}
+		if (state->stats[i] != NULL) {
+			copy->stats[i] = create_dyn_array(state->stats[i]->elm_size, DEFAULT_CHUNK, 1, false);
+		}
+	}
+}
+
+
+/*
+ * validate_init - set up the run states each thread compares the results of its bitstreams with
+ *
+ * given:
+ *      state           // run state, with its tests initialized and its epsilon allocated
+ *
+ * Does nothing without -V.
+ *
+ * This function does not return on error.
+ */
+void
+validate_init(struct state *state)
+{
+	struct validate *validate;	// run states of a thread
+	long int t;
+	int i;
+
+	/*
+	 * Check preconditions (firewall)
+	 */
+	if (state == NULL) {
+		err(97, __func__, "state arg is NULL");
+	}
+	if (state->validateFlag == false || state->runMode == MODE_ASSESS_ONLY) {
+		return;
+	}
+
+	state->validate = calloc((size_t) state->numberOfThreads, sizeof(state->validate[0]));
+	if (state->validate == NULL) {
+		errp(97, __func__, "cannot calloc for validate: %ld elements of %lu bytes each", state->numberOfThreads,
+		     sizeof(state->validate[0]));
+	}
+	for (t = 0; t < state->numberOfThreads; t++) {
+		validate = &state->validate[t];
+		validate_copy(&validate->alternate, state);
+		validate_copy(&validate->reference, state);
+		validate->reference.referenceInstance = true;
+		for (i = 1; i <= NUMOFTESTS; i++) {
+			validate->reference.memo[i] = NULL;
+		}
+	}
+	dbg(DBG_LOW, "will compare the results of each bitstream with the reference implementation, within %d ulp of 1.0",
+	    VALIDATE_ULP);
+}
+
+
+/*
+ * validate_clear - forget the results of a test of a bitstream
+ *
+ * given:
+ *      copy            // run state of validate_copy()
+ *      test            // test whose results to forget
+ */
+static void
+validate_clear(struct state *copy, enum test test)
+{
+	copy->count[test] = 0;
+	copy->valid[test] = 0;
+	copy->success[test] = 0;
+	copy->failure[test] = 0;
+	copy->valid_p_val[test] = 0;
+	if (copy->p_val[test] != NULL) {
+		clear_dyn_array(copy->p_val[test]);
+	}
+	if (copy->stats[test] != NULL) {
+		clear_dyn_array(copy->stats[test]);
+	}
+}
+
+
+/*
+ * validate_value - determine if a p-value is within the budget of its reference
+ *
+ * given:
+ *      value           // p-value of the run as set up
+ *      reference       // p-value of the reference implementation
+ *      rounded         // set to true if the values differ within the budget
+ *
+ * returns:
+ *      true ==> the p-values are the same, or differ by VALIDATE_ULP units in the last place of 1.0 at most
+ */
+static bool
+validate_value(double value, double reference, bool *rounded)
+{
+	if (memcmp(&value, &reference, sizeof(value)) == 0) {
+		return true;
+	}
+	if (isnan(value) || isnan(reference) || fabs(value - reference) > VALIDATE_ULP * DBL_EPSILON) {
+		return false;
+	}
+	*rounded = true;
+	return true;
+}
+
+
+/*
+ * validate_compare - compare the results of a test of a bitstream with those of the reference implementation
+ *
+ * given:
+ *      validate        // run states of the thread, with the results of both implementations
+ *      thread_state    // thread that tested the bitstream
+ *      test            // test of the bitstream
+ *
+ * The first VALIDATE_WARN bitstreams of each test of the thread whose results differ are reported.
+ */
+static void
+validate_compare(struct validate *validate, struct thread_state *thread_state, enum test test)
+{
+	struct state *alternate = &validate->alternate;	// results of the run as set up
+	struct state *reference = &validate->reference;	// results of the reference implementation
+	struct dyn_array *value;			// p-values of the run as set up
+	struct dyn_array *expect;			// p-values of the reference implementation
+	struct nonover_stats *nonover;			// results of a template of the run as set up
+	struct nonover_stats *nonover_expect;		// results of a template of the reference implementation
+	char const *name = alternate->testNames[test];	// name of the test
+	long int iteration = thread_state->iteration_being_done + 1;	// iteration, as reported
+	bool report = (validate->differ[test] < VALIDATE_WARN);	// true ==> report what differs
+	bool differ = false;				// true ==> some results differ beyond the budget
+	bool rounded = false;				// true ==> some p-values differ within the budget
+	double p_value;					// p-value of the run as set up
+	double p_expect;				// p-value of the reference implementation
+	long int k;
+
+	/*
+	 * Compare the counts of the iteration
+	 */
+	if (alternate->count[test] != reference->count[test] || alternate->valid[test] != reference->valid[test] ||
+	    alternate->success[test] != reference->success[test] || alternate->failure[test] != reference->failure[test] ||
+	    alternate->valid_p_val[test] != reference->valid_p_val[test]) {
+		differ = true;
+		if (report == true) {
+			warn(__func__, "iteration %ld of test %s[%d]: count, valid, success, failure, valid p-values: "
+			     "%ld %ld %ld %ld %ld, reference: %ld %ld %ld %ld %ld", iteration, name, test,
+			     alternate->count[test], alternate->valid[test], alternate->success[test], alternate->failure[test],
+			     alternate->valid_p_val[test], reference->count[test], reference->valid[test],
+			     reference->success[test], reference->failure[test], reference->valid_p_val[test]);
+		}
+	}
+
+	/*
+	 * Compare the statistics
+	 */
+	if (alternate->stats[test] != NULL && reference->stats[test] != NULL) {
+		if (alternate->stats[test]->count != reference->stats[test]->count ||
+		    memcmp(alternate->stats[test]->data, reference->stats[test]->data,
+			   (size_t) alternate->stats[test]->count * alternate->stats[test]->elm_size) != 0) {
+			differ = true;
+			if (report == true) {
+				warn(__func__, "iteration %ld of test %s[%d]: statistics differ from the reference",
+				     iteration, name, test);
+			}
+		}
+	}
+
+	/*
+	 * Compare the p-values, and the statistics of each template of TEST_NON_OVERLAPPING
+	 */
+	value = alternate->p_val[test];
+	expect = reference->p_val[test];
+	if (value->count != expect->count) {
+		differ = true;
+		if (report == true) {
+			warn(__func__, "iteration %ld of test %s[%d]: %ld p-values, reference: %ld",
+			     iteration, name, test, value->count, expect->count);
+		}
+	} else {
+		for (k = 0; k < value->count; k++) {
+			if (test == TEST_NON_OVERLAPPING) {
+				nonover = (struct nonover_stats *) value->data + k;
+				nonover_expect = (struct nonover_stats *) expect->data + k;
+				if (nonover->success != nonover_expect->success ||
+				    memcmp(&nonover->chi2, &nonover_expect->chi2, sizeof(nonover->chi2)) != 0 ||
+				    nonover->template_index != nonover_expect->template_index ||
+				    memcmp(nonover->Wj, nonover_expect->Wj, sizeof(nonover->Wj)) != 0) {
+					differ = true;
+					if (report == true) {
+						warn(__func__, "iteration %ld of test %s[%d]: statistics of template %ld differ "
+						     "from the reference", iteration, name, test, k);
+					}
+				}
+				p_value = nonover->p_value;
+				p_expect = nonover_expect->p_value;
+			} else {
+				p_value = ((double *) value->data)[k];
+				p_expect = ((double *) expect->data)[k];
+			}
+			if (validate_value(p_value, p_expect, &rounded) == false) {
+				differ = true;
+				if (report == true) {
+					warn(__func__, "iteration %ld of test %s[%d]: p-value %ld: %.17g, reference: %.17g",
+					     iteration, name, test, k, p_value, p_expect);
+				}
+			}
+		}
+	}
+
+	/*
+	 * Count the comparison
+	 */
+	validate->compared[test]++;
+	if (differ == true) {
+		validate->differ[test]++;
+	} else if (rounded == true) {
+		validate->rounded[test]++;
+	}
+}
+
+
+/*
+ * validate_merge - record the results of a test of a bitstream in the run state
+ *
+ * given:
+ *      thread_state    // thread that tested the bitstream, whose global_state is the run state
+ *      alternate       // run state of the thread the test recorded its results into
+ *      test            // test of the bitstream
+ */
+static void
+validate_merge(struct thread_state *thread_state, struct state *alternate, enum test test)
+{
+	struct state *state = thread_state->global_state;	// run state
+	long int k;
+
+	/*
+	 * Lock mutex before making changes to the shared state
+	 */
+	if (thread_state->mutex != NULL) {
+		timing_lock(thread_state, thread_state->mutex);
+	}
+
+	/*
+	 * Record the results as the test would have
+	 */
+	state->count[test] += alternate->count[test];
+	state->valid[test] += alternate->valid[test];
+	state->success[test] += alternate->success[test];
+	state->failure[test] += alternate->failure[test];
+	state->valid_p_val[test] += alternate->valid_p_val[test];
+	if (state->stats[test] != NULL && alternate->stats[test] != NULL && alternate->stats[test]->count > 0) {
+		append_array(state->stats[test], alternate->stats[test]->data, alternate->stats[test]->count);
+		for (k = 0; state->statsIteration[test] != NULL && k < alternate->stats[test]->count; k++) {
+			append_value(state->statsIteration[test], &thread_state->iteration_being_done);
+		}
+	}
+	if (alternate->p_val[test]->count > 0) {
+		append_array(state->p_val[test], alternate->p_val[test]->data, alternate->p_val[test]->count);
+	}
+
+	/*
+	 * Unlock mutex after making changes to the shared state
+	 */
+	if (thread_state->mutex != NULL) {
+		pthread_mutex_unlock(thread_state->mutex);
+	}
+}
+
+
+/*
+ * validate_iterate - test a bitstream with a test and its reference implementation, and compare
+ *
+ * given:
+ *      thread_state    // thread testing the bitstream
+ *      test            // test to perform
+ *      fn              // iterate function of the test
+ *
+ * This function does not return on error.
+ */
+void
+validate_iterate(struct thread_state *thread_state, enum test test, void (*fn) (struct thread_state *))
+{
+	struct thread_state alternate;	// thread_state recording into the run state private to the thread
+	struct thread_state reference;	// thread_state of the reference implementation
+	struct validate *validate;	// run states of the thread
+
+	/*
+	 * Check preconditions (firewall)
+	 */
+	if (thread_state == NULL || fn == NULL) {
+		err(98, __func__, "thread_state or fn arg is NULL");
+	}
+	struct state *state = thread_state->global_state;
+	if (state == NULL || state->validate == NULL) {
+		err(98, __func__, "state arg is NULL or -V was not set up");
+	}
+	if (test < 1 || test > NUMOFTESTS) {
+		err(98, __func__, "test arg: %d must be in the range [1, %d]", test, NUMOFTESTS);
+	}
+	if (thread_state->thread_id < 0 || thread_state->thread_id >= state->numberOfThreads) {
+		err(98, __func__, "thread_id: %ld must be in [0, %ld)", thread_state->thread_id, state->numberOfThreads);
+	}
+	validate = &state->validate[thread_state->thread_id];
+
+	/*
+	 * Test the bitstream as the run is set up
+	 */
+	alternate = *thread_state;
+	alternate.global_state = &validate->alternate;
+	alternate.mutex = NULL;
+	fn(&alternate);
+
+	/*
+	 * Test it with the reference implementation, which counts the patterns of the bitstream anew
+	 */
+	forgetPatterns(state, thread_state->thread_id);
+	reference = *thread_state;
+	reference.global_state = &validate->reference;
+	reference.mutex = NULL;
+	reference.lane = NULL;
+	fn(&reference);
+
+	/*
+	 * Compare, record the results of the run as set up, and forget both
+	 */
+	validate_compare(validate, thread_state, test);
+	validate_merge(thread_state, &validate->alternate, test);
+	validate_clear(&validate->alternate, test);
+	validate_clear(&validate->reference, test);
+}
+
+
+/*
+ * validate_report - report the comparisons of the run, exit if some results differ
+ *
+ * given:
+ *      state           // run state
+ *
+ * Does nothing without -V.
+ *
+ * This function does not return if some results differ from the reference implementation.
+ */
+void
+validate_report(struct state *state)
+{
+	long int compared;	// bitstreams of a test compared
+	long int rounded;	// bitstreams of a test with p-values within the budget
+	long int differ;	// bitstreams of a test whose results differ
+	long int total = 0;	// results compared
+	long int total_rounded = 0;	// results with p-values within the budget
+	long int total_differ = 0;	// results that differ
+	int tests_differ = 0;	// tests with results that differ
+	long int t;
+	int i;
+
+	/*
+	 * Check preconditions (firewall)
+	 */
+	if (state == NULL) {
+		err(99, __func__, "state arg is NULL");
+	}
+	if (state->validate == NULL) {
+		return;
+	}
+
+	for (i = 1; i <= NUMOFTESTS; i++) {
+		if (state->testVector[i] != true) {
+			continue;
+		}
+		compared = 0;
+		rounded = 0;
+		differ = 0;
+		for (t = 0; t < state->numberOfThreads; t++) {
+			compared += state->validate[t].compared[i];
+			rounded += state->validate[t].rounded[i];
+			differ += state->validate[t].differ[i];
+		}
+		if (differ > 0) {
+			msg("validate: %s: %ld of %ld bitstreams differ from the reference implementation",
+			    state->testNames[i], differ, compared);
+			++tests_differ;
+		} else {
+			dbg(DBG_LOW, "validate: %s: %ld bitstreams agree with the reference implementation, %ld within %d ulp",
+			    state->testNames[i], compared, rounded, VALIDATE_ULP);
+		}
+		total += compared;
+		total_rounded += rounded;
+		total_differ += differ;
+	}
+
+	if (total_differ > 0) {
+		err(97, __func__, "%ld of %ld test results of %d tests differ from the reference implementation",
+		    total_differ, total, tests_differ);
+	}
+	msg("validate: all %ld test results agree with the reference implementation, %ld with p-values within %d ulp of 1.0",
+	    total, total_rounded, VALIDATE_ULP);
+}
+
+
+/*
+ * validate_free_copy - free the results of a run state of validate_copy()
+ *
+ * given:
+ *      copy            // run state to free the results of
+ */
+static void
+validate_free_copy(struct state *copy)
+{
+	int i;
+
+	for (i = 1; i <= NUMOFTESTS; i++) {
+		if (copy->p_val[i] != NULL) {
+			free_dyn_array(copy->p_val[i]);
+			free(copy->p_val[i]);
+			copy->p_val[i] = NULL;
+		}
+		if (copy->stats[i] != NULL) {
+			free_dyn_array(copy->stats[i]);
+			free(copy->stats[i]);
+			copy->stats[i] = NULL;
+		}
+	}
+}
+
+
+/*
+ * validate_free - free the run states of validate_init()
+ *
+ * given:
+ *      state           // run state
+ */
+void
+validate_free(struct state *state)
+{
+	long int t;
+
+	/*
+	 * Check preconditions (firewall)
+	 */
+	if (state == NULL) {
+		err(99, __func__, "state arg is NULL");
+	}
+	if (state->validate == NULL) {
+		return;
+	}
+
+	for (t = 0; t < state->numberOfThreads; t++) {
+		validate_free_copy(&state->validate[t].alternate);
+		validate_free_copy(&state->validate[t].reference);
+	}
+	free(state->validate);
+	state->validate = NULL;
+}
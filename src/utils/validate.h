@@ -0,0 +1,52 @@
+/*****************************************************************************
+ V A L I D A T E  F U N C T I O N  P R O T O T Y P E S
+ *****************************************************************************/
+
+/*
+ * This code has been heavily modified by the following people:
+ *
+ *      Landon Curt Noll
+ *      Tom Gilgan
+ *      Riccardo Paccagnella
+ *
+ * See the README.md and the initial comment in sts.c for more information.
+ *
+ * WE (THOSE LISTED ABOVE WHO HEAVILY MODIFIED THIS CODE) DISCLAIM ALL
+ * WARRANTIES WITH REGARD TO THIS SOFTWARE, INCLUDING ALL IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL WE (THOSE LISTED ABOVE
+ * WHO HEAVILY MODIFIED THIS CODE) BE LIABLE FOR ANY SPECIAL, INDIRECT OR
+ * CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF
+ * USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ *
+ * chongo (Landon Curt Noll, http://www.isthe.com/chongo/index.html) /\oo/\
+ *
+ * Share and enjoy! :-)
+ */
+
+#ifndef VALIDATE_H
+#   define VALIDATE_H
+
+#   include "defs.h"
+
+#   define VALIDATE_ULP	(4)	// p-values may differ from the reference by this many units in the last place of 1.0
+#   define VALIDATE_WARN	(8)	// differences each thread reports of each test, the others are only counted
+
+/*
+ * validate - run states of a thread under -V, and what the comparisons of its bitstreams found
+ */
+struct validate {
+	struct state alternate;			// the run state, recording the results of the thread's bitstream
+	struct state reference;			// the run state of the reference implementation
+	long int compared[NUMOFTESTS + 1];	// bitstreams of each test compared
+	long int rounded[NUMOFTESTS + 1];	// bitstreams of each test with p-values that differ within VALIDATE_ULP
+	long int differ[NUMOFTESTS + 1];	// bitstreams of each test whose results differ beyond VALIDATE_ULP
+};
+
+extern void validate_init(struct state *state);
+extern void validate_iterate(struct thread_state *thread_state, enum test test, void (*fn) (struct thread_state *));
+extern void validate_report(struct state *state);
+extern void validate_free(struct state *state);
+
+#endif				/* VALIDATE_H */
@@ -0,0 +1,677 @@
+// writer.c - stream -s results to stats.txt, results.txt, data*.txt while iterating
+
+/*
+ * This code has been heavily modified by the following people:
+ *
+ *      Landon Curt Noll
+ *      Tom Gilgan
+ *      Riccardo Paccagnella
+ *
+ * See the README.md and the initial comment in sts.c for more information.
+ *
+ * WE (THOSE LISTED ABOVE WHO HEAVILY MODIFIED THIS CODE) DISCLAIM ALL
+ * WARRANTIES WITH REGARD TO THIS SOFTWARE, INCLUDING ALL IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL WE (THOSE LISTED ABOVE
+ * WHO HEAVILY MODIFIED THIS CODE) BE LIABLE FOR ANY SPECIAL, INDIRECT OR
+ * CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF
+ * USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ *
+ * chongo (Landon Curt Noll, http://www.isthe.com/chongo/index.html) /\oo/\
+ *
+ * Share and enjoy! :-)
+ */
+
+
+
+// Exit codes: 245 thru 249
+
+/*
+ * Under -s every iteration of a test leaves a record in stats[test] and its p_values in p_val[test].
+ * Rather than formatting all of them once the run is over, a writer thread formats the records
+ * as iterations complete, so the output I/O overlaps the computation of later iterations.
+ *
+ * All files of a test are opened up front with large stdio buffers, so that even the 148 data*.txt
+ * files of NonOverlappingTemplate are written with a few large writes each.
+ *
+ * Records are written in iteration order, so that the files are the same whatever the number of
+ * threads.  The threads record iterations as they complete them, and recordStats() notes the
+ * iteration of each record in statsIteration[test].  Under the iterate mutex, the writer moves
+ * the records that were not in order yet, and their p_values, into iteration order, then writes
+ * the records up to the first iteration still being tested.  The records of later iterations
+ * wait in stats[test] for it: that reorder window is bounded by the iterations the threads test
+ * at once, as the threads claim iterations in order and the readers only read so far ahead.
+ *
+ * The iterate threads append records while holding the iterate mutex.  When init reserved every
+ * result array for the whole run (state->resultsReserved), records below a count seen under the
+ * mutex never move: the writer formats them without holding the mutex.  Otherwise an array may
+ * be moved as it grows, and the writer holds the mutex while it formats.  Afterwards the records written out are dropped
+ * from stats[test] (only those already in the checkpoint file, if any), so the records waiting
+ * for the writer keep reusing the same few pages instead of filling all of stats[test].
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+#include "../utils/externs.h"
+#include "utilities.h"
+#include "writer.h"
+#include "debug.h"
+
+
+/*
+ * Writer thread, when running
+ */
+static pthread_t writer_thread;					// the writer thread
+static pthread_mutex_t *writer_mutex = NULL;			// iterate mutex, NULL ==> writer thread not running
+static pthread_cond_t writer_cond = PTHREAD_COND_INITIALIZER;	// signaled when records were recorded
+static bool writer_done = false;				// true ==> no more records will be recorded
+
+
+/*
+ * Forward static function declarations
+ */
+static FILE *open_buffered(char *pathname, char *buf, size_t size);
+static void close_buffered(FILE *stream, char *pathname);
+static void order_records(struct state *state, int test);
+static bool recorded(struct state *state, long int *ready);
+static void write_ready(struct state *state, long int *ready);
+static void drop_written(struct state *state);
+static void *writer(void *arg);
+
+
+/*
+ * open_buffered - open/truncate a file written through a given stdio buffer
+ *
+ * given:
+ *      pathname        // file to open
+ *      buf             // stdio buffer for the file
+ *      size            // size of buf
+ *
+ * returns:
+ *      Open file stream.
+ *
+ * This function does not return on error.
+ */
+static FILE *
+open_buffered(char *pathname, char *buf, size_t size)
+{
+	FILE *stream;		// the open file
+
+	dbg(DBG_HIGH, "about to open/truncate: %s", pathname);
+	stream = openTruncate(pathname);
+	errno = 0;		// paranoia
+	if (setvbuf(stream, buf, _IOFBF, size) != 0) {
+		errp(245, __func__, "cannot set a %lu byte buffer for: %s", size, pathname);
+	}
+
+	return stream;
+}
+
+
+/*
+ * close_buffered - flush and close a file opened by open_buffered()
+ *
+ * given:
+ *      stream          // open file
+ *      pathname        // pathname of the file
+ *
+ * This function does not return on error.
+ */
+static void
+close_buffered(FILE *stream, char *pathname)
+{
+	int io_ret;		// I/O return status
+
+	errno = 0;		// paranoia
+	io_ret = fflush(stream);
+	if (io_ret != 0) {
+		errp(245, __func__, "error flushing to: %s", pathname);
+	}
+	errno = 0;		// paranoia
+	io_ret = fclose(stream);
+	if (io_ret != 0) {
+		errp(245, __func__, "error closing: %s", pathname);
+	}
+}
+
+
+/*
+ * writer_open - open stats.txt, results.txt and data*.txt of every active test
+ *
+ * given:
+ *      state           // run state
+ *
+ * Nothing is done if the files are already open, or if -s was not given.
+ * Under -L manifest, the files of each source go in a sourceNNNN directory under each test directory.
+ *
+ * This function does not return on error.
+ */
+void
+writer_open(struct state *state)
+{
+	struct test_output *out;		// files of the test being opened
+	char data_filename[BUFSIZ + 1];		// Basename for a given data*.txt pathname
+	char source_dirname[BUFSIZ + 1];	// Basename of the directory of a -L manifest source
+	char *dir;				// Directory holding the files of the test
+	int snprintf_ret;			// snprintf return value
+	int i;
+	long int j;
+
+	/*
+	 * Check preconditions (firewall)
+	 */
+	if (state == NULL) {
+		err(246, __func__, "state arg is NULL");
+	}
+	if (state->resultstxtFlag == false || state->output != NULL) {
+		return;
+	}
+
+	state->output = calloc(NUMOFTESTS + 1, sizeof(state->output[0]));
+	if (state->output == NULL) {
+		errp(246, __func__, "cannot calloc %d test outputs", NUMOFTESTS + 1);
+	}
+	for (i = 1; i <= NUMOFTESTS; i++) {
+		if (state->testVector[i] != true || state->stats[i] == NULL) {
+			continue;
+		}
+		out = &state->output[i];
+		if (state->partitionCount[i] < 1) {
+			err(246, __func__, "%s[%d] has state.partitionCount: %d < 1",
+			    state->testNames[i], i, state->partitionCount[i]);
+		}
+
+		/*
+		 * Under -L manifest, each source writes into its own directory under the test directory
+		 */
+		dir = state->subDir[i];
+		if (state->manifestFlag == true) {
+			errno = 0;	// paranoia
+			snprintf_ret = snprintf(source_dirname, BUFSIZ, "source%04ld", state->source + 1);
+			source_dirname[BUFSIZ] = '\0';	// paranoia
+			if (snprintf_ret <= 0 || snprintf_ret >= BUFSIZ || errno != 0) {
+				errp(246, __func__, "snprintf failed for %d bytes for source%04ld, returned: %d",
+				     BUFSIZ, state->source + 1, snprintf_ret);
+			}
+			dir = filePathName(state->subDir[i], source_dirname);
+			precheckPath(state, dir);
+		}
+
+		/*
+		 * Open stats.txt and results.txt
+		 */
+		out->stats_buf = malloc(WRITER_BUFSIZ);
+		out->results_buf = malloc(WRITER_BUFSIZ);
+		if (out->stats_buf == NULL || out->results_buf == NULL) {
+			errp(246, __func__, "cannot malloc stdio buffers for %s[%d]", state->testNames[i], i);
+		}
+		out->stats_txt = filePathName(dir, "stats.txt");
+		out->stats = open_buffered(out->stats_txt, out->stats_buf, WRITER_BUFSIZ);
+		out->results_txt = filePathName(dir, "results.txt");
+		out->results = open_buffered(out->results_txt, out->results_buf, WRITER_BUFSIZ);
+
+		/*
+		 * Open a data*.txt for each partition if we need to partition results
+		 */
+		if (state->partitionCount[i] > 1) {
+			if (state->datatxt_fmt[i] == NULL) {
+				err(246, __func__, "format for data0*.txt filename of %s[%d] is NULL", state->testNames[i], i);
+			}
+			out->data = malloc(state->partitionCount[i] * sizeof(out->data[0]));
+			out->data_txt = malloc(state->partitionCount[i] * sizeof(out->data_txt[0]));
+			out->data_buf = malloc(state->partitionCount[i] * WRITER_DATA_BUFSIZ);
+			if (out->data == NULL || out->data_txt == NULL || out->data_buf == NULL) {
+				errp(246, __func__, "cannot malloc %d data*.txt files for %s[%d]",
+				     state->partitionCount[i], state->testNames[i], i);
+			}
+			for (j = 0; j < state->partitionCount[i]; ++j) {
+
+				/*
+				 * Form the data*.txt basename
+				 */
+				errno = 0;	// paranoia
+				snprintf_ret = snprintf(data_filename, BUFSIZ, state->datatxt_fmt[i], j + 1);
+				data_filename[BUFSIZ] = '\0';	// paranoia
+				if (snprintf_ret <= 0 || snprintf_ret >= BUFSIZ || errno != 0) {
+					errp(246, __func__, "snprintf failed for %d bytes for data%03ld.txt, returned: %d",
+					     BUFSIZ, j + 1, snprintf_ret);
+				}
+
+				out->data_txt[j] = filePathName(dir, data_filename);
+				out->data[j] = open_buffered(out->data_txt[j], out->data_buf + (j * WRITER_DATA_BUFSIZ),
+							     WRITER_DATA_BUFSIZ);
+			}
+		}
+
+		out->swap = malloc(MAX(state->stats[i]->elm_size, state->partitionCount[i] * state->p_val[i]->elm_size));
+		if (out->swap == NULL) {
+			errp(246, __func__, "cannot malloc the record swap buffer of %s[%d]", state->testNames[i], i);
+		}
+
+		/*
+		 * Everything in stats[i] is still to be written, including records restored by -r
+		 */
+		out->written = 0;
+		out->first = 0;
+		out->ordered = 0;
+		if (dir != state->subDir[i]) {
+			free(dir);
+		}
+	}
+}
+
+
+/*
+ * order_records - move the records of a test not yet in iteration order into it
+ *
+ * given:
+ *      state           // run state
+ *      test            // test whose records to order
+ *
+ * The records before the iteration out->ordered are in order already, and are left alone: the
+ * writer may be writing them.  The others are insertion sorted by their iteration, which moves
+ * few of them, as threads complete their iterations about in the order they claim them.
+ *
+ * NOTE: The caller must hold the iterate mutex when the iterate threads are running.
+ *
+ * This function does not return on error.
+ */
+static void
+order_records(struct state *state, int test)
+{
+	struct test_output *out = &state->output[test];	// files of the test
+	struct dyn_array *stats = state->stats[test];		// stats of the records
+	struct dyn_array *p_val = state->p_val[test];		// p_values, partitionCount of them per record
+	struct dyn_array *iteration = state->statsIteration[test];	// iteration of each record
+	size_t stat_size = stats->elm_size;			// bytes of the stats of a record
+	size_t p_val_size;			// bytes of the p_values of a record
+	char *a;				// record to swap
+	char *b;				// record to swap with
+	long int it;				// iteration being moved
+	long int k;
+	long int m;
+
+	if (iteration == NULL) {
+		out->ordered = out->first + stats->count;
+		return;
+	}
+	if (iteration->count != stats->count || p_val->count < (out->first + stats->count) * state->partitionCount[test]) {
+		err(249, __func__, "%s[%d] has %ld records, %ld iterations of them and %ld p_values",
+		    state->testNames[test], test, stats->count, iteration->count, p_val->count);
+	}
+	p_val_size = state->partitionCount[test] * p_val->elm_size;
+
+	/*
+	 * Insertion sort the records from the first one that was not in order
+	 */
+	for (k = out->ordered - out->first + 1; k < stats->count; k++) {
+		it = get_value(iteration, long int, k);
+		for (m = k; m > out->ordered - out->first && get_value(iteration, long int, m - 1) > it; m--) {
+			a = (char *) stats->data + (m - 1) * stat_size;
+			b = a + stat_size;
+			memcpy(out->swap, a, stat_size);
+			memcpy(a, b, stat_size);
+			memcpy(b, out->swap, stat_size);
+			a = (char *) p_val->data + (out->first + m - 1) * p_val_size;
+			b = a + p_val_size;
+			memcpy(out->swap, a, p_val_size);
+			memcpy(a, b, p_val_size);
+			memcpy(b, out->swap, p_val_size);
+			get_value(iteration, long int, m) = get_value(iteration, long int, m - 1);
+		}
+		get_value(iteration, long int, m) = it;
+	}
+
+	/*
+	 * The records are in order up to the first iteration not recorded yet
+	 */
+	while (out->ordered - out->first < stats->count &&
+	       get_value(iteration, long int, out->ordered - out->first) == out->ordered) {
+		out->ordered++;
+	}
+}
+
+
+/*
+ * recorded - determine how many iterations of each test were recorded
+ *
+ * given:
+ *      state           // run state
+ *      ready           // for each test, set to the number of iterations recorded so far, in order
+ *
+ * returns:
+ *      true ==> some test has recorded iterations, in order, not written yet
+ *
+ * NOTE: The caller must hold the iterate mutex when the iterate threads are running.
+ */
+static bool
+recorded(struct state *state, long int *ready)
+{
+	struct test_output *out;	// files of a test
+	bool pending = false;		// true ==> some iterations were not written yet
+	int i;
+
+	for (i = 1; i <= NUMOFTESTS; i++) {
+		out = &state->output[i];
+		if (out->stats == NULL) {
+			ready[i] = 0;
+			continue;
+		}
+		order_records(state, i);
+		ready[i] = out->ordered;
+		if (ready[i] > out->written) {
+			pending = true;
+		}
+	}
+
+	return pending;
+}
+
+
+/*
+ * write_ready - write the recorded iterations of each test that were not written yet
+ *
+ * given:
+ *      state           // run state
+ *      ready           // for each test, number of iterations recorded as returned by recorded()
+ */
+static void
+write_ready(struct state *state, long int *ready)
+{
+	struct test_output *out;	// files of a test
+	int i;
+
+	for (i = 1; i <= NUMOFTESTS; i++) {
+		out = &state->output[i];
+		if (out->stats != NULL && ready[i] > out->written) {
+			print_iterations(state, i, out->written, ready[i]);
+			out->written = ready[i];
+		}
+	}
+}
+
+
+/*
+ * drop_written - drop the stats records that were written and are no longer needed
+ *
+ * given:
+ *      state           // run state
+ *
+ * While a checkpoint file is open, records not yet in the checkpoint file are kept for it.
+ *
+ * NOTE: The caller must hold the iterate mutex.
+ */
+static void
+drop_written(struct state *state)
+{
+	struct test_output *out;	// files of a test
+	long int done;			// number of records that may be dropped
+	int i;
+
+	for (i = 1; i <= NUMOFTESTS; i++) {
+		out = &state->output[i];
+		if (out->stats == NULL) {
+			continue;
+		}
+		done = out->written - out->first;
+		if (state->checkpointFile != NULL) {
+			done = MIN(done, state->checkpointStats[i]);
+			state->checkpointStats[i] -= done;
+		}
+		drop_dyn_array(state->stats[i], done);
+		if (state->statsIteration[i] != NULL) {
+			drop_dyn_array(state->statsIteration[i], done);
+		}
+		out->first += done;
+	}
+}
+
+
+/*
+ * writer - body of the writer thread
+ *
+ * given:
+ *      arg             // run state
+ */
+static void *
+writer(void *arg)
+{
+	struct state *state = (struct state *) arg;	// run state
+	long int ready[NUMOFTESTS + 1];			// number of iterations of each test recorded
+
+	dbg(DBG_HIGH, "Writer thread started.");
+	pthread_mutex_lock(writer_mutex);
+	while (1) {
+
+		/*
+		 * Wait for iterations to complete
+		 */
+		if (recorded(state, ready) == false) {
+			if (writer_done == true) {
+				break;
+			}
+			pthread_cond_wait(&writer_cond, writer_mutex);
+			continue;
+		}
+
+		/*
+		 * Let the iterate threads go on while we write, unless they may move the records
+		 */
+		if (state->resultsReserved == true) {
+			pthread_mutex_unlock(writer_mutex);
+			write_ready(state, ready);
+			pthread_mutex_lock(writer_mutex);
+		} else {
+			write_ready(state, ready);
+		}
+		drop_written(state);
+	}
+	pthread_mutex_unlock(writer_mutex);
+	dbg(DBG_HIGH, "Writer thread done.");
+
+	return NULL;
+}
+
+
+/*
+ * writer_start - start writing -s results while iterating
+ *
+ * given:
+ *      state           // run state
+ *      mutex           // mutex the iterate threads hold while recording results
+ *
+ * Nothing is done unless -s was given.
+ *
+ * This function does not return on error.
+ */
+void
+writer_start(struct state *state, pthread_mutex_t *mutex)
+{
+	int io_ret;		// pthread return status
+
+	/*
+	 * Check preconditions (firewall)
+	 */
+	if (state == NULL) {
+		err(247, __func__, "state arg is NULL");
+	}
+	if (mutex == NULL) {
+		err(247, __func__, "mutex arg is NULL");
+	}
+	if (writer_mutex != NULL) {
+		err(247, __func__, "writer thread is already running");
+	}
+	if (state->resultstxtFlag == false) {
+		return;
+	}
+
+	writer_open(state);
+	writer_mutex = mutex;
+	writer_done = false;
+	io_ret = pthread_create(&writer_thread, NULL, writer, state);
+	if (io_ret != 0) {
+		errno = io_ret;
+		errp(247, __func__, "error on pthread_create()");
+	}
+}
+
+
+/*
+ * writer_notify - let the writer thread know that an iteration was recorded
+ *
+ * given:
+ *      state           // run state
+ *
+ * NOTE: The caller must hold the iterate mutex.
+ */
+void
+writer_notify(struct state *state)
+{
+	if (state != NULL && writer_mutex != NULL) {
+		pthread_cond_signal(&writer_cond);
+	}
+}
+
+
+/*
+ * writer_order - put the records of every test in iteration order
+ *
+ * given:
+ *      state           // run state
+ *
+ * Called before a checkpoint, while no iteration is in flight, so that the checkpoint file holds
+ * the records in iteration order.  Nothing is done unless -s was given.
+ *
+ * NOTE: The caller must hold the iterate mutex when the iterate threads are running.
+ */
+void
+writer_order(struct state *state)
+{
+	int i;
+
+	if (state == NULL || state->output == NULL) {
+		return;
+	}
+	for (i = 1; i <= NUMOFTESTS; i++) {
+		if (state->output[i].stats != NULL) {
+			order_records(state, i);
+		}
+	}
+}
+
+
+/*
+ * writer_stop - wait for the writer thread to write every recorded iteration
+ *
+ * given:
+ *      state           // run state
+ *
+ * NOTE: Must be called once the iterate threads are done.
+ *
+ * This function does not return on error.
+ */
+void
+writer_stop(struct state *state)
+{
+	int io_ret;		// pthread return status
+
+	/*
+	 * Check preconditions (firewall)
+	 */
+	if (state == NULL) {
+		err(248, __func__, "state arg is NULL");
+	}
+	if (writer_mutex == NULL) {
+		return;
+	}
+
+	pthread_mutex_lock(writer_mutex);
+	writer_done = true;
+	pthread_cond_signal(&writer_cond);
+	pthread_mutex_unlock(writer_mutex);
+	io_ret = pthread_join(writer_thread, NULL);
+	if (io_ret != 0) {
+		errno = io_ret;
+		errp(248, __func__, "error on pthread_join()");
+	}
+	writer_mutex = NULL;
+}
+
+
+/*
+ * writer_close - write whatever is left and close stats.txt, results.txt and data*.txt
+ *
+ * given:
+ *      state           // run state
+ *
+ * The files are opened here if no writer thread ran, so all iterations are written now.
+ *
+ * This function does not return on error.
+ */
+void
+writer_close(struct state *state)
+{
+	struct test_output *out;	// files of a test
+	long int ready[NUMOFTESTS + 1];	// number of iterations of each test recorded
+	int i;
+	long int j;
+
+	/*
+	 * Check preconditions (firewall)
+	 */
+	if (state == NULL) {
+		err(249, __func__, "state arg is NULL");
+	}
+	if (writer_mutex != NULL) {
+		err(249, __func__, "writer thread is still running");
+	}
+	writer_open(state);
+	if (state->output == NULL) {
+		return;
+	}
+
+	/*
+	 * Write what is left
+	 */
+	if (recorded(state, ready) == true) {
+		write_ready(state, ready);
+	}
+
+	/*
+	 * Close the files of each test
+	 */
+	for (i = 1; i <= NUMOFTESTS; i++) {
+		out = &state->output[i];
+		if (out->stats == NULL) {
+			continue;
+		}
+		if (out->written != state->tp.numOfBitStreams) {
+			err(249, __func__, "wrote %ld iterations of %s[%d], expected %ld",
+			    out->written, state->testNames[i], i, state->tp.numOfBitStreams);
+		}
+
+		close_buffered(out->stats, out->stats_txt);
+		free(out->stats_txt);
+		free(out->stats_buf);
+		free(out->swap);
+		close_buffered(out->results, out->results_txt);
+		free(out->results_txt);
+		free(out->results_buf);
+		if (out->data != NULL) {
+			for (j = 0; j < state->partitionCount[i]; ++j) {
+				close_buffered(out->data[j], out->data_txt[j]);
+				free(out->data_txt[j]);
+			}
+			free(out->data);
+			free(out->data_txt);
+			free(out->data_buf);
+		}
+	}
+	free(state->output);
+	state->output = NULL;
+}
@@ -0,0 +1,63 @@
+/*****************************************************************************
+ W R I T E R  F U N C T I O N  P R O T O T Y P E S
+ *****************************************************************************/
+
+/*
+ * This code has been heavily modified by the following people:
+ *
+ *      Landon Curt Noll
+ *      Tom Gilgan
+ *      Riccardo Paccagnella
+ *
+ * See the README.md and the initial comment in sts.c for more information.
+ *
+ * WE (THOSE LISTED ABOVE WHO HEAVILY MODIFIED THIS CODE) DISCLAIM ALL
+ * WARRANTIES WITH REGARD TO THIS SOFTWARE, INCLUDING ALL IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL WE (THOSE LISTED ABOVE
+ * WHO HEAVILY MODIFIED THIS CODE) BE LIABLE FOR ANY SPECIAL, INDIRECT OR
+ * CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF
+ * USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ *
+ * chongo (Landon Curt Noll, http://www.isthe.com/chongo/index.html) /\oo/\
+ *
+ * Share and enjoy! :-)
+ */
+
+#ifndef WRITER_H
+#   define WRITER_H
+
+#   include <pthread.h>
+#   include "defs.h"
+
+#   define WRITER_BUFSIZ	(1024 * 1024)	// stdio buffer of each stats.txt and results.txt
+#   define WRITER_DATA_BUFSIZ	(64 * 1024)	// stdio buffer of each data*.txt
+
+/*
+ * test_output - the -s files of a test, written as iterations complete
+ */
+struct test_output {
+	FILE *stats;			// open stats.txt
+	char *stats_txt;		// pathname of stats.txt
+	char *stats_buf;		// stdio buffer of stats.txt
+	FILE *results;			// open results.txt
+	char *results_txt;		// pathname of results.txt
+	char *results_buf;		// stdio buffer of results.txt
+	FILE **data;			// open data*.txt files, partitionCount of them, or NULL if not partitioned
+	char **data_txt;		// pathnames of the data*.txt files
+	char *data_buf;			// stdio buffers of the data*.txt files
+	long int written;		// number of iterations written to the files
+	long int first;			// iteration whose record is the first one left in stats[test]
+	long int ordered;		// iterations whose records are in iteration order in stats[test] and p_val[test]
+	char *swap;			// buffer to swap the stats or p_values of two records
+};
+
+extern void writer_open(struct state *state);
+extern void writer_start(struct state *state, pthread_mutex_t *mutex);
+extern void writer_notify(struct state *state);
+extern void writer_order(struct state *state);
+extern void writer_stop(struct state *state);
+extern void writer_close(struct state *state);
+
+#endif				/* WRITER_H */